@@ -8,8 +8,10 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "charsets.h"
 #include "bibutils.h"
+#include "zstream.h"
 #include "args.h"
 
 void
@@ -87,7 +89,104 @@ args_encoding( int argc, char *argv[], int i, int *charset,
 	}
 }
 
-/* Must process charset info first so switches are order independent */
+static void
+args_compress( int argc, char *argv[], int i, param *p )
+{
+	int type = -1;
+	if ( i+1 < argc ) type = zstream_type( argv[i+1] );
+	if ( type==-1 ) {
+		fprintf( stderr, "%s: error --compress-output takes the argument "
+				"gzip, zstd, xz, or none\n", p->progname );
+		exit( EXIT_FAILURE );
+	}
+	if ( !zstream_available( type ) ) {
+		fprintf( stderr, "%s: %s compression is not supported by "
+				"this build\n", p->progname, zstream_name( type ) );
+		exit( EXIT_FAILURE );
+	}
+	p->compressout = type;
+}
+
+static void
+args_threads( int argc, char *argv[], int i, param *p )
+{
+	if ( i+1 >= argc || atoi( argv[i+1] ) < 1 ) {
+		fprintf( stderr, "%s: error --threads takes a positive "
+			"number of threads\n", p->progname );
+		exit( EXIT_FAILURE );
+	}
+	p->nthreads = atoi( argv[i+1] );
+}
+
+static void
+args_namecache( int argc, char *argv[], int i, param *p )
+{
+	if ( i+1 >= argc || atol( argv[i+1] ) < 1 ) {
+		fprintf( stderr, "%s: error --name-cache takes a positive "
+			"number of names\n", p->progname );
+		exit( EXIT_FAILURE );
+	}
+	p->namecache = atol( argv[i+1] );
+}
+
+static void
+args_outdir( int argc, char *argv[], int i, param *p )
+{
+	if ( i+1 >= argc || argv[i+1][0]=='\0' ) {
+		fprintf( stderr, "%s: error --output-dir takes the argument "
+			"of the directory\n", p->progname );
+		exit( EXIT_FAILURE );
+	}
+	if ( p->outdir ) free( p->outdir );
+	p->outdir = strdup( argv[i+1] );
+	if ( !p->outdir ) {
+		fprintf( stderr, "%s: Memory error when reading --output-dir\n",
+			p->progname );
+		exit( EXIT_FAILURE );
+	}
+}
+
+/* --shard-refs K, --shard-bytes B[k|m|g], --shard-hash N */
+static void
+args_shard( int argc, char *argv[], int i, param *p, int mode )
+{
+	char *end = NULL;
+	long n = -1;
+
+	if ( i+1 < argc ) n = strtol( argv[i+1], &end, 10 );
+	if ( n > 0 && mode==BIBL_SHARD_BYTES ) {
+		if      ( *end=='k' || *end=='K' ) { n *= 1024L; end++; }
+		else if ( *end=='m' || *end=='M' ) { n *= 1024L*1024L; end++; }
+		else if ( *end=='g' || *end=='G' ) { n *= 1024L*1024L*1024L; end++; }
+	}
+	if ( n < 1 || !end || *end!='\0' ) {
+		fprintf( stderr, "%s: error %s takes a positive number\n",
+			p->progname, argv[i] );
+		exit( EXIT_FAILURE );
+	}
+	p->shardmode = mode;
+	p->shardsize = n;
+}
+
+static void
+args_shardprefix( int argc, char *argv[], int i, param *p )
+{
+	if ( i+1 >= argc || argv[i+1][0]=='\0' ) {
+		fprintf( stderr, "%s: error --shard-prefix takes the argument "
+			"of the file name prefix\n", p->progname );
+		exit( EXIT_FAILURE );
+	}
+	if ( p->shardprefix ) free( p->shardprefix );
+	p->shardprefix = strdup( argv[i+1] );
+	if ( !p->shardprefix ) {
+		fprintf( stderr, "%s: Memory error when reading --shard-prefix\n",
+			p->progname );
+		exit( EXIT_FAILURE );
+	}
+}
+
+/* Must process charset, compression, and output info first so switches
+ * are order independent */
 void
 process_charsets( int *argc, char *argv[], param *p )
 {
@@ -116,6 +215,33 @@ process_charsets( int *argc, char *argv[], param *p )
 			}
 			p->charsetout_src = BIBL_SRC_USER;
 			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--compress-output" ) ) {
+			args_compress( *argc, argv, i, p );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--async-output" ) ) {
+			p->asyncout = 1;
+			subtract = 1;
+		} else if ( args_match( argv[i], NULL, "--threads" ) ) {
+			args_threads( *argc, argv, i, p );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--name-cache" ) ) {
+			args_namecache( *argc, argv, i, p );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--output-dir" ) ) {
+			args_outdir( *argc, argv, i, p );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--shard-refs" ) ) {
+			args_shard( *argc, argv, i, p, BIBL_SHARD_REFS );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--shard-bytes" ) ) {
+			args_shard( *argc, argv, i, p, BIBL_SHARD_BYTES );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--shard-hash" ) ) {
+			args_shard( *argc, argv, i, p, BIBL_SHARD_HASH );
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--shard-prefix" ) ) {
+			args_shardprefix( *argc, argv, i, p );
+			subtract = 2;
 		}
 		if ( subtract ) {
 			for ( j=i+subtract; j<*argc; ++j )
@@ -0,0 +1,464 @@
+/*
+ * bibconvert.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Program and source code released under the GPL version 2
+ *
+ * Convert directly between any input and output format, e.g.
+ *
+ *     bibconvert -i bibtex -o ris refs.bib > refs.ris
+ *
+ * gives the same output as bib2xml refs.bib | xml2ris, but the
+ * references go straight from the reader's fields to the writer
+ * without being written out as MODS XML and parsed back in; see
+ * bibl_normalize() for how the differences a trip through MODS
+ * would make are kept.
+ *
+ * The references as read can also be saved as a snapshot and converted
+ * from that later without parsing the original again:
+ *
+ *     bibconvert -i bibtex -o snapshot refs.bib > refs.snap
+ *     bibconvert -i snapshot -o ris refs.snap > refs.ris
+ *
+ * A few records can be pulled out of a large file by citekey or DOI
+ * after indexing it once:
+ *
+ *     bibconvert -i ris --make-index archive.ris
+ *     bibconvert -i ris -o bibtex -k Smith2001 -k 10.1000/xyz archive.ris
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "bibutils.h"
+#include "args.h"
+
+const char progname[] = "bibconvert";
+
+/* not a bibutils format, but handled here */
+#define SNAPSHOT (-2)
+
+#define INDEX_SUFFIX ".bidx"
+
+typedef struct {
+	const char *name;
+	int mode;
+} formatname;
+
+static formatname informats[] = {
+	{ "bibtex",     BIBL_BIBTEXIN },
+	{ "bib",        BIBL_BIBTEXIN },
+	{ "biblatex",   BIBL_BIBLATEXIN },
+	{ "copac",      BIBL_COPACIN },
+	{ "ebi",        BIBL_EBIIN },
+	{ "endnote",    BIBL_ENDNOTEIN },
+	{ "end",        BIBL_ENDNOTEIN },
+	{ "endnotexml", BIBL_ENDNOTEXMLIN },
+	{ "endx",       BIBL_ENDNOTEXMLIN },
+	{ "isi",        BIBL_ISIIN },
+	{ "medline",    BIBL_MEDLINEIN },
+	{ "med",        BIBL_MEDLINEIN },
+	{ "mods",       BIBL_MODSIN },
+	{ "xml",        BIBL_MODSIN },
+	{ "nbib",       BIBL_NBIBIN },
+	{ "ris",        BIBL_RISIN },
+	{ "snapshot",   SNAPSHOT },
+	{ "wordbib",    BIBL_WORDIN },
+};
+static int ninformats = sizeof( informats ) / sizeof( informats[0] );
+
+static formatname outformats[] = {
+	{ "ads",        BIBL_ADSABSOUT },
+	{ "bibtex",     BIBL_BIBTEXOUT },
+	{ "bib",        BIBL_BIBTEXOUT },
+	{ "endnote",    BIBL_ENDNOTEOUT },
+	{ "end",        BIBL_ENDNOTEOUT },
+	{ "isi",        BIBL_ISIOUT },
+	{ "mods",       BIBL_MODSOUT },
+	{ "xml",        BIBL_MODSOUT },
+	{ "nbib",       BIBL_NBIBOUT },
+	{ "ris",        BIBL_RISOUT },
+	{ "snapshot",   SNAPSHOT },
+	{ "wordbib",    BIBL_WORD2007OUT },
+};
+static int noutformats = sizeof( outformats ) / sizeof( outformats[0] );
+
+static void
+help( const char *progname )
+{
+	args_tellversion( progname );
+	fprintf(stderr,"Converts references directly from one format to another\n\n");
+
+	fprintf(stderr,"usage: %s -i in_format -o out_format in_file > out_file\n\n",progname);
+	fprintf(stderr,"  in_file can be replaced with file list or omitted to use as a filter\n\n");
+	fprintf(stderr,"  in_format:  bibtex, biblatex, copac, ebi, endnote, endnotexml, isi,\n");
+	fprintf(stderr,"              medline, mods, nbib, ris, snapshot, wordbib\n");
+	fprintf(stderr,"  out_format: ads, bibtex, endnote, isi, mods, nbib, ris, snapshot,\n");
+	fprintf(stderr,"              wordbib\n\n");
+
+	fprintf(stderr,"  -h, --help                display this help\n");
+	fprintf(stderr,"  -v, --version             display version\n");
+	fprintf(stderr,"  -i, --input-format FMT    read references in format FMT\n");
+	fprintf(stderr,"  -o, --output-format FMT   write references in format FMT\n");
+	fprintf(stderr,"  --make-index              write an index of each in_file to in_file%s\n", INDEX_SUFFIX );
+	fprintf(stderr,"  -k, --key KEY             convert only the reference with citekey, DOI, or PMID KEY,\n");
+	fprintf(stderr,"                            found through the index; may be repeated\n");
+	fprintf(stderr,"  --keys FILE               as -k for each line of FILE\n");
+	fprintf(stderr,"  --input-encoding          interpret the input with specified character set\n" );
+	fprintf(stderr,"  --output-encoding         write the output with specified character set\n" );
+	fprintf(stderr,"  -a, --add-refcount        add \"_#\", where # is reference count to reference\n");
+	fprintf(stderr,"  -c, --corporation-file    specify file of corporation names\n");
+	fprintf(stderr,"  -as, --asis               specify file of names that shouldn't be mangled\n");
+	fprintf(stderr,"  -nt, --nosplit-title      don't split titles into TITLE/SUBTITLE pairs\n");
+	fprintf(stderr,"  -d, --drop-key            don't write the reference key\n");
+	fprintf(stderr,"  -nb, --no-bom             do not write Byte Order Mark in UTF8 output\n");
+	fprintf(stderr,"  -fc, -sd, -b, -w, -sk, -U, -at\n");
+	fprintf(stderr,"                            bibtex output options, as for xml2bib\n");
+	fprintf(stderr,"  -s, --single-refperfile   one reference per output file\n");
+	fprintf(stderr,"  --compress-output TYPE    gzip, zstd, or xz compress the output\n");
+	fprintf(stderr,"  --async-output            write the output on a separate I/O thread\n");
+	fprintf(stderr,"  --output-dir DIR          write -s or split output files into DIR\n");
+	fprintf(stderr,"  --shard-refs K            split the output into files of K references\n");
+	fprintf(stderr,"  --shard-bytes B           split the output into files of about B bytes\n");
+	fprintf(stderr,"  --shard-hash N            split the output into N files by citekey\n");
+	fprintf(stderr,"  --shard-prefix NAME       name the split files NAME.0001... (default out)\n");
+	fprintf(stderr,"  --threads N               parse large inputs and write -s or split output\n");
+	fprintf(stderr,"                            with N threads\n");
+	fprintf(stderr,"  --name-cache N            remember the parse of about N personal names\n");
+	fprintf(stderr,"                            (--verbose reports how often it helped)\n");
+	fprintf(stderr,"  --verbose                 report all warnings\n");
+	fprintf(stderr,"  --debug                   very verbose output\n\n");
+
+	fprintf(stderr,"http://sourceforge.net/p/bibutils/home/Bibutils for more details\n\n");
+}
+
+static int
+find_format( formatname *f, int n, const char *name )
+{
+	int i;
+	for ( i=0; i<n; ++i )
+		if ( !strcasecmp( f[i].name, name ) ) return f[i].mode;
+	return -1;
+}
+
+/* find_formats()
+ *
+ * Pull -i/-o out of the arguments before anything else; elsewhere
+ * these are the short forms of --input-encoding/--output-encoding.
+ * Indexing needs no output format, so --make-index is found here too.
+ */
+static void
+find_formats( int *argc, char *argv[], int *readmode, int *writemode, int *makeindex )
+{
+	int i, j, subtract, *mode;
+	formatname *f;
+	int n;
+
+	*readmode = *writemode = -1;
+	*makeindex = 0;
+
+	i = 1;
+	while ( i<*argc ) {
+		subtract = 0;
+		if ( args_match( argv[i], "-h", "--help" ) ) {
+			help( progname );
+			exit( EXIT_SUCCESS );
+		} else if ( args_match( argv[i], "-v", "--version" ) ) {
+			args_tellversion( progname );
+			exit( EXIT_SUCCESS );
+		} else if ( args_match( argv[i], "-i", "--input-format" ) ||
+		            args_match( argv[i], "-o", "--output-format" ) ) {
+			if ( args_match( argv[i], "-i", "--input-format" ) ) {
+				mode = readmode;
+				f = informats;
+				n = ninformats;
+			} else {
+				mode = writemode;
+				f = outformats;
+				n = noutformats;
+			}
+			if ( i+1 < *argc ) *mode = find_format( f, n, argv[i+1] );
+			if ( *mode==-1 ) {
+				fprintf( stderr, "%s: error %s takes one of the formats "
+					"listed by --help\n", progname, argv[i] );
+				exit( EXIT_FAILURE );
+			}
+			subtract = 2;
+		} else if ( args_match( argv[i], NULL, "--make-index" ) ) {
+			*makeindex = 1;
+			subtract = 1;
+		}
+		if ( subtract ) {
+			for ( j=i+subtract; j<*argc; ++j )
+				argv[j-subtract] = argv[j];
+			*argc -= subtract;
+		} else i++;
+	}
+
+	if ( *makeindex ) {
+		if ( *readmode==-1 || *readmode==SNAPSHOT ) {
+			fprintf( stderr, "%s: error --make-index requires an input "
+				"format (-i) other than snapshot\n", progname );
+			exit( EXIT_FAILURE );
+		}
+		if ( *writemode==-1 ) *writemode = BIBL_MODSOUT;
+	}
+
+	if ( *readmode==-1 || *writemode==-1 ) {
+		fprintf( stderr, "%s: error both an input format (-i) and an "
+			"output format (-o) are required\n", progname );
+		exit( EXIT_FAILURE );
+	}
+}
+
+static void
+read_namelist( int argc, char *argv[], int i, param *p, int corps )
+{
+	int status;
+
+	if ( i+1 >= argc ) {
+		fprintf( stderr, "%s: error %s takes the argument of the file\n",
+			p->progname, argv[i] );
+		exit( EXIT_FAILURE );
+	}
+	if ( corps ) status = bibl_readcorps( p, argv[i+1] );
+	else status = bibl_readasis( p, argv[i+1] );
+	if ( status==BIBL_ERR_MEMERR ) {
+		fprintf( stderr, "%s: Memory error when reading %s '%s'\n",
+			p->progname, argv[i], argv[i+1] );
+		exit( EXIT_FAILURE );
+	} else if ( status==BIBL_ERR_CANTOPEN ) {
+		fprintf( stderr, "%s: Cannot read %s '%s'\n",
+			p->progname, argv[i], argv[i+1] );
+	}
+}
+
+static void
+read_keys( int argc, char *argv[], int i, slist *keys )
+{
+	slist more;
+	int status;
+
+	if ( i+1 >= argc ) {
+		fprintf( stderr, "%s: error %s takes an argument\n", progname, argv[i] );
+		exit( EXIT_FAILURE );
+	}
+	if ( args_match( argv[i], "-k", "--key" ) ) {
+		if ( !slist_addc( keys, argv[i+1] ) ) status = SLIST_ERR_MEMERR;
+		else status = SLIST_OK;
+	} else {
+		slist_init( &more );
+		status = slist_fill( &more, argv[i+1], 1 );
+		if ( status==SLIST_OK ) status = slist_append( keys, &more );
+		else if ( status==SLIST_ERR_CANTOPEN )
+			fprintf( stderr, "%s: Cannot read %s '%s'\n", progname, argv[i], argv[i+1] );
+		slist_free( &more );
+	}
+	if ( status==SLIST_ERR_MEMERR ) {
+		fprintf( stderr, "%s: Memory error when reading %s '%s'\n",
+			progname, argv[i], argv[i+1] );
+		exit( EXIT_FAILURE );
+	}
+}
+
+static void
+process_args( int *argc, char *argv[], param *p, slist *keys )
+{
+	int i, j, subtract;
+	i = 1;
+	while ( i<*argc ) {
+		subtract = 0;
+		if ( args_match( argv[i], "-a", "--add-refcount" ) ) {
+			p->addcount = 1;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-c", "--corporation-file" ) ) {
+			read_namelist( *argc, argv, i, p, 1 );
+			subtract = 2;
+		} else if ( args_match( argv[i], "-as", "--asis" ) ) {
+			read_namelist( *argc, argv, i, p, 0 );
+			subtract = 2;
+		} else if ( args_match( argv[i], "-k", "--key" ) ||
+		            args_match( argv[i], NULL, "--keys" ) ) {
+			read_keys( *argc, argv, i, keys );
+			subtract = 2;
+		} else if ( args_match( argv[i], "-nt", "--nosplit-title" ) ) {
+			p->nosplittitle = 1;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-d", "--drop-key" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_DROPKEY |
+			                  BIBL_FORMAT_MODSOUT_DROPKEY;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-nb", "--no-bom" ) ) {
+			p->utf8bom = 0;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-fc", "--finalcomma" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_FINALCOMMA;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-sd", "--singledash" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_SINGLEDASH;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-b", "--brackets" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_BRACKETS;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-w", "--whitespace" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_WHITESPACE;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-sk", "--strictkey" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_STRICTKEY;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-U", "--uppercase" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_UPPERCASE;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-at", "--abbreviated-titles" ) ) {
+			p->format_opts |= BIBL_FORMAT_BIBOUT_SHORTTITLE;
+			subtract = 1;
+		} else if ( args_match( argv[i], "-s", "--single-refperfile" ) ) {
+			p->singlerefperfile = 1;
+			subtract = 1;
+		} else if ( args_match( argv[i], NULL, "--verbose" ) ) {
+			if ( p->verbose<1 ) p->verbose = 1;
+			subtract = 1;
+		} else if ( args_match( argv[i], NULL, "--debug" ) ) {
+			p->verbose = 3;
+			subtract = 1;
+		}
+		if ( subtract ) {
+			for ( j=i+subtract; j<*argc; ++j )
+				argv[j-subtract] = argv[j];
+			*argc -= subtract;
+		} else {
+			if ( argv[i][0]=='-' ) fprintf( stderr, "Warning: Did not recognize potential command-line argument %s\n", argv[i] );
+			i++;
+		}
+	}
+}
+
+static FILE *
+open_index( const char *filename, const char *mode )
+{
+	FILE *fp;
+	str path;
+
+	str_init( &path );
+	str_mergestrs( &path, filename, INDEX_SUFFIX, NULL );
+	if ( str_memerr( &path ) ) fp = NULL;
+	else fp = fopen( str_cstr( &path ), mode );
+	str_free( &path );
+
+	return fp;
+}
+
+static int
+readrefs( bibl *b, FILE *fp, char *filename, param *p, int readmode, slist *keys )
+{
+	FILE *idxfp;
+	int err;
+
+	if ( readmode==SNAPSHOT ) return bibl_readsnapshot( b, fp, p );
+	if ( keys->n==0 ) return bibl_read( b, fp, filename, p );
+
+	idxfp = open_index( filename, "r" );
+	if ( !idxfp ) return BIBL_ERR_INDEX;
+	err = bibl_readindexed( b, fp, filename, idxfp, keys, p );
+	fclose( idxfp );
+	return err;
+}
+
+static void
+makeindex( int argc, char *argv[], param *p )
+{
+	FILE *fp, *idxfp;
+	int err, i;
+
+	if ( argc<2 ) {
+		fprintf( stderr, "%s: error --make-index requires input files\n", progname );
+		exit( EXIT_FAILURE );
+	}
+
+	for ( i=1; i<argc; ++i ) {
+		fp = fopen( argv[i], "r" );
+		if ( !fp ) {
+			fprintf( stderr, "%s: Cannot read '%s'\n", progname, argv[i] );
+			continue;
+		}
+		idxfp = open_index( argv[i], "w" );
+		if ( !idxfp ) {
+			fprintf( stderr, "%s: Cannot write index '%s%s'\n", progname, argv[i], INDEX_SUFFIX );
+			fclose( fp );
+			continue;
+		}
+		err = bibl_writeindex( fp, argv[i], idxfp, p );
+		if ( err ) bibl_reporterr( err );
+		fclose( idxfp );
+		fclose( fp );
+	}
+}
+
+/* as bibprog(), but the references are normalized between reading
+ * and writing */
+static void
+convert( int argc, char *argv[], param *p, int readmode, int writemode, slist *keys )
+{
+	FILE *fp;
+	bibl b;
+	int err, i;
+
+	bibl_init( &b );
+	if ( argc<2 ) {
+		if ( keys->n ) {
+			fprintf( stderr, "%s: error -k needs indexed input files, "
+				"not standard input\n", progname );
+			exit( EXIT_FAILURE );
+		}
+		err = readrefs( &b, stdin, "stdin", p, readmode, keys );
+		if ( err ) bibl_reporterr( err );
+	} else {
+		for ( i=1; i<argc; ++i ) {
+			fp = fopen( argv[i], "r" );
+			if ( fp ) {
+				err = readrefs( &b, fp, argv[i], p, readmode, keys );
+				if ( err ) bibl_reporterr( err );
+				fclose( fp );
+			}
+		}
+	}
+	if ( writemode==SNAPSHOT ) {
+		err = bibl_writesnapshot( &b, stdout, p );
+		if ( err ) bibl_reporterr( err );
+	} else {
+		err = bibl_normalize( &b, p );
+		if ( err ) bibl_reporterr( err );
+		err = bibl_write( &b, stdout, p );
+		if ( err ) bibl_reporterr( err );
+	}
+	fflush( stdout );
+	if ( p->progname ) fprintf( stderr, "%s: ", p->progname );
+	fprintf( stderr, "Processed %ld references.\n", b.nrefs );
+	bibl_free( &b );
+	if ( err ) exit( EXIT_FAILURE );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int readmode, writemode, indexing;
+	slist keys;
+	param p;
+
+	find_formats( &argc, argv, &readmode, &writemode, &indexing );
+	/* a snapshot records its own input format; any reader and
+	 * writer will do to set up the parameters */
+	bibl_initparams( &p, ( readmode==SNAPSHOT ) ? BIBL_MODSIN : readmode,
+		( writemode==SNAPSHOT ) ? BIBL_MODSOUT : writemode,
+		( char * ) progname );
+	process_charsets( &argc, argv, &p );
+	slist_init( &keys );
+	process_args( &argc, argv, &p, &keys );
+	if ( indexing ) makeindex( argc, argv, &p );
+	else convert( argc, argv, &p, readmode, writemode, &keys );
+	slist_free( &keys );
+	bibl_freeparams( &p );
+	return EXIT_SUCCESS;
+}
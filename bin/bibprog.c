@@ -7,6 +7,7 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include "bibutils.h"
 #include "bibprog.h"
 
@@ -31,10 +32,12 @@ bibprog( int argc, char *argv[], param *p )
 			}
 		} 
 	}
-	bibl_write( &b, stdout, p );
+	err = bibl_write( &b, stdout, p );
+	if ( err ) bibl_reporterr( err );
 	fflush( stdout );
 	if( p->progname ) fprintf( stderr, "%s: ", p->progname );
 	fprintf( stderr, "Processed %ld references.\n", b.nrefs );
 	bibl_free( &b );
+	if ( err ) exit( EXIT_FAILURE );
 }
 
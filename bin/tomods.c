@@ -30,6 +30,13 @@ args_tomods_help( char *progname, char *help1, char *help2 )
 	fprintf(stderr,"  -v, --version             display version\n");
 	fprintf(stderr,"  -a, --add-refcount        add \"_#\", where # is reference count to reference\n");
 	fprintf(stderr,"  -s, --single-refperfile   one reference per output file\n");
+	fprintf(stderr,"  --output-dir DIR          write -s or split output files into DIR\n");
+	fprintf(stderr,"  --shard-refs K            split the output into files of K references\n");
+	fprintf(stderr,"  --shard-bytes B           split the output into files of about B bytes\n");
+	fprintf(stderr,"  --shard-hash N            split the output into N files by citekey\n");
+	fprintf(stderr,"  --shard-prefix NAME       name the split files NAME.0001.xml... (default out)\n");
+	fprintf(stderr,"  --compress-output TYPE    gzip, zstd, or xz compress the output\n");
+	fprintf(stderr,"  --async-output            write the output on a separate I/O thread\n");
 	fprintf(stderr,"  -i, --input-encoding      input character encoding\n");
 	fprintf(stderr,"  -o, --output-encoding     output character encoding\n");
 	fprintf(stderr,"  -u, --unicode-characters  DEFAULT: write unicode (not xml entities)\n");
@@ -40,6 +47,10 @@ args_tomods_help( char *progname, char *help1, char *help2 )
 	fprintf(stderr,"  -c, --corporation-file    specify file of corporation names\n");
 	fprintf(stderr,"  -as, --asis               specify file of names that shouldn't be mangled\n");
 	fprintf(stderr,"  -nt, --nosplit-title      don't split titles into TITLE/SUBTITLE pairs\n");
+	fprintf(stderr,"  --threads N               parse large RIS, ISI, BibTeX, PubMed inputs and\n");
+	fprintf(stderr,"                            write -s output with N threads\n");
+	fprintf(stderr,"  --name-cache N            remember the parse of about N personal names\n");
+	fprintf(stderr,"                            (--verbose reports how often it helped)\n");
 	fprintf(stderr,"  --verbose                 report all warnings\n");
 	fprintf(stderr,"  --debug                   very verbose output\n\n");
 
@@ -28,6 +28,14 @@ help( char *progname )
 	fprintf(stderr,"  -v, --version  display version\n\n");
 	fprintf(stderr,"  -nb, --no-bom  do not write Byte Order Mark in UTF8 output\n");
 	fprintf(stderr,"  -s, --single-refperfile one reference per output file\n");
+	fprintf(stderr,"  --compress-output TYPE  gzip, zstd, or xz compress the output\n");
+	fprintf(stderr,"  --async-output          write the output on a separate I/O thread\n");
+	fprintf(stderr,"  --output-dir DIR        write -s or split output files into DIR\n");
+	fprintf(stderr,"  --shard-refs K          split the output into files of K references\n");
+	fprintf(stderr,"  --shard-bytes B         split the output into files of about B bytes\n");
+	fprintf(stderr,"  --shard-hash N          split the output into N files by citekey\n");
+	fprintf(stderr,"  --shard-prefix NAME     name the split files NAME.0001... (default out)\n");
+	fprintf(stderr,"  --threads N             write -s output files with N threads\n");
 	fprintf(stderr,"  -i, --input-encoding  interpret the input with specified character set\n" );
 	fprintf(stderr,"                        (use w/o argument for current list)\n" );
 	fprintf(stderr,"  -o, --output-encoding write the output with specified character set\n" );
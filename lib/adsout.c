@@ -16,13 +16,16 @@
 #include "str.h"
 #include "strsearch.h"
 #include "fields.h"
+#include "outfields.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
+#include "outsink.h"
 #include "bibformats.h"
+#include "adsout_journals.h"
 
-static int  adsout_write( fields *in, FILE *fp, param *p, unsigned long refnum );
-static void adsout_writeheader( FILE *outptr, param *p );
+static int  adsout_write( fields *in, outsink *fp, param *p, unsigned long refnum );
+static void adsout_writeheader( outsink *outptr, param *p );
 
 void
 adsout_initparams( param *p, const char *progname )
@@ -39,6 +42,12 @@ adsout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	if ( p->charsetout == BIBL_CHARSET_UNICODE ) {
 		p->utf8out = p->utf8bom = 1;
@@ -158,7 +167,7 @@ get_type( fields *in )
 }
 
 static int
-append_title( fields *in, char *ttl, char *sub, char *adstag, int level, fields *out, int *status )
+append_title( fields *in, char *ttl, char *sub, char *adstag, int level, outfields *out, int *status )
 {
 	str fulltitle, *title, *subtitle, *vol, *iss, *sn, *en, *ar;
 	int fstatus, output = 0;
@@ -212,7 +221,7 @@ append_title( fields *in, char *ttl, char *sub, char *adstag, int level, fields
 			goto out;
 		}
 
-		fstatus = fields_add( out, adstag, str_cstr( &fulltitle ), LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, str_cstr( &fulltitle ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 
 	}
@@ -224,7 +233,7 @@ out:
 }
 
 static void
-append_titles( fields *in, int type, fields *out, int *status )
+append_titles( fields *in, int type, outfields *out, int *status )
 {
 	int added;
 	if ( type==TYPE_ARTICLE || type==TYPE_MAGARTICLE ) {
@@ -235,7 +244,7 @@ append_titles( fields *in, int type, fields *out, int *status )
 }
 
 static void
-append_people( fields *in, char *tag1, char *tag2, char *tag3, char *adstag, int level, fields *out, int *status )
+append_people( fields *in, char *tag1, char *tag2, char *tag3, char *adstag, int level, outfields *out, int *status )
 {
 	str oneperson, allpeople;
 	vplist_index i;
@@ -253,7 +262,7 @@ append_people( fields *in, char *tag1, char *tag2, char *tag3, char *adstag, int
 			name_build_withcomma( &oneperson, (char *) vplist_get( &a, i) );
 			str_strcat( &allpeople, &oneperson );
 		}
-		fstatus = fields_add( out, adstag, str_cstr( &allpeople ), LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, str_cstr( &allpeople ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -263,7 +272,7 @@ append_people( fields *in, char *tag1, char *tag2, char *tag3, char *adstag, int
 }
 
 static void
-append_pages( fields *in, fields *out, int *status )
+append_pages( fields *in, outfields *out, int *status )
 {
 	str *sn, *en, *ar;
 	int fstatus;
@@ -273,7 +282,7 @@ append_pages( fields *in, fields *out, int *status )
 	ar = fields_findv( in, LEVEL_ANY, FIELDS_STRP, "ARTICLENUMBER" );
 
 	if ( str_has_value( sn ) ) {
-		fstatus = fields_add( out, "%P", str_cstr( sn ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "%P", str_cstr( sn ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -281,7 +290,7 @@ append_pages( fields *in, fields *out, int *status )
 	}
 
 	else if ( str_has_value( ar ) ) {
-		fstatus = fields_add( out, "%P", str_cstr( ar ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "%P", str_cstr( ar ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -289,7 +298,7 @@ append_pages( fields *in, fields *out, int *status )
 	}
 
 	if ( str_has_value( en ) ) {
-		fstatus = fields_add( out, "%L", str_cstr( en ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "%L", str_cstr( en ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -323,7 +332,7 @@ get_month( fields *in, int level )
 }
 
 static void
-append_date( fields *in, char *adstag, int level, fields *out, int *status )
+append_date( fields *in, char *adstag, int level, outfields *out, int *status )
 {
 	int month, fstatus;
 	char outstr[1000];
@@ -333,13 +342,11 @@ append_date( fields *in, char *adstag, int level, fields *out, int *status )
 	if ( str_has_value( year ) ) {
 		month = get_month( in, level );
 		sprintf( outstr, "%02d/%s", month, str_cstr( year ) );
-		fstatus = fields_add( out, adstag, outstr, LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, outstr, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
-#include "adsout_journals.c"
-
 static void
 output_4digit_value( char *pos, long long n )
 {
@@ -461,28 +468,11 @@ get_firstinitial( fields *in )
 	} else return '\0';
 }
 
-static int
-get_journalabbr( fields *in )
-{
-	char *jrnl;
-	int n, j;
-
-	n = fields_find( in, "TITLE", LEVEL_HOST );
-	if ( n!=FIELDS_NOTFOUND ) {
-		jrnl = fields_value( in, n, FIELDS_CHRP );
-		for ( j=0; j<njournals; j++ ) {
-			if ( !strcasecmp( jrnl, journals[j]+6 ) )
-				return j;
-		}
-	}
-	return -1;
-}
-
 static void
-append_Rtag( fields *in, char *adstag, int type, fields *out, int *status )
+append_Rtag( fields *in, char *adstag, int type, outfields *out, int *status )
 {
-	char outstr[20], ch;
-	int n, i, fstatus;
+	char outstr[20], abbr[6], ch;
+	int n, fstatus;
 	long long page;
 
 	strcpy( outstr, "..................." );
@@ -493,14 +483,9 @@ append_Rtag( fields *in, char *adstag, int type, fields *out, int *status )
 	if ( n!=FIELDS_NOTFOUND ) output_4digit_value( outstr, atoi( fields_value( in, n, FIELDS_CHRP ) ) );
 
 	/** JJJJ */
-	n = get_journalabbr( in );
-	if ( n!=-1 ) {
-		i = 0;
-		while ( i<5 && journals[n][i]!=' ' && journals[n][i]!='\t' ) {
-			outstr[4+i] = journals[n][i];
-			i++;
-		}
-	}
+	n = fields_find( in, "TITLE", LEVEL_HOST );
+	if ( n!=FIELDS_NOTFOUND && adsout_journalabbr( fields_value( in, n, FIELDS_CHRP ), abbr ) )
+		memcpy( outstr+4, abbr, 5 );
 
 	/** VVVV */
 	n = fields_find( in, "VOLUME", LEVEL_ANY );
@@ -522,12 +507,12 @@ append_Rtag( fields *in, char *adstag, int type, fields *out, int *status )
 	 ch = toupper( (unsigned char) get_firstinitial( in ) );
 	if ( ch!='\0' ) outstr[18] = ch;
 
-	fstatus = fields_add( out, adstag, outstr, LEVEL_MAIN );
+	fstatus = outfields_add( out, adstag, outstr, LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_easyall( fields *in, char *tag, char *adstag, int level, fields *out, char *prefix, int *status )
+append_easyall( fields *in, char *tag, char *adstag, int level, outfields *out, char *prefix, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -547,7 +532,7 @@ append_easyall( fields *in, char *tag, char *adstag, int level, fields *out, cha
 			str_strcatc( &output, val );
 			val = str_cstr( &output );
 		}
-		fstatus = fields_add( out, adstag, val, LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, val, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			goto out;
@@ -559,20 +544,20 @@ out:
 }
 
 static void
-append_easy( fields *in, char *tag, char *adstag, int level, fields *out, int *status )
+append_easy( fields *in, char *tag, char *adstag, int level, outfields *out, int *status )
 {
 	char *value;
 	int fstatus;
 
 	value = fields_findv( in, level, FIELDS_CHRP, tag );
 	if ( value && value[0]!='\0' ) {
-		fstatus = fields_add( out, adstag, value, LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, value, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_keys( fields *in, char *tag, char *adstag, int level, fields *out, int *status )
+append_keys( fields *in, char *tag, char *adstag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	str allkeys;
@@ -589,7 +574,7 @@ append_keys( fields *in, char *tag, char *adstag, int level, fields *out, int *s
 			if ( i>0 ) str_strcatc( &allkeys, ", " );
 			str_strcatc( &allkeys, (char *) vplist_get( &a, i ) );
 		}
-		fstatus = fields_add( out, adstag, str_cstr( &allkeys ), LEVEL_MAIN );
+		fstatus = outfields_add( out, adstag, str_cstr( &allkeys ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -598,7 +583,7 @@ append_keys( fields *in, char *tag, char *adstag, int level, fields *out, int *s
 }
 
 static void
-append_urls( fields *in, fields *out, int *status )
+append_urls( fields *in, outfields *out, int *status )
 {
 	int lstatus;
 	slist types;
@@ -616,17 +601,17 @@ append_urls( fields *in, fields *out, int *status )
 }
 
 static void
-append_trailer( fields *out, int *status )
+append_trailer( outfields *out, int *status )
 {
 	int fstatus;
 
-	fstatus = fields_add( out, "%W", "PHY", LEVEL_MAIN );
+	fstatus = outfields_add( out, "%W", "PHY", LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) {
 		*status = BIBL_ERR_MEMERR;
 		return;
 	}
 
-	fstatus = fields_add( out, "%G", "AUTHOR", LEVEL_MAIN );
+	fstatus = outfields_add( out, "%G", "AUTHOR", LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) {
 		*status = BIBL_ERR_MEMERR;
 		return;
@@ -634,23 +619,16 @@ append_trailer( fields *out, int *status )
 }
 
 static void
-output( FILE *fp, fields *out )
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
 {
-	char *tag, *value;
-	int i;
-
-	for ( i=0; i<out->n; ++i ) {
-		tag   = fields_tag( out, i, FIELDS_CHRP );
-		value = fields_value( out, i, FIELDS_CHRP );
-		fprintf( fp, "%s %s\n", tag, value );
-	}
-
-	fprintf( fp, "\n" );
-	fflush( fp );
+	outsink_puts( fp, tag );
+	outsink_putc( fp, ' ' );
+	outsink_puts( fp, value );
+	outsink_putc( fp, '\n' );
 }
 
 static int
-append_data( fields *in, fields *out )
+append_data( fields *in, outfields *out )
 {
 	int type, status = BIBL_OK;
 
@@ -679,24 +657,24 @@ append_data( fields *in, fields *out )
 }
 
 static int
-adsout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+adsout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, NULL );
 
 	status = append_data( in, &out );
-	if ( status==BIBL_OK ) output( fp, &out );
+	if ( status==BIBL_OK ) outsink_puts( fp, "\n" );
 
-	fields_free( &out );
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-adsout_writeheader( FILE *outptr, param *p )
+adsout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
 
@@ -1,3 +1,17 @@
+/*
+ * adsout_journals.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include "phash.h"
+#include "adsout_journals.h"
+
 /* http://adsabs.harvard.edu/abs_doc/journals1.html
  * download URL source then parse with
  * fgrep setfields journals1.html | awk -F ';' '{printf "%s\n",$2}'
@@ -4508,3 +4522,136 @@ static const char *journals[] = {
 "ZvDeb Zvaigsnota Debess",
 };
 static const int njournals = sizeof( journals ) / sizeof( journals[0] );
+
+/* Journals are found by name, ignoring case, through a perfect hash
+ * built once on first use, and by abbreviation through an open-addressed
+ * table filled at the same time. A name or abbreviation listed twice
+ * gives the first entry, as a scan of the list did. If the hash of
+ * names can't be built, the list is scanned.
+ */
+#define JOURNALS_ABBRSIZE (8192) /* a power of two, well over njournals */
+
+static const char *journals_names[ sizeof( journals ) / sizeof( journals[0] ) ];
+static phash journals_byname;
+static int journals_hashed = 0;
+static int journals_byabbr[ JOURNALS_ABBRSIZE ]; /* entry+1, 0 for none */
+static pthread_once_t journals_once = PTHREAD_ONCE_INIT;
+
+/* length of an abbreviation without the trailing '.' padding */
+static int
+journals_abbrlen( const char *s, int max )
+{
+	int n = 0;
+	while ( n<max && s[n] && s[n]!=' ' && s[n]!='\t' ) n++;
+	while ( n>0 && s[n-1]=='.' ) n--;
+	return n;
+}
+
+typedef struct {
+	const char *abbr;
+	int        len;
+} journals_abbrkey;
+
+/* abbreviations are compared with case, unlike the hash that places them */
+static int
+journals_abbrstop( const void *table, unsigned long i, const void *key )
+{
+	const int *slot = ( const int * ) table;
+	const journals_abbrkey *k = ( const journals_abbrkey * ) key;
+	const char *abbr;
+
+	if ( !slot[i] ) return 1;
+	abbr = journals[ slot[i]-1 ];
+	return ( journals_abbrlen( abbr, 5 )==k->len && !strncmp( abbr, k->abbr, k->len ) );
+}
+
+static unsigned long
+journals_abbrslot( const char *abbr, int len )
+{
+	journals_abbrkey key;
+
+	key.abbr = abbr;
+	key.len  = len;
+	return phash_probe( journals_byabbr, JOURNALS_ABBRSIZE - 1, phash_hash( abbr, len, 0 ),
+			journals_abbrstop, &key );
+}
+
+static void
+journals_hash( void )
+{
+	unsigned long h;
+	int j;
+
+	for ( j=0; j<njournals; ++j ) {
+		journals_names[j] = journals[j]+6;
+		h = journals_abbrslot( journals[j], journals_abbrlen( journals[j], 5 ) );
+		if ( !journals_byabbr[h] ) journals_byabbr[h] = j+1;
+	}
+	if ( phash_build( &journals_byname, journals_names, sizeof( journals_names[0] ), njournals )==PHASH_OK )
+		journals_hashed = 1;
+}
+
+/* entry for the journal called name, or -1 */
+static int
+journals_findname( const char *name )
+{
+	int j;
+
+	pthread_once( &journals_once, journals_hash );
+
+	if ( journals_hashed ) return phash_find( &journals_byname, name );
+
+	for ( j=0; j<njournals; ++j )
+		if ( !strcasecmp( journals[j]+6, name ) ) return j;
+	return -1;
+}
+
+/* entry for the journal abbreviated abbr, with or without its '.' padding, or -1 */
+static int
+journals_findabbr( const char *abbr )
+{
+	int len;
+
+	pthread_once( &journals_once, journals_hash );
+
+	len = journals_abbrlen( abbr, strlen( abbr ) );
+	if ( len==0 || len>5 ) return -1;
+	return journals_byabbr[ journals_abbrslot( abbr, len ) ] - 1;
+}
+
+/* adsout_journalabbr()
+ *
+ * Copy the five character ADS abbreviation of the journal called
+ * name, padded with '.', into abbr[6]. Returns 0 if it isn't known.
+ */
+int
+adsout_journalabbr( const char *name, char *abbr )
+{
+	int i, j;
+
+	j = journals_findname( name );
+	if ( j==-1 ) return 0;
+
+	for ( i=0; i<5; ++i ) {
+		if ( journals[j][i]==' ' || journals[j][i]=='\t' ) break;
+		abbr[i] = journals[j][i];
+	}
+	for ( ; i<5; ++i ) abbr[i] = '.';
+	abbr[5] = '\0';
+
+	return 1;
+}
+
+/* adsout_journalname()
+ *
+ * The name of the journal with the ADS abbreviation abbr, or NULL.
+ */
+const char *
+adsout_journalname( const char *abbr )
+{
+	int j;
+
+	j = journals_findabbr( abbr );
+	if ( j==-1 ) return NULL;
+	return journals[j]+6;
+}
@@ -0,0 +1,15 @@
+/*
+ * adsout_journals.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef ADSOUT_JOURNALS_H
+#define ADSOUT_JOURNALS_H
+
+int          adsout_journalabbr( const char *name, char *abbr );
+const char * adsout_journalname( const char *abbr );
+
+#endif
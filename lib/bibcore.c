@@ -8,6 +8,16 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <ctype.h>
+#include <pthread.h>
 #include "bibutils.h"
 
 /* internal includes */
@@ -15,6 +25,13 @@
 #include "charsets.h"
 #include "str_conv.h"
 #include "is_ws.h"
+#include "strsearch.h"
+#include "tagline.h"
+#include "zstream.h"
+#include "outsink.h"
+#include "bibsnap.h"
+#include "phash.h"
+#include "name.h"
 
 /* illegal modes to pass in, but use internally for consistency */
 #define BIBL_INTERNALIN   (BIBL_LASTIN+1)
@@ -83,6 +100,15 @@ report_params( FILE *fp, const char *f, param *p )
 	fprintf( fp, "\tutf8bom=%d\n", p->utf8bom );
 	fprintf( fp, "\tlatexout=%d\n", p->latexout );
 	fprintf( fp, "\txmlout=%d\n", p->xmlout );
+	fprintf( fp, "\tcompressout=%d (%s)\n", p->compressout, zstream_name( p->compressout ) );
+	fprintf( fp, "\tasyncout=%d\n", p->asyncout );
+	fprintf( fp, "\tsinglerefperfile=%d\n", p->singlerefperfile );
+	fprintf( fp, "\toutdir=%s\n", ( p->outdir ) ? p->outdir : "(null)" );
+	fprintf( fp, "\tnthreads=%d\n", p->nthreads );
+	fprintf( fp, "\tnamecache=%ld\n", p->namecache );
+	fprintf( fp, "\tshardmode=%d\n", p->shardmode );
+	fprintf( fp, "\tshardsize=%ld\n", p->shardsize );
+	fprintf( fp, "\tshardprefix=%s\n", ( p->shardprefix ) ? p->shardprefix : "(null)" );
 	fprintf( fp, "-------------------params end for %s\n", f );
 
 	fflush( fp );
@@ -98,6 +124,7 @@ bibl_duplicateparams( param *np, param *op )
 	int status;
 	slist_init( &(np->asis) );
 	slist_init( &(np->corps) );
+	name_cache_init( &(np->names), 0 );
 	status = slist_copy( &(np->asis), &(op->asis ) );
 	if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
 	status = slist_copy( &(np->corps), &(op->corps ) );
@@ -131,6 +158,22 @@ bibl_duplicateparams( param *np, param *op )
 	np->addcount = op->addcount;
 	np->output_raw = op->output_raw;
 	np->singlerefperfile = op->singlerefperfile;
+	np->compressout = op->compressout;
+	np->asyncout = op->asyncout;
+	np->nthreads = op->nthreads;
+	np->namecache = op->namecache;
+	np->shardmode = op->shardmode;
+	np->shardsize = op->shardsize;
+	if ( !op->shardprefix ) np->shardprefix = NULL;
+	else {
+		np->shardprefix = strdup( op->shardprefix );
+		if ( !np->shardprefix ) return BIBL_ERR_MEMERR;
+	}
+	if ( !op->outdir ) np->outdir = NULL;
+	else {
+		np->outdir = strdup( op->outdir );
+		if ( !np->outdir ) return BIBL_ERR_MEMERR;
+	}
 
 	np->readf = op->readf;
 	np->processf = op->processf;
@@ -162,6 +205,8 @@ bibl_setreadparams( param *np, param *op )
 		np->xmlout         = BIBL_XMLOUT_FALSE;
 		np->latexout       = 0;
 		np->writeformat    = BIBL_INTERNALOUT;
+		if ( !name_cache_init( &(np->names), op->namecache ) )
+			status = BIBL_ERR_MEMERR;
 	}
 	return status;
 }
@@ -192,7 +237,10 @@ bibl_freeparams( param *p )
 	if ( p ) {
 		slist_free( &(p->asis) );
 		slist_free( &(p->corps) );
+		name_cache_free( &(p->names) );
 		if ( p->progname ) free( p->progname );
+		if ( p->outdir ) free( p->outdir );
+		if ( p->shardprefix ) free( p->shardprefix );
 	}
 }
 
@@ -205,6 +253,7 @@ bibl_readasis( param *p, char *f )
 	if ( !f ) return BIBL_ERR_BADINPUT;
 
 	status = slist_fill( &(p->asis), f, 1 );
+	if ( status == SLIST_OK ) status = slist_hash( &(p->asis) );
 
 	if ( status == SLIST_ERR_CANTOPEN ) return BIBL_ERR_CANTOPEN;
 	else if ( status == SLIST_ERR_MEMERR ) return BIBL_ERR_MEMERR;
@@ -220,9 +269,10 @@ bibl_readcorps( param *p, char *f )
 	if ( !f ) return BIBL_ERR_BADINPUT;
 
 	status = slist_fill( &(p->corps), f, 1 );
+	if ( status == SLIST_OK ) status = slist_hash( &(p->corps) );
 
 	if ( status == SLIST_ERR_CANTOPEN ) return BIBL_ERR_CANTOPEN;
-	else if ( status == 0 ) return BIBL_ERR_MEMERR;
+	else if ( status == SLIST_ERR_MEMERR ) return BIBL_ERR_MEMERR;
 	return BIBL_OK;
 }
 
@@ -238,6 +288,7 @@ bibl_addtoasis( param *p, char *d )
 	if ( !p ) return BIBL_ERR_BADINPUT;
 	if ( !d ) return BIBL_ERR_BADINPUT;
 
+	if ( slist_hash( &(p->asis) )!=SLIST_OK ) return BIBL_ERR_MEMERR;
 	s = slist_addc( &(p->asis), d );
 
 	return ( s==NULL )? BIBL_ERR_MEMERR : BIBL_OK;
@@ -255,6 +306,7 @@ bibl_addtocorps( param *p, char *d )
 	if ( !p ) return BIBL_ERR_BADINPUT;
 	if ( !d ) return BIBL_ERR_BADINPUT;
 
+	if ( slist_hash( &(p->corps) )!=SLIST_OK ) return BIBL_ERR_MEMERR;
 	s = slist_addc( &(p->corps), d );
 
 	return ( s==NULL )? BIBL_ERR_MEMERR : BIBL_OK;
@@ -273,12 +325,32 @@ bibl_reporterr( int err )
 			fprintf( stderr, "Memory error." ); break;
 		case BIBL_ERR_CANTOPEN:
 			fprintf( stderr, "Can't open." ); break;
+		case BIBL_ERR_NOCOMPRESS:
+			fprintf( stderr, "Compression format not supported by this build." ); break;
+		case BIBL_ERR_ZSTREAM:
+			fprintf( stderr, "Corrupt or unreadable compressed stream." ); break;
+		case BIBL_ERR_WRITE:
+			fprintf( stderr, "Write error." ); break;
+		case BIBL_ERR_SNAPSHOT:
+			fprintf( stderr, "Not a bibutils snapshot, or a damaged one." ); break;
+		case BIBL_ERR_INDEX:
+			fprintf( stderr, "Record index missing, damaged, or out of date." ); break;
 		default:
 			fprintf( stderr, "Cannot identify error code %d.", err ); break;
 	}
 	fprintf( stderr, "\n" );
 }
 
+static int
+bibl_zstatus( int zstatus )
+{
+	switch( zstatus ) {
+		case ZSTREAM_OK:          return BIBL_OK;
+		case ZSTREAM_ERR_UNAVAIL: return BIBL_ERR_NOCOMPRESS;
+		default:                  return BIBL_ERR_ZSTREAM;
+	}
+}
+
 static int
 bibl_illegalinmode( int mode )
 {
@@ -451,52 +523,442 @@ out:
 	return ret;
 }
 
+/* read_addref()
+ *
+ * Process reference nref with processf and add it to bin.
+ */
 static int
-read_ref( FILE *fp, bibl *bin, char *filename, param *p )
+read_addref( bibl *bin, char *data, char *filename, long nref, param *p )
+{
+	fields *ref;
+
+	ref = fields_new();
+	if ( !ref ) return BIBL_ERR_MEMERR;
+	if ( p->processf( ref, data, filename, nref, p ) ) {
+		if ( !bibl_addref( bin, ref ) ) {
+			fields_delete( ref );
+			return BIBL_ERR_MEMERR;
+		}
+	} else {
+		fields_delete( ref );
+	}
+	return BIBL_OK;
+}
+
+/* read_refs()
+ *
+ * Split input into references with readf and process each with processf,
+ * numbering them on from nstart.
+ * The last character set reported by the input is returned in *fcharset_last.
+ */
+static int
+read_refs( FILE *fp, bibl *bin, char *filename, long nstart, param *p, int *fcharset_last )
 {
-	int nrefs = 0, bufpos = 0, ok, ret=BIBL_OK, fcharset;/* = CHARSET_UNKNOWN;*/
+	int bufpos = 0, ret=BIBL_OK, fcharset;/* = CHARSET_UNKNOWN;*/
+	long nrefs = nstart;
 	str reference, line;
 	char buf[256]="";
-	fields *ref;
 	str_init( &reference );
 	str_init( &line );
 	while ( p->readf( fp, buf, sizeof(buf), &bufpos, &line, &reference, &fcharset ) ) {
 		if ( reference.len==0 ) continue;
-		ref = fields_new();
-		if ( !ref ) {
-			ret = BIBL_ERR_MEMERR;
+		ret = read_addref( bin, reference.data, filename, ++nrefs, p );
+		if ( ret!=BIBL_OK ) {
 			bibl_free( bin );
 			goto out;
 		}
-		if ( p->processf( ref, reference.data, filename, nrefs+1, p )){
-			ok = bibl_addref( bin, ref );
-			if ( !ok ) {
-				ret = BIBL_ERR_MEMERR;
-				bibl_free( bin );
-				fields_delete( ref );
-				goto out;
-			}
-		} else {
-			fields_delete( ref );
-		}
 		str_empty( &reference );
-		if ( fcharset!=CHARSET_UNKNOWN ) {
-			/* charset from file takes priority over default, but
-			 * not user-specified */
-			if ( p->charsetin_src!=BIBL_SRC_USER ) {
-				p->charsetin_src = BIBL_SRC_FILE;
-				p->charsetin = fcharset;
-				if ( fcharset!=CHARSET_UNICODE ) p->utf8in = 0;
-			}
-		}
+		if ( fcharset!=CHARSET_UNKNOWN ) *fcharset_last = fcharset;
 	}
-	if ( p->charsetin==CHARSET_UNICODE ) p->utf8in = 1;
 out:
 	str_free( &line );
 	str_free( &reference );
 	return ret;
 }
 
+static void
+read_setcharset( param *p, int fcharset )
+{
+	if ( fcharset!=CHARSET_UNKNOWN ) {
+		/* charset from file takes priority over default, but
+		 * not user-specified */
+		if ( p->charsetin_src!=BIBL_SRC_USER ) {
+			p->charsetin_src = BIBL_SRC_FILE;
+			p->charsetin = fcharset;
+			if ( fcharset!=CHARSET_UNICODE ) p->utf8in = 0;
+		}
+	}
+	if ( p->charsetin==CHARSET_UNICODE ) p->utf8in = 1;
+}
+
+/*
+ * Chunked reading of a single large input
+ *
+ * For formats whose record boundaries can be found by looking at
+ * single lines (RIS 'ER  -', ISI 'ER', BibTeX '@', and PubMed
+ * '</PubmedArticle>'), the input is read into memory, cut at record
+ * boundaries into p->nthreads roughly equal chunks, and each chunk
+ * is split and processed on its own thread. All chunks are split
+ * before any is processed, so that references are numbered in
+ * messages just as in a serial read. References are merged back in
+ * input order.
+ */
+
+#define READ_MINCHUNK (1024L*1024L)
+
+typedef struct readchunk {
+	char   *data;
+	size_t  len;
+	char   *filename;
+	param  *p;
+	slist   refs;	/* the chunk split into references */
+	long    nstart;	/* references in the chunks before this one */
+	bibl    b;
+	int     fcharset;
+	int     status;
+} readchunk;
+
+static int
+read_canchunk( int format )
+{
+	switch ( format ) {
+	case BIBL_BIBTEXIN:
+	case BIBL_BIBLATEXIN:
+	case BIBL_RISIN:
+	case BIBL_ISIIN:
+	case BIBL_MEDLINEIN:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static char *
+chunk_nextline( char *p, char *end )
+{
+	while ( p<end && *p!='\n' && *p!='\r' ) p++;
+	while ( p<end && ( *p=='\n' || *p=='\r' ) ) p++;
+	return p;
+}
+
+static int
+chunk_islinestart( char *data, char *p )
+{
+	unsigned char *up = ( unsigned char * ) data;
+	if ( p==data || p[-1]=='\n' || p[-1]=='\r' ) return 1;
+	/* first line after a UTF8 byte order mark */
+	if ( p==data+3 && up[0]==0xEF && up[1]==0xBB && up[2]==0xBF ) return 1;
+	return 0;
+}
+
+/* chunk_boundary()
+ *
+ * Returns the offset of the first record boundary at or after the line
+ * containing offset pos, or len if there isn't one. A chunk starting
+ * at a boundary leaves readf in the same state as in a serial read.
+ */
+static size_t
+chunk_boundary( int format, char *data, size_t len, size_t pos )
+{
+	char *end = data + len, *p = data + pos, *q, *s;
+
+	if ( !chunk_islinestart( data, p ) ) p = chunk_nextline( p, end );
+
+	while ( p < end ) {
+		q = chunk_nextline( p, end );
+		switch ( format ) {
+		/* record starts with a line beginning with '@' */
+		case BIBL_BIBTEXIN:
+		case BIBL_BIBLATEXIN:
+			s = p;
+			while ( s<q && ( *s==' ' || *s=='\t' ) ) s++;
+			if ( s<q && *s=='@' ) return p - data;
+			break;
+		/* record ends with 'ER  -' line */
+		case BIBL_RISIN:
+			if ( ( q-p>=5 && !strncmp( p, "ER  -", 5 ) ) ||
+			     ( q-p>=6 && !strncmp( p, "ER   -", 6 ) ) )
+				return q - data;
+			break;
+		/* record ends with 'ER' line */
+		case BIBL_ISIIN:
+			if ( q-p>=3 && !strncmp( p, "ER", 2 ) && tagline_istag( TAGLINE_ISI, p ) )
+				return q - data;
+			break;
+		/* record ends with line containing '</PubmedArticle>' */
+		case BIBL_MEDLINEIN:
+			for ( s=p; s+16<=q; ++s )
+				if ( *s=='<' && !strncasecmp( s, "</PubmedArticle>", 16 ) )
+					return q - data;
+			break;
+		/* record ends with line containing '</mods>' or '</mods:mods>' */
+		case BIBL_MODSIN:
+			for ( s=p; s+7<=q; ++s ) {
+				if ( *s!='<' || s[1]!='/' ) continue;
+				if ( !strncmp( s, "</mods>", 7 ) ) return q - data;
+				if ( s+12<=q && !strncmp( s, "</mods:mods>", 12 ) ) return q - data;
+			}
+			break;
+		}
+		p = q;
+	}
+
+	return len;
+}
+
+/* chunk_stringsend()
+ *
+ * BibTeX @STRING records update the reader's macro table as they are
+ * processed, so everything through the last @STRING record is read
+ * before processing the rest of the input in parallel. Returns offset
+ * of the end of the last @STRING record, or 0 if there are none.
+ */
+static size_t
+chunk_stringsend( int format, char *data, size_t len )
+{
+	char *p = data, *end = data + len, *q, *s, *last = NULL;
+
+	while ( p < end ) {
+		q = strsearch( p, "@STRING" );
+		if ( !q ) {
+			/* keep searching past embedded '\0' characters */
+			p += strlen( p ) + 1;
+			continue;
+		}
+		s = q;
+		while ( s>data && ( s[-1]==' ' || s[-1]=='\t' ) ) s--;
+		if ( chunk_islinestart( data, s ) ) last = q;
+		p = q + 7;
+	}
+
+	if ( !last ) return 0;
+	return chunk_boundary( format, data, len, ( last - data ) + 1 );
+}
+
+/* chunk_slurp()
+ *
+ * Read all of fp into a '\0' terminated buffer.
+ */
+static char *
+chunk_slurp( FILE *fp, size_t *len )
+{
+	size_t max = READ_MINCHUNK, n = 0, got;
+	char *data, *more;
+
+	data = ( char * ) malloc( max + 1 );
+	if ( !data ) return NULL;
+
+	while ( ( got = fread( data+n, 1, max-n, fp ) ) > 0 ) {
+		n += got;
+		if ( n==max ) {
+			more = ( char * ) realloc( data, max*2 + 1 );
+			if ( !more ) {
+				free( data );
+				return NULL;
+			}
+			data = more;
+			max *= 2;
+		}
+	}
+	data[n] = '\0';
+
+	*len = n;
+	return data;
+}
+
+static void *
+read_splitchunk( void *arg )
+{
+	readchunk *c = ( readchunk * ) arg;
+	int bufpos = 0, fcharset;
+	str reference, line;
+	char buf[256]="";
+	FILE *fp;
+
+	c->status = BIBL_OK;
+	if ( c->len==0 ) return NULL;
+
+	fp = fmemopen( c->data, c->len, "r" );
+	if ( !fp ) {
+		c->status = BIBL_ERR_MEMERR;
+		return NULL;
+	}
+
+	strs_init( &reference, &line, NULL );
+	while ( c->p->readf( fp, buf, sizeof(buf), &bufpos, &line, &reference, &fcharset ) ) {
+		if ( reference.len==0 ) continue;
+		if ( !slist_add( &(c->refs), &reference ) ) {
+			c->status = BIBL_ERR_MEMERR;
+			break;
+		}
+		str_empty( &reference );
+		if ( fcharset!=CHARSET_UNKNOWN ) c->fcharset = fcharset;
+	}
+	strs_free( &reference, &line, NULL );
+	fclose( fp );
+
+	return NULL;
+}
+
+static void *
+read_processchunk( void *arg )
+{
+	readchunk *c = ( readchunk * ) arg;
+	slist_index i;
+
+	for ( i=0; i<c->refs.n && c->status==BIBL_OK; ++i )
+		c->status = read_addref( &(c->b), slist_cstr( &(c->refs), i ), c->filename, c->nstart + i + 1, c->p );
+
+	return NULL;
+}
+
+/* read_runchunks()
+ *
+ * Run f on chunks from..n-1, the first on this thread and the rest on
+ * threads of their own (or on this one, if a thread can't be started).
+ */
+static void
+read_runchunks( readchunk *chunks, int from, int n, void *(*f)( void * ), pthread_t *threads, char *started )
+{
+	int i;
+
+	for ( i=from+1; i<n; ++i )
+		started[i] = !pthread_create( &(threads[i]), NULL, f, &(chunks[i]) );
+	if ( from<n ) f( &(chunks[from]) );
+	for ( i=from+1; i<n; ++i ) {
+		if ( started[i] ) pthread_join( threads[i], NULL );
+		else f( &(chunks[i]) );
+	}
+}
+
+/* read_mergechunk()
+ *
+ * Move references from chunk c to the end of bin.
+ */
+static int
+read_mergechunk( bibl *bin, readchunk *c )
+{
+	long i;
+	int ok;
+
+	for ( i=0; i<c->b.nrefs; ++i ) {
+		ok = bibl_addref( bin, c->b.ref[i] );
+		if ( !ok ) {
+			/* references not yet moved are freed with the chunk */
+			memmove( c->b.ref, c->b.ref+i, sizeof( fields* ) * ( c->b.nrefs-i ) );
+			c->b.nrefs -= i;
+			return BIBL_ERR_MEMERR;
+		}
+	}
+	c->b.nrefs = 0;
+	bibl_free( &(c->b) );
+
+	return BIBL_OK;
+}
+
+static int
+read_ref_chunked( FILE *fp, bibl *bin, char *filename, param *p )
+{
+	int i, n, nchunks, status = BIBL_OK, fcharset = CHARSET_UNKNOWN;
+	readchunk *chunks = NULL;
+	pthread_t *threads = NULL;
+	char *started = NULL;
+	size_t len, start, pos, end;
+	char *data;
+
+	data = chunk_slurp( fp, &len );
+	if ( !data ) return BIBL_ERR_MEMERR;
+
+	/* chunk 0 holds any BibTeX @STRING definitions and is read first */
+	start = 0;
+	if ( p->readformat==BIBL_BIBTEXIN || p->readformat==BIBL_BIBLATEXIN )
+		start = chunk_stringsend( p->readformat, data, len );
+
+	nchunks = p->nthreads;
+	if ( ( len - start ) / READ_MINCHUNK + 1 < (size_t) nchunks )
+		nchunks = ( len - start ) / READ_MINCHUNK + 1;
+	n = nchunks + 1;
+
+	chunks  = ( readchunk * ) calloc( n, sizeof( readchunk ) );
+	threads = ( pthread_t * ) calloc( n, sizeof( pthread_t ) );
+	started = ( char * ) calloc( n, sizeof( char ) );
+	if ( !chunks || !threads || !started ) {
+		status = BIBL_ERR_MEMERR;
+		goto out;
+	}
+
+	pos = 0;
+	for ( i=0; i<n; ++i ) {
+		if ( i==0 ) end = start;
+		else if ( i==n-1 ) end = len;
+		else end = chunk_boundary( p->readformat, data, len,
+				start + ( len - start ) / nchunks * i );
+		if ( end < pos ) end = pos;
+		chunks[i].data     = data + pos;
+		chunks[i].len      = end - pos;
+		chunks[i].filename = filename;
+		chunks[i].p        = p;
+		chunks[i].fcharset = CHARSET_UNKNOWN;
+		slist_init( &(chunks[i].refs) );
+		bibl_init( &(chunks[i].b) );
+		pos = end;
+	}
+
+	read_runchunks( chunks, 0, n, read_splitchunk, threads, started );
+	for ( i=0; i<n; ++i ) {
+		if ( chunks[i].status!=BIBL_OK ) {
+			status = chunks[i].status;
+			goto out;
+		}
+		if ( i ) chunks[i].nstart = chunks[i-1].nstart + chunks[i-1].refs.n;
+	}
+
+	read_processchunk( &(chunks[0]) );
+	read_runchunks( chunks, 1, n, read_processchunk, threads, started );
+
+	for ( i=0; i<n; ++i ) {
+		if ( chunks[i].status!=BIBL_OK ) {
+			status = chunks[i].status;
+			goto out;
+		}
+		status = read_mergechunk( bin, &(chunks[i]) );
+		if ( status!=BIBL_OK ) goto out;
+		if ( chunks[i].fcharset!=CHARSET_UNKNOWN )
+			fcharset = chunks[i].fcharset;
+	}
+
+	read_setcharset( p, fcharset );
+
+out:
+	if ( chunks ) {
+		for ( i=0; i<n; ++i ) {
+			slist_free( &(chunks[i].refs) );
+			bibl_free( &(chunks[i].b) );
+		}
+		free( chunks );
+	}
+	if ( status!=BIBL_OK ) bibl_free( bin );
+	if ( threads ) free( threads );
+	if ( started ) free( started );
+	free( data );
+
+	return status;
+}
+
+static int
+read_ref( FILE *fp, bibl *bin, char *filename, param *p )
+{
+	int status, fcharset = CHARSET_UNKNOWN;
+
+	if ( p->nthreads > 1 && read_canchunk( p->readformat ) )
+		return read_ref_chunked( fp, bin, filename, p );
+
+	status = read_refs( fp, bin, filename, 0, p, &fcharset );
+	if ( status==BIBL_OK ) read_setcharset( p, fcharset );
+
+	return status;
+}
+
 /* Don't manipulate latex for URL's and the like */
 static int
 bibl_notexify( char *tag )
@@ -675,50 +1137,53 @@ out:
 	return ret;
 }
 
+/* resolve_citekeys()
+ *
+ * Give the references sharing a citekey suffixes a, b, c... in input
+ * order; dup[j] is the first reference with the citekey of j, or -1
+ * if it is unique.
+ */
 static int
 resolve_citekeys( bibl *b, slist *citekeys, int *dup )
 {
 	const char abc[]="abcdefghijklmnopqrstuvwxyz";
-	int nsame, ntmp, n, i, j, status = BIBL_OK;
+	int ntmp, n, j, *nsame, status = BIBL_OK;
 	str tmp;
 
+	nsame = ( int * ) calloc( citekeys->n, sizeof( int ) );
+	if ( !nsame ) return BIBL_ERR_MEMERR;
+
 	str_init( &tmp );
 
-	for ( i=0; i<citekeys->n; ++i ) {
-		if ( dup[i]==-1 ) continue;
-		nsame = 0;
-		for ( j=i; j<citekeys->n; ++j ) {
-			if ( dup[j]!=i ) continue;
-			str_strcpy( &tmp, slist_str( citekeys, j ) );
-			if ( str_memerr( &tmp ) ) {
-				status = BIBL_ERR_MEMERR;
-				goto out;
-			}
-			ntmp = nsame;
-			while ( ntmp >= 26 ) {
-				str_addchar( &tmp, 'a' );
-					ntmp -= 26;
-			}
-			if ( ntmp<26 && ntmp>=0 )
-			str_addchar( &tmp, abc[ntmp] );
-			if ( str_memerr( &tmp ) ) {
+	for ( j=0; j<citekeys->n; ++j ) {
+		if ( dup[j]==-1 ) continue;
+		str_strcpy( &tmp, slist_str( citekeys, j ) );
+		if ( str_memerr( &tmp ) ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+		ntmp = nsame[ dup[j] ]++;
+		while ( ntmp >= 26 ) {
+			str_addchar( &tmp, 'a' );
+			ntmp -= 26;
+		}
+		str_addchar( &tmp, abc[ntmp] );
+		if ( str_memerr( &tmp ) ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+		n = fields_find( b->ref[j], "REFNUM", LEVEL_ANY );
+		if ( n!=FIELDS_NOTFOUND ) {
+			str_strcpy(&((b->ref[j])->data[n]),&tmp);
+			if ( str_memerr( &((b->ref[j])->data[n]) ) ) {
 				status = BIBL_ERR_MEMERR;
 				goto out;
 			}
-			nsame++;
-			dup[j] = -1;
-			n = fields_find( b->ref[j], "REFNUM", LEVEL_ANY );
-			if ( n!=FIELDS_NOTFOUND ) {
-				str_strcpy(&((b->ref[j])->data[n]),&tmp);
-				if ( str_memerr( &((b->ref[j])->data[n]) ) ) {
-					status = BIBL_ERR_MEMERR;
-					goto out;
-				}
-			}
 		}
 	}
 out:
 	str_free( &tmp );
+	free( nsame );
 	return status;
 }
 
@@ -746,24 +1211,26 @@ get_citekeys( bibl *b, slist *citekeys )
 static int 
 dup_citekeys( bibl *b, slist *citekeys )
 {
-	int i, j, status = BIBL_OK, *dup, ndup=0;
+	int i, first, status, *dup, ndup=0;
+
+	/* with the citekeys hashed, each finds the first of its kind at once */
+	status = slist_hash( citekeys );
+	if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
 
 	dup = ( int * ) malloc( sizeof( int ) * citekeys->n );
 	if ( !dup ) return BIBL_ERR_MEMERR;
 
 	for ( i=0; i<citekeys->n; ++i ) dup[i] = -1;
-	for ( i=0; i<citekeys->n-1; ++i ) {
-		if ( dup[i]!=-1 ) continue;
-		for ( j=i+1; j<citekeys->n; ++j ) {
-			if ( !strcmp( slist_cstr( citekeys, i ),
-			              slist_cstr( citekeys, j ) ) ) {
-					dup[i] = i;
-					dup[j] = i;
-					ndup++;
-			}
+	for ( i=0; i<citekeys->n; ++i ) {
+		first = slist_findc( citekeys, slist_cstr( citekeys, i ) );
+		if ( first!=i ) {
+			dup[first] = first;
+			dup[i] = first;
+			ndup++;
 		}
 	}
 	if ( ndup ) status = resolve_citekeys( b, citekeys, dup );
+	else status = BIBL_OK;
 	free( dup );
 	return status;
 }
@@ -789,6 +1256,18 @@ clean_ref( bibl *bin, param *p )
 	else return BIBL_OK;
 }
 
+static void
+report_namecache( param *p )
+{
+	namecache_stats s = p->names.stats;
+
+	if ( p->progname ) fprintf( stderr, "%s: ", p->progname );
+	fprintf( stderr, "Name cache: %lu lookups, %lu hits (%.1f%%), "
+		"%lu of %lu entries used, %lu replaced\n", s.lookups, s.hits,
+		( s.lookups ) ? 100. * s.hits / s.lookups : 0., s.used,
+		s.size, s.replaced );
+}
+
 static int 
 convert_ref( bibl *bin, char *fname, bibl *bout, param *p )
 {
@@ -820,175 +1299,1268 @@ convert_ref( bibl *bin, char *fname, bibl *bout, param *p )
 		fprintf( stderr, "-------------------end for convert_ref\n" );
 		fflush( stderr );
 	}
-	status = uniqueify_citekeys( bout );
-	return status;
+	if ( verbose_set( p ) && p->namecache ) report_namecache( p );
+	return BIBL_OK;
 }
 
-int
-bibl_read( bibl *b, FILE *fp, char *filename, param *p )
+/* read_convert()
+ *
+ * Take references just split and processed from the input through
+ * charset conversion, cleaning, and conversion to the internal
+ * format, adding them to b.
+ */
+static int
+read_convert( bibl *bin, char *filename, bibl *b, param *lp, param *p )
 {
 	int ok, status;
-	param lp;
-	bibl bin;
-
-	if ( !b )  return BIBL_ERR_BADINPUT;
-	if ( !fp ) return BIBL_ERR_BADINPUT;
-	if ( !p )  return BIBL_ERR_BADINPUT;
-
-	if ( bibl_illegalinmode( p->readformat ) ) {
-		if ( debug_set( p ) ) {
-			fflush( stdout );
-			report_params( stderr, "bibl_read", p );
-		}
-		return BIBL_ERR_BADINPUT;
-	}
-
-	status = bibl_setreadparams( &lp, p );
-	if ( status!=BIBL_OK ) {
-		if ( debug_set( p ) ) {
-			fflush( stdout );
-			report_params( stderr, "bibl_read", p );
-		}
-		return status;
-	}
-
-	bibl_init( &bin );
-
-	status = read_ref( fp, &bin, filename, &lp );
-	if ( status!=BIBL_OK ) {
-		if ( debug_set( p ) ) {
-			fflush( stdout );
-			report_params( stderr, "bibl_read", &lp );
-		}
-		bibl_freeparams( &lp );
-		return status;
-	}
 
 	if ( debug_set( p ) ) {
 		fflush( stdout );
-		report_params( stderr, "bibl_read", &lp );
+		report_params( stderr, "bibl_read", lp );
 		fprintf( stderr, "-------------------raw_input start for bibl_read\n");
-		bibl_verbose0( &bin );
+		bibl_verbose0( bin );
 		fprintf( stderr, "-------------------raw_input end for bibl_read\n" );
 		fflush( stderr );
 	}
 
-	if ( !lp.output_raw || ( lp.output_raw & BIBL_RAW_WITHCHARCONVERT ) ) {
-		status = bibl_fixcharsets( &bin, &lp );
+	if ( !lp->output_raw || ( lp->output_raw & BIBL_RAW_WITHCHARCONVERT ) ) {
+		status = bibl_fixcharsets( bin, lp );
 		if ( status!=BIBL_OK ) return status;
 		if ( debug_set( p ) ) {
 			fprintf( stderr, "-------------------post_fixcharsets start for bibl_read\n");
-			bibl_verbose0( &bin );
+			bibl_verbose0( bin );
 			fprintf( stderr, "-------------------post_fixcharsets end for bibl_read\n" );
 			fflush( stderr );
 		}
 	}
-	if ( !lp.output_raw ) {
-		status = clean_ref( &bin, &lp );
+	if ( !lp->output_raw ) {
+		status = clean_ref( bin, lp );
 		if ( status!=BIBL_OK ) return status;
 		if ( debug_set( p ) ) {
 			fprintf( stderr, "-------------------post_clean_ref start for bibl_read\n");
-			bibl_verbose0( &bin );
+			bibl_verbose0( bin );
 			fprintf( stderr, "-------------------post_clean_ref end for bibl_read\n" );
 			fflush( stderr );
 		}
-		ok = convert_ref( &bin, filename, b, &lp );
+		ok = convert_ref( bin, filename, b, lp );
 		if ( ok!=BIBL_OK ) return ok;
 		if ( debug_set( p ) ) {
 			fprintf( stderr, "-------------------post_convert_ref start for bibl_read\n");
-			bibl_verbose0( &bin );
+			bibl_verbose0( bin );
 			fprintf( stderr, "-------------------post_convert_ref end for bibl_read\n" );
 			fflush( stderr );
 		}
 	} else {
 		if ( debug_set( p ) ) {
 			fprintf( stderr, "-------------------here1 start for bibl_read\n");
-			bibl_verbose0( &bin );
+			bibl_verbose0( bin );
 			fprintf( stderr, "-------------------here1 end for bibl_read\n" );
 			fflush( stderr );
 		}
-		ok = bibl_copy( b, &bin );
-		if ( !ok ) {
-			bibl_freeparams( &lp );
-			return BIBL_ERR_MEMERR;
-		}
+		ok = bibl_copy( b, bin );
+		if ( !ok ) return BIBL_ERR_MEMERR;
 	}
-	if ( !lp.output_raw || ( lp.output_raw & BIBL_RAW_WITHMAKEREFID ) )
-		bibl_checkrefid( b, &lp );
-
-	bibl_free( &bin );
-
-	bibl_freeparams( &lp );
 
 	return BIBL_OK;
 }
 
-static FILE *
-singlerefname( fields *reffields, long nref, int mode )
+/* give the references of b citekeys that are unique among them */
+static int
+read_citekeys( bibl *b, param *lp )
 {
-	char outfile[2048];
-	char suffix[5] = "xml";
-	FILE *fp;
-	long count;
-	int  found;
-	if      ( mode==BIBL_ADSABSOUT )     strcpy( suffix, "ads" );
-	else if ( mode==BIBL_BIBTEXOUT )     strcpy( suffix, "bib" );
-	else if ( mode==BIBL_ENDNOTEOUT )    strcpy( suffix, "end" );
-	else if ( mode==BIBL_ISIOUT )        strcpy( suffix, "isi" );
-	else if ( mode==BIBL_MODSOUT )       strcpy( suffix, "xml" );
-	else if ( mode==BIBL_RISOUT )        strcpy( suffix, "ris" );
-	else if ( mode==BIBL_WORD2007OUT )   strcpy( suffix, "xml" );
-	found = fields_find( reffields, "REFNUM", LEVEL_MAIN );
-	/* find new filename based on reference */
-	if ( found!=-1 ) {
-		sprintf( outfile,"%s.%s",reffields->data[found].data, suffix );
-	} else  sprintf( outfile,"%ld.%s",nref, suffix );
-	count = 0;
-	fp = fopen( outfile, "r" );
-	while ( fp ) {
-		fclose(fp);
-		count++;
-		if ( count==60000 ) return NULL;
-		if ( found!=-1 )
-			sprintf( outfile, "%s_%ld.%s", 
-				reffields->data[found].data, count, suffix  );
-		else sprintf( outfile,"%ld_%ld.%s",nref, count, suffix );
-		fp = fopen( outfile, "r" );
-	}
-	return fopen( outfile, "w" );
+	int status;
+
+	if ( !lp->output_raw ) {
+		status = uniqueify_citekeys( b );
+		if ( status!=BIBL_OK ) return status;
+	}
+	if ( !lp->output_raw || ( lp->output_raw & BIBL_RAW_WITHMAKEREFID ) )
+		bibl_checkrefid( b, lp );
+
+	return BIBL_OK;
 }
 
 static int
-bibl_writeeachfp( FILE *fp, bibl *b, param *p )
+read_finish( bibl *bin, char *filename, bibl *b, param *lp, param *p )
 {
 	int status;
+
+	status = read_convert( bin, filename, b, lp, p );
+	if ( status!=BIBL_OK ) return status;
+
+	return read_citekeys( b, lp );
+}
+
+int
+bibl_read( bibl *b, FILE *fp, char *filename, param *p )
+{
+	int status, zstatus;
+	param lp;
+	bibl bin;
+	zstream z;
+
+	if ( !b )  return BIBL_ERR_BADINPUT;
+	if ( !fp ) return BIBL_ERR_BADINPUT;
+	if ( !p )  return BIBL_ERR_BADINPUT;
+
+	if ( bibl_illegalinmode( p->readformat ) ) {
+		if ( debug_set( p ) ) {
+			fflush( stdout );
+			report_params( stderr, "bibl_read", p );
+		}
+		return BIBL_ERR_BADINPUT;
+	}
+
+	status = bibl_setreadparams( &lp, p );
+	if ( status!=BIBL_OK ) {
+		if ( debug_set( p ) ) {
+			fflush( stdout );
+			report_params( stderr, "bibl_read", p );
+		}
+		return status;
+	}
+
+	bibl_init( &bin );
+
+	/* compressed input is decompressed on its own thread */
+	zstatus = zstream_openread( &z, fp );
+	if ( zstatus==ZSTREAM_OK ) {
+		status = read_ref( z.fp, &bin, filename, &lp );
+		zstatus = zstream_close( &z );
+		if ( status==BIBL_OK ) status = bibl_zstatus( zstatus );
+	} else status = bibl_zstatus( zstatus );
+	if ( status!=BIBL_OK ) {
+		if ( debug_set( p ) ) {
+			fflush( stdout );
+			report_params( stderr, "bibl_read", &lp );
+		}
+		bibl_free( &bin );
+		bibl_freeparams( &lp );
+		return status;
+	}
+
+	status = read_finish( &bin, filename, b, &lp, p );
+
+	bibl_free( &bin );
+
+	bibl_freeparams( &lp );
+
+	return status;
+}
+
+/*
+ * Record index
+ *
+ * A sidecar index lets a few records be pulled out of a large input
+ * without parsing the rest. It lists where each record lies in the
+ * input under its REFNUM, DOI, and PMID; records are cut at the same
+ * boundaries as for chunked reading. The index is text:
+ *
+ *     bibutils-index 1 <input format> <input charset> <input size>
+ *     @<tab><offset><tab><length>     records that yield no reference,
+ *                                     e.g. BibTeX @STRING, in input order
+ *     <key><tab><offset><tab><length> sorted by key
+ *
+ * Keys are folded to lowercase and looked up by binary search in the
+ * mapped index, so a lookup touches only a few of its pages.
+ */
+
+#define INDEX_MAGIC   "bibutils-index"
+#define INDEX_VERSION (1)
+
+/* the tags a record can be looked up by */
+static char *index_tags[] = { "REFNUM", "DOI", "PMID" };
+#define NINDEXTAGS ( (int) ( sizeof( index_tags ) / sizeof( index_tags[0] ) ) )
+
+typedef struct indexseg {
+	off_t  offset;
+	size_t len;
+} indexseg;
+
+static int
+index_canindex( int format )
+{
+	return ( read_canchunk( format ) || format==BIBL_MODSIN );
+}
+
+/* end of the record starting at pos */
+static size_t
+index_segend( int format, char *data, size_t len, size_t pos )
+{
+	/* BibTeX boundaries are at the start of a record, not its end */
+	if ( format==BIBL_BIBTEXIN || format==BIBL_BIBLATEXIN )
+		pos = chunk_nextline( data+pos, data+len ) - data;
+	return chunk_boundary( format, data, len, pos );
+}
+
+/* a key as stored: lowercase, with nothing that would break the line */
+static void
+index_key( str *key, const char *value )
+{
+	str_empty( key );
+	while ( *value ) {
+		if ( *value=='\t' || *value=='\n' || *value=='\r' ) str_addchar( key, ' ' );
+		else str_addchar( key, tolower( (unsigned char) *value ) );
+		value++;
+	}
+}
+
+static int
+index_addentry( slist *entries, str *key, size_t offset, size_t len )
+{
+	char buf[64];
+	str line;
+	int status = BIBL_OK;
+
+	if ( key->len==0 ) return BIBL_OK;
+
+	str_init( &line );
+	sprintf( buf, "\t%lu\t%lu", (unsigned long) offset, (unsigned long) len );
+	str_strcpy( &line, key );
+	str_strcatc( &line, buf );
+	if ( str_memerr( &line ) || !slist_add( entries, &line ) ) status = BIBL_ERR_MEMERR;
+	str_free( &line );
+
+	return status;
+}
+
+/* index_gencitekeys()
+ *
+ * References without a citekey get the one uniqueify_citekeys() would
+ * make for them, so they can be found by it before any are renamed.
+ */
+static int
+index_gencitekeys( bibl *b, long nstart )
+{
 	long i;
-	for ( i=0; i<b->nrefs; ++i ) {
-		fp = singlerefname( b->ref[i], i, p->writeformat );
-		if ( !fp ) return BIBL_ERR_CANTOPEN;
-		if ( p->headerf ) p->headerf( fp, p );
-		status = p->writef( b->ref[i], fp, p, i );
-		if ( p->footerf ) p->footerf( fp );
-		fclose( fp );
+
+	for ( i=nstart; i<b->nrefs; ++i ) {
+		if ( fields_find( b->ref[i], "REFNUM", LEVEL_ANY )!=FIELDS_NOTFOUND ) continue;
+		if ( generate_citekey( b->ref[i], i )==-1 ) return BIBL_ERR_MEMERR;
+	}
+
+	return BIBL_OK;
+}
+
+/* index_record()
+ *
+ * Read the record at data[0..len) and note it under its keys, or as
+ * a preamble if it yields no references.
+ */
+static int
+index_record( char *data, size_t offset, size_t len, char *filename, param *lp,
+		slist *entries, str *preamble, int *fcharset )
+{
+	bibl bin, bout, *ref;
+	int i, j, n, status;
+	char buf[64];
+	FILE *fp;
+	str key;
+
+	bibl_init( &bin );
+	bibl_init( &bout );
+	str_init( &key );
+
+	fp = fmemopen( data, len, "r" );
+	if ( !fp ) return BIBL_ERR_MEMERR;
+	status = read_refs( fp, &bin, filename, 0, lp, fcharset );
+	fclose( fp );
+	if ( status!=BIBL_OK ) goto out;
+
+	if ( bin.nrefs==0 ) {
+		sprintf( buf, "@\t%lu\t%lu\n", (unsigned long) offset, (unsigned long) len );
+		str_strcatc( preamble, buf );
+		if ( str_memerr( preamble ) ) status = BIBL_ERR_MEMERR;
+		goto out;
+	}
+
+	/* No cleaning: a record on its own can't resolve cross-references
+	 * and the keys don't need it. Raw formats are already internal. */
+	if ( lp->output_raw ) ref = &bin;
+	else {
+		status = convert_ref( &bin, filename, &bout, lp );
+		if ( status!=BIBL_OK ) goto out;
+		status = index_gencitekeys( &bout, 0 );
+		if ( status!=BIBL_OK ) goto out;
+		ref = &bout;
+	}
+
+	for ( i=0; i<ref->nrefs; ++i ) {
+		for ( j=0; j<NINDEXTAGS; ++j ) {
+			n = fields_find( ref->ref[i], index_tags[j], LEVEL_MAIN );
+			if ( n==FIELDS_NOTFOUND ) continue;
+			index_key( &key, fields_value( ref->ref[i], n, FIELDS_CHRP_NOUSE ) );
+			status = index_addentry( entries, &key, offset, len );
+			if ( status!=BIBL_OK ) goto out;
+		}
+	}
+
+out:
+	str_free( &key );
+	bibl_free( &bin );
+	bibl_free( &bout );
+	return status;
+}
+
+/* map a whole file read-only; returns NULL if it isn't a plain file */
+static char *
+index_map( FILE *fp, size_t *len )
+{
+	struct stat st;
+	void *data;
+
+	if ( fstat( fileno( fp ), &st ) || !S_ISREG( st.st_mode ) ) return NULL;
+	*len = st.st_size;
+	if ( *len==0 ) return NULL;
+	data = mmap( NULL, *len, PROT_READ, MAP_PRIVATE, fileno( fp ), 0 );
+	if ( data==MAP_FAILED ) return NULL;
+	return ( char * ) data;
+}
+
+/* bibl_writeindex()
+ *
+ * Write an index of the records of fp, a plain file in p->readformat,
+ * to idxfp.
+ */
+int
+bibl_writeindex( FILE *fp, char *filename, FILE *idxfp, param *p )
+{
+	int status, fcharset = CHARSET_UNKNOWN;
+	size_t len, pos, end;
+	slist entries;
+	str preamble;
+	char *data;
+	param lp;
+	long i;
+
+	if ( !fp )    return BIBL_ERR_BADINPUT;
+	if ( !idxfp ) return BIBL_ERR_BADINPUT;
+	if ( !p )     return BIBL_ERR_BADINPUT;
+	if ( !index_canindex( p->readformat ) ) return BIBL_ERR_BADINPUT;
+
+	data = index_map( fp, &len );
+	if ( !data ) return BIBL_ERR_CANTOPEN;
+
+	status = bibl_setreadparams( &lp, p );
+	if ( status!=BIBL_OK ) {
+		munmap( data, len );
+		return status;
+	}
+
+	slist_init( &entries );
+	str_init( &preamble );
+
+	for ( pos=0; pos<len; pos=end ) {
+		end = index_segend( p->readformat, data, len, pos );
+		if ( end<=pos ) end = len;
+		status = index_record( data+pos, pos, end-pos, filename, &lp,
+				&entries, &preamble, &fcharset );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	slist_sort( &entries );
+
+	fprintf( idxfp, "%s %d %d %d %lu\n", INDEX_MAGIC, INDEX_VERSION,
+		p->readformat, fcharset, (unsigned long) len );
+	if ( preamble.len ) fputs( str_cstr( &preamble ), idxfp );
+	for ( i=0; i<entries.n; ++i ) {
+		fputs( slist_cstr( &entries, i ), idxfp );
+		fputc( '\n', idxfp );
+	}
+	if ( ferror( idxfp ) ) status = BIBL_ERR_CANTOPEN;
+
+out:
+	str_free( &preamble );
+	slist_free( &entries );
+	bibl_freeparams( &lp );
+	munmap( data, len );
+	return status;
+}
+
+/* compare key with the key that starts the index line at p */
+static int
+index_keycmp( const char *key, const char *p, const char *end )
+{
+	const unsigned char *k = ( const unsigned char * ) key;
+	const unsigned char *q = ( const unsigned char * ) p;
+
+	while ( *k && q<( const unsigned char * ) end && *q!='\t' && *k==*q ) {
+		k++;
+		q++;
+	}
+	if ( q>=( const unsigned char * ) end || *q=='\t' || *q=='\n' )
+		return ( *k ) ? 1 : 0;
+	if ( !*k ) return -1;
+	return ( *k < *q ) ? -1 : 1;
+}
+
+static char *
+index_linestart( char *start, char *p )
+{
+	while ( p>start && p[-1]!='\n' ) p--;
+	return p;
+}
+
+/* copy the index line at p, which isn't '\0' terminated, for sscanf() */
+static void
+index_getline( char *p, char *end, char *buf, size_t n )
+{
+	size_t i = 0;
+	while ( p<end && *p!='\n' && i<n-1 ) buf[i++] = *p++;
+	buf[i] = '\0';
+}
+
+static int
+index_addseg( vplist *segs, char *line, char *end )
+{
+	unsigned long offset, len;
+	indexseg *seg;
+	char buf[64];
+
+	while ( line<end && *line!='\t' ) line++;
+	index_getline( line, end, buf, sizeof( buf ) );
+	if ( sscanf( buf, "\t%lu\t%lu", &offset, &len )!=2 ) return BIBL_ERR_INDEX;
+
+	seg = ( indexseg * ) malloc( sizeof( indexseg ) );
+	if ( !seg ) return BIBL_ERR_MEMERR;
+	seg->offset = offset;
+	seg->len    = len;
+	if ( vplist_add( segs, seg )!=VPLIST_OK ) {
+		free( seg );
+		return BIBL_ERR_MEMERR;
+	}
+	return BIBL_OK;
+}
+
+/* index_find()
+ *
+ * Add every record listed under key in the sorted part of the index,
+ * data[0..len), to segs.
+ */
+static int
+index_find( char *data, size_t len, const char *key, vplist *segs )
+{
+	char *end = data + len, *lo = data, *hi = end, *mid, *line;
+	int status;
+
+	/* lo: a line start at or before the first match; hi: after the last */
+	while ( hi - lo > 0 ) {
+		mid = index_linestart( lo, lo + ( hi - lo ) / 2 );
+		if ( mid==lo ) break;
+		if ( index_keycmp( key, mid, end ) > 0 ) lo = mid;
+		else hi = mid;
+	}
+
+	for ( line=lo; line<end; line=chunk_nextline( line, end ) ) {
+		status = index_keycmp( key, line, end );
+		if ( status < 0 ) break;
+		if ( status > 0 ) continue;
+		status = index_addseg( segs, line, end );
 		if ( status!=BIBL_OK ) return status;
 	}
+
 	return BIBL_OK;
 }
 
 static int
-bibl_writefp( FILE *fp, bibl *b, param *p )
+index_segcmp( const void *v1, const void *v2 )
+{
+	const indexseg *s1 = *( const indexseg ** ) v1;
+	const indexseg *s2 = *( const indexseg ** ) v2;
+	if ( s1->offset < s2->offset ) return -1;
+	if ( s1->offset > s2->offset ) return 1;
+	return 0;
+}
+
+/* read the record at seg from fp, appending what it yields to bin */
+static int
+index_readseg( FILE *fp, indexseg *seg, bibl *bin, char *filename, param *lp, int *fcharset )
 {
 	int status = BIBL_OK;
+	FILE *mfp;
+	char *buf;
+
+	if ( seg->len==0 ) return BIBL_OK;
+
+	buf = ( char * ) malloc( seg->len );
+	if ( !buf ) return BIBL_ERR_MEMERR;
+
+	if ( pread( fileno( fp ), buf, seg->len, seg->offset )!=( ssize_t ) seg->len )
+		status = BIBL_ERR_INDEX;
+	else {
+		mfp = fmemopen( buf, seg->len, "r" );
+		if ( !mfp ) status = BIBL_ERR_MEMERR;
+		else {
+			status = read_refs( mfp, bin, filename, bin->nrefs, lp, fcharset );
+			fclose( mfp );
+		}
+	}
+
+	free( buf );
+	return status;
+}
+
+static int
+index_haskey( fields *f, slist *keys )
+{
+	int i, j, n, found = 0;
+	str key;
+
+	str_init( &key );
+	for ( i=0; i<NINDEXTAGS && !found; ++i ) {
+		n = fields_find( f, index_tags[i], LEVEL_MAIN );
+		if ( n==FIELDS_NOTFOUND ) continue;
+		index_key( &key, fields_value( f, n, FIELDS_CHRP_NOUSE ) );
+		for ( j=0; j<keys->n && !found; ++j )
+			if ( !strcmp( str_cstr( &key ), slist_cstr( keys, j ) ) ) found = 1;
+	}
+	str_free( &key );
+
+	return found;
+}
+
+/* bibl_readindexed()
+ *
+ * As bibl_read(), but only the records whose REFNUM, DOI, or PMID is in keys
+ * are read, going straight to them through the index in idxfp. fp must
+ * be the plain file the index was written for.
+ */
+int
+bibl_readindexed( bibl *b, FILE *fp, char *filename, FILE *idxfp, slist *keys, param *p )
+{
+	int i, version, status, format, charset, fcharset = CHARSET_UNKNOWN;
+	char *data, *sorted, *end, buf[256];
+	unsigned long size;
+	long nstart, npre, j, n;
+	slist folded;
+	struct stat st;
+	vplist segs;
+	bibl bin;
+	size_t len;
+	param lp;
+	str key;
+
+	if ( !b || !fp || !idxfp || !keys || !p ) return BIBL_ERR_BADINPUT;
+	if ( bibl_illegalinmode( p->readformat ) ) return BIBL_ERR_BADINPUT;
+
+	data = index_map( idxfp, &len );
+	if ( !data ) return BIBL_ERR_INDEX;
+	end = data + len;
+
+	/* an index for another format, or for the file before it changed, is no use */
+	index_getline( data, end, buf, sizeof( buf ) );
+	if ( sscanf( buf, INDEX_MAGIC " %d %d %d %lu", &version, &format, &charset, &size )!=4 ||
+	     version!=INDEX_VERSION || format!=p->readformat ||
+	     fstat( fileno( fp ), &st ) || (unsigned long) st.st_size!=size ) {
+		munmap( data, len );
+		return BIBL_ERR_INDEX;
+	}
+
+	status = bibl_setreadparams( &lp, p );
+	if ( status!=BIBL_OK ) {
+		munmap( data, len );
+		return status;
+	}
+
+	vplist_init( &segs );
+	slist_init( &folded );
+	bibl_init( &bin );
+	str_init( &key );
+
+	/* records without references go first, so BibTeX macros are defined */
+	sorted = chunk_nextline( data, end );
+	while ( sorted<end && *sorted=='@' && sorted+1<end && sorted[1]=='\t' ) {
+		status = index_addseg( &segs, sorted, end );
+		if ( status!=BIBL_OK ) goto out;
+		sorted = chunk_nextline( sorted, end );
+	}
+	npre = segs.n;
+
+	for ( i=0; i<keys->n; ++i ) {
+		index_key( &key, slist_cstr( keys, i ) );
+		if ( key.len==0 ) continue;
+		if ( str_memerr( &key ) || !slist_add( &folded, &key ) ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+		status = index_find( sorted, end - sorted, str_cstr( &key ), &segs );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	/* in input order, each record once */
+	if ( segs.n > npre ) qsort( segs.data + npre, segs.n - npre, sizeof( void * ), index_segcmp );
+
+	for ( j=0; j<segs.n; ++j ) {
+		if ( j>npre && index_segcmp( &(segs.data[j-1]), &(segs.data[j]) )==0 ) continue;
+		status = index_readseg( fp, ( indexseg * ) vplist_get( &segs, j ), &bin, filename, &lp, &fcharset );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	if ( fcharset==CHARSET_UNKNOWN ) fcharset = charset;
+	read_setcharset( &lp, fcharset );
+
+	nstart = b->nrefs;
+	status = read_convert( &bin, filename, b, &lp, p );
+	if ( status!=BIBL_OK ) goto out;
+	if ( !lp.output_raw ) {
+		status = index_gencitekeys( b, nstart );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	/* a record can hold more than one reference; keep those asked for,
+	 * by the keys they were read with, before duplicates are renamed */
+	for ( n=j=nstart; j<b->nrefs; ++j ) {
+		if ( index_haskey( b->ref[j], &folded ) ) b->ref[n++] = b->ref[j];
+		else fields_delete( b->ref[j] );
+	}
+	b->nrefs = n;
+
+	status = read_citekeys( b, &lp );
+
+out:
+	str_free( &key );
+	bibl_free( &bin );
+	slist_free( &folded );
+	vplist_freefn( &segs, free );
+	bibl_freeparams( &lp );
+	munmap( data, len );
+	return status;
+}
+
+/* An open output: header written, references going through the
+ * outsink into fp, compressed and/or written on threads of their
+ * own if requested. */
+typedef struct refout {
+	outsink o;
+	zstream z;
+	param   *p;
+	int     status;
+} refout;
+
+static int
+refout_open( refout *r, FILE *fp, param *p )
+{
+	int zstatus;
+
+	r->p = p;
+	r->status = BIBL_OK;
+
+	zstatus = zstream_openwrite( &(r->z), fp, p->compressout );
+	if ( zstatus!=ZSTREAM_OK ) return bibl_zstatus( zstatus );
+
+	/* not worth a thread for each -s file */
+	if ( p->asyncout && !p->singlerefperfile )
+		outsink_initasync( &(r->o), r->z.fp );
+	else outsink_init( &(r->o), r->z.fp );
+	if ( r->o.status!=OUTSINK_OK ) {
+		zstream_close( &(r->z) );
+		return BIBL_ERR_MEMERR;
+	}
+
+	if ( p->headerf ) p->headerf( &(r->o), p );
+	return BIBL_OK;
+}
+
+static int
+refout_ref( refout *r, bibl *b, long n )
+{
+	if ( r->status==BIBL_OK )
+		r->status = r->p->writef( b->ref[n], &(r->o), r->p, n );
+	return r->status;
+}
+
+/* write the footer and close, returning the first error seen */
+static int
+refout_close( refout *r )
+{
+	int status = r->status, ostatus, zstatus;
+
+	if ( r->p->footerf ) r->p->footerf( &(r->o) );
+
+	ostatus = outsink_free( &(r->o) );
+	if ( ostatus==OUTSINK_MEMERR && status==BIBL_OK ) status = BIBL_ERR_MEMERR;
+	if ( ostatus==OUTSINK_ERR && status==BIBL_OK ) status = BIBL_ERR_WRITE;
+
+	/* a compressing thread that can't write its output fails with */
+	/* ZSTREAM_ERR_SYSTEM                                          */
+	zstatus = zstream_close( &(r->z) );
+	if ( zstatus==ZSTREAM_ERR_SYSTEM && status==BIBL_OK ) status = BIBL_ERR_WRITE;
+	if ( status==BIBL_OK ) status = bibl_zstatus( zstatus );
+
+	/* the tail of the output may still sit in the FILE's buffer */
+	if ( fflush( r->z.raw ) && status==BIBL_OK ) status = BIBL_ERR_WRITE;
+
+	return status;
+}
+
+/* write header, references [first,last), and footer to fp */
+static int
+bibl_writerefs( FILE *fp, bibl *b, long first, long last, param *p )
+{
+	int status;
+	refout r;
 	long i;
-	if ( p->headerf ) p->headerf( fp, p );
-	for ( i=0; i<b->nrefs; ++i ) {
-		status = p->writef( b->ref[i], fp, p, i );
+
+	status = refout_open( &r, fp, p );
+	if ( status!=BIBL_OK ) return status;
+
+	for ( i=first; i<last; ++i )
+		if ( refout_ref( &r, b, i )!=BIBL_OK ) break;
+
+	return refout_close( &r );
+}
+
+/*
+ * Single reference per file output
+ *
+ * Names are handed out from an in-memory table of the stems already
+ * used in this run, so a run of references sharing a REFNUM picks up
+ * where the last one left off instead of re-probing every earlier
+ * name on disk. A name whose file already exists from some earlier
+ * run just moves on to the next count. Every name is settled in
+ * reference order before any file is written, so which reference gets
+ * which name doesn't depend on the threads; creating and writing the
+ * files is then spread over p->nthreads threads.
+ */
+#define SINGLEREF_MAXCOUNT (60000)
+
+typedef struct refstem {
+	str  stem;
+	long next;	/* next count to try for references with this stem */
+	int  used;
+} refstem;
+
+typedef struct refnames {
+	refstem *slot;
+	unsigned long size, n;
+} refnames;
+
+static int
+refnames_init( refnames *r, long nrefs )
+{
+	r->n    = 0;
+	r->size = 64;
+	while ( r->size < (unsigned long) nrefs * 2 ) r->size *= 2;
+	r->slot = ( refstem * ) calloc( r->size, sizeof( refstem ) );
+	if ( !r->slot ) return BIBL_ERR_MEMERR;
+	return BIBL_OK;
+}
+
+static void
+refnames_free( refnames *r )
+{
+	unsigned long i;
+	for ( i=0; i<r->size; ++i )
+		str_free( &(r->slot[i].stem) );
+	free( r->slot );
+	r->slot = NULL;
+	r->size = r->n = 0;
+}
+
+static int
+refnames_stop( const void *table, unsigned long i, const void *stem )
+{
+	refstem *slot = ( refstem * ) table;
+	return ( !slot[i].used || !strcmp( str_cstr( &(slot[i].stem) ), ( const char * ) stem ) );
+}
+
+/* slot holding stem, or the empty slot where it would go */
+static refstem *
+refnames_slot( refstem *slot, unsigned long size, const char *stem )
+{
+	return &(slot[ phash_probe( slot, size - 1, phash_hash( stem, PHASH_WHOLE, 0 ), refnames_stop, stem ) ]);
+}
+
+static int
+refnames_grow( refnames *r )
+{
+	refstem *slot, *t;
+	unsigned long i, size = r->size * 2;
+
+	slot = ( refstem * ) calloc( size, sizeof( refstem ) );
+	if ( !slot ) return BIBL_ERR_MEMERR;
+	for ( i=0; i<r->size; ++i ) {
+		if ( !r->slot[i].used ) continue;
+		t = refnames_slot( slot, size, str_cstr( &(r->slot[i].stem) ) );
+		*t = r->slot[i];
+	}
+	free( r->slot );
+	r->slot = slot;
+	r->size = size;
+	return BIBL_OK;
+}
+
+/* refnames_next()
+ *
+ * Give out the next unused stem for a reference with the base name
+ * base: base itself, then base_1, base_2, ...
+ */
+static int
+refnames_next( refnames *r, const char *base, str *stem )
+{
+	char count[32];
+	refstem *b, *t;
+	long n = 0;
+
+	if ( ( r->n + 2 ) * 2 > r->size && refnames_grow( r )!=BIBL_OK )
+		return BIBL_ERR_MEMERR;
+
+	b = refnames_slot( r->slot, r->size, base );
+	if ( b->used ) n = b->next;
+
+	while ( 1 ) {
+		if ( n >= SINGLEREF_MAXCOUNT ) return BIBL_ERR_CANTOPEN;
+		str_strcpyc( stem, base );
+		if ( n ) {
+			sprintf( count, "_%ld", n );
+			str_strcatc( stem, count );
+		}
+		if ( str_memerr( stem ) ) return BIBL_ERR_MEMERR;
+		t = refnames_slot( r->slot, r->size, str_cstr( stem ) );
+		if ( !t->used ) break;
+		n++;
+	}
+
+	str_strcpyc( &(t->stem), str_cstr( stem ) );
+	if ( str_memerr( &(t->stem) ) ) return BIBL_ERR_MEMERR;
+	t->next = 1;
+	t->used = 1;
+	r->n++;
+
+	b = refnames_slot( r->slot, r->size, base );
+	b->next = n + 1;
+
+	return BIBL_OK;
+}
+
+static const char *
+singlerefsuffix( int mode )
+{
+	if      ( mode==BIBL_ADSABSOUT )     return "ads";
+	else if ( mode==BIBL_BIBTEXOUT )     return "bib";
+	else if ( mode==BIBL_ENDNOTEOUT )    return "end";
+	else if ( mode==BIBL_ISIOUT )        return "isi";
+	else if ( mode==BIBL_MODSOUT )       return "xml";
+	else if ( mode==BIBL_RISOUT )        return "ris";
+	else if ( mode==BIBL_WORD2007OUT )   return "xml";
+	return "xml";
+}
+
+/* reference's name is its REFNUM, or its position if it has none */
+static void
+singlerefbase( fields *reffields, long nref, str *base )
+{
+	char buf[32];
+	int found;
+	found = fields_find( reffields, "REFNUM", LEVEL_MAIN );
+	if ( found!=-1 )
+		str_strcpyc( base, fields_value( reffields, found, FIELDS_CHRP_NOUSE ) );
+	else {
+		sprintf( buf, "%ld", nref );
+		str_strcpyc( base, buf );
+	}
+}
+
+typedef struct writeeach {
+	bibl            *b;
+	param           *p;
+	str             *path;     /* file for each reference, set up front */
+	pthread_mutex_t lock;
+	long            next;      /* next reference to hand out */
+	int             status;
+} writeeach;
+
+static void
+writeeach_seterr( writeeach *w, int status )
+{
+	pthread_mutex_lock( &(w->lock) );
+	if ( w->status==BIBL_OK ) w->status = status;
+	pthread_mutex_unlock( &(w->lock) );
+}
+
+/* singlerefpath()
+ *
+ * Name the file for the reference with base name base: the next unused
+ * stem for it whose file isn't already on disk.
+ */
+static int
+singlerefpath( refnames *names, const char *base, param *p, str *stem, str *path )
+{
+	struct stat sb;
+	int status;
+
+	while ( 1 ) {
+		status = refnames_next( names, base, stem );
+		if ( status!=BIBL_OK ) return status;
+
+		str_makepath( path, p->outdir, str_cstr( stem ), '/' );
+		str_addchar( path, '.' );
+		str_strcatc( path, singlerefsuffix( p->writeformat ) );
+		str_strcatc( path, zstream_suffix( p->compressout ) );
+		if ( str_memerr( path ) ) return BIBL_ERR_MEMERR;
+
+		if ( lstat( str_cstr( path ), &sb )!=0 ) {
+			if ( errno==ENOENT ) return BIBL_OK;
+			return BIBL_ERR_CANTOPEN;
+		}
+	}
+}
+
+/* create the file for reference n; one that has appeared since it
+ * was named is left alone */
+static FILE *
+singlerefopen( writeeach *w, long n, int *status )
+{
+	FILE *fp;
+	int fd;
+
+	fd = open( str_cstr( &(w->path[n]) ), O_WRONLY | O_CREAT | O_EXCL, 0666 );
+	if ( fd==-1 ) {
+		*status = BIBL_ERR_CANTOPEN;
+		return NULL;
+	}
+
+	fp = fdopen( fd, "w" );
+	if ( !fp ) {
+		close( fd );
+		*status = BIBL_ERR_CANTOPEN;
+	}
+	return fp;
+}
+
+static void *
+writeeach_refs( void *arg )
+{
+	writeeach *w = ( writeeach * ) arg;
+	int status = BIBL_OK;
+	FILE *fp;
+	long n;
+
+	while ( 1 ) {
+		pthread_mutex_lock( &(w->lock) );
+		if ( w->status!=BIBL_OK || w->next>=w->b->nrefs ) n = -1;
+		else n = w->next++;
+		pthread_mutex_unlock( &(w->lock) );
+		if ( n==-1 ) break;
+
+		fp = singlerefopen( w, n, &status );
+		if ( !fp ) break;
+		status = bibl_writerefs( fp, w->b, n, n+1, w->p );
+		fclose( fp );
 		if ( status!=BIBL_OK ) break;
 	}
-	if ( p->footerf ) p->footerf( fp );
+
+	if ( status!=BIBL_OK ) writeeach_seterr( w, status );
+
+	return NULL;
+}
+
+static int
+bibl_writeeachfp( FILE *fp, bibl *b, param *p )
+{
+	pthread_t *threads = NULL;
+	char *started = NULL;
+	int i, nthreads, status;
+	refnames names;
+	str base, stem;
+	writeeach w;
+	long n;
+
+	if ( b->nrefs==0 ) return BIBL_OK;
+
+	if ( p->outdir && mkdir( p->outdir, 0777 )!=0 && errno!=EEXIST )
+		return BIBL_ERR_CANTOPEN;
+
+	w.b      = b;
+	w.p      = p;
+	w.next   = 0;
+	w.status = BIBL_OK;
+	w.path   = NULL;
+
+	status = refnames_init( &names, b->nrefs );
+	if ( status!=BIBL_OK ) return status;
+	pthread_mutex_init( &(w.lock), NULL );
+	strs_init( &base, &stem, NULL );
+
+	/* files are named in reference order, so the output is the
+	 * same however many threads do the writing */
+	w.path = ( str * ) calloc( b->nrefs, sizeof( str ) );
+	if ( !w.path ) {
+		status = BIBL_ERR_MEMERR;
+		goto out;
+	}
+	for ( n=0; n<b->nrefs; ++n ) {
+		singlerefbase( b->ref[n], n, &base );
+		if ( str_memerr( &base ) ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+		status = singlerefpath( &names, str_cstr( &base ), p, &stem, &(w.path[n]) );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	nthreads = p->nthreads;
+	if ( nthreads > b->nrefs ) nthreads = b->nrefs;
+	if ( nthreads > 1 ) {
+		threads = ( pthread_t * ) calloc( nthreads, sizeof( pthread_t ) );
+		started = ( char * ) calloc( nthreads, sizeof( char ) );
+		if ( !threads || !started ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+	}
+
+	for ( i=1; i<nthreads; ++i )
+		started[i] = !pthread_create( &(threads[i]), NULL, writeeach_refs, &w );
+	writeeach_refs( &w );
+	for ( i=1; i<nthreads; ++i )
+		if ( started[i] ) pthread_join( threads[i], NULL );
+
+	status = w.status;
+out:
+	if ( w.path ) {
+		for ( n=0; n<b->nrefs; ++n )
+			str_free( &(w.path[n]) );
+		free( w.path );
+	}
+	if ( threads ) free( threads );
+	if ( started ) free( started );
+	refnames_free( &names );
+	pthread_mutex_destroy( &(w.lock) );
+	strs_free( &base, &stem, NULL );
 	return status;
 }
 
+/*
+ * Sharded output
+ *
+ * Split the output into files <prefix>.0001.<suffix>, <prefix>.0002...,
+ * each with its own header and footer, holding p->shardsize references
+ * (BIBL_SHARD_REFS), about p->shardsize bytes (BIBL_SHARD_BYTES), or
+ * the references whose citekey hashes to that shard out of p->shardsize
+ * (BIBL_SHARD_HASH). Shards whose contents are known up front are
+ * written on p->nthreads threads; byte-sized shards can only be cut as
+ * they are written and so are written in order.
+ */
+typedef struct writeshards {
+	bibl            *b;
+	param           *p;
+	long            nshards;
+	long            *start;    /* shard k is refs[start[k]..start[k+1]) */
+	long            *refs;
+	pthread_mutex_t lock;
+	long            next;      /* next shard to hand out */
+	int             status;
+} writeshards;
+
+static FILE *
+shardopen( param *p, long k, str *path )
+{
+	char num[32];
+
+	sprintf( num, ".%04ld.", k+1 );
+	str_makepath( path, p->outdir, ( p->shardprefix ) ? p->shardprefix : "out", '/' );
+	str_strcatc( path, num );
+	str_strcatc( path, singlerefsuffix( p->writeformat ) );
+	str_strcatc( path, zstream_suffix( p->compressout ) );
+	if ( str_memerr( path ) ) return NULL;
+
+	return fopen( str_cstr( path ), "w" );
+}
+
+static void *
+writeshards_shards( void *arg )
+{
+	writeshards *w = ( writeshards * ) arg;
+	int status = BIBL_OK;
+	refout r;
+	str path;
+	FILE *fp;
+	long k, i;
+
+	str_init( &path );
+
+	while ( 1 ) {
+		pthread_mutex_lock( &(w->lock) );
+		if ( w->status!=BIBL_OK || w->next>=w->nshards ) k = -1;
+		else k = w->next++;
+		pthread_mutex_unlock( &(w->lock) );
+		if ( k==-1 ) break;
+
+		fp = shardopen( w->p, k, &path );
+		if ( !fp ) {
+			status = BIBL_ERR_CANTOPEN;
+			break;
+		}
+		status = refout_open( &r, fp, w->p );
+		if ( status==BIBL_OK ) {
+			for ( i=w->start[k]; i<w->start[k+1]; ++i )
+				if ( refout_ref( &r, w->b, w->refs[i] )!=BIBL_OK ) break;
+			status = refout_close( &r );
+		}
+		fclose( fp );
+		if ( status!=BIBL_OK ) break;
+	}
+
+	if ( status!=BIBL_OK ) {
+		pthread_mutex_lock( &(w->lock) );
+		if ( w->status==BIBL_OK ) w->status = status;
+		pthread_mutex_unlock( &(w->lock) );
+	}
+
+	str_free( &path );
+
+	return NULL;
+}
+
+/* shard for a reference keyed by its citekey (REFNUM) */
+static long
+shardhash( fields *reffields, long nref, long nshards )
+{
+	int found;
+	found = fields_find( reffields, "REFNUM", LEVEL_MAIN );
+	if ( found==-1 ) return nref % nshards;
+	return phash_hash( fields_value( reffields, found, FIELDS_CHRP_NOUSE ), PHASH_WHOLE, 0 ) % nshards;
+}
+
+/* bucket the references into shards: start[] and refs[] in CSR form */
+static int
+writeshards_partition( writeshards *w )
+{
+	bibl *b = w->b;
+	long i, k, *shard = NULL;
+
+	if ( w->p->shardmode==BIBL_SHARD_REFS ) {
+		w->nshards = ( b->nrefs + w->p->shardsize - 1 ) / w->p->shardsize;
+		if ( w->nshards==0 ) w->nshards = 1;
+	} else w->nshards = w->p->shardsize;
+
+	w->start = ( long * ) calloc( w->nshards + 1, sizeof( long ) );
+	w->refs  = ( long * ) malloc( sizeof( long ) * ( b->nrefs + 1 ) );
+	if ( !w->start || !w->refs ) return BIBL_ERR_MEMERR;
+
+	if ( w->p->shardmode==BIBL_SHARD_REFS ) {
+		for ( k=0; k<w->nshards; ++k )
+			w->start[k] = k * w->p->shardsize;
+		w->start[w->nshards] = b->nrefs;
+		for ( i=0; i<b->nrefs; ++i )
+			w->refs[i] = i;
+		return BIBL_OK;
+	}
+
+	shard = ( long * ) malloc( sizeof( long ) * ( b->nrefs + 1 ) );
+	if ( !shard ) return BIBL_ERR_MEMERR;
+	for ( i=0; i<b->nrefs; ++i ) {
+		shard[i] = shardhash( b->ref[i], i, w->nshards );
+		w->start[ shard[i]+1 ]++;
+	}
+	for ( k=0; k<w->nshards; ++k )
+		w->start[k+1] += w->start[k];
+	/* start[k] walks to the end of shard k, then shift back down */
+	for ( i=0; i<b->nrefs; ++i )
+		w->refs[ w->start[ shard[i] ]++ ] = i;
+	for ( k=w->nshards; k>0; --k )
+		w->start[k] = w->start[k-1];
+	w->start[0] = 0;
+	free( shard );
+	return BIBL_OK;
+}
+
+/* byte-sized shards: start a new file once the current one has
+ * reached p->shardsize bytes */
+static int
+bibl_writeshardbytes( bibl *b, param *p )
+{
+	int status = BIBL_OK;
+	long k = 0, i = 0;
+	refout r;
+	str path;
+	FILE *fp;
+
+	str_init( &path );
+
+	do {
+		fp = shardopen( p, k++, &path );
+		if ( !fp ) {
+			status = BIBL_ERR_CANTOPEN;
+			break;
+		}
+		status = refout_open( &r, fp, p );
+		if ( status==BIBL_OK ) {
+			while ( i<b->nrefs ) {
+				if ( refout_ref( &r, b, i++ )!=BIBL_OK ) break;
+				if ( outsink_tell( &(r.o) ) >= (unsigned long) p->shardsize ) break;
+			}
+			status = refout_close( &r );
+		}
+		fclose( fp );
+	} while ( status==BIBL_OK && i<b->nrefs );
+
+	str_free( &path );
+
+	return status;
+}
+
+static int
+bibl_writeshards( bibl *b, param *p )
+{
+	pthread_t *threads = NULL;
+	char *started = NULL;
+	int i, nthreads, status;
+	writeshards w;
+
+	if ( p->shardsize < 1 ) return BIBL_ERR_BADINPUT;
+
+	if ( p->outdir && mkdir( p->outdir, 0777 )!=0 && errno!=EEXIST )
+		return BIBL_ERR_CANTOPEN;
+
+	if ( p->shardmode==BIBL_SHARD_BYTES )
+		return bibl_writeshardbytes( b, p );
+
+	w.b      = b;
+	w.p      = p;
+	w.start  = NULL;
+	w.refs   = NULL;
+	w.next   = 0;
+	w.status = BIBL_OK;
+	pthread_mutex_init( &(w.lock), NULL );
+
+	status = writeshards_partition( &w );
+	if ( status!=BIBL_OK ) goto out;
+
+	nthreads = p->nthreads;
+	if ( nthreads > w.nshards ) nthreads = w.nshards;
+	if ( nthreads > 1 ) {
+		threads = ( pthread_t * ) calloc( nthreads, sizeof( pthread_t ) );
+		started = ( char * ) calloc( nthreads, sizeof( char ) );
+		if ( !threads || !started ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+	}
+
+	for ( i=1; i<nthreads; ++i )
+		started[i] = !pthread_create( &(threads[i]), NULL, writeshards_shards, &w );
+	writeshards_shards( &w );
+	for ( i=1; i<nthreads; ++i )
+		if ( started[i] ) pthread_join( threads[i], NULL );
+
+	status = w.status;
+out:
+	if ( w.start ) free( w.start );
+	if ( w.refs ) free( w.refs );
+	if ( threads ) free( threads );
+	if ( started ) free( started );
+	pthread_mutex_destroy( &(w.lock) );
+	return status;
+}
+
+static int
+bibl_writefp( FILE *fp, bibl *b, param *p )
+{
+	return bibl_writerefs( fp, b, 0, b->nrefs, p );
+}
+
 int
 bibl_write( bibl *b, FILE *fp, param *p )
 {
@@ -998,7 +2570,8 @@ bibl_write( bibl *b, FILE *fp, param *p )
 	if ( !b ) return BIBL_ERR_BADINPUT;
 	if ( !p ) return BIBL_ERR_BADINPUT;
 	if ( bibl_illegaloutmode( p->writeformat ) ) return BIBL_ERR_BADINPUT;
-	if ( !fp && !p->singlerefperfile ) return BIBL_ERR_BADINPUT;
+	if ( !fp && !p->singlerefperfile && !p->shardmode ) return BIBL_ERR_BADINPUT;
+	if ( !zstream_available( p->compressout ) ) return BIBL_ERR_NOCOMPRESS;
 
 	status = bibl_setwriteparams( &lp, p );
 	if ( status!=BIBL_OK ) return status;
@@ -1016,6 +2589,7 @@ bibl_write( bibl *b, FILE *fp, param *p )
 	}
 
 	if ( p->singlerefperfile ) status = bibl_writeeachfp( fp, b, &lp );
+	else if ( p->shardmode ) status = bibl_writeshards( b, &lp );
 	else status = bibl_writefp( fp, b, &lp );
 
 	bibl_freeparams( &lp );
@@ -1023,3 +2597,79 @@ bibl_write( bibl *b, FILE *fp, param *p )
 	return status;
 }
 
+static int
+bibl_snapstatus( int sstatus )
+{
+	switch( sstatus ) {
+		case BIBSNAP_OK:         return BIBL_OK;
+		case BIBSNAP_ERR_MEMERR: return BIBL_ERR_MEMERR;
+		case BIBSNAP_ERR_SYSTEM: return BIBL_ERR_CANTOPEN;
+		default:                 return BIBL_ERR_SNAPSHOT;
+	}
+}
+
+/* bibl_writesnapshot()
+ *
+ * Save the references as read, before any output conversion, so that
+ * bibl_readsnapshot() can hand them to bibl_write() without reading
+ * the original input again.
+ */
+int
+bibl_writesnapshot( bibl *b, FILE *fp, param *p )
+{
+	int status;
+
+	if ( !b )  return BIBL_ERR_BADINPUT;
+	if ( !fp ) return BIBL_ERR_BADINPUT;
+	if ( !p )  return BIBL_ERR_BADINPUT;
+
+	status = bibsnap_write( fp, b, p->readformat );
+	if ( status==BIBSNAP_ERR_SYSTEM ) return BIBL_ERR_WRITE;
+
+	return bibl_snapstatus( status );
+}
+
+/* bibl_readsnapshot()
+ *
+ * Add the references of a snapshot to b. p->readformat is set to the
+ * input format they were originally read from.
+ */
+int
+bibl_readsnapshot( bibl *b, FILE *fp, param *p )
+{
+	int status = BIBL_OK;
+	fields *ref;
+	bibsnap s;
+	long i;
+
+	if ( !b )  return BIBL_ERR_BADINPUT;
+	if ( !fp ) return BIBL_ERR_BADINPUT;
+	if ( !p )  return BIBL_ERR_BADINPUT;
+
+	status = bibl_snapstatus( bibsnap_open( &s, fp ) );
+	if ( status!=BIBL_OK ) return status;
+
+	if ( bibl_illegalinmode( s.readformat ) ) {
+		status = BIBL_ERR_SNAPSHOT;
+		goto out;
+	}
+	p->readformat = s.readformat;
+
+	for ( i=0; i<s.nrefs; ++i ) {
+		ref = fields_new();
+		if ( !ref ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+		status = bibl_snapstatus( bibsnap_getref( &s, i, ref ) );
+		if ( status==BIBL_OK && !bibl_addref( b, ref ) ) status = BIBL_ERR_MEMERR;
+		if ( status!=BIBL_OK ) {
+			fields_delete( ref );
+			goto out;
+		}
+	}
+
+out:
+	bibsnap_close( &s );
+	return status;
+}
@@ -32,5 +32,7 @@ void risout_initparams    ( param *p, const char *progname );
 void wordin_initparams    ( param *p, const char *progname );
 void wordout_initparams   ( param *p, const char *progname );
 
+int  modsout_normalize( fields *f, param *p );
+
 #endif
 
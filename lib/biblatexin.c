@@ -18,6 +18,7 @@
 #include "str_conv.h"
 #include "fields.h"
 #include "slist.h"
+#include "pslist.h"
 #include "name.h"
 #include "reftypes.h"
 #include "bibformats.h"
@@ -26,8 +27,8 @@
 extern variants biblatex_all[];
 extern int biblatex_nall;
 
-static slist find    = { 0, 0, 0, NULL };
-static slist replace = { 0, 0, 0, NULL };
+static slist find    = { 0, 0, 0, NULL, NULL, 0 };
+static slist replace = { 0, 0, 0, NULL, NULL, 0 };
 
 /*****************************************************
  PUBLIC: void biblatexin_initparams()
@@ -51,6 +52,8 @@ biblatexin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = biblatexin_readf;
@@ -63,6 +66,7 @@ biblatexin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -431,6 +435,7 @@ process_string( char *p, long nref, param *pm )
 		if ( str_memerr( &s2 ) ) { status = BIBL_ERR_MEMERR; goto out; }
 	}
 	if ( str_has_value( &s1 ) ) {
+		if ( slist_hash( &find )!=SLIST_OK ) { status = BIBL_ERR_MEMERR; goto out; }
 		n = slist_find( &find, &s1 );
 		if ( n==-1 ) {
 			s = slist_add( &find, &s1 );
@@ -550,11 +555,23 @@ biblatex_cleantoken( str *s )
 	else return BIBL_ERR_MEMERR;
 }
 
+/* the token, trimmed and, if asked, cleaned */
 static int
-biblatex_split( slist *tokens, str *s )
+biblatex_addtoken( pslist *tokens, str *tok, int clean )
+{
+	str_trimstartingws( tok );
+	str_trimendingws( tok );
+	if ( clean && biblatex_cleantoken( tok )!=BIBL_OK ) return BIBL_ERR_MEMERR;
+	if ( str_memerr( tok ) ) return BIBL_ERR_MEMERR;
+	if ( pslist_add( tokens, tok )!=PSLIST_OK ) return BIBL_ERR_MEMERR;
+	return BIBL_OK;
+}
+
+static int
+biblatex_split( pslist *tokens, str *s, int clean )
 {
 	int i, n = s->len, nbrackets = 0, status = BIBL_OK;
-	str tok, *t;
+	str tok;
 
 	str_init( &tok );
 
@@ -570,23 +587,15 @@ biblatex_split( slist *tokens, str *s )
 		} else if ( is_ws( s->data[i] ) ) {
 			if ( str_memerr( &tok ) ) { status = BIBL_ERR_MEMERR; goto out; }
 			if ( str_has_value( &tok ) ) {
-				t = slist_add( tokens, &tok );
-				if ( !t ) { status = BIBL_ERR_MEMERR; goto out; }
+				status = biblatex_addtoken( tokens, &tok, clean );
+				if ( status!=BIBL_OK ) goto out;
 			}
 			str_empty( &tok );
 		}
 	}
 	if ( str_has_value( &tok ) ) {
 		if ( str_memerr( &tok ) ) { status = BIBL_ERR_MEMERR; goto out; }
-		t = slist_add( tokens, &tok );
-		if ( !t ) { status = BIBL_ERR_MEMERR; goto out; }
-	}
-
-	for ( i=0; i<tokens->n; ++i ) {
-		t = slist_str( tokens, i );
-		str_trimstartingws( t );
-		str_trimendingws( t );
-		if ( str_memerr( t ) ) { status = BIBL_ERR_MEMERR; goto out; }
+		status = biblatex_addtoken( tokens, &tok, clean );
 	}
 out:
 	str_free( &tok );
@@ -659,32 +668,36 @@ is_url_tag( str *tag )
 static int
 biblatexin_cleandata( str *tag, str *s, fields *info, param *p )
 {
-	slist tokens;
-	str *tok;
 	int i, status = BIBL_OK;
+	pslist tokens;
+	str tok, cleaned;
+	char *t;
 	if ( str_is_empty( s ) ) return status;
 	/* protect url from undergoing any parsing */
 	if ( is_url_tag( tag ) ) return status;
-	slist_init( &tokens );
-	biblatex_split( &tokens, s );
+	pslist_init( &tokens );
+	strs_init( &tok, &cleaned, NULL );
+	status = biblatex_split( &tokens, s, 0 );
+	if ( status!=BIBL_OK ) goto out;
 	for ( i=0; i<tokens.n; ++i ) {
-		if ( !strncasecmp(slist_cstr( &tokens, i ), "\\href{", 6 )) {
-			status = biblatexin_addtitleurl( info, slist_str( &tokens, i ) );
+		t = pslist_cstr( &tokens, i );
+		str_segcpy( &tok, t, t + pslist_strlen( &tokens, i ) );
+		if ( !strncasecmp( t, "\\href{", 6 ) ) {
+			status = biblatexin_addtitleurl( info, &tok );
 			if ( status!=BIBL_OK ) goto out;
 		}
 		if ( p && p->latexin && !is_name_tag( tag ) ) {
-			status = biblatex_cleantoken( slist_str( &tokens, i ) );
+			status = biblatex_cleantoken( &tok );
 			if ( status!=BIBL_OK ) goto out;
 		}
+		if ( i>0 ) str_addchar( &cleaned, ' ' );
+		str_strcat( &cleaned, &tok );
 	}
-	str_empty( s );
-	for ( i=0; i<tokens.n; ++i ) {
-		tok = slist_str( &tokens, i );
-		if ( i>0 ) str_addchar( s, ' ' );
-		str_strcat( s, tok );
-	}
+	str_strcpy( s, &cleaned );
+	if ( str_memerr( s ) ) status = BIBL_ERR_MEMERR;
 out:
-	slist_free( &tokens );
+	strs_free( &tok, &cleaned, NULL );
+	pslist_free( &tokens );
 	return status;
 }
 
@@ -1003,8 +1016,8 @@ out:
 static int
 biblatex_names( fields *info, char *tag, str *data, int level, slist *asis, slist *corps )
 {
-	int begin, end, ok, n, etal, i, match, status = BIBL_OK;
-	slist tokens;
+	int begin, end, ok, n, etal, match, status = BIBL_OK;
+	pslist tokens;
 
 	/* If we match the asis or corps list add and bail. */
 	status = biblatex_matches_list( info, tag, ":ASIS", data, level, asis, &match );
@@ -1012,11 +1025,10 @@ biblatex_names( fields *info, char *tag, str *data, int level, slist *asis, slis
 	status = biblatex_matches_list( info, tag, ":CORP", data, level, corps, &match );
 	if ( match==1 || status!=BIBL_OK ) return status;
 
-	slist_init( &tokens );
+	pslist_init( &tokens );
 
-	biblatex_split( &tokens, data );
-	for ( i=0; i<tokens.n; ++i )
-		biblatex_cleantoken( slist_str( &tokens, i ) );
+	status = biblatex_split( &tokens, data, 1 );
+	if ( status!=BIBL_OK ) goto out;
 
 	etal = name_findetal( &tokens );
 
@@ -1026,11 +1038,11 @@ biblatex_names( fields *info, char *tag, str *data, int level, slist *asis, slis
 
 		end = begin + 1;
 
-		while ( end < n && strcasecmp( slist_cstr( &tokens, end ), "and" ) )
+		while ( end < n && strcasecmp( pslist_cstr( &tokens, end ), "and" ) )
 			end++;
 
 		if ( end - begin == 1 ) {
-			ok = name_addsingleelement( info, tag, slist_cstr( &tokens, begin ), level, 0 );
+			ok = name_addsingleelement( info, tag, pslist_cstr( &tokens, begin ), level, 0 );
 			if ( !ok ) { status = BIBL_ERR_MEMERR; goto out; }
 		} else {
 			ok = name_addmultielement( info, tag, &tokens, begin, end, level );
@@ -1040,7 +1052,7 @@ biblatex_names( fields *info, char *tag, str *data, int level, slist *asis, slis
 		begin = end + 1;
 
 		/* Handle repeated 'and' errors */
-		while ( begin < n && !strcasecmp( slist_cstr( &tokens, begin ), "and" ) )
+		while ( begin < n && !strcasecmp( pslist_cstr( &tokens, begin ), "and" ) )
 			begin++;
 
 	}
@@ -1051,7 +1063,7 @@ biblatex_names( fields *info, char *tag, str *data, int level, slist *asis, slis
 	}
 
 out:
-	slist_free( &tokens );
+	pslist_free( &tokens );
 	return status;
 }
 
@@ -0,0 +1,437 @@
+/*
+ * bibsnap.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Binary snapshots of a bibl, so a bibliography converted to several
+ * output formats need only be parsed, charset-converted, and run
+ * through the input format's conversion once.
+ *
+ * All integers are little-endian. A snapshot is
+ *
+ *     header    "BIBLSNAP", u32 version, i32 input format
+ *     records   per reference: u32 nfields, then per field
+ *               u32 tag number, i32 level, u32 length, value, '\0'
+ *     tags      u32 ntags, then per tag: u32 length, tag, '\0'
+ *     index     u64 offset of each record
+ *     trailer   u64 nrefs, u64 tags offset, u64 index offset, "BIBLSNAP"
+ *
+ * The trailer is last so a snapshot can be written to a pipe. Tags are
+ * stored once and referred to by number, and strings carry their '\0'
+ * so they can be used straight from the mapped file.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "outsink.h"
+#include "phash.h"
+#include "bibsnap.h"
+
+static const char bibsnap_magic[8] = { 'B', 'I', 'B', 'L', 'S', 'N', 'A', 'P' };
+
+#define BIBSNAP_HEADER  (16)
+#define BIBSNAP_TRAILER (32)
+
+/* far beyond the levels any reader produces, but it keeps a damaged
+ * snapshot from sending the writers through billions of them */
+#define BIBSNAP_MAXLEVEL (64)
+
+/*
+ * writing
+ */
+
+static void
+snap_put32( outsink *o, uint32_t v )
+{
+	unsigned char b[4];
+	b[0] = v & 0xff;
+	b[1] = ( v >> 8 ) & 0xff;
+	b[2] = ( v >> 16 ) & 0xff;
+	b[3] = ( v >> 24 ) & 0xff;
+	outsink_write( o, ( char * ) b, 4 );
+}
+
+static void
+snap_put64( outsink *o, uint64_t v )
+{
+	snap_put32( o, ( uint32_t ) ( v & 0xffffffffUL ) );
+	snap_put32( o, ( uint32_t ) ( v >> 32 ) );
+}
+
+/* tags seen so far, numbered in order of first use */
+typedef struct snaptags {
+	const char **slot;	/* open addressing on the tag string */
+	uint32_t *id;
+	const char **order;
+	unsigned long size, n;
+} snaptags;
+
+static int
+snaptags_init( snaptags *t )
+{
+	t->n    = 0;
+	t->size = 256;
+	t->slot  = ( const char ** ) calloc( t->size, sizeof( const char * ) );
+	t->id    = ( uint32_t * ) calloc( t->size, sizeof( uint32_t ) );
+	t->order = ( const char ** ) calloc( t->size, sizeof( const char * ) );
+	if ( !t->slot || !t->id || !t->order ) return BIBSNAP_ERR_MEMERR;
+	return BIBSNAP_OK;
+}
+
+static void
+snaptags_free( snaptags *t )
+{
+	free( t->slot );
+	free( t->id );
+	free( t->order );
+}
+
+static int
+snaptags_stop( const void *table, unsigned long i, const void *tag )
+{
+	const char * const *slot = ( const char * const * ) table;
+	return ( !slot[i] || !strcmp( slot[i], ( const char * ) tag ) );
+}
+
+static unsigned long
+snaptags_find( snaptags *t, const char *tag )
+{
+	return phash_probe( t->slot, t->size - 1, phash_hash( tag, PHASH_WHOLE, 0 ), snaptags_stop, tag );
+}
+
+static int
+snaptags_grow( snaptags *t )
+{
+	snaptags bigger;
+	unsigned long i, j;
+
+	bigger.n     = t->n;
+	bigger.size  = t->size * 2;
+	bigger.slot  = ( const char ** ) calloc( bigger.size, sizeof( const char * ) );
+	bigger.id    = ( uint32_t * ) calloc( bigger.size, sizeof( uint32_t ) );
+	bigger.order = ( const char ** ) calloc( bigger.size, sizeof( const char * ) );
+	if ( !bigger.slot || !bigger.id || !bigger.order ) {
+		snaptags_free( &bigger );
+		return BIBSNAP_ERR_MEMERR;
+	}
+
+	memcpy( bigger.order, t->order, sizeof( const char * ) * t->n );
+	for ( i=0; i<t->size; ++i ) {
+		if ( !t->slot[i] ) continue;
+		j = snaptags_find( &bigger, t->slot[i] );
+		bigger.slot[j] = t->slot[i];
+		bigger.id[j]   = t->id[i];
+	}
+
+	snaptags_free( t );
+	*t = bigger;
+	return BIBSNAP_OK;
+}
+
+/* number of tag, adding it if it's new */
+static int
+snaptags_add( snaptags *t, const char *tag, uint32_t *id )
+{
+	unsigned long i;
+	int status;
+
+	i = snaptags_find( t, tag );
+	if ( !t->slot[i] ) {
+		if ( ( t->n + 1 ) * 2 > t->size ) {
+			status = snaptags_grow( t );
+			if ( status!=BIBSNAP_OK ) return status;
+			i = snaptags_find( t, tag );
+		}
+		t->slot[i] = tag;
+		t->id[i]   = t->n;
+		t->order[ t->n++ ] = tag;
+	}
+	*id = t->id[i];
+	return BIBSNAP_OK;
+}
+
+static int
+snap_writeref( outsink *o, fields *f, snaptags *t )
+{
+	const char *tag, *value;
+	unsigned long len;
+	uint32_t id;
+	int i, status;
+
+	snap_put32( o, f->n );
+	for ( i=0; i<f->n; ++i ) {
+		tag   = str_cstr( &(f->tag[i]) );
+		value = str_cstr( &(f->data[i]) );
+		if ( !tag )   tag   = "";
+		if ( !value ) value = "";
+		status = snaptags_add( t, tag, &id );
+		if ( status!=BIBSNAP_OK ) return status;
+		len = strlen( value );
+		snap_put32( o, id );
+		snap_put32( o, ( uint32_t ) f->level[i] );
+		snap_put32( o, len );
+		outsink_write( o, value, len + 1 );
+	}
+	return BIBSNAP_OK;
+}
+
+/* bibsnap_write()
+ *
+ * Write the references of b as a snapshot, noting the input format
+ * they were read from.
+ */
+int
+bibsnap_write( FILE *fp, bibl *b, int readformat )
+{
+	uint64_t *offset = NULL, tagoff, indexoff;
+	int status;
+	unsigned long i, len;
+	snaptags t;
+	outsink o;
+
+	if ( outsink_init( &o, fp )!=OUTSINK_OK ) return BIBSNAP_ERR_MEMERR;
+
+	status = snaptags_init( &t );
+	if ( status!=BIBSNAP_OK ) goto out;
+
+	offset = ( uint64_t * ) malloc( sizeof( uint64_t ) * ( b->nrefs + 1 ) );
+	if ( !offset ) {
+		status = BIBSNAP_ERR_MEMERR;
+		goto out;
+	}
+
+	outsink_write( &o, bibsnap_magic, sizeof( bibsnap_magic ) );
+	snap_put32( &o, BIBSNAP_VERSION );
+	snap_put32( &o, ( uint32_t ) readformat );
+
+	for ( i=0; i<b->nrefs; ++i ) {
+		offset[i] = outsink_tell( &o );
+		status = snap_writeref( &o, b->ref[i], &t );
+		if ( status!=BIBSNAP_OK ) goto out;
+	}
+
+	tagoff = outsink_tell( &o );
+	snap_put32( &o, t.n );
+	for ( i=0; i<t.n; ++i ) {
+		len = strlen( t.order[i] );
+		snap_put32( &o, len );
+		outsink_write( &o, t.order[i], len + 1 );
+	}
+
+	indexoff = outsink_tell( &o );
+	for ( i=0; i<b->nrefs; ++i )
+		snap_put64( &o, offset[i] );
+
+	snap_put64( &o, b->nrefs );
+	snap_put64( &o, tagoff );
+	snap_put64( &o, indexoff );
+	outsink_write( &o, bibsnap_magic, sizeof( bibsnap_magic ) );
+
+out:
+	free( offset );
+	snaptags_free( &t );
+	if ( outsink_free( &o )!=OUTSINK_OK && status==BIBSNAP_OK ) {
+		if ( o.status==OUTSINK_MEMERR ) status = BIBSNAP_ERR_MEMERR;
+		else status = BIBSNAP_ERR_SYSTEM;
+	}
+	return status;
+}
+
+/*
+ * reading
+ */
+
+static uint32_t
+snap_get32( const unsigned char *p )
+{
+	return ( uint32_t ) p[0] | ( ( uint32_t ) p[1] << 8 ) |
+	       ( ( uint32_t ) p[2] << 16 ) | ( ( uint32_t ) p[3] << 24 );
+}
+
+static uint64_t
+snap_get64( const unsigned char *p )
+{
+	return ( uint64_t ) snap_get32( p ) | ( ( uint64_t ) snap_get32( p+4 ) << 32 );
+}
+
+/* a pipe can't be mapped, so read it all in */
+static int
+snap_slurp( bibsnap *s, FILE *fp )
+{
+	size_t max = 64*1024, n;
+	unsigned char *more;
+
+	s->data = ( unsigned char * ) malloc( max );
+	if ( !s->data ) return BIBSNAP_ERR_MEMERR;
+	s->len = 0;
+
+	while ( ( n = fread( s->data + s->len, 1, max - s->len, fp ) ) > 0 ) {
+		s->len += n;
+		if ( s->len == max ) {
+			more = ( unsigned char * ) realloc( s->data, max * 2 );
+			if ( !more ) return BIBSNAP_ERR_MEMERR;
+			s->data = more;
+			max *= 2;
+		}
+	}
+	if ( ferror( fp ) ) return BIBSNAP_ERR_SYSTEM;
+	return BIBSNAP_OK;
+}
+
+static int
+snap_map( bibsnap *s, FILE *fp )
+{
+	struct stat st;
+	void *p;
+
+	if ( fstat( fileno( fp ), &st ) || !S_ISREG( st.st_mode ) || st.st_size==0 ||
+	     ftell( fp )!=0 )
+		return snap_slurp( s, fp );
+
+	p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno( fp ), 0 );
+	if ( p==MAP_FAILED ) return snap_slurp( s, fp );
+
+	s->data   = ( unsigned char * ) p;
+	s->len    = st.st_size;
+	s->mapped = 1;
+	return BIBSNAP_OK;
+}
+
+/* find the tags and the index, checking that they lie where they should */
+static int
+snap_settables( bibsnap *s )
+{
+	const unsigned char *trailer;
+	uint64_t nrefs, tagoff, indexoff, pos, len;
+	unsigned long i;
+
+	if ( s->len < BIBSNAP_HEADER + BIBSNAP_TRAILER ) return BIBSNAP_ERR_DATA;
+	if ( memcmp( s->data, bibsnap_magic, sizeof( bibsnap_magic ) ) ) return BIBSNAP_ERR_DATA;
+	if ( snap_get32( s->data + 8 )!=BIBSNAP_VERSION ) return BIBSNAP_ERR_DATA;
+	s->readformat = ( int32_t ) snap_get32( s->data + 12 );
+
+	trailer = s->data + s->len - BIBSNAP_TRAILER;
+	if ( memcmp( trailer + 24, bibsnap_magic, sizeof( bibsnap_magic ) ) ) return BIBSNAP_ERR_DATA;
+	nrefs    = snap_get64( trailer );
+	tagoff   = snap_get64( trailer + 8 );
+	indexoff = snap_get64( trailer + 16 );
+	if ( indexoff < BIBSNAP_HEADER + 4 || indexoff > s->len - BIBSNAP_TRAILER ) return BIBSNAP_ERR_DATA;
+	if ( tagoff < BIBSNAP_HEADER || tagoff > indexoff - 4 ) return BIBSNAP_ERR_DATA;
+	if ( nrefs != ( s->len - BIBSNAP_TRAILER - indexoff ) / 8 ) return BIBSNAP_ERR_DATA;
+
+	s->nrefs = nrefs;
+	s->index = s->data + indexoff;
+
+	s->ntags = snap_get32( s->data + tagoff );
+	if ( s->ntags > ( indexoff - tagoff ) / 5 ) return BIBSNAP_ERR_DATA;
+	s->tags = ( const char ** ) malloc( sizeof( const char * ) * ( s->ntags + 1 ) );
+	if ( !s->tags ) return BIBSNAP_ERR_MEMERR;
+
+	pos = tagoff + 4;
+	for ( i=0; i<s->ntags; ++i ) {
+		if ( pos + 4 > indexoff ) return BIBSNAP_ERR_DATA;
+		len = snap_get32( s->data + pos );
+		pos += 4;
+		if ( pos + len + 1 > indexoff || s->data[ pos + len ]!='\0' ) return BIBSNAP_ERR_DATA;
+		s->tags[i] = ( const char * ) s->data + pos;
+		pos += len + 1;
+	}
+
+	return BIBSNAP_OK;
+}
+
+/* bibsnap_open()
+ *
+ * Map the snapshot in fp, or read it if fp isn't a plain file, and
+ * check its layout. References are read from it with bibsnap_getref().
+ */
+int
+bibsnap_open( bibsnap *s, FILE *fp )
+{
+	int status;
+
+	s->data   = NULL;
+	s->len    = 0;
+	s->mapped = 0;
+	s->nrefs  = 0;
+	s->ntags  = 0;
+	s->tags   = NULL;
+	s->index  = NULL;
+	s->readformat = -1;
+
+	status = snap_map( s, fp );
+	if ( status==BIBSNAP_OK ) status = snap_settables( s );
+	if ( status!=BIBSNAP_OK ) bibsnap_close( s );
+
+	return status;
+}
+
+void
+bibsnap_close( bibsnap *s )
+{
+	if ( s->mapped ) munmap( ( void * ) s->data, s->len );
+	else free( s->data );
+	free( s->tags );
+	s->data   = NULL;
+	s->tags   = NULL;
+	s->index  = NULL;
+	s->len    = 0;
+	s->mapped = 0;
+	s->nrefs  = 0;
+	s->ntags  = 0;
+}
+
+/* bibsnap_getref()
+ *
+ * Add the fields of reference n to f.
+ */
+int
+bibsnap_getref( bibsnap *s, long n, fields *f )
+{
+	const unsigned char *p, *end = s->index;
+	uint32_t nfields, i, id, len;
+	uint64_t off;
+	int k, level;
+
+	if ( n < 0 || n >= s->nrefs ) return BIBSNAP_ERR_DATA;
+
+	off = snap_get64( s->index + 8 * n );
+	if ( off < BIBSNAP_HEADER || off + 4 > ( uint64_t ) ( end - s->data ) ) return BIBSNAP_ERR_DATA;
+	p = s->data + off;
+
+	nfields = snap_get32( p );
+	p += 4;
+	if ( nfields > ( size_t ) ( end - p ) / 13 ) return BIBSNAP_ERR_DATA;
+	if ( fields_reserve( f, f->n + nfields )!=FIELDS_OK ) return BIBSNAP_ERR_MEMERR;
+
+	for ( i=0; i<nfields; ++i ) {
+		if ( p + 12 > end ) return BIBSNAP_ERR_DATA;
+		id    = snap_get32( p );
+		level = ( int32_t ) snap_get32( p+4 );
+		len   = snap_get32( p+8 );
+		if ( id >= s->ntags ) return BIBSNAP_ERR_DATA;
+		if ( level > BIBSNAP_MAXLEVEL || level < -BIBSNAP_MAXLEVEL ) return BIBSNAP_ERR_DATA;
+		if ( len >= ( size_t ) ( end - ( p + 12 ) ) || p[ 12 + len ]!='\0' ) return BIBSNAP_ERR_DATA;
+
+		k = f->n;
+		f->used[k]  = 0;
+		f->level[k] = level;
+		str_strcpyc( &(f->tag[k]), s->tags[id] );
+		str_strcpyc( &(f->data[k]), ( const char * ) p + 12 );
+		if ( str_memerr( &(f->tag[k]) ) || str_memerr( &(f->data[k]) ) )
+			return BIBSNAP_ERR_MEMERR;
+		f->n++;
+
+		p += 12 + len + 1;
+	}
+
+	return BIBSNAP_OK;
+}
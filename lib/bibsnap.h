@@ -0,0 +1,44 @@
+/*
+ * bibsnap.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef BIBSNAP_H
+#define BIBSNAP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "bibl.h"
+
+#define BIBSNAP_OK         (0)
+#define BIBSNAP_ERR_MEMERR (-1)
+#define BIBSNAP_ERR_DATA   (-2)  /* not a snapshot, or a damaged one */
+#define BIBSNAP_ERR_SYSTEM (-3)  /* i/o failure */
+
+#define BIBSNAP_VERSION (1)
+
+/* A snapshot holds the references of a bibl as they stand after
+ * reading, so they can be written out again without the original
+ * parse.  An open snapshot is mapped (or, for a pipe, read) whole
+ * and references are built from it on request.
+ */
+typedef struct bibsnap {
+	unsigned char *data;
+	size_t        len;
+	int           mapped;
+	int           readformat;   /* input format the references came from */
+	long          nrefs;
+	unsigned long ntags;
+	const char    **tags;       /* point into data */
+	const unsigned char *index; /* nrefs record offsets */
+} bibsnap;
+
+int  bibsnap_write ( FILE *fp, bibl *b, int readformat );
+int  bibsnap_open  ( bibsnap *s, FILE *fp );
+int  bibsnap_getref( bibsnap *s, long n, fields *f );
+void bibsnap_close ( bibsnap *s );
+
+#endif
@@ -16,6 +16,7 @@
 #include "str_conv.h"
 #include "fields.h"
 #include "slist.h"
+#include "pslist.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
@@ -23,8 +24,8 @@
 #include "bibformats.h"
 #include "generic.h"
 
-static slist find    = { 0, 0, 0, NULL };
-static slist replace = { 0, 0, 0, NULL };
+static slist find    = { 0, 0, 0, NULL, NULL, 0 };
+static slist replace = { 0, 0, 0, NULL, NULL, 0 };
 
 extern variants bibtex_all[];
 extern int bibtex_nall;
@@ -51,6 +52,8 @@ bibtexin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = bibtexin_readf;
@@ -63,6 +66,7 @@ bibtexin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -186,166 +190,313 @@ bibtex_tag( char *p, str *tag )
 	return skip_ws( p );
 }
 
+/* A field value is split into tokens that are spans of the reference
+ * buffer: quoted strings, bracketed strings, bare words (possibly
+ * @STRING macros), and '#' concatenation operators.
+ */
+typedef struct bibtex_token {
+	char *start;
+	unsigned long len;
+	int hash;    /* '#' concatenation operator */
+	str *macro;  /* @STRING replacement for bare word, if any */
+} bibtex_token;
+
+#define BIBTEX_NTOKENS (32)
+
+typedef struct bibtex_tokens {
+	bibtex_token  buf[ BIBTEX_NTOKENS ];
+	bibtex_token *tok;
+	int n, max;
+} bibtex_tokens;
+
+static void
+bibtex_tokens_init( bibtex_tokens *t )
+{
+	t->tok = t->buf;
+	t->n   = 0;
+	t->max = BIBTEX_NTOKENS;
+}
+
+static void
+bibtex_tokens_free( bibtex_tokens *t )
+{
+	if ( t->tok!=t->buf ) free( t->tok );
+}
+
+static int
+bibtex_tokens_add( bibtex_tokens *t, char *start, char *end, int hash )
+{
+	bibtex_token *more;
+	int i;
+
+	if ( t->n == t->max ) {
+		if ( t->tok==t->buf ) {
+			more = ( bibtex_token * ) malloc( sizeof( bibtex_token ) * t->max * 2 );
+			if ( more )
+				for ( i=0; i<t->n; ++i ) more[i] = t->buf[i];
+		} else {
+			more = ( bibtex_token * ) realloc( t->tok, sizeof( bibtex_token ) * t->max * 2 );
+		}
+		if ( !more ) return BIBL_ERR_MEMERR;
+		t->tok = more;
+		t->max *= 2;
+	}
+
+	t->tok[t->n].start = start;
+	t->tok[t->n].len   = end - start;
+	t->tok[t->n].hash  = hash;
+	t->tok[t->n].macro = NULL;
+	t->n++;
+
+	return BIBL_OK;
+}
+
+/* bibtex_tokenize()
+ *
+ * Split the field value starting at p into tokens, stopping at the
+ * ',', '=', '}', or ')' that ends the value.
+ */
 static char *
-bibtex_data( char *p, fields *bibin, slist *tokens, long nref, param *pm )
+bibtex_tokenize( char *p, bibtex_tokens *tokens, long nref, param *pm )
 {
 	unsigned int nbracket = 0, nquotes = 0;
-	char *startp = p;
-	str tok, *t;
+	char *startp = p, *tokstart = NULL;
+	int status = BIBL_OK;
 
-	str_init( &tok );
-	while ( p && *p ) {
+	while ( *p ) {
 		if ( !nquotes && !nbracket ) {
 			if ( *p==',' || *p=='=' || *p=='}' || *p==')' )
-				goto out;
+				break;
 		}
 		if ( *p=='\"' && nbracket==0 && ( p==startp || *(p-1)!='\\' ) ) {
+			if ( !tokstart ) tokstart = p;
 			nquotes = !nquotes;
-			str_addchar( &tok, *p );
 			if ( !nquotes ) {
-				if ( str_memerr( &tok ) ) { p=NULL; goto out; }
-				t = slist_add( tokens, &tok );
-				if ( !t ) { p=NULL; goto out0; }
-				str_empty( &tok );
+				status = bibtex_tokens_add( tokens, tokstart, p+1, 0 );
+				tokstart = NULL;
 			}
 		} else if ( *p=='#' && !nquotes && !nbracket ) {
-			if ( str_has_value( &tok ) ) {
-				if ( str_memerr( &tok ) ) { p=NULL; goto out; }
-				t = slist_add( tokens, &tok );
-				if ( !t ) { p=NULL; goto out0; }
-			}
-			str_strcpyc( &tok, "#" );
-			t = slist_add( tokens, &tok );
-			if ( !t ) { p=NULL; goto out0; }
-			str_empty( &tok );
+			if ( tokstart )
+				status = bibtex_tokens_add( tokens, tokstart, p, 0 );
+			if ( status==BIBL_OK )
+				status = bibtex_tokens_add( tokens, p, p+1, 1 );
+			tokstart = NULL;
 		} else if ( *p=='{' && !nquotes && ( p==startp || *(p-1)!='\\' ) ) {
+			if ( !tokstart ) tokstart = p;
 			nbracket++;
-			str_addchar( &tok, *p );
 		} else if ( *p=='}' && !nquotes && ( p==startp || *(p-1)!='\\' ) ) {
 			nbracket--;
-			str_addchar( &tok, *p );
 			if ( nbracket==0 ) {
-				if ( str_memerr( &tok ) ) { p=NULL; goto out; }
-				t = slist_add( tokens, &tok );
-				if ( !t ) { p=NULL; goto out; }
-				str_empty( &tok );
+				status = bibtex_tokens_add( tokens, tokstart, p+1, 0 );
+				tokstart = NULL;
 			}
-		} else if ( !is_ws( *p ) || nquotes || nbracket ) {
-			if ( !is_ws( *p ) ) str_addchar( &tok, *p );
-			else {
-				if ( tok.len!=0 && *p!='\n' && *p!='\r' )
-					str_addchar( &tok, *p );
-				else if ( tok.len!=0 && (*p=='\n' || *p=='\r')) {
-					str_addchar( &tok, ' ' );
-					while ( is_ws( *(p+1) ) ) p++;
-				}
-			}
-		} else if ( is_ws( *p ) ) {
-			if ( tok.len ) {
-				if ( str_memerr( &tok ) ) { p=NULL; goto out; }
-				t = slist_add( tokens, &tok );
-				if ( !t ) { p=NULL; goto out; }
-				str_empty( &tok );
+		} else if ( !is_ws( *p ) ) {
+			if ( !tokstart ) tokstart = p;
+		} else if ( !nquotes && !nbracket ) {
+			if ( tokstart ) {
+				status = bibtex_tokens_add( tokens, tokstart, p, 0 );
+				tokstart = NULL;
 			}
 		}
+		if ( status!=BIBL_OK ) return NULL;
 		p++;
 	}
-out:
+
 	if ( nbracket!=0 ) {
 		fprintf( stderr, "%s: Mismatch in number of brackets in reference %ld.\n", pm->progname, nref );
 	}
 	if ( nquotes!=0 ) {
 		fprintf( stderr, "%s: Mismatch in number of quotes in reference %ld.\n", pm->progname, nref );
 	}
-	if ( str_has_value( &tok ) ) {
-		if ( str_memerr( &tok ) ) { p = NULL; goto out; }
-		t = slist_add( tokens, &tok );
-		if ( !t ) p = NULL;
+	if ( tokstart ) {
+		status = bibtex_tokens_add( tokens, tokstart, p, 0 );
+		if ( status!=BIBL_OK ) return NULL;
 	}
-out0:
-	str_free( &tok );
+
 	return p;
 }
 
-/* replace_strings()
+/* bibtex_tokenstr()
  *
- * do string replacement -- only if unprotected by quotation marks or curly brackets
+ * Append token text to s; line breaks inside quoted and bracketed
+ * strings (with any following whitespace) become a single space.
  */
 static void
-replace_strings( slist *tokens, fields *bibin, param *pm )
+bibtex_tokenstr( str *s, bibtex_token *t, unsigned long skip )
 {
-	int i, n, ok;
-	char *q;
-	str *s;
-	i = 0;
-	while ( i < tokens->n ) {
-		s = slist_str( tokens, i );
-		if ( !strcmp( s->data, "#" ) ) {
-		} else if ( s->data[0]!='\"' && s->data[0]!='{' ) {
-			n = slist_find( &find, s );
-			if ( n!=-1 ) {
-				str_strcpy( s, slist_str( &replace, n ) );
-			} else {
-				q = s->data;
-				ok = 1;
-				while ( *q && ok ) {
-					if ( !isdigit( *q ) ) ok = 0;
-					q++;
-				}
-			}
+	char *p, *end, *q;
+
+	if ( t->macro ) {
+		if ( skip < t->macro->len )
+			str_strcatc( s, t->macro->data + skip );
+		return;
+	}
+
+	p   = t->start + skip;
+	end = t->start + t->len;
+	while ( p < end ) {
+		q = p;
+		while ( q < end && *q!='\n' && *q!='\r' ) q++;
+		if ( q > p ) str_segcat( s, p, q );
+		if ( q < end ) {
+			str_addchar( s, ' ' );
+			while ( q < end && is_ws( *q ) ) q++;
 		}
-		i++;
+		p = q;
 	}
 }
 
+static char
+bibtex_tokenfirst( bibtex_token *t )
+{
+	if ( t->macro ) return ( t->macro->len ) ? t->macro->data[0] : '\0';
+	return ( t->len ) ? t->start[0] : '\0';
+}
+
+static char
+bibtex_tokenlast( bibtex_token *t )
+{
+	if ( t->macro ) return ( t->macro->len ) ? t->macro->data[t->macro->len-1] : '\0';
+	return ( t->len ) ? t->start[t->len-1] : '\0';
+}
+
+/* bibtex_findmacro()
+ *
+ * Replace bare words defined by @STRING -- only if unprotected by quotation
+ * marks or curly brackets
+ */
 static int
-string_concatenate( slist *tokens, fields *bibin, long nref, param *pm )
+bibtex_findmacro( bibtex_token *t, str *tmp )
 {
-	int i, status;
-	str *s, *t;
-	i = 0;
-	while ( i < tokens->n ) {
-		s = slist_str( tokens, i );
-		if ( !strcmp( s->data, "#" ) ) {
-			if ( i==0 || i==tokens->n-1 ) {
-				fprintf( stderr, "%s: Warning: Stray string concatenation "
-					"('#' character) in reference %ld\n", pm->progname, nref );
-				status = slist_remove( tokens, i );
-				if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
-				continue;
-			}
-			s = slist_str( tokens, i-1 );
-			if ( s->data[0]!='\"' && s->data[s->len-1]!='\"' )
-				fprintf( stderr, "%s: Warning: String concentation should "
-					"be used in context of quotations marks in reference %ld\n", pm->progname, nref );
-			t = slist_str( tokens, i+1 );
-			if ( t->data[0]!='\"' && t->data[s->len-1]!='\"' )
-				fprintf( stderr, "%s: Warning: String concentation should "
-					"be used in context of quotations marks in reference %ld\n", pm->progname, nref );
-			if ( ( s->data[s->len-1]=='\"' && t->data[0]=='\"') || (s->data[s->len-1]=='}' && t->data[0]=='{') ) {
-				str_trimend( s, 1 );
-				str_trimbegin( t, 1 );
-				str_strcat( s, t );
-			} else {
-				str_strcat( s, t );
-			}
-			status = slist_remove( tokens, i );
-			if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
-			status = slist_remove( tokens, i );
-			if ( status!=SLIST_OK ) return BIBL_ERR_MEMERR;
-		} else i++;
+	char *s = t->start;
+	unsigned long len = t->len;
+	slist_index i;
+
+	if ( t->hash || *s=='\"' || *s=='{' ) return BIBL_OK;
+
+	/* match on text with line breaks removed */
+	if ( memchr( s, '\n', len ) || memchr( s, '\r', len ) ) {
+		str_empty( tmp );
+		bibtex_tokenstr( tmp, t, 0 );
+		if ( str_memerr( tmp ) ) return BIBL_ERR_MEMERR;
+		s   = tmp->data;
+		len = tmp->len;
 	}
+
+	i = slist_findcn( &find, s, ( slist_index ) len );
+	if ( i!=-1 ) {
+		t->macro = slist_str( &replace, i );
+		/* a macro defined as "#" acts as a concatenation */
+		if ( t->macro->len==1 && t->macro->data[0]=='#' ) t->hash = 1;
+	}
+
 	return BIBL_OK;
 }
 
+/* bibtex_endvalue()
+ *
+ * Strip the quotation marks or brackets around the completed value
+ * starting at position start in data.
+ */
+static void
+bibtex_endvalue( str *data, unsigned long start, uchar stripquotes )
+{
+	char first, last;
+
+	if ( data->len <= start ) return;
+
+	first = data->data[start];
+	last  = data->data[data->len-1];
+	if ( ( stripquotes && first=='\"' && last=='\"' ) ||
+	     ( first=='{' && last=='}' ) ) {
+		if ( data->len - start > 1 )
+			memmove( data->data + start, data->data + start + 1, data->len - start - 2 );
+		data->len -= ( data->len - start > 1 ) ? 2 : 1;
+		data->data[data->len] = '\0';
+	}
+}
+
+static int
+bibtex_quoted( char first, char last )
+{
+	return ( first=='\"' || last=='\"' );
+}
+
+/* bibtex_data()
+ *
+ * Build the field value in data from a single pass over the tokens,
+ * resolving @STRING macros and '#' concatenation. Adjacent values
+ * (without '#') are appended directly.
+ */
+static char *
+bibtex_data( char *p, str *data, uchar stripquotes, long nref, param *pm )
+{
+	unsigned long start = 0;
+	bibtex_tokens tokens;
+	bibtex_token *t;
+	int i, status, have = 0;
+	char last;
+	str tmp;
+
+	bibtex_tokens_init( &tokens );
+	str_init( &tmp );
+
+	p = bibtex_tokenize( p, &tokens, nref, pm );
+	if ( !p ) goto out;
+
+	for ( i=0; i<tokens.n; ++i ) {
+		status = bibtex_findmacro( &(tokens.tok[i]), &tmp );
+		if ( status!=BIBL_OK ) { p = NULL; goto out; }
+	}
+
+	for ( i=0; i<tokens.n; ++i ) {
+		t = &(tokens.tok[i]);
+
+		if ( !t->hash ) {
+			/* start of a new value */
+			if ( have ) bibtex_endvalue( data, start, stripquotes );
+			start = data->len;
+			bibtex_tokenstr( data, t, 0 );
+			have = 1;
+			continue;
+		}
+
+		if ( !have || i==tokens.n-1 ) {
+			fprintf( stderr, "%s: Warning: Stray string concatenation "
+				"('#' character) in reference %ld\n", pm->progname, nref );
+			continue;
+		}
+
+		/* concatenate next token onto current value */
+		t = &(tokens.tok[++i]);
+		last = ( data->len > start ) ? data->data[data->len-1] : '\0';
+		if ( !bibtex_quoted( ( data->len > start ) ? data->data[start] : '\0', last ) )
+			fprintf( stderr, "%s: Warning: String concentation should "
+				"be used in context of quotations marks in reference %ld\n", pm->progname, nref );
+		if ( !bibtex_quoted( bibtex_tokenfirst( t ), bibtex_tokenlast( t ) ) )
+			fprintf( stderr, "%s: Warning: String concentation should "
+				"be used in context of quotations marks in reference %ld\n", pm->progname, nref );
+		if ( ( last=='\"' && bibtex_tokenfirst( t )=='\"' ) ||
+		     ( last=='}'  && bibtex_tokenfirst( t )=='{' ) ) {
+			str_trimend( data, 1 );
+			bibtex_tokenstr( data, t, 1 );
+		} else {
+			bibtex_tokenstr( data, t, 0 );
+		}
+	}
+	if ( have ) bibtex_endvalue( data, start, stripquotes );
+
+	if ( str_memerr( data ) ) p = NULL;
+out:
+	bibtex_tokens_free( &tokens );
+	str_free( &tmp );
+	return p;
+}
+
 /* return NULL on memory error */
 static char *
 process_bibtexline( char *p, str *tag, str *data, uchar stripquotes, fields *bibin, long nref, param *pm )
 {
-	int i, status;
-	slist tokens;
-	str *s;
-
 	str_empty( data );
 
 	p = bibtex_tag( p, tag );
@@ -357,32 +508,9 @@ process_bibtexline( char *p, str *tag, str *data, uchar stripquotes, fields *bib
 		return p;
 	}
 
-	slist_init( &tokens );
-
-	if ( *p=='=' ) {
-		p = bibtex_data( p+1, bibin, &tokens, nref, pm );
-		if ( p==NULL ) goto out;
-	}
-
-	replace_strings( &tokens, bibin, pm );
-
-	status = string_concatenate( &tokens, bibin, nref, pm );
-	if ( status!=BIBL_OK ) {
-		p = NULL;
-		goto out;
-	}
+	if ( *p=='=' )
+		p = bibtex_data( p+1, data, stripquotes, nref, pm );
 
-	for ( i=0; i<tokens.n; i++ ) {
-		s = slist_str( &tokens, i );
-		if ( ( stripquotes && s->data[0]=='\"' && s->data[s->len-1]=='\"' ) ||
-		     ( s->data[0]=='{' && s->data[s->len-1]=='}' ) ) {
-			str_trimbegin( s, 1 );
-			str_trimend( s, 1 );
-		}
-		str_strcat( data, slist_str( &tokens, i ) );
-	}
-out:
-	slist_free( &tokens );
 	return p;
 }
 
@@ -448,6 +576,7 @@ process_string( char *p, long nref, param *pm )
 		str_findreplace( &s2, "\\ ", " " );
 	}
 	if ( str_has_value( &s1 ) ) {
+		if ( slist_hash( &find )!=SLIST_OK ) { status = BIBL_ERR_MEMERR; goto out; }
 		n = slist_find( &find, &s1 );
 		if ( n==-1 ) {
 			t = slist_add( &find, &s1 );
@@ -497,49 +626,32 @@ bibtex_protected( str *data )
 	return 0;
 }
 
-static int
-bibtex_split( slist *tokens, str *s )
+/* bibtex_nexttoken()
+ *
+ * Find the next whitespace-delimited token (whitespace within brackets
+ * doesn't split tokens) at or after p and before end. Returns the start
+ * of the token, or NULL if there are no more, with *tokend set to the
+ * character just past the token.
+ */
+static char *
+bibtex_nexttoken( char *p, char *end, char *data, char **tokend )
 {
-	int i, n = s->len, nbrackets = 0, status = BIBL_OK;
-	str tok, *t;
+	int nbrackets = 0;
+	char *start;
 
-	str_init( &tok );
+	while ( p<end && is_ws( *p ) ) p++;
+	if ( p==end ) return NULL;
 
-	for ( i=0; i<n; ++i ) {
-		if ( s->data[i]=='{' && ( i==0 || s->data[i-1]!='\\' ) ) {
-			nbrackets++;
-			str_addchar( &tok, '{' );
-		} else if ( s->data[i]=='}' && ( i==0 || s->data[i-1]!='\\' ) ) {
-			nbrackets--;
-			str_addchar( &tok, '}' );
-		} else if ( !is_ws( s->data[i] ) || nbrackets ) {
-			str_addchar( &tok, s->data[i] );
-		} else if ( is_ws( s->data[i] ) ) {
-			if ( str_has_value( &tok ) ) {
-				t = slist_add( tokens, &tok );
-				if ( !t ) {
-					status = BIBL_ERR_MEMERR;
-					goto out;
-				}
-			}
-			str_empty( &tok );
-		}
-	}
-	if ( str_has_value( &tok ) ) {
-		t = slist_add( tokens, &tok );
-		if ( !t ) {
-			status = BIBL_ERR_MEMERR;
-			goto out;
-		}
+	start = p;
+	while ( p<end ) {
+		if ( *p=='{' && ( p==data || *(p-1)!='\\' ) ) nbrackets++;
+		else if ( *p=='}' && ( p==data || *(p-1)!='\\' ) ) nbrackets--;
+		else if ( is_ws( *p ) && !nbrackets ) break;
+		p++;
 	}
 
-	for ( i=0; i<tokens->n; ++i ) {
-		str_trimstartingws( slist_str( tokens, i ) );
-		str_trimendingws( slist_str( tokens, i ) );
-	}
-out:
-	str_free( &tok );
-	return status;
+	*tokend = p;
+	return start;
 }
 
 static int
@@ -642,66 +754,113 @@ bibtex_process_bracket( str *s )
 static void
 bibtex_cleantoken( str *s )
 {
-	/* 'textcomp' annotations */
-	str_findreplace( s, "\\textit", "" );
-	str_findreplace( s, "\\textbf", "" );
-	str_findreplace( s, "\\textsl", "" );
-	str_findreplace( s, "\\textsc", "" );
-	str_findreplace( s, "\\textsf", "" );
-	str_findreplace( s, "\\texttt", "" );
-	str_findreplace( s, "\\textsubscript", "" );
-	str_findreplace( s, "\\textsuperscript", "" );
-	str_findreplace( s, "\\emph", "" );
-	str_findreplace( s, "\\url", "" );
-	str_findreplace( s, "\\mbox", "" );
-
-	/* Other text annotations */
-	str_findreplace( s, "\\it ", "" );
-	str_findreplace( s, "\\em ", "" );
-
-	str_findreplace( s, "\\%", "%" );
-	str_findreplace( s, "\\$", "$" );
+	/* all annotations start with a backslash, skip searching for them */
+	/* in the common case of plain text                                  */
+	int annotated = ( s->len && memchr( s->data, '\\', s->len ) );
+
+	if ( annotated ) {
+
+		/* 'textcomp' annotations */
+		str_findreplace( s, "\\textit", "" );
+		str_findreplace( s, "\\textbf", "" );
+		str_findreplace( s, "\\textsl", "" );
+		str_findreplace( s, "\\textsc", "" );
+		str_findreplace( s, "\\textsf", "" );
+		str_findreplace( s, "\\texttt", "" );
+		str_findreplace( s, "\\textsubscript", "" );
+		str_findreplace( s, "\\textsuperscript", "" );
+		str_findreplace( s, "\\emph", "" );
+		str_findreplace( s, "\\url", "" );
+		str_findreplace( s, "\\mbox", "" );
+
+		/* Other text annotations */
+		str_findreplace( s, "\\it ", "" );
+		str_findreplace( s, "\\em ", "" );
+
+		str_findreplace( s, "\\%", "%" );
+		str_findreplace( s, "\\$", "$" );
+	}
+
 	while ( str_findreplace( s, "  ", " " ) ) {}
 
-	/* 'textcomp' annotations that we don't want to substitute on output*/
-	str_findreplace( s, "\\textdollar", "$" );
-	str_findreplace( s, "\\textunderscore", "_" );
+	if ( annotated ) {
+		/* 'textcomp' annotations that we don't want to substitute on output*/
+		str_findreplace( s, "\\textdollar", "$" );
+		str_findreplace( s, "\\textunderscore", "_" );
+	}
 
 	bibtex_process_bracket( s );
 	bibtex_process_tilde( s );
 
 }
 
+/* bibtex_split()
+ *
+ * Split s into whitespace-delimited tokens, cleaned, for callers that
+ * need them as a list (e.g. names).
+ */
+static int
+bibtex_split( pslist *tokens, str *s )
+{
+	int status = BIBL_OK;
+	char *p, *start, *end;
+	str tok;
+
+	if ( str_is_empty( s ) ) return BIBL_OK;
+
+	str_init( &tok );
+
+	p = s->data;
+	while ( ( start = bibtex_nexttoken( p, s->data + s->len, s->data, &p ) ) ) {
+		end = p;
+		while ( end > start && is_ws( *(end-1) ) ) end--;
+		str_segcpy( &tok, start, end );
+		bibtex_cleantoken( &tok );
+		if ( str_memerr( &tok ) || pslist_add( tokens, &tok )!=PSLIST_OK ) {
+			status = BIBL_ERR_MEMERR;
+			goto out;
+		}
+	}
+out:
+	str_free( &tok );
+	return status;
+}
+
 static int
 bibtex_cleandata( str *tag, str *s, fields *info, param *p )
 {
-	int i, status;
-	slist tokens;
-	str *tok;
+	int status = BIBL_OK, ntok = 0, clean;
+	char *q, *start, *end;
+	str tok, out;
+
 	if ( str_is_empty( s ) ) return BIBL_OK;
 	/* protect url from undergoing any parsing */
 	if ( is_url_tag( tag ) ) return BIBL_OK;
-	slist_init( &tokens );
-	status = bibtex_split( &tokens, s );
-	if ( status!=BIBL_OK ) goto out;
-	for ( i=0; i<tokens.n; ++i ) {
-		tok = slist_str( &tokens, i );
-		if ( bibtex_protected( tok ) ) {
-			if (!strncasecmp(tok->data,"\\href{", 6)) {
-				bibtex_addtitleurl( info, tok );
+
+	clean = ( p->latexin && !is_name_tag( tag ) && !is_url_tag( tag ) );
+
+	strs_init( &tok, &out, NULL );
+
+	/* clean each token in turn, rejoining with single spaces */
+	q = s->data;
+	while ( ( start = bibtex_nexttoken( q, s->data + s->len, s->data, &q ) ) ) {
+		end = q;
+		while ( end > start && is_ws( *(end-1) ) ) end--;
+		str_segcpy( &tok, start, end );
+		if ( bibtex_protected( &tok ) ) {
+			if (!strncasecmp(tok.data,"\\href{", 6)) {
+				bibtex_addtitleurl( info, &tok );
 			}
 		}
-		if ( p->latexin && !is_name_tag( tag ) && !is_url_tag( tag ) )
-			bibtex_cleantoken( tok );
-	}
-	str_empty( s );
-	for ( i=0; i<tokens.n; ++i ) {
-		tok = slist_str( &tokens, i );
-		if ( i>0 ) str_addchar( s, ' ' );
-		str_strcat( s, tok );
+		if ( clean ) bibtex_cleantoken( &tok );
+		if ( ntok++ ) str_addchar( &out, ' ' );
+		str_strcat( &out, &tok );
 	}
-out:
-	slist_free( &tokens );
+
+	if ( str_memerr( &tok ) || str_memerr( &out ) ) status = BIBL_ERR_MEMERR;
+	else str_swapstrings( s, &out );
+
+	strs_free( &tok, &out, NULL );
 	return status;
 }
 
@@ -1165,8 +1324,8 @@ out:
 static int
 bibtexin_person( fields *bibin, int m, str *intag, str *invalue, int level, param *pm, char *outtag, fields *bibout )
 {
-	int begin, end, ok, n, etal, i, status, match;
-	slist tokens;
+	int begin, end, ok, n, etal, status, match;
+	pslist tokens;
 
 	/* If we match the asis or corps list add and bail. */
 	status = bibtex_matches_list( bibout, outtag, ":ASIS", invalue, level, &(pm->asis), &match );
@@ -1174,11 +1333,10 @@ bibtexin_person( fields *bibin, int m, str *intag, str *invalue, int level, para
 	status = bibtex_matches_list( bibout, outtag, ":CORP", invalue, level, &(pm->corps), &match );
 	if ( match==1 || status!=BIBL_OK ) return status;
 
-	slist_init( &tokens );
+	pslist_init( &tokens );
 
-	bibtex_split( &tokens, invalue );
-	for ( i=0; i<tokens.n; ++i )
-		bibtex_cleantoken( slist_str( &tokens, i ) );
+	status = bibtex_split( &tokens, invalue );
+	if ( status!=BIBL_OK ) goto out;
 
 	etal = name_findetal( &tokens );
 
@@ -1188,11 +1346,11 @@ bibtexin_person( fields *bibin, int m, str *intag, str *invalue, int level, para
 
 		end = begin + 1;
 
-		while ( end < n && strcasecmp( slist_cstr( &tokens, end ), "and" ) )
+		while ( end < n && strcasecmp( pslist_cstr( &tokens, end ), "and" ) )
 			end++;
 
 		if ( end - begin == 1 ) {
-			ok = name_addsingleelement( bibout, outtag, slist_cstr( &tokens, begin ), level, 0 );
+			ok = name_addsingleelement( bibout, outtag, pslist_cstr( &tokens, begin ), level, 0 );
 			if ( !ok ) { status = BIBL_ERR_MEMERR; goto out; }
 		} else {
 			ok = name_addmultielement( bibout, outtag, &tokens, begin, end, level );
@@ -1202,7 +1360,7 @@ bibtexin_person( fields *bibin, int m, str *intag, str *invalue, int level, para
 		begin = end + 1;
 
 		/* Handle repeated 'and' errors: authors="G. F. Author and and B. K. Author" */
-		while ( begin < n && !strcasecmp( slist_cstr( &tokens, begin ), "and" ) )
+		while ( begin < n && !strcasecmp( pslist_cstr( &tokens, begin ), "and" ) )
 			begin++;
 	}
 
@@ -1212,7 +1370,7 @@ bibtexin_person( fields *bibin, int m, str *intag, str *invalue, int level, para
 	}
 
 out:
-	slist_free( &tokens );
+	pslist_free( &tokens );
 	return status;
 
 }
@@ -15,13 +15,15 @@
 #include "utf8.h"
 #include "xml.h"
 #include "fields.h"
+#include "outfields.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static int  bibtexout_write( fields *in, FILE *fp, param *p, unsigned long refnum );
-static void bibtexout_writeheader( FILE *outptr, param *p );
+static int  bibtexout_write( fields *in, outsink *fp, param *p, unsigned long refnum );
+static void bibtexout_writeheader( outsink *outptr, param *p );
 
 void
 bibtexout_initparams( param *p, const char *progname )
@@ -38,6 +40,12 @@ bibtexout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	p->headerf = bibtexout_writeheader;
 	p->footerf = NULL;
@@ -169,75 +177,69 @@ bibtexout_type( fields *in, char *filename, int refnum, param *p )
 	return type;
 }
 
+/* write a field value, converting unescaped double quotes to ``/'' */
+/* pairs; the runs between quotes are copied out in bulk             */
 static void
-output( FILE *fp, fields *out, int format_opts )
+output_value( outsink *fp, const char *value, int format_opts )
 {
-	int i, j, len, nquotes;
-	char *tag, *value, ch;
+	int nquotes = 0;
+	const char *p, *q;
+
+	p = value;
+	while ( ( q = strchr( p, '\"' ) ) ) {
+		outsink_write( fp, p, q - p );
+		if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS || ( q>value && q[-1]=='\\' ) )
+			outsink_putc( fp, '\"' );
+		else {
+			if ( nquotes % 2 == 0 )
+				outsink_puts( fp, "``" );
+			else    outsink_puts( fp, "\'\'" );
+			nquotes++;
+		}
+		p = q + 1;
+	}
+	outsink_puts( fp, p );
+}
+
+static void
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
+{
+	int format_opts = ( ( param * ) data )->format_opts;
 
 	/* ...output type information "@article{" */
-	value = ( char * ) fields_value( out, 0, FIELDS_CHRP );
-	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE) ) fprintf( fp, "@%s{", value );
-	else {
-		len = strlen( value );
-		fprintf( fp, "@" );
-		for ( i=0; i<len; ++i )
-			fprintf( fp, "%c", toupper((unsigned char)value[i]) );
-		fprintf( fp, "{" );
+	if ( n==0 ) {
+		outsink_putc( fp, '@' );
+		if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE) ) outsink_puts( fp, value );
+		else outsink_toupper( fp, value );
+		outsink_putc( fp, '{' );
+		return;
 	}
 
 	/* ...output refnum "Smith2001" */
-	value = ( char * ) fields_value( out, 1, FIELDS_CHRP );
-	fprintf( fp, "%s", value );
+	if ( n==1 ) {
+		outsink_puts( fp, value );
+		return;
+	}
 
 	/* ...rest of the references */
-	for ( j=2; j<out->n; ++j ) {
-		nquotes = 0;
-		tag   = ( char * ) fields_tag( out, j, FIELDS_CHRP );
-		value = ( char * ) fields_value( out, j, FIELDS_CHRP );
-		fprintf( fp, ",\n" );
-		if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) fprintf( fp, "  " );
-		if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) fprintf( fp, "%s", tag );
-		else {
-			len = strlen( tag );
-			for ( i=0; i<len; ++i )
-				fprintf( fp, "%c", toupper((unsigned char)tag[i]) );
-		}
-		if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) fprintf( fp, " = \t" );
-		else fprintf( fp, "=" );
-
-		if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) fprintf( fp, "{" );
-		else fprintf( fp, "\"" );
-
-		len = strlen( value );
-		for ( i=0; i<len; ++i ) {
-			ch = value[i];
-			if ( ch!='\"' ) fprintf( fp, "%c", ch );
-			else {
-				if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS || ( i>0 && value[i-1]=='\\' ) )
-					fprintf( fp, "\"" );
-				else {
-					if ( nquotes % 2 == 0 )
-						fprintf( fp, "``" );
-					else    fprintf( fp, "\'\'" );
-					nquotes++;
-				}
-			}
-		}
+	outsink_puts( fp, ",\n" );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) outsink_puts( fp, "  " );
+	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) outsink_puts( fp, tag );
+	else outsink_toupper( fp, tag );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) outsink_puts( fp, " = \t" );
+	else outsink_putc( fp, '=' );
 
-		if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) fprintf( fp, "}" );
-		else fprintf( fp, "\"" );
-	}
+	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) outsink_putc( fp, '{' );
+	else outsink_putc( fp, '\"' );
 
-	/* ...finish reference */
-	if ( format_opts & BIBL_FORMAT_BIBOUT_FINALCOMMA ) fprintf( fp, "," );
-	fprintf( fp, "\n}\n\n" );
+	output_value( fp, value, format_opts );
 
-	fflush( fp );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) outsink_putc( fp, '}' );
+	else outsink_putc( fp, '\"' );
 }
 
 static void
-append_type( int type, fields *out, int *status )
+append_type( int type, outfields *out, int *status )
 {
 	char *typenames[ NUM_TYPES ] = {
 		[ TYPE_ARTICLE       ] = "Article",
@@ -262,12 +264,12 @@ append_type( int type, fields *out, int *status )
 	if ( type < 0 || type >= NUM_TYPES ) type = TYPE_MISC;
 	s = typenames[ type ];
 
-	fstatus = fields_add( out, "TYPE", s, LEVEL_MAIN );
+	fstatus = outfields_add( out, "TYPE", s, LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_citekey( fields *in, fields *out, int format_opts, int *status )
+append_citekey( fields *in, outfields *out, int format_opts, int *status )
 {
 	int n, fstatus;
 	str s;
@@ -275,7 +277,7 @@ append_citekey( fields *in, fields *out, int format_opts, int *status )
 
 	n = fields_find( in, "REFNUM", LEVEL_ANY );
 	if ( ( format_opts & BIBL_FORMAT_BIBOUT_DROPKEY ) || n==FIELDS_NOTFOUND ) {
-		fstatus = fields_add( out, "REFNUM", "", LEVEL_MAIN );
+		fstatus = outfields_add( out, "REFNUM", "", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -297,34 +299,34 @@ append_citekey( fields *in, fields *out, int format_opts, int *status )
 			p++;
 		}
 		if ( str_memerr( &s ) )  { *status = BIBL_ERR_MEMERR; str_free( &s ); return; }
-		fstatus = fields_add( out, "REFNUM", str_cstr( &s ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "REFNUM", str_cstr( &s ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		str_free( &s );
 	}
 }
 
 static void
-append_simple( fields *in, char *intag, char *outtag, fields *out, int *status )
+append_simple( fields *in, char *intag, char *outtag, outfields *out, int *status )
 {
 	int n, fstatus;
 
 	n = fields_find( in, intag, LEVEL_ANY );
 	if ( n!=FIELDS_NOTFOUND ) {
 		fields_setused( in, n );
-		fstatus = fields_add( out, outtag, fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
+		fstatus = outfields_add( out, outtag, fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_simpleall( fields *in, char *intag, char *outtag, fields *out, int *status )
+append_simpleall( fields *in, char *intag, char *outtag, outfields *out, int *status )
 {
 	int i, fstatus;
 
 	for ( i=0; i<in->n; ++i ) {
 		if ( fields_match_tag( in, i, intag ) ) {
 			fields_setused( in, i );
-			fstatus = fields_add( out, outtag, fields_value( in, i, FIELDS_CHRP ), LEVEL_MAIN );
+			fstatus = outfields_add( out, outtag, fields_value( in, i, FIELDS_CHRP ), LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) {
 				*status = BIBL_ERR_MEMERR;
 				return;
@@ -334,7 +336,7 @@ append_simpleall( fields *in, char *intag, char *outtag, fields *out, int *statu
 }
 
 static void
-append_keywords( fields *in, fields *out, int *status )
+append_keywords( fields *in, outfields *out, int *status )
 {
 	str keywords, *word;
 	vplist_index i;
@@ -356,7 +358,7 @@ append_keywords( fields *in, fields *out, int *status )
 
 		if ( str_memerr( &keywords ) ) { *status = BIBL_ERR_MEMERR; goto out; }
 
-		fstatus = fields_add( out, "keywords", str_cstr( &keywords ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "keywords", str_cstr( &keywords ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			goto out;
@@ -371,7 +373,7 @@ out:
 }
 
 static void
-append_fileattach( fields *in, fields *out, int *status )
+append_fileattach( fields *in, outfields *out, int *status )
 {
 	char *tag, *value;
 	int i, fstatus;
@@ -399,7 +401,7 @@ append_fileattach( fields *in, fields *out, int *status )
 		}
 
 		fields_setused( in, i );
-		fstatus = fields_add( out, "file", str_cstr( &data ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "file", str_cstr( &data ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			goto out;
@@ -413,7 +415,7 @@ out:
 
 static void
 append_people( fields *in, char *tag, char *ctag, char *atag,
-		char *bibtag, int level, fields *out, int format_opts )
+		char *bibtag, int level, outfields *out, int format_opts )
 {
 	str allpeople, oneperson;
 	int i, npeople, person, corp, asis;
@@ -449,14 +451,14 @@ append_people( fields *in, char *tag, char *ctag, char *atag,
 		}
 	}
 	if ( npeople ) {
-		fields_add( out, bibtag, allpeople.data, LEVEL_MAIN );
+		outfields_add( out, bibtag, allpeople.data, LEVEL_MAIN );
 	}
 
 	strs_free( &allpeople, &oneperson, NULL );
 }
 
 static int
-append_title_chosen( fields *in, char *bibtag, fields *out, int nmainttl, int nsubttl )
+append_title_chosen( fields *in, char *bibtag, outfields *out, int nmainttl, int nsubttl )
 {
 	str fulltitle, *mainttl = NULL, *subttl = NULL;
 	int status, ret = BIBL_OK;
@@ -481,7 +483,7 @@ append_title_chosen( fields *in, char *bibtag, fields *out, int nmainttl, int ns
 	}
 
 	if ( str_has_value( &fulltitle ) ) {
-		status = fields_add( out, bibtag, str_cstr( &fulltitle ), LEVEL_MAIN );
+		status = outfields_add( out, bibtag, str_cstr( &fulltitle ), LEVEL_MAIN );
 		if ( status!=FIELDS_OK ) ret = BIBL_ERR_MEMERR;
 	}
 
@@ -491,7 +493,7 @@ out:
 }
 
 static int
-append_title( fields *in, char *bibtag, int level, fields *out, int format_opts )
+append_title( fields *in, char *bibtag, int level, outfields *out, int format_opts )
 {
 	int title, short_title, subtitle, short_subtitle, use_title, use_subtitle;
 
@@ -514,7 +516,7 @@ append_title( fields *in, char *bibtag, int level, fields *out, int format_opts
 }
 
 static void
-append_titles( fields *in, int type, fields *out, int format_opts, int *status )
+append_titles( fields *in, int type, outfields *out, int format_opts, int *status )
 {
 	/* item=main level title */
 	*status = append_title( in, "title", 0, out, format_opts );
@@ -578,7 +580,7 @@ find_date( fields *in, char *date_element )
 }
 
 static void
-append_date( fields *in, fields *out, int *status )
+append_date( fields *in, outfields *out, int *status )
 {
 	char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", 
 		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
@@ -587,7 +589,7 @@ append_date( fields *in, fields *out, int *status )
 	n = find_date( in, "YEAR" );
 	if ( n!=FIELDS_NOTFOUND ) {
 		fields_setused( in, n );
-		fstatus = fields_add( out, "year", in->data[n].data, LEVEL_MAIN );
+		fstatus = outfields_add( out, "year", in->data[n].data, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -599,9 +601,9 @@ append_date( fields *in, fields *out, int *status )
 		fields_setused( in, n );
 		month = atoi( in->data[n].data );
 		if ( month>0 && month<13 )
-			fstatus = fields_add( out, "month", months[month-1], LEVEL_MAIN );
+			fstatus = outfields_add( out, "month", months[month-1], LEVEL_MAIN );
 		else
-			fstatus = fields_add( out, "month", in->data[n].data, LEVEL_MAIN );
+			fstatus = outfields_add( out, "month", in->data[n].data, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -611,7 +613,7 @@ append_date( fields *in, fields *out, int *status )
 	n = find_date( in, "DAY" );
 	if ( n!=-1 ) {
 		fields_setused( in, n );
-		fstatus = fields_add( out, "day", in->data[n].data, LEVEL_MAIN );
+		fstatus = outfields_add( out, "day", in->data[n].data, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -621,7 +623,7 @@ append_date( fields *in, fields *out, int *status )
 }
 
 static void
-append_arxiv( fields *in, fields *out, int *status )
+append_arxiv( fields *in, outfields *out, int *status )
 {
 	int n, fstatus1, fstatus2;
 	str url;
@@ -636,8 +638,8 @@ append_arxiv( fields *in, fields *out, int *status )
 	 *     eprint = "#####",
 	 * ...for arXiv references
 	 */
-	fstatus1 = fields_add( out, "archivePrefix", "arXiv", LEVEL_MAIN );
-	fstatus2 = fields_add( out, "eprint", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
+	fstatus1 = outfields_add( out, "archivePrefix", "arXiv", LEVEL_MAIN );
+	fstatus2 = outfields_add( out, "eprint", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
 	if ( fstatus1!=FIELDS_OK || fstatus2!=FIELDS_OK ) {
 		*status = BIBL_ERR_MEMERR;
 		return;
@@ -650,14 +652,14 @@ append_arxiv( fields *in, fields *out, int *status )
 	str_init( &url );
 	arxiv_to_url( in, n, "URL", &url );
 	if ( str_has_value( &url ) ) {
-		fstatus1 = fields_add( out, "url", str_cstr( &url ), LEVEL_MAIN );
+		fstatus1 = outfields_add( out, "url", str_cstr( &url ), LEVEL_MAIN );
 		if ( fstatus1!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	str_free( &url );
 }
 
 static void
-append_urls( fields *in, fields *out, int *status )
+append_urls( fields *in, outfields *out, int *status )
 {
 	int lstatus;
 	slist types;
@@ -674,19 +676,19 @@ append_urls( fields *in, fields *out, int *status )
 }
 
 static void
-append_isi( fields *in, fields *out, int *status )
+append_isi( fields *in, outfields *out, int *status )
 {
 	int n, fstatus;
 
 	n = fields_find( in, "ISIREFNUM", LEVEL_ANY );
 	if ( n==FIELDS_NOTFOUND ) return;
 
-	fstatus = fields_add( out, "note", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
+	fstatus = outfields_add( out, "note", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_articlenumber( fields *in, fields *out, int *status )
+append_articlenumber( fields *in, outfields *out, int *status )
 {
 	int n, fstatus;
 
@@ -694,7 +696,7 @@ append_articlenumber( fields *in, fields *out, int *status )
 	if ( n==FIELDS_NOTFOUND ) return;
 
 	fields_setused( in, n );
-	fstatus = fields_add( out, "pages", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
+	fstatus = outfields_add( out, "pages", fields_value( in, n, FIELDS_CHRP ), LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
@@ -735,7 +737,7 @@ pages_are_defined( fields *in, int *sn, int *en )
 }
 
 static void
-append_pages( fields *in, fields *out, int format_opts, int *status )
+append_pages( fields *in, outfields *out, int format_opts, int *status )
 {
 	int sn, en, fstatus;
 	str pages;
@@ -748,7 +750,7 @@ append_pages( fields *in, fields *out, int format_opts, int *status )
 	str_init( &pages );
 	*status = pages_build_pagestr( &pages, in, sn, en, format_opts );
 	if ( *status==BIBL_OK ) {
-		fstatus = fields_add( out, "pages", str_cstr( &pages ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "pages", str_cstr( &pages ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	str_free( &pages );
@@ -767,7 +769,7 @@ append_pages( fields *in, fields *out, int format_opts, int *status )
  */
 
 static void
-append_issue_number( fields *in, fields *out, int *status )
+append_issue_number( fields *in, outfields *out, int *status )
 {
 	char issue[] = "issue", number[] = "number", *use_issue = number;
 	int nissue  = fields_find( in, "ISSUE",  LEVEL_ANY );
@@ -778,7 +780,7 @@ append_issue_number( fields *in, fields *out, int *status )
 
 	if ( nissue!=FIELDS_NOTFOUND ) {
 		fields_setused( in, nissue );
-		fstatus = fields_add( out, use_issue, fields_value( in, nissue, FIELDS_CHRP ), LEVEL_MAIN );
+		fstatus = outfields_add( out, use_issue, fields_value( in, nissue, FIELDS_CHRP ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -787,7 +789,7 @@ append_issue_number( fields *in, fields *out, int *status )
 
 	if ( nnumber!=FIELDS_NOTFOUND ) {
 		fields_setused( in, nnumber );
-		fstatus = fields_add( out, "number", fields_value( in, nnumber, FIELDS_CHRP ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "number", fields_value( in, nnumber, FIELDS_CHRP ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -796,7 +798,7 @@ append_issue_number( fields *in, fields *out, int *status )
 }
 
 static void
-append_howpublished( fields *in, fields *out, int *status )
+append_howpublished( fields *in, outfields *out, int *status )
 {
 	int n, fstatus;
 	char *d;
@@ -806,21 +808,21 @@ append_howpublished( fields *in, fields *out, int *status )
 
 	d = fields_value( in, n, FIELDS_CHRP_NOUSE );
 	if ( !strcmp( d, "Habilitation thesis" ) ) {
-		fstatus = fields_add( out, "howpublised", d, LEVEL_MAIN );
+		fstatus = outfields_add( out, "howpublised", d, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	if ( !strcmp( d, "Licentiate thesis" ) ) {
-		fstatus = fields_add( out, "howpublised", d, LEVEL_MAIN );
+		fstatus = outfields_add( out, "howpublised", d, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	if ( !strcmp( d, "Diploma thesis" ) ) {
-		fstatus = fields_add( out, "howpublised", d, LEVEL_MAIN );
+		fstatus = outfields_add( out, "howpublised", d, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static int
-append_data( fields *in, fields *out, param *p, unsigned long refnum )
+append_data( fields *in, outfields *out, param *p, unsigned long refnum )
 {
 	int type, status = BIBL_OK;
 
@@ -865,24 +867,29 @@ append_data( fields *in, fields *out, param *p, unsigned long refnum )
 }
 
 static int
-bibtexout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+bibtexout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, p );
 
 	status = append_data( in, &out, p, refnum );
-	if ( status==BIBL_OK ) output( fp, &out, p->format_opts );
 
-	fields_free( &out );
+	/* ...finish reference */
+	if ( status==BIBL_OK ) {
+		if ( p->format_opts & BIBL_FORMAT_BIBOUT_FINALCOMMA ) outsink_putc( fp, ',' );
+		outsink_puts( fp, "\n}\n\n" );
+	}
+
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-bibtexout_writeheader( FILE *outptr, param *p )
+bibtexout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
 
@@ -22,6 +22,7 @@ bibl_initparams( param *p, int readmode, int writemode, char *progname )
 	case BIBL_EBIIN:        ebiin_initparams( p, progname ); break;
 	case BIBL_ENDNOTEIN:    endin_initparams( p, progname ); break;
 	case BIBL_ENDNOTEXMLIN: endxmlin_initparams( p, progname ); break;
+	case BIBL_ISIIN:        isiin_initparams( p, progname ); break;
 	case BIBL_MEDLINEIN:    medin_initparams( p, progname ); break;
 	case BIBL_MODSIN:       modsin_initparams( p, progname ); break;
 	case BIBL_NBIBIN:       nbibin_initparams( p, progname ); break;
@@ -43,3 +44,28 @@ bibl_initparams( param *p, int readmode, int writemode, char *progname )
 	}
 }
 
+/* bibl_normalize()
+ *
+ * When converting directly between two formats other than MODS, make
+ * the references what a trip through MODS would have left, so that
+ * the output matches going through MODS XML in a pipe.
+ */
+int
+bibl_normalize( bibl *b, param *p )
+{
+	int status;
+	long i;
+
+	if ( !b ) return BIBL_ERR_BADINPUT;
+	if ( !p ) return BIBL_ERR_BADINPUT;
+
+	if ( p->readformat==BIBL_MODSIN || p->writeformat==BIBL_MODSOUT )
+		return BIBL_OK;
+
+	for ( i=0; i<b->nrefs; ++i ) {
+		status = modsout_normalize( b->ref[i], p );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	return BIBL_OK;
+}
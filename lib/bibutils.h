@@ -16,13 +16,19 @@ extern "C" {
 #include <stdio.h>
 #include "bibl.h"
 #include "slist.h"
+#include "name.h"
 #include "charsets.h"
 #include "str_conv.h"
 
-#define BIBL_OK           (0)
-#define BIBL_ERR_BADINPUT (-1)
-#define BIBL_ERR_MEMERR   (-2)
-#define BIBL_ERR_CANTOPEN (-3)
+#define BIBL_OK             (0)
+#define BIBL_ERR_BADINPUT   (-1)
+#define BIBL_ERR_MEMERR     (-2)
+#define BIBL_ERR_CANTOPEN   (-3)
+#define BIBL_ERR_NOCOMPRESS (-4)  /* compression format not compiled in */
+#define BIBL_ERR_ZSTREAM    (-5)  /* corrupt compressed stream */
+#define BIBL_ERR_WRITE      (-6)  /* output could not be written */
+#define BIBL_ERR_SNAPSHOT   (-7)  /* not a snapshot, or a damaged one */
+#define BIBL_ERR_INDEX      (-8)  /* record index missing, damaged, or out of date */
 
 #define BIBL_FIRSTIN      (100)
 #define BIBL_MODSIN       (BIBL_FIRSTIN)
@@ -79,8 +85,21 @@ extern "C" {
 #define BIBL_XMLOUT_TRUE     STR_CONV_XMLOUT_TRUE
 #define BIBL_XMLOUT_ENTITIES STR_CONV_XMLOUT_ENTITIES
 
+/* same values as ZSTREAM_NONE, _GZIP, _ZSTD, _XZ in zstream.h */
+#define BIBL_COMPRESS_NONE (0)
+#define BIBL_COMPRESS_GZIP (1)
+#define BIBL_COMPRESS_ZSTD (2)
+#define BIBL_COMPRESS_XZ   (3)
+
+#define BIBL_SHARD_NONE  (0)
+#define BIBL_SHARD_REFS  (1)  /* shardsize references per file */
+#define BIBL_SHARD_BYTES (2)  /* about shardsize bytes per file */
+#define BIBL_SHARD_HASH  (3)  /* shardsize files, chosen by citekey hash */
+
 typedef unsigned char uchar;
 
+struct outsink; /* outsink.h */
+
 typedef struct param {
 
 	int readformat;
@@ -105,9 +124,18 @@ typedef struct param {
 	uchar output_raw;
 	uchar verbose;
 	uchar singlerefperfile;
+	uchar compressout; /* BIBL_COMPRESS_NONE, _GZIP, _ZSTD, _XZ */
+	uchar asyncout;    /* If true, write output on its own I/O thread */
+	int nthreads;  /* parse large inputs in this many chunks, 1 = serial */
+	long namecache; /* remember this many parsed personal names, 0 = none */
+	char *outdir;  /* directory for singlerefperfile/shard output, NULL = cwd */
+	uchar shardmode;   /* BIBL_SHARD_NONE, _REFS, _BYTES, _HASH */
+	long  shardsize;
+	char *shardprefix; /* shard files are shardprefix.0001.xml..., NULL = "out" */
 
 	slist asis;  /* Names that shouldn't be mangled */
 	slist corps; /* Names that shouldn't be mangled-MODS corporation type */
+	struct namecache names; /* Parsed personal names, up to namecache of them */
 
 	char *progname;
 
@@ -117,9 +145,9 @@ typedef struct param {
         int  (*cleanf)(bibl*,struct param*);
         int  (*typef) (fields*,char*,int,struct param*);
         int  (*convertf)(fields*,fields*,int,struct param*);
-        void (*headerf)(FILE*,struct param*);
-        void (*footerf)(FILE*);
-        int  (*writef)(fields*,FILE*,struct param*,unsigned long);
+        void (*headerf)(struct outsink*,struct param*);
+        void (*footerf)(struct outsink*);
+        int  (*writef)(fields*,struct outsink*,struct param*,unsigned long);
         variants *all;
         int  nall;
 
@@ -134,7 +162,13 @@ extern int  bibl_addtoasis( param *p, char *entry );
 extern int  bibl_readcorps( param *p, char *filename );
 extern int  bibl_addtocorps( param *p, char *entry );
 extern int  bibl_read( bibl *b, FILE *fp, char *filename, param *p );
+extern int  bibl_normalize( bibl *b, param *p );
 extern int  bibl_write( bibl *b, FILE *fp, param *p );
+extern int  bibl_readsnapshot( bibl *b, FILE *fp, param *p );
+extern int  bibl_writeindex( FILE *fp, char *filename, FILE *idxfp, param *p );
+extern int  bibl_readindexed( bibl *b, FILE *fp, char *filename, FILE *idxfp,
+	slist *keys, param *p );
+extern int  bibl_writesnapshot( bibl *b, FILE *fp, param *p );
 extern void bibl_reporterr( int err );
 
 #ifdef __cplusplus
@@ -6,6 +6,8 @@
  * Source code released under the GPL version 2
  */
 #include <string.h>
+#include <pthread.h>
+#include "phash.h"
 #include "bu_auth.h"
 
 const char *bu_genre[] = {
@@ -48,9 +50,23 @@ position_in_list( const char *list[], int nlist, const char *query )
 	return -1;
 }
 
+/* hashed on first use; scanned if that fails */
+static phash genre_hash;
+static int hashed = 0;
+static pthread_once_t hash_once = PTHREAD_ONCE_INIT;
+
+static void
+bu_hash( void )
+{
+	if ( phash_build( &genre_hash, bu_genre, sizeof( bu_genre[0] ), nbu_genre )==PHASH_OK )
+		hashed = 1;
+}
+
 int
 bu_findgenre( const char *query )
 {
+	pthread_once( &hash_once, bu_hash );
+	if ( hashed ) return phash_find( &genre_hash, query );
 	return position_in_list( bu_genre, nbu_genre, query );
 }
 
@@ -18,6 +18,7 @@
 #include "reftypes.h"
 #include "bibformats.h"
 #include "generic.h"
+#include "tagline.h"
 
 extern variants copac_all[];
 extern int copac_nall;
@@ -42,6 +43,8 @@ copacin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = copacin_readf;
@@ -54,6 +57,7 @@ copacin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -63,23 +67,6 @@ copacin_initparams( param *p, const char *progname )
  PUBLIC: int copacin_readf()
 *****************************************************/
 
-/* Endnote-Refer/Copac tag definition:
-    character 1 = alphabetic character
-    character 2 = alphabetic character
-    character 3 = dash
-    character 4 = space
-*/
-static int
-copacin_istag( char *buf )
-{
-	if (! ((buf[0]>='A' && buf[0]<='Z')) || (buf[0]>='a' && buf[0]<='z') )
-		return 0;
-	if (! ((buf[1]>='A' && buf[1]<='Z')) || (buf[1]>='a' && buf[1]<='z') )
-		return 0;
-	if (buf[2]!='-' ) return 0;
-	if (buf[3]!=' ' ) return 0;
-	return 1; 
-}
 static int
 readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
 {
@@ -97,16 +84,9 @@ copacin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *re
 		/* blank line separates */
 		if ( line->data==NULL ) continue;
 		if ( inref && line->len==0 ) haveref=1; 
-		p = &(line->data[0]);
 		/* Recognize UTF8 BOM */
-		if ( line->len > 2 &&
-				(unsigned char)(p[0])==0xEF &&
-				(unsigned char)(p[1])==0xBB &&
-				(unsigned char)(p[2])==0xBF ) {
-			*fcharset = CHARSET_UNICODE;
-			p += 3;
-		}
-		if ( copacin_istag( p ) ) {
+		p = tagline_skipbom( line->data, fcharset );
+		if ( tagline_istag( TAGLINE_COPAC, p ) ) {
 			if ( inref ) str_addchar( reference, '\n' );
 			str_strcatc( reference, p );
 			str_empty( line );
@@ -132,57 +112,34 @@ copacin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *re
  PUBLIC: int copacin_processf()
 *****************************************************/
 
-static char*
-copacin_addtag2( char *p, str *tag, str *data )
-{
-	int  i;
-	i =0;
-	while ( i<3 && *p ) {
-		str_addchar( tag, *p++ );
-		i++;
-	}
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' ) {
-		str_addchar( data, *p );
-		p++;
-	}
-	str_trimendingws( data );
-	while ( *p=='\n' || *p=='\r' ) p++;
-	return p;
-}
-
-static char *
-copacin_nextline( char *p )
-{
-	while ( *p && *p!='\n' && *p!='\r') p++;
-	while ( *p=='\n' || *p=='\r' ) p++;
-	return p;
-}
-
 static int
 copacin_processf( fields *copacin, char *p, char *filename, long nref, param *pm )
 {
+	int status, ret = 1;
 	str tag, data;
-	int status;
-	str_init( &tag );
-	str_init( &data );
+	tagline t;
+	strs_init( &tag, &data, NULL );
 	while ( *p ) {
 		p = skip_ws( p );
-		if ( copacin_istag( p ) ) {
-			p = copacin_addtag2( p, &tag, &data );
-			/* don't add empty strings */
-			if ( str_has_value( &tag ) && str_has_value( &data ) ) {
-				status = fields_add( copacin, tag.data, data.data, 0 );
-				if ( status!=FIELDS_OK ) return 0;
+		p = tagline_next( TAGLINE_COPAC, p, &t );
+		/* copac continuation lines were merged in copacin_readf() */
+		if ( !t.taglen ) continue;
+		if ( !tagline_strs( &t, &tag, &data ) ) {
+			ret = 0;
+			goto out;
+		}
+		/* don't add empty strings */
+		if ( str_has_value( &data ) ) {
+			status = fields_add( copacin, tag.data, data.data, 0 );
+			if ( status!=FIELDS_OK ) {
+				ret = 0;
+				goto out;
 			}
-			str_empty( &tag );
-			str_empty( &data );
 		}
-		else p = copacin_nextline( p );
 	}
-	str_free( &tag );
-	str_free( &data );
-	return 1;
+out:
+	strs_free( &tag, &data, NULL );
+	return ret;
 }
 
 /*****************************************************
@@ -204,7 +161,7 @@ copacin_person( fields *bibin, int n, str *intag, str *invalue, int level, param
 
 	if ( slist_find( &(pm->asis),  invalue ) !=-1  ||
 	     slist_find( &(pm->corps), invalue ) !=-1 ) {
-		ok = name_add( bibout, outtag, invalue->data, level, &(pm->asis), &(pm->corps) );
+		ok = name_add( bibout, outtag, invalue->data, level, &(pm->asis), &(pm->corps), &(pm->names) );
 		if ( ok ) return BIBL_OK;
 		else return BIBL_ERR_MEMERR;
 	}
@@ -239,7 +196,7 @@ copacin_person( fields *bibin, int n, str *intag, str *invalue, int level, param
 
 	slist_free( &tokens );
 
-	ok = name_add( bibout, usetag, str_cstr( &usename ), level, &(pm->asis), &(pm->corps) );
+	ok = name_add( bibout, usetag, str_cstr( &usename ), level, &(pm->asis), &(pm->corps), &(pm->names) );
 
 	str_free( &usename );
 
@@ -37,6 +37,8 @@ ebiin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                      BIBL_RAW_WITHCHARCONVERT;
 
@@ -50,6 +52,7 @@ ebiin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
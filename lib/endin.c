@@ -18,6 +18,7 @@
 #include "reftypes.h"
 #include "bibformats.h"
 #include "generic.h"
+#include "tagline.h"
 
 extern variants end_all[];
 extern int end_nall;
@@ -44,6 +45,8 @@ endin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = endin_readf;
@@ -56,6 +59,7 @@ endin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -66,23 +70,6 @@ endin_initparams( param *p, const char *progname )
  PUBLIC: int endin_readf()
 *****************************************************/
 
-/* Endnote tag definition:
-    character 1 = '%'
-    character 2 = alphabetic character or digit (or other characters)
-    character 3 = space (ansi 32)
-*/
-static int
-endin_istag( char *buf )
-{
-	const char others[]="!@#$^&*()+=?[~>";
-	if ( buf[0]!='%' ) return 0;
-	if ( buf[2]!=' ' ) return 0;
-	if ( isalpha( (unsigned char)buf[1] ) ) return 1;
-	if ( isdigit( (unsigned char)buf[1] ) ) return 1;
-	if ( strchr( others, buf[1] ) ) return 1;
-	return 0;
-}
-
 static int
 readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
 {
@@ -94,28 +81,20 @@ static int
 endin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
 {
 	int haveref = 0, inref = 0;
-	unsigned char *up;
 	char *p;
 	*fcharset = CHARSET_UNKNOWN;
 	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
 		if ( !line->data ) continue;
-		p = &(line->data[0]);
 
 		/* Skip <feff> Unicode header information */
-		/* <feff> = ef bb bf */
-		up = (unsigned char* ) p;
-		if ( line->len > 2 && up[0]==0xEF && up[1]==0xBB &&
-				up[2]==0xBF ) {
-			*fcharset = CHARSET_UNICODE;
-			p += 3;
-		}
+		p = tagline_skipbom( line->data, fcharset );
 
 		if ( !*p ) {
 			if ( inref ) haveref = 1; /* blank line separates */
 			else continue; /* blank line to ignore */
 		}
 		/* Each reference starts with a tag && ends with a blank line */
-		if ( endin_istag( p ) ) {
+		if ( tagline_istag( TAGLINE_ENDNOTE, p ) ) {
 			if ( reference->len ) str_addchar( reference, '\n' );
 			str_strcatc( reference, p );
 			inref = 1;
@@ -132,59 +111,36 @@ endin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
 /*****************************************************
  PUBLIC: int endin_processf()
 *****************************************************/
-static char*
-process_endline( str *tag, str *data, char *p )
-{
-	int  i;
-
-	i = 0;
-	while ( i<2 && *p ) {
-		str_addchar( tag, *p++);
-		i++;
-	}
-	while ( *p==' ' || *p=='\t' ) p++;
-
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	str_trimendingws( data );
-
-	while ( *p=='\r' || *p=='\n' ) p++;
-
-	return p;
-}
-
-static char *
-process_endline2( str *tag, str *data, char *p )
-{
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	str_trimendingws( data );
-	while ( *p=='\r' || *p=='\n' ) p++;
-	return p;
-}
-
 static int
 endin_processf( fields *endin, char *p, char *filename, long nref, param *pm )
 {
+	int status, n, ret = 1;
 	str tag, data;
-	int status, n;
+	tagline t;
 	strs_init( &tag, &data, NULL );
 	while ( *p ) {
-		strs_empty( &tag, &data, NULL );
-		if ( endin_istag( p ) ) {
-			p = process_endline( &tag, &data, p );
+		p = tagline_next( TAGLINE_ENDNOTE, p, &t );
+		if ( !tagline_strs( &t, &tag, &data ) ) {
+			ret = 0;
+			goto out;
+		}
+		if ( t.taglen ) {
 			if ( str_is_empty( &data ) ) continue;
 			status = fields_add( endin, str_cstr( &tag ), str_cstr( &data ), 0 );
-			if ( status!=FIELDS_OK ) return 0;
+			if ( status!=FIELDS_OK ) {
+				ret = 0;
+				goto out;
+			}
 		} else {
-			p = process_endline2( &tag, &data, p );
 			/* endnote puts %K only on 1st line of keywords */
 			n = fields_num( endin );
 			if ( n>0 && str_has_value( &data ) ) {
 			if ( !strncmp( endin->tag[n-1].data, "%K", 2 ) ) {
 				status = fields_add( endin, "%K", str_cstr( &data ), 0 );
-				if ( status!=FIELDS_OK ) return 0;
+				if ( status!=FIELDS_OK ) {
+					ret = 0;
+					goto out;
+				}
 			} else {
 				str_addchar( &(endin->data[n-1]), ' ' );
 				str_strcat( &(endin->data[n-1]), &data );
@@ -192,8 +148,9 @@ endin_processf( fields *endin, char *p, char *filename, long nref, param *pm )
 			}
 		}
 	}
+out:
 	strs_free( &tag, &data, NULL );
-	return 1;
+	return ret;
 }
 
 /*****************************************************
@@ -14,13 +14,15 @@
 #include "str.h"
 #include "strsearch.h"
 #include "fields.h"
+#include "outfields.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static int  endout_write( fields *in, FILE *fp, param *p, unsigned long refnum );
-static void endout_writeheader( FILE *outptr, param *p );
+static int  endout_write( fields *in, outsink *fp, param *p, unsigned long refnum );
+static void endout_writeheader( outsink *outptr, param *p );
 
 
 void
@@ -38,6 +40,12 @@ endout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	if ( p->charsetout == BIBL_CHARSET_UNICODE ) {
 		p->utf8out = p->utf8bom = 1;
@@ -372,7 +380,7 @@ get_type( fields *in, param *p, unsigned long refnum )
 }
 
 static void
-append_type( int type, fields *out, param *p, int *status )
+append_type( int type, outfields *out, param *p, int *status )
 {
 	/* These are restricted to Endnote-defined types */
 	match_type genrenames[] = {
@@ -421,13 +429,13 @@ append_type( int type, fields *out, param *p, int *status )
 	int i, fstatus, found = 0;
 	for ( i=0; i<ngenrenames && !found; ++i ) {
 		if ( genrenames[i].type == type ) {
-			fstatus = fields_add( out, "%0", genrenames[i].name, LEVEL_MAIN );
+			fstatus = outfields_add( out, "%0", genrenames[i].name, LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 			found = 1;
 		}
 	}
 	if ( !found ) {
-		fstatus = fields_add( out, "%0", "Generic", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%0", "Generic", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		if ( p->progname ) fprintf( stderr, "%s: ", p->progname );
 		fprintf( stderr, "Cannot identify type %d\n", type );
@@ -436,7 +444,7 @@ append_type( int type, fields *out, param *p, int *status )
 
 static int
 append_title( fields *in, char *full, char *sub, char *endtag,
-		int level, fields *out, int *status )
+		int level, outfields *out, int *status )
 {
 	str *mainttl = fields_findv( in, level, FIELDS_STRP, full );
 	str *subttl  = fields_findv( in, level, FIELDS_STRP, sub );
@@ -452,7 +460,7 @@ append_title( fields *in, char *full, char *sub, char *endtag,
 	}
 
 	if ( str_has_value( &fullttl ) ) {
-		fstatus = fields_add( out, endtag, str_cstr( &fullttl ), LEVEL_MAIN );
+		fstatus = outfields_add( out, endtag, str_cstr( &fullttl ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 out:
@@ -461,7 +469,7 @@ out:
 }
 
 static void
-append_people( fields *in, char *tag, char *entag, int level, fields *out, int *status )
+append_people( fields *in, char *tag, char *entag, int level, outfields *out, int *status )
 {
 	int i, n, flvl, fstatus;
 	str oneperson;
@@ -475,7 +483,7 @@ append_people( fields *in, char *tag, char *entag, int level, fields *out, int *
 		ftag = fields_tag( in, i, FIELDS_CHRP );
 		if ( !strcasecmp( ftag, tag ) ) {
 			name_build_withcomma( &oneperson, fields_value( in, i, FIELDS_CHRP ) );
-			fstatus = fields_add_can_dup( out, entag, str_cstr( &oneperson ), LEVEL_MAIN );
+			fstatus = outfields_add_can_dup( out, entag, str_cstr( &oneperson ), LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		}
 	}
@@ -483,7 +491,7 @@ append_people( fields *in, char *tag, char *entag, int level, fields *out, int *
 }
 
 static void
-append_pages( fields *in, fields *out, int *status )
+append_pages( fields *in, outfields *out, int *status )
 {
 	str *sn, *en;
 	int fstatus;
@@ -498,20 +506,20 @@ append_pages( fields *in, fields *out, int *status )
 		if ( sn && en ) str_strcatc( &pages, "-" );
 		if ( en ) str_strcat( &pages, en );
 		if ( str_memerr( &pages ) ) { *status = BIBL_ERR_MEMERR; str_free( &pages ); return; }
-		fstatus = fields_add( out, "%P", str_cstr( &pages ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "%P", str_cstr( &pages ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		str_free( &pages );
 	} else {
 		ar = fields_findv( in, LEVEL_ANY, FIELDS_CHRP, "ARTICLENUMBER" );
 		if ( ar ) {
-			fstatus = fields_add( out, "%P", ar, LEVEL_MAIN );
+			fstatus = outfields_add( out, "%P", ar, LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		}
 	}
 }
 
 static void
-append_urls( fields *in, fields *out, int *status )
+append_urls( fields *in, outfields *out, int *status )
 {
 	int lstatus;
 	slist types;
@@ -528,20 +536,20 @@ append_urls( fields *in, fields *out, int *status )
 }
 
 static void
-append_year( fields *in, fields *out, int *status )
+append_year( fields *in, outfields *out, int *status )
 {
 	int fstatus;
 	char *year;
 
 	year = fields_findv_firstof( in, LEVEL_ANY, FIELDS_CHRP, "DATE:YEAR", "PARTDATE:YEAR", NULL );
 	if ( year ) {
-		fstatus = fields_add( out, "%D", year, LEVEL_MAIN );
+		fstatus = outfields_add( out, "%D", year, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_monthday( fields *in, fields *out, int *status )
+append_monthday( fields *in, outfields *out, int *status )
 {
 	char *months[12] = { "January", "February", "March", "April",
 		"May", "June", "July", "August", "September", "October",
@@ -561,14 +569,14 @@ append_monthday( fields *in, fields *out, int *status )
 		}
 		if ( month && day ) str_strcatc( &monday, " " );
 		if ( day ) str_strcatc( &monday, day );
-		fstatus = fields_add( out, "%8", str_cstr( &monday ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "%8", str_cstr( &monday ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	str_free( &monday );
 }
 
 static void
-append_genrehint( int type, fields *out, vplist *a, int *status )
+append_genrehint( int type, outfields *out, vplist *a, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -587,7 +595,7 @@ append_genrehint( int type, fields *out, vplist *a, int *status )
 		if ( !strcmp( g, "communication" ) && type==TYPE_COMMUNICATION ) continue;
 		if ( !strcmp( g, "report" ) && type==TYPE_REPORT ) continue;
 		if ( !strcmp( g, "book chapter" ) && type==TYPE_INBOOK ) continue;
-		fstatus = fields_add( out, "%9", g, LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", g, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) {
 			*status = BIBL_ERR_MEMERR;
 			return;
@@ -596,7 +604,7 @@ append_genrehint( int type, fields *out, vplist *a, int *status )
 }
 
 static void
-append_all_genrehint( int type, fields *in, fields *out, int *status )
+append_all_genrehint( int type, fields *in, outfields *out, int *status )
 {
 	vplist a;
 
@@ -614,38 +622,38 @@ append_all_genrehint( int type, fields *in, fields *out, int *status )
 }
 
 static void
-append_thesishint( int type, fields *out, int *status )
+append_thesishint( int type, outfields *out, int *status )
 {
 	int fstatus;
 
 	if ( type==TYPE_MASTERSTHESIS ) {
-		fstatus = fields_add( out, "%9", "Masters thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Masters thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	else if ( type==TYPE_PHDTHESIS ) {
-		fstatus = fields_add( out, "%9", "Ph.D. thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Ph.D. thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	else if ( type==TYPE_DIPLOMATHESIS ) {
-		fstatus = fields_add( out, "%9", "Diploma thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Diploma thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	else if ( type==TYPE_DOCTORALTHESIS ) {
-		fstatus = fields_add( out, "%9", "Doctoral thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Doctoral thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	else if ( type==TYPE_HABILITATIONTHESIS ) {
-		fstatus = fields_add( out, "%9", "Habilitation thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Habilitation thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	else if ( type==TYPE_LICENTIATETHESIS ) {
-		fstatus = fields_add( out, "%9", "Licentiate thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "%9", "Licentiate thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_easyall( fields *in, char *tag, char *entag, int level, fields *out, int *status )
+append_easyall( fields *in, char *tag, char *entag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -653,27 +661,27 @@ append_easyall( fields *in, char *tag, char *entag, int level, fields *out, int
 	vplist_init( &a );
 	fields_findv_each( in, level, FIELDS_CHRP, &a, tag );
 	for ( i=0; i<a.n; ++i ) {
-		fstatus = fields_add( out, entag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
+		fstatus = outfields_add( out, entag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	vplist_free( &a );
 }
 
 static void
-append_easy( fields *in, char *tag, char *entag, int level, fields *out, int *status )
+append_easy( fields *in, char *tag, char *entag, int level, outfields *out, int *status )
 {
 	char *value;
 	int fstatus;
 
 	value = fields_findv( in, level, FIELDS_CHRP, tag );
 	if ( value ) {
-		fstatus = fields_add( out, entag, value, LEVEL_MAIN );
+		fstatus = outfields_add( out, entag, value, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static int
-append_data( fields *in, fields *out, param *p, unsigned long refnum )
+append_data( fields *in, outfields *out, param *p, unsigned long refnum )
 {
 	int added, type, status = BIBL_OK;
 
@@ -780,38 +788,31 @@ append_data( fields *in, fields *out, param *p, unsigned long refnum )
 }
 
 static void
-output( FILE *fp, fields *out )
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
 {
-	int i;
-
-	for ( i=0; i<out->n; ++i ) {
-		fprintf( fp, "%s %s\n",
-			(char*) fields_tag( out, i, FIELDS_CHRP ),
-			(char*) fields_value( out, i, FIELDS_CHRP )
-		);
-	}
-
-	fprintf( fp, "\n" );
-	fflush( fp );
+	outsink_puts( fp, tag );
+	outsink_putc( fp, ' ' );
+	outsink_puts( fp, value );
+	outsink_putc( fp, '\n' );
 }
 
 static int
-endout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+endout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, NULL );
 	status = append_data( in, &out, p, refnum );
-	if ( status==BIBL_OK ) output( fp, &out );
-	fields_free( &out );
+	if ( status==BIBL_OK ) outsink_puts( fp, "\n" );
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-endout_writeheader( FILE *outptr, param *p )
+endout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
 
@@ -55,9 +55,9 @@ fields_delete( fields *f )
 }
 
 static int
-fields_alloc( fields *f )
+fields_alloc( fields *f, int alloc )
 {
-	int i, alloc = 20;
+	int i;
 
 	f->tag   = (str *) malloc( sizeof(str) * alloc );
 	f->data  = (str *) malloc( sizeof(str) * alloc );
@@ -82,11 +82,11 @@ fields_alloc( fields *f )
 }
 
 static int
-fields_realloc( fields *f )
+fields_realloc( fields *f, int alloc )
 {
 	str *newtags, *newdata;
 	int *newused, *newlevel;
-	int i, alloc = f->max * 2;
+	int i;
 
 	newtags = (str*) realloc( f->tag, sizeof(str) * alloc );
 	newdata = (str*) realloc( f->data, sizeof(str) * alloc );
@@ -111,6 +111,20 @@ fields_realloc( fields *f )
 	return FIELDS_OK;
 }
 
+/* fields_reserve()
+ *
+ * Make room for at least n entries up front, for callers that know
+ * how many they will add.
+ */
+int
+fields_reserve( fields *f, int n )
+{
+	if ( n < 1 ) n = 1;
+	if ( f->max==0 ) return fields_alloc( f, n );
+	if ( n > f->max ) return fields_realloc( f, n );
+	return FIELDS_OK;
+}
+
 int
 _fields_add( fields *f, char *tag, char *data, int level, int mode )
 {
@@ -120,10 +134,10 @@ _fields_add( fields *f, char *tag, char *data, int level, int mode )
 	if ( !tag || !data ) return FIELDS_OK;
 
 	if ( f->max==0 ) {
-		status = fields_alloc( f );
+		status = fields_alloc( f, 20 );
 		if ( status!=FIELDS_OK ) return status;
 	} else if ( f->n >= f->max ) {
-		status = fields_realloc( f );
+		status = fields_realloc( f, f->max * 2 );
 		if ( status!=FIELDS_OK ) return status;
 	}
 
@@ -37,6 +37,7 @@ void    fields_init( fields *f );
 fields *fields_new( void );
 void    fields_delete( fields *f );
 void    fields_free( fields *f );
+int     fields_reserve( fields *f, int n );
 
 #define FIELDS_CAN_DUP (0)
 #define FIELDS_NO_DUPS (1)
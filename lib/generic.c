@@ -46,7 +46,7 @@ generic_pages( fields *bibin, int n, str *intag, str *invalue, int level, param
 int
 generic_person( fields *bibin, int n, str *intag, str *invalue, int level, param *pm, char *outtag, fields *bibout )
 {
-        if ( name_add( bibout, outtag, str_cstr( invalue ), level, &(pm->asis), &(pm->corps) ) ) return BIBL_OK;
+        if ( name_add( bibout, outtag, str_cstr( invalue ), level, &(pm->asis), &(pm->corps), &(pm->names) ) ) return BIBL_OK;
         else return BIBL_ERR_MEMERR;
 }
 
@@ -17,6 +17,7 @@
 #include "reftypes.h"
 #include "bibformats.h"
 #include "generic.h"
+#include "tagline.h"
 
 extern variants isi_all[];
 extern int isi_nall;
@@ -42,6 +43,8 @@ isiin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = isiin_readf;
@@ -54,6 +57,7 @@ isiin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -63,19 +67,6 @@ isiin_initparams( param *p, const char *progname )
  PUBLIC: int isiin_readf()
 *****************************************************/
 
-/* ISI definition of a tag is strict:
- *   char 1 = uppercase alphabetic character
- *   char 2 = uppercase alphabetic character or digit
- */
-static int
-is_isi_tag( char *buf )
-{
-	if ( ! (buf[0]>='A' && buf[0]<='Z') ) return 0;
-	if ( ! (((buf[1]>='A' && buf[1]<='Z'))||(buf[1]>='0'&&buf[1]<='9')))
-		return 0;
-	return 1;
-}
-
 static int
 readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
 {
@@ -91,17 +82,10 @@ isiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
 	*fcharset = CHARSET_UNKNOWN;
 	while ( !haveref && readmore( fp, buf, bufsize, bufpos, line ) ) {
 		if ( !line->data ) continue;
-		p = &(line->data[0]);
 		/* Recognize UTF8 BOM */
-		if ( line->len > 2 &&
-				(unsigned char)(p[0])==0xEF &&
-				(unsigned char)(p[1])==0xBB &&
-				(unsigned char)(p[2])==0xBF ) {
-			*fcharset = CHARSET_UNICODE;
-			p += 3;
-		}
+		p = tagline_skipbom( line->data, fcharset );
 		/* Each reference ends with 'ER ' */
-		if ( is_isi_tag( p ) ) {
+		if ( tagline_istag( TAGLINE_ISI, p ) ) {
 			if ( !strncmp( p, "FN ", 3 ) ) {
 				if (strncasecmp( p, "FN ISI Export Format",20)){
 					fprintf( stderr, ": warning file FN type not '%s' not recognized.\n", /*r->progname,*/ p );
@@ -135,36 +119,6 @@ isiin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
  PUBLIC: int isiin_processf()
 *****************************************************/
 
-static char *
-process_tagged_line( str *tag, str *data, char *p )
-{
-	int i;
-
-	/* collect tag and skip past it */
-	i = 0;
-	while ( i<2 && *p && *p!='\r' && *p!='\n') {
-		str_addchar( tag, *p++ );
-		i++;
-	}
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	str_trimendingws( data );
-	while ( *p=='\r' || *p=='\n' ) p++;
-	return p;
-}
-
-static char *
-process_untagged_line( str *data, char *p )
-{
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	str_trimendingws( data );
-	while ( *p=='\r' || *p=='\n' ) p++;
-	return p;
-}
-
 static int
 add_tag_value( fields *isiin, str *tag, str *value, int *tag_added )
 {
@@ -226,32 +180,29 @@ isiin_processf( fields *isiin, char *p, char *filename, long nref, param *pm )
 {
 	int status, tag_added = 0, ret = 1;
 	str tag, value;
+	tagline t;
 
 	strs_init( &tag, &value, NULL );
 
 	while ( *p ) {
 
+		p = tagline_next( TAGLINE_ISI, p, &t );
+		if ( !tagline_strs( &t, &tag, &value ) ) {
+			ret = 0;
+			goto out;
+		}
+
 		/* ...with tag, add */
-		if ( is_isi_tag( p ) ) {
-			str_empty( &tag );
-			str_empty( &value );
-			p = process_tagged_line( &tag, &value, p );
+		if ( t.taglen )
 			status = add_tag_value( isiin, &tag, &value, &tag_added );
-			if ( status!=BIBL_OK ) {
-				ret = 0;
-				goto out;
-			}
-		}
 
 		/* ...untagged, merge -- one AU or AF for list of authors */
-		else {
-			str_empty( &value );
-			p = process_untagged_line( &value, p );
+		else
 			status = merge_tag_value( isiin, &tag, &value, &tag_added );
-			if ( status!=BIBL_OK ) {
-				ret = 0;
-				goto out;
-			}
+
+		if ( status!=BIBL_OK ) {
+			ret = 0;
+			goto out;
 		}
 
 	}
@@ -284,7 +235,7 @@ isiin_typef( fields *isiin, char *filename, int nref, param *p )
 
 /* pull off authors first--use AF before AU */
 static int
-isiin_addauthors( fields *isiin, fields *info, int reftype, variants *all, int nall, slist *asis, slist *corps )
+isiin_addauthors( fields *isiin, fields *info, int reftype, variants *all, int nall, slist *asis, slist *corps, namecache *nc )
 {
 	char *newtag, *authortype, use_af[]="AF", use_au[]="AU";
 	int level, i, n, has_af=0, has_au=0, nfields, ok;
@@ -307,7 +258,7 @@ isiin_addauthors( fields *isiin, fields *info, int reftype, variants *all, int n
 		n = process_findoldtag( authortype, reftype, all, nall );
 		level = ((all[reftype]).tags[n]).level;
 		newtag = all[reftype].tags[n].newstr;
-		ok = name_add( info, newtag, d->data, level, asis, corps );
+		ok = name_add( info, newtag, d->data, level, asis, corps, nc );
 		if ( !ok ) return BIBL_ERR_MEMERR;
 	}
 	return BIBL_OK;
@@ -361,7 +312,7 @@ isiin_convertf( fields *bibin, fields *bibout, int reftype, param *p )
 	str *intag, *invalue;
 	char *outtag;
 
-	status = isiin_addauthors( bibin, bibout, reftype, p->all, p->nall, &(p->asis), &(p->corps) );
+	status = isiin_addauthors( bibin, bibout, reftype, p->all, p->nall, &(p->asis), &(p->corps), &(p->names) );
 	if ( status!=BIBL_OK ) return status;
 
 	nfields = fields_num( bibin );
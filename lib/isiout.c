@@ -14,12 +14,14 @@
 #include "str.h"
 #include "strsearch.h"
 #include "fields.h"
+#include "outfields.h"
 #include "title.h"
 #include "bibutils.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static int  isiout_write( fields *info, FILE *fp, param *p, unsigned long refnum );
-static void isiout_writeheader( FILE *outptr, param *p );
+static int  isiout_write( fields *info, outsink *fp, param *p, unsigned long refnum );
+static void isiout_writeheader( outsink *outptr, param *p );
 
 void
 isiout_initparams( param *p, const char *progname )
@@ -36,6 +38,12 @@ isiout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	if ( p->charsetout == BIBL_CHARSET_UNICODE ) {
 		p->utf8out = p->utf8bom = 1;
@@ -81,7 +89,7 @@ get_type( fields *in )
 }
 
 static void
-append_type( int type, fields *out, int *status )
+append_type( int type, outfields *out, int *status )
 {
 	int fstatus;
 	char *s;
@@ -91,12 +99,12 @@ append_type( int type, fields *out, int *status )
 	else if ( type==TYPE_BOOK ) s = "Book";
 	else s = "Unknown";
 
-	fstatus = fields_add( out, "PT", s, LEVEL_MAIN );
+	fstatus = outfields_add( out, "PT", s, LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_titlecore( fields *in, char *isitag, int level, char *maintag, char *subtag, fields *out, int *status )
+append_titlecore( fields *in, char *isitag, int level, char *maintag, char *subtag, outfields *out, int *status )
 {
 	str *mainttl = fields_findv( in, level, FIELDS_STRP, maintag );
 	str *subttl  = fields_findv( in, level, FIELDS_STRP, subtag );
@@ -112,7 +120,7 @@ append_titlecore( fields *in, char *isitag, int level, char *maintag, char *subt
 	}
 
 	if ( str_has_value( &fullttl ) ) {
-		fstatus = fields_add( out, isitag, str_cstr( &fullttl ), LEVEL_MAIN );
+		fstatus = outfields_add( out, isitag, str_cstr( &fullttl ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 out:
@@ -120,19 +128,19 @@ out:
 }
 
 static void
-append_title( fields *in, char *isitag, int level, fields *out, int *status )
+append_title( fields *in, char *isitag, int level, outfields *out, int *status )
 {
 	append_titlecore( in, isitag, level, "TITLE", "SUBTITLE", out, status );
 }
 
 static void
-append_abbrtitle( fields *in, char *isitag, int level, fields *out, int *status )
+append_abbrtitle( fields *in, char *isitag, int level, outfields *out, int *status )
 {
 	append_titlecore( in, isitag, level, "SHORTTITLE", "SHORTSUBTITLE", out, status );
 }
 
 static void
-append_keywords( fields *in, fields *out, int *status )
+append_keywords( fields *in, outfields *out, int *status )
 {
 	vplist_index i;
 	str keywords;
@@ -149,7 +157,7 @@ append_keywords( fields *in, fields *out, int *status )
 			str_strcat( &keywords, (str *) vplist_get( &kw, i ) );
 		}
 		if ( str_memerr( &keywords ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		fstatus = fields_add( out, "DE", str_cstr( &keywords ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "DE", str_cstr( &keywords ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 	}
 out:
@@ -195,7 +203,7 @@ process_person( str *person, char *name )
 }
 
 static void
-append_people( fields *f, char *tag, char *isitag, int level, fields *out, int *status )
+append_people( fields *f, char *tag, char *isitag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	vplist people;
@@ -209,8 +217,8 @@ append_people( fields *f, char *tag, char *isitag, int level, fields *out, int *
 	for ( i=0; i<people.n; ++i ) {
 		process_person( &person, (char *)vplist_get( &people, i ) );
 		if ( str_memerr( &person ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		if ( i==0 ) fstatus = fields_add_can_dup( out, isitag, str_cstr( &person ), LEVEL_MAIN );
-		else        fstatus = fields_add_can_dup( out, "  ",   str_cstr( &person ), LEVEL_MAIN );
+		if ( i==0 ) fstatus = outfields_add_can_dup( out, isitag, str_cstr( &person ), LEVEL_MAIN );
+		else        fstatus = outfields_add_can_dup( out, "  ",   str_cstr( &person ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 	}
 
@@ -220,20 +228,20 @@ out:
 }
 
 static void
-append_easy( fields *in, char *tag, char *isitag, int level, fields *out, int *status )
+append_easy( fields *in, char *tag, char *isitag, int level, outfields *out, int *status )
 {
 	char *value;
 	int fstatus;
 
 	value = fields_findv( in, level, FIELDS_CHRP, tag );
 	if ( value ) {
-		fstatus = fields_add( out, isitag, value, LEVEL_MAIN );
+		fstatus = outfields_add( out, isitag, value, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_easyall( fields *in, char *tag, char *isitag, int level, fields *out, int *status )
+append_easyall( fields *in, char *tag, char *isitag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -242,32 +250,32 @@ append_easyall( fields *in, char *tag, char *isitag, int level, fields *out, int
 	vplist_init( &a );
 	fields_findv_each( in, level, FIELDS_CHRP, &a, tag );
 	for ( i=0; i<a.n; ++i ) {
-		fstatus = fields_add( out, isitag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
+		fstatus = outfields_add( out, isitag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	vplist_free( &a );
 }
 
 static void
-append_date( fields *in, fields *out, int *status )
+append_date( fields *in, outfields *out, int *status )
 {
 	char *month, *year;
 	int fstatus;
 
 	month = fields_findv_firstof( in, LEVEL_ANY, FIELDS_CHRP, "PARTDATE:MONTH", "DATE:MONTH", NULL );
 	if ( month ) {
-		fstatus = fields_add( out, "PD", month, LEVEL_MAIN );
+		fstatus = outfields_add( out, "PD", month, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	year  = fields_findv_firstof( in, LEVEL_ANY, FIELDS_CHRP, "PARTDATE:YEAR",  "DATE:YEAR",  NULL );
 	if ( year ) {
-		fstatus = fields_add( out, "PY", year, LEVEL_MAIN );
+		fstatus = outfields_add( out, "PY", year, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static int
-append_data( fields *in, fields *out )
+append_data( fields *in, outfields *out )
 {
 	int type, status = BIBL_OK;
 
@@ -334,45 +342,48 @@ output_verbose( fields *f, const char *type, unsigned long refnum )
 }
 
 static void
-output( FILE *fp, fields *out )
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
 {
-	int i;
-
-	for ( i=0; i<out->n; ++i ) {
-		fprintf( fp, "%s %s\n",
-			( char * ) fields_tag  ( out, i, FIELDS_CHRP ),
-			( char * ) fields_value( out, i, FIELDS_CHRP )
-		);
-	}
-        fprintf( fp, "ER\n\n" );
-        fflush( fp );
+	outsink_puts( fp, tag );
+	outsink_putc( fp, ' ' );
+	outsink_puts( fp, value );
+	outsink_putc( fp, '\n' );
 }
 
 static int
-isiout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+isiout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
+	fields verbose;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, NULL );
+	fields_init( &verbose );
 
-	if ( p->format_opts & BIBL_FORMAT_VERBOSE )
+	/* ...verbose output needs the full record, so collect it first */
+	if ( p->format_opts & BIBL_FORMAT_VERBOSE ) {
 		output_verbose( in, "IN", refnum );
+		outfields_collect( &out, &verbose );
+	}
 
 	status = append_data( in, &out );
 
-	if ( status==BIBL_OK ) output( fp, &out );
+	if ( status==BIBL_OK ) {
+		outfields_write( &out );
+		outsink_puts( fp, "ER\n\n" );
+	}
 
 	if ( p->format_opts & BIBL_FORMAT_VERBOSE )
-		output_verbose( &out, "OUT", refnum );
+		output_verbose( &verbose, "OUT", refnum );
 
-	fields_free( &out );
+	fields_free( &verbose );
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-isiout_writeheader( FILE *outptr, param *p )
+isiout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
@@ -2,6 +2,8 @@
  * iso639_1.c
  */
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include "iso639_1.h"
 
 typedef struct {
@@ -198,13 +200,53 @@ static iso639_1_t iso639_1[] = {
 };
 static int niso639_1= sizeof( iso639_1 ) / sizeof( iso639_1[0] );
 
+/* The table is in code order, so codes are found by binary search;
+ * names are found through an index sorted once on first use. */
+static int byname[ sizeof( iso639_1 ) / sizeof( iso639_1[0] ) ];
+static pthread_once_t byname_once = PTHREAD_ONCE_INIT;
+
+static int
+iso639_1_namecmp( const void *v1, const void *v2 )
+{
+	int n1 = *( const int * ) v1, n2 = *( const int * ) v2, n;
+	n = strcasecmp( iso639_1[n1].language, iso639_1[n2].language );
+	if ( n ) return n;
+	return n1 - n2;
+}
+
+static void
+iso639_1_sortnames( void )
+{
+	int i;
+	for ( i=0; i<niso639_1; ++i ) byname[i] = i;
+	qsort( byname, niso639_1, sizeof( int ), iso639_1_namecmp );
+}
+
 char *
 iso639_1_from_code( const char *code )
 {
-	int i;
-	for ( i=0; i<niso639_1; ++i ) {
-		if ( !strcasecmp( iso639_1[i].code, code ) )
-			return iso639_1[i].language;
+	int lo = 0, hi = niso639_1 - 1, mid, n;
+	while ( lo<=hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		n = strcasecmp( iso639_1[mid].code, code );
+		if ( n==0 ) return iso639_1[mid].language;
+		if ( n<0 ) lo = mid + 1;
+		else hi = mid - 1;
+	}
+	return NULL;
+}
+
+char *
+iso639_1_from_name( const char *name )
+{
+	int lo = 0, hi = niso639_1, mid;
+	pthread_once( &byname_once, iso639_1_sortnames );
+	while ( lo<hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		if ( strcasecmp( iso639_1[byname[mid]].language, name ) < 0 ) lo = mid + 1;
+		else hi = mid;
 	}
+	if ( lo<niso639_1 && !strcasecmp( iso639_1[byname[lo]].language, name ) )
+		return iso639_1[byname[lo]].code;
 	return NULL;
 }
@@ -5,5 +5,6 @@
 #define ISO639_1_H
 
 char * iso639_1_from_code( const char *code );
+char * iso639_1_from_name( const char *name );
 
 #endif
@@ -2,6 +2,8 @@
  * iso639-2 language codes
  */
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include "iso639_2.h"
 
 typedef struct {
@@ -586,28 +588,69 @@ static iso639_2_t iso639_2[] = {
 };
 static int niso639_2= sizeof( iso639_2 ) / sizeof( iso639_2[0] );
 
-char *
-iso639_2_from_code( char *code )
+/* The table is in language order, so languages are found by binary
+ * search; codes, both bibliographic and terminologic, are found
+ * through an index sorted once on first use. */
+typedef struct {
+	char *code;
+	int  n;
+} iso639_2_code_t;
+
+static iso639_2_code_t bycode[ 2 * sizeof( iso639_2 ) / sizeof( iso639_2[0] ) ];
+static int nbycode = 0;
+static pthread_once_t bycode_once = PTHREAD_ONCE_INIT;
+
+static int
+iso639_2_codecmp( const void *v1, const void *v2 )
+{
+	const iso639_2_code_t *c1 = v1, *c2 = v2;
+	int n;
+	n = strcasecmp( c1->code, c2->code );
+	if ( n ) return n;
+	return c1->n - c2->n; /* keep table order, so the first listed wins */
+}
+
+static void
+iso639_2_sortcodes( void )
 {
 	int i;
 	for ( i=0; i<niso639_2; ++i ) {
 		if ( !iso639_2[i].main ) continue;
-		if ( !strcasecmp( iso639_2[i].code1, code ) )
-			return iso639_2[i].language;
-		if ( iso639_2[i].code2[0]!='\0' && !strcasecmp( iso639_2[i].code2, code ) )
-			return iso639_2[i].language;
+		bycode[nbycode].code = iso639_2[i].code1;
+		bycode[nbycode++].n  = i;
+		if ( iso639_2[i].code2[0]=='\0' ) continue;
+		bycode[nbycode].code = iso639_2[i].code2;
+		bycode[nbycode++].n  = i;
+	}
+	qsort( bycode, nbycode, sizeof( iso639_2_code_t ), iso639_2_codecmp );
+}
+
+char *
+iso639_2_from_code( char *code )
+{
+	int lo = 0, hi, mid;
+	pthread_once( &bycode_once, iso639_2_sortcodes );
+	hi = nbycode;
+	while ( lo<hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		if ( strcasecmp( bycode[mid].code, code ) < 0 ) lo = mid + 1;
+		else hi = mid;
 	}
+	if ( lo<nbycode && !strcasecmp( bycode[lo].code, code ) )
+		return iso639_2[bycode[lo].n].language;
 	return NULL;
 }
 
 char *
 iso639_2_from_language( char *lang )
 {
-	int i, n;
-	for ( i=0; i<niso639_2; ++i ) {
-		n = strcasecmp( iso639_2[i].language, lang );
-		if ( n==0 ) return iso639_2[i].code1;
-		if ( n > 0 ) return NULL;
+	int lo = 0, hi = niso639_2 - 1, mid, n;
+	while ( lo<=hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		n = strcasecmp( iso639_2[mid].language, lang );
+		if ( n==0 ) return iso639_2[mid].code1;
+		if ( n<0 ) lo = mid + 1;
+		else hi = mid - 1;
 	}
 	return NULL;
 }
@@ -2,6 +2,8 @@
  * iso639_3.c
  */
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include "iso639_3.h"
 
 typedef struct {
@@ -8407,13 +8409,38 @@ static iso639_3_t iso639_3[] = {
 };
 static int niso639_3= sizeof( iso639_3 ) / sizeof( iso639_3[0] );
 
+/* The table is in code order, so codes are found by binary search;
+ * names are found through an index sorted once on first use. */
+static int byname[ sizeof( iso639_3 ) / sizeof( iso639_3[0] ) ];
+static pthread_once_t byname_once = PTHREAD_ONCE_INIT;
+
+static int
+iso639_3_namecmp( const void *v1, const void *v2 )
+{
+	int n1 = *( const int * ) v1, n2 = *( const int * ) v2, n;
+	n = strcasecmp( iso639_3[n1].language, iso639_3[n2].language );
+	if ( n ) return n;
+	return n1 - n2; /* keep table order, so the first listed wins */
+}
+
+static void
+iso639_3_sortnames( void )
+{
+	int i;
+	for ( i=0; i<niso639_3; ++i ) byname[i] = i;
+	qsort( byname, niso639_3, sizeof( int ), iso639_3_namecmp );
+}
+
 char *
 iso639_3_from_code( const char *code )
 {
-	int i;
-	for ( i=0; i<niso639_3; ++i ) {
-		if ( !strcasecmp( iso639_3[i].code, code ) )
-			return iso639_3[i].language;
+	int lo = 0, hi = niso639_3 - 1, mid, n;
+	while ( lo<=hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		n = strcasecmp( iso639_3[mid].code, code );
+		if ( n==0 ) return iso639_3[mid].language;
+		if ( n<0 ) lo = mid + 1;
+		else hi = mid - 1;
 	}
 	return NULL;
 }
@@ -8421,10 +8448,14 @@ iso639_3_from_code( const char *code )
 char *
 iso639_3_from_name( const char *name )
 {
-	int i;
-	for ( i=0; i<niso639_3; ++i ) {
-		if ( !strcasecmp( iso639_3[i].language, name ) )
-			return iso639_3[i].code;
+	int lo = 0, hi = niso639_3, mid;
+	pthread_once( &byname_once, iso639_3_sortnames );
+	while ( lo<hi ) {
+		mid = lo + ( hi - lo ) / 2;
+		if ( strcasecmp( iso639_3[byname[mid]].language, name ) < 0 ) lo = mid + 1;
+		else hi = mid;
 	}
+	if ( lo<niso639_3 && !strcasecmp( iso639_3[byname[lo]].language, name ) )
+		return iso639_3[byname[lo]].code;
 	return NULL;
 }
@@ -515,9 +515,7 @@ latex2char( char *s, unsigned int *pos, int *unicode )
 
 	p = &( s[*pos] );
 	value = (unsigned char) *p;
-	if ( value=='{' || value=='\\' || value=='~' || 
-	     value=='$' || value=='\'' || value=='`' || 
-	     value=='-' || value=='^' ) {
+	if ( value && strchr( LATEX_STARTCHARS, value ) ) {
 //		if ( *p=='\\' && ( *p=='{' || *p=='}' ) ) {
 //		} else {
 		for ( i=0; i<nlatex_chars; ++i ) {
@@ -9,6 +9,9 @@
 #ifndef LATEX_H
 #define LATEX_H
 
+/* the characters that can start a sequence latex2char() converts */
+#define LATEX_STARTCHARS "{\\~$'`-^"
+
 extern unsigned int latex2char( char *s, unsigned int *pos, int *unicode );
 extern void uni2latex( unsigned int ch, char buf[], int buf_size );
 
@@ -8,6 +8,8 @@
  */
 #include "marc_auth.h"
 #include <string.h>
+#include <pthread.h>
+#include "phash.h"
 
 static const char *marc_genre[] = {
 	"abstract or summary",
@@ -408,11 +410,41 @@ static const marc_trans relators[] = {
 
 static const int nrealtors = sizeof( relators ) / sizeof( relators[0] );
 
+/* The vocabularies are hashed on first use; if that fails they are
+ * scanned instead. */
+static phash genre_hash, resource_hash, relators_hash;
+static int hashed = 0;
+static pthread_once_t hash_once = PTHREAD_ONCE_INIT;
+
+static void
+marc_hash( void )
+{
+	if ( phash_build( &genre_hash, marc_genre, sizeof( marc_genre[0] ), nmarc_genre )!=PHASH_OK )
+		return;
+	if ( phash_build( &resource_hash, marc_resource, sizeof( marc_resource[0] ), nmarc_resource )!=PHASH_OK ) {
+		phash_free( &genre_hash );
+		return;
+	}
+	if ( phash_build( &relators_hash, relators, sizeof( relators[0] ), nrealtors )!=PHASH_OK ) {
+		phash_free( &genre_hash );
+		phash_free( &resource_hash );
+		return;
+	}
+	hashed = 1;
+}
+
 char *
 marc_convertrole( const char *query )
 {
 	int i;
 
+	pthread_once( &hash_once, marc_hash );
+	if ( hashed ) {
+		i = phash_find( &relators_hash, query );
+		if ( i==-1 ) return NULL;
+		return relators[i].internal_name;
+	}
+
 	for ( i=0; i<nrealtors; ++i ) {
 		if ( !strcasecmp( query, relators[i].abbreviation ) )
 			return relators[i].internal_name;
@@ -433,6 +465,8 @@ position_in_list( const char *list[], int nlist, const char *query )
 int
 marc_findgenre( const char *query )
 {
+	pthread_once( &hash_once, marc_hash );
+	if ( hashed ) return phash_find( &genre_hash, query );
 	return position_in_list( marc_genre, nmarc_genre, query );
 }
 
@@ -446,6 +480,8 @@ is_marc_genre( const char *query )
 int
 marc_findresource( const char *query )
 {
+	pthread_once( &hash_once, marc_hash );
+	if ( hashed ) return phash_find( &resource_hash, query );
 	return position_in_list( marc_resource, nmarc_resource, query );
 }
 
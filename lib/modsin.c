@@ -48,7 +48,15 @@ modsin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 	p->output_raw       = BIBL_RAW_WITHMAKEREFID |
 	                      BIBL_RAW_WITHCHARCONVERT;
 
@@ -62,6 +70,7 @@ modsin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -12,6 +12,7 @@
 #include <string.h>
 #include "is_ws.h"
 #include "str.h"
+#include "slist.h"
 #include "charsets.h"
 #include "str_conv.h"
 #include "fields.h"
@@ -20,11 +21,14 @@
 #include "modstypes.h"
 #include "bu_auth.h"
 #include "marc_auth.h"
+#include "name.h"
+#include "url.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static void modsout_writeheader( FILE *outptr, param *p );
-static void modsout_writefooter( FILE *outptr );
-static int  modsout_write( fields *info, FILE *outptr, param *p, unsigned long numrefs );
+static void modsout_writeheader( outsink *outptr, param *p );
+static void modsout_writefooter( outsink *outptr );
+static int  modsout_write( fields *info, outsink *outptr, param *p, unsigned long numrefs );
 
 void
 modsout_initparams( param *p, const char *progname )
@@ -41,6 +45,12 @@ modsout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	p->headerf = modsout_writeheader;
 	p->footerf = modsout_writefooter;
@@ -67,38 +77,45 @@ modsout_initparams( param *p, const char *progname )
 #define TAG_NEWLINE   (1)
 
 static void
-output_tag_core( FILE *outptr, int nindents, char *tag, char *data, unsigned char mode, unsigned char newline, va_list *attrs )
+output_tag_core( outsink *outptr, int nindents, char *tag, char *data, unsigned char mode, unsigned char newline, va_list *attrs )
 {
 	char *attr, *val;
-	int i;
 
-	for ( i=0; i<nindents; ++i ) fprintf( outptr, "    " );
+	outsink_repeat( outptr, "    ", nindents );
 
 	if ( mode!=TAG_CLOSE )
-		fprintf( outptr, "<" );
+		outsink_putc( outptr, '<' );
 	else
-		fprintf( outptr, "</" );
+		outsink_puts( outptr, "</" );
 
-	fprintf( outptr, "%s", tag );
+	outsink_puts( outptr, tag );
 
 	do {
 		attr = va_arg( *attrs, char * );
 		if ( attr ) val  = va_arg( *attrs, char * );
-		if ( attr && val )
-			fprintf( outptr, " %s=\"%s\"", attr, val );
+		if ( attr && val ) {
+			outsink_putc( outptr, ' ' );
+			outsink_puts( outptr, attr );
+			outsink_puts( outptr, "=\"" );
+			outsink_puts( outptr, val );
+			outsink_putc( outptr, '\"' );
+		}
 	} while ( attr && val );
 
 	if ( mode!=TAG_SELFCLOSE )
-		fprintf( outptr, ">" );
+		outsink_putc( outptr, '>' );
 	else
-		fprintf( outptr, "/>" );
+		outsink_puts( outptr, "/>" );
 
 	if ( mode==TAG_OPENCLOSE ) {
-		fprintf( outptr, "%s</%s>", data, tag );
+		outsink_puts( outptr, data );
+		outsink_puts( outptr, "</" );
+		outsink_puts( outptr, tag );
+		outsink_putc( outptr, '>' );
 	}
 
 	if ( newline==TAG_NEWLINE )
-		fprintf( outptr, "\n" );
+		outsink_putc( outptr, '\n' );
 }
 
 /* output_tag()
@@ -112,7 +129,7 @@ output_tag_core( FILE *outptr, int nindents, char *tag, char *data, unsigned cha
  * will be output in the tag
  */
 static void
-output_tag( FILE *outptr, int nindents, char *tag, char *value, unsigned char mode, unsigned char newline, ... )
+output_tag( outsink *outptr, int nindents, char *tag, char *value, unsigned char mode, unsigned char newline, ... )
 {
 	va_list attrs;
 
@@ -131,7 +148,7 @@ output_tag( FILE *outptr, int nindents, char *tag, char *value, unsigned char mo
  * value looked up in fields will only be used in mode TAG_OPENCLOSE
  */
 static void
-output_fil( FILE *outptr, int nindents, char *tag, fields *f, int n, unsigned char mode, unsigned char newline, ... )
+output_fil( outsink *outptr, int nindents, char *tag, fields *f, int n, unsigned char mode, unsigned char newline, ... )
 {
 	va_list attrs;
 	char *value;
@@ -158,6 +175,316 @@ incr_level( int level, int amt )
 	else return level-amt;
 }
 
+/* modsfields
+ *
+ *       The output_* routines each look for a handful of tags, once
+ *       per level. Rather than have every routine rescan the whole
+ *       reference, it is classified once up front: each field is
+ *       threaded onto a list for its tag and the routines only walk
+ *       those lists.
+ *
+ *       Tags whose routine needs them interleaved in their original
+ *       order (notes, subjects, genres) share the list of a group
+ *       leader. Name roles also collect their :ASIS, :CORP, and :CONF
+ *       variants, with the variant remembered in flags[].
+ */
+typedef struct modstag {
+	char *tag;
+	char *group;
+	int  isname;
+} modstag;
+
+/* sorted for strcasecmp() */
+static const modstag modstags[] = {
+	{ "2ND_AUTHOR",      NULL,              1 },
+	{ "3RD_AUTHOR",      NULL,              1 },
+	{ "ABSTRACT",        NULL,              0 },
+	{ "ACCESSNUM",       NULL,              0 },
+	{ "ADDENDUM",        "NOTES",           0 },
+	{ "ADDRESS",         NULL,              0 },
+	{ "ADDRESSEE",       NULL,              1 },
+	{ "AFTERAUTHOR",     NULL,              1 },
+	{ "ANNOTATION",      "NOTES",           0 },
+	{ "ANNOTATOR",       NULL,              1 },
+	{ "ANNOTE",          "NOTES",           0 },
+	{ "ARTICLENUMBER",   NULL,              0 },
+	{ "ARTIST",          NULL,              1 },
+	{ "ARXIV",           NULL,              0 },
+	{ "ASSIGNEE",        NULL,              1 },
+	{ "AUTHOR",          NULL,              1 },
+	{ "AUTHORADDRESS",   NULL,              0 },
+	{ "BIBKEY",          "NOTES",           0 },
+	{ "CALLNUMBER",      NULL,              0 },
+	{ "CARTOGRAPHER",    NULL,              1 },
+	{ "CHAPTER",         NULL,              0 },
+	{ "CODEN",           NULL,              0 },
+	{ "COLLABORATOR",    NULL,              1 },
+	{ "COMMENTATOR",     NULL,              1 },
+	{ "COMMITTEE",       NULL,              1 },
+	{ "COMPILER",        NULL,              1 },
+	{ "CONTENTS",        NULL,              0 },
+	{ "COURT",           NULL,              1 },
+	{ "DATE",            NULL,              0 },
+	{ "DATE:DAY",        NULL,              0 },
+	{ "DATE:MONTH",      NULL,              0 },
+	{ "DATE:YEAR",       NULL,              0 },
+	{ "DEGREEGRANTOR",   NULL,              1 },
+	{ "DESCRIPTION",     NULL,              0 },
+	{ "DIRECTOR",        NULL,              1 },
+	{ "DOI",             NULL,              0 },
+	{ "EDITION",         NULL,              0 },
+	{ "EDITOR",          NULL,              1 },
+	{ "EID",             NULL,              0 },
+	{ "EPRINT",          NULL,              0 },
+	{ "EPRINTCLASS",     "KEYWORD",         0 },
+	{ "EPRINTTYPE",      NULL,              0 },
+	{ "EVENT",           NULL,              1 },
+	{ "FILEATTACH",      NULL,              0 },
+	{ "GENRE:BIBUTILS",  "GENRE:MARC",      0 },
+	{ "GENRE:MARC",      NULL,              0 },
+	{ "GENRE:UNKNOWN",   "GENRE:MARC",      0 },
+	{ "INTERNAL_TYPE",   NULL,              0 },
+	{ "INTROAUTHOR",     NULL,              1 },
+	{ "INVENTOR",        NULL,              1 },
+	{ "ISBN",            NULL,              0 },
+	{ "ISBN13",          NULL,              0 },
+	{ "ISIREFNUM",       NULL,              0 },
+	{ "ISRN",            NULL,              0 },
+	{ "ISSN",            NULL,              0 },
+	{ "ISSUANCE",        NULL,              0 },
+	{ "ISSUE",           NULL,              0 },
+	{ "JSTOR",           NULL,              0 },
+	{ "KEYWORD",         NULL,              0 },
+	{ "LANGCATALOG",     NULL,              0 },
+	{ "LANGUAGE",        NULL,              0 },
+	{ "LCCN",            NULL,              0 },
+	{ "LEGISLATIVEBODY", NULL,              1 },
+	{ "LOCATION",        NULL,              0 },
+	{ "MEDLINE",         NULL,              0 },
+	{ "MRNUMBER",        NULL,              0 },
+	{ "NOTES",           NULL,              0 },
+	{ "NUMBER",          NULL,              0 },
+	{ "NUMVOLUMES",      NULL,              0 },
+	{ "ORGANIZER",       NULL,              1 },
+	{ "PAGES",           NULL,              0 },
+	{ "PAGES:START",     NULL,              0 },
+	{ "PAGES:STOP",      NULL,              0 },
+	{ "PAGES:TOTAL",     NULL,              0 },
+	{ "PART",            NULL,              0 },
+	{ "PARTDATE",        NULL,              0 },
+	{ "PARTDATE:DAY",    NULL,              0 },
+	{ "PARTDATE:MONTH",  NULL,              0 },
+	{ "PARTDATE:YEAR",   NULL,              0 },
+	{ "PARTTITLE",       NULL,              0 },
+	{ "PDFLINK",         NULL,              0 },
+	{ "PERFORMER",       NULL,              1 },
+	{ "PII",             NULL,              0 },
+	{ "PMC",             NULL,              0 },
+	{ "PMID",            NULL,              0 },
+	{ "PRODUCER",        NULL,              1 },
+	{ "PUBLICLAWNUMBER", NULL,              0 },
+	{ "PUBLISHER",       NULL,              0 },
+	{ "PUBSTATE",        "NOTES",           0 },
+	{ "REDACTOR",        NULL,              1 },
+	{ "REFNUM",          NULL,              0 },
+	{ "REPORTER",        NULL,              1 },
+	{ "REPORTNUMBER",    NULL,              0 },
+	{ "RESOURCE",        NULL,              0 },
+	{ "SECTION",         NULL,              0 },
+	{ "SERIALNUMBER",    NULL,              0 },
+	{ "SESSION",         NULL,              0 },
+	{ "SHORTTITLE",      NULL,              0 },
+	{ "SPONSOR",         NULL,              1 },
+	{ "SUB_AUTHOR",      NULL,              1 },
+	{ "SUBTITLE",        NULL,              0 },
+	{ "TIMESCITED",      "NOTES",           0 },
+	{ "TITLE",           NULL,              0 },
+	{ "TRANSLATOR",      NULL,              1 },
+	{ "URL",             NULL,              0 },
+	{ "URLDATE",         NULL,              0 },
+	{ "VOLUME",          NULL,              0 },
+	{ "WRITER",          NULL,              1 },
+};
+
+#define NMODSTAGS ( sizeof( modstags ) / sizeof( modstags[0] ) )
+
+#define MODSFIELDS_N       (256)
+#define MODSFIELDS_NLEVELS (16)
+
+#define NAME_ASIS (1)
+#define NAME_CORP (2)
+#define NAME_CONF (4)
+
+typedef struct modsfields {
+	fields        *f;
+	int           head[ NMODSTAGS ];
+	int           tail[ NMODSTAGS ];
+	int           *next;      /* next field on the same list, -1 at end */
+	unsigned char *flags;     /* NAME_ASIS/NAME_CORP/NAME_CONF */
+	int           nlevels;    /* -1 if more than MODSFIELDS_NLEVELS */
+	int           levels[ MODSFIELDS_NLEVELS ];
+	int           next0[ MODSFIELDS_N ];
+	unsigned char flags0[ MODSFIELDS_N ];
+} modsfields;
+
+static int
+modstag_lookup( const char *tag )
+{
+	int lo = 0, hi = NMODSTAGS - 1, mid, cmp;
+
+	while ( lo <= hi ) {
+		mid = ( lo + hi ) / 2;
+		cmp = strcasecmp( tag, modstags[mid].tag );
+		if ( cmp==0 ) return mid;
+		if ( cmp < 0 ) hi = mid - 1;
+		else lo = mid + 1;
+	}
+
+	return -1;
+}
+
+/* returns the list that fields with this tag are threaded onto */
+static int
+modstag_list( const char *tag )
+{
+	int n;
+
+	n = modstag_lookup( tag );
+	if ( n!=-1 && modstags[n].group ) n = modstag_lookup( modstags[n].group );
+
+	return n;
+}
+
+/* "AUTHOR:CORP" and friends go on the list for their role */
+static int
+modstag_namelist( const char *tag, str *role, unsigned char *flags )
+{
+	int n;
+
+	*flags = 0;
+	str_strcpyc( role, tag );
+	if ( str_findreplace( role, ":ASIS", "" ) ) *flags |= NAME_ASIS;
+	if ( str_findreplace( role, ":CORP", "" ) ) *flags |= NAME_CORP;
+	if ( str_findreplace( role, ":CONF", "" ) ) *flags |= NAME_CONF;
+	if ( *flags==0 || str_memerr( role ) ) return -1;
+
+	n = modstag_lookup( str_cstr( role ) );
+	if ( n==-1 || !modstags[n].isname ) return -1;
+
+	return n;
+}
+
+static void
+modsfields_addlevel( modsfields *m, int level )
+{
+	int i;
+
+	if ( m->nlevels==-1 ) return;
+
+	for ( i=0; i<m->nlevels; ++i )
+		if ( m->levels[i]==level ) return;
+
+	if ( m->nlevels==MODSFIELDS_NLEVELS ) m->nlevels = -1;
+	else m->levels[ m->nlevels++ ] = level;
+}
+
+static void
+modsfields_free( modsfields *m )
+{
+	if ( m->next!=m->next0 ) free( m->next );
+	if ( m->flags!=m->flags0 ) free( m->flags );
+}
+
+static int
+modsfields_init( modsfields *m, fields *f )
+{
+	int i, n, list, status = BIBL_OK;
+	unsigned char flags;
+	char *tag;
+	str role;
+
+	m->f       = f;
+	m->next    = m->next0;
+	m->flags   = m->flags0;
+	m->nlevels = 0;
+	for ( i=0; i<NMODSTAGS; ++i )
+		m->head[i] = m->tail[i] = -1;
+
+	n = fields_num( f );
+	if ( n > MODSFIELDS_N ) {
+		m->next  = ( int * ) malloc( sizeof( int ) * n );
+		m->flags = ( unsigned char * ) malloc( sizeof( unsigned char ) * n );
+		if ( !m->next || !m->flags ) {
+			free( m->next );
+			free( m->flags );
+			m->next  = m->next0;
+			m->flags = m->flags0;
+			return BIBL_ERR_MEMERR;
+		}
+	}
+
+	str_init( &role );
+
+	for ( i=0; i<n; ++i ) {
+
+		modsfields_addlevel( m, fields_level( f, i ) );
+
+		m->next[i]  = -1;
+		m->flags[i] = flags = 0;
+
+		tag  = fields_tag( f, i, FIELDS_CHRP_NOUSE );
+		list = modstag_list( tag );
+		if ( list==-1 && strchr( tag, ':' ) ) {
+			list = modstag_namelist( tag, &role, &flags );
+			if ( str_memerr( &role ) ) {
+				status = BIBL_ERR_MEMERR;
+				break;
+			}
+			m->flags[i] = flags;
+		}
+		if ( list==-1 ) continue;
+
+		if ( m->head[list]==-1 ) m->head[list] = i;
+		else m->next[ m->tail[list] ] = i;
+		m->tail[list] = i;
+	}
+
+	str_free( &role );
+
+	if ( status!=BIBL_OK ) modsfields_free( m );
+
+	return status;
+}
+
+/* first field on the list for tag, -1 if none */
+static int
+modsfields_first( modsfields *m, char *tag )
+{
+	int list = modstag_list( tag );
+	if ( list==-1 ) return -1;
+	return m->head[list];
+}
+
+/* modsfields_find()
+ *
+ *       Same result as fields_find( m->f, tag, level ), including
+ *       marking matching fields with no data as used.
+ */
+static int
+modsfields_find( modsfields *m, char *tag, int level )
+{
+	fields *f = m->f;
+	int i;
+
+	for ( i=modsfields_first( m, tag ); i!=-1; i=m->next[i] ) {
+		if ( !fields_match_casetag_level( f, i, tag, level ) ) continue;
+		if ( f->data[i].len ) return i;
+		f->used[i] = 1;
+	}
+
+	return FIELDS_NOTFOUND;
+}
+
 /* convert_findallfields()
  *
  *       Find the positions of all convert.internal tags in the fields
@@ -166,12 +493,12 @@ incr_level( int level, int amt )
  *       Return number of the tags found.
  */
 static int
-convert_findallfields( fields *f, convert *parts, int nparts, int level )
+convert_findallfields( modsfields *m, convert *parts, int nparts, int level )
 {
 	int i, n = 0;
 
 	for ( i=0; i<nparts; ++i ) {
-		parts[i].pos = fields_find( f, parts[i].internal, level );
+		parts[i].pos = modsfields_find( m, parts[i].internal, level );
 		n += ( parts[i].pos!=FIELDS_NOTFOUND );
 	}
 
@@ -179,12 +506,13 @@ convert_findallfields( fields *f, convert *parts, int nparts, int level )
 }
 
 static void
-output_title( fields *f, FILE *outptr, int level )
+output_title( modsfields *m, outsink *outptr, int level )
 {
-	int ttl    = fields_find( f, "TITLE", level );
-	int subttl = fields_find( f, "SUBTITLE", level );
-	int shrttl = fields_find( f, "SHORTTITLE", level );
-	int parttl = fields_find( f, "PARTTITLE", level );
+	fields *f  = m->f;
+	int ttl    = modsfields_find( m, "TITLE", level );
+	int subttl = modsfields_find( m, "SUBTITLE", level );
+	int shrttl = modsfields_find( m, "SHORTTITLE", level );
+	int parttl = modsfields_find( m, "PARTTITLE", level );
 	char *val;
 
 	output_tag( outptr, lvl2indent(level),               "titleInfo", NULL,      TAG_OPEN,      TAG_NEWLINE, NULL );
@@ -207,54 +535,71 @@ output_title( fields *f, FILE *outptr, int level )
 	}
 }
 
-static void
-output_name( FILE *outptr, char *p, int level )
+/* modsname_split()
+ *
+ *       Take apart a name in the internal "family|given|given||suffix"
+ *       form. The period of an "A." given name is dropped, as
+ *       output_name() writes "A. B. Jones" with "A" and "B".
+ *
+ *       Returns BIBL_OK or BIBL_ERR_MEMERR.
+ */
+static int
+modsname_split( char *p, str *family, slist *given, str *suffix )
 {
-	str family, part, suffix;
-	int n=0;
+	int status = BIBL_OK;
+	str part;
 
-	strs_init( &family, &part, &suffix, NULL );
+	str_init( &part );
 
-	while ( *p && *p!='|' ) str_addchar( &family, *p++ );
+	while ( *p && *p!='|' ) str_addchar( family, *p++ );
 	if ( *p=='|' ) p++;
 
 	while ( *p ) {
 		while ( *p && *p!='|' ) str_addchar( &part, *p++ );
-		/* truncate periods from "A. B. Jones" names */
 		if ( part.len ) {
-			if ( part.len==2 && part.data[1]=='.' ) {
-				part.len=1;
-				part.data[1]='\0';
-			}
-			if ( n==0 )
-				output_tag( outptr, lvl2indent(level), "name", NULL, TAG_OPEN, TAG_NEWLINE, "type", "personal", NULL );
-			output_tag( outptr, lvl2indent(incr_level(level,1)), "namePart", part.data, TAG_OPENCLOSE, TAG_NEWLINE, "type", "given", NULL );
-			n++;
+			if ( part.len==2 && part.data[1]=='.' ) str_trimend( &part, 1 );
+			if ( !slist_add( given, &part ) ) { status = BIBL_ERR_MEMERR; break; }
 		}
 		if ( *p=='|' ) {
 			p++;
 			if ( *p=='|' ) {
 				p++;
-				while ( *p && *p!='|' ) str_addchar( &suffix, *p++ );
+				while ( *p && *p!='|' ) str_addchar( suffix, *p++ );
 			}
 			str_empty( &part );
 		}
 	}
 
-	if ( family.len ) {
-		if ( n==0 )
-			output_tag( outptr, lvl2indent(level), "name", NULL, TAG_OPEN, TAG_NEWLINE, "type", "personal", NULL );
-		output_tag( outptr, lvl2indent(incr_level(level,1)), "namePart", family.data, TAG_OPENCLOSE, TAG_NEWLINE, "type", "family", NULL );
-		n++;
-	}
+	if ( str_memerr( family ) || str_memerr( suffix ) || str_memerr( &part ) )
+		status = BIBL_ERR_MEMERR;
 
-	if ( suffix.len ) {
-		if ( n==0 )
-			output_tag( outptr, lvl2indent(level), "name", NULL, TAG_OPEN, TAG_NEWLINE, "type", "personal", NULL );
+	str_free( &part );
+	return status;
+}
+
+static void
+output_name( outsink *outptr, char *p, int level )
+{
+	str family, suffix;
+	slist given;
+	int i;
+
+	strs_init( &family, &suffix, NULL );
+	slist_init( &given );
+
+	modsname_split( p, &family, &given, &suffix );
+
+	if ( given.n || family.len || suffix.len )
+		output_tag( outptr, lvl2indent(level), "name", NULL, TAG_OPEN, TAG_NEWLINE, "type", "personal", NULL );
+	for ( i=0; i<given.n; ++i )
+		output_tag( outptr, lvl2indent(incr_level(level,1)), "namePart", slist_cstr( &given, i ), TAG_OPENCLOSE, TAG_NEWLINE, "type", "given", NULL );
+	if ( family.len )
+		output_tag( outptr, lvl2indent(incr_level(level,1)), "namePart", family.data, TAG_OPENCLOSE, TAG_NEWLINE, "type", "family", NULL );
+	if ( suffix.len )
 		output_tag( outptr, lvl2indent(incr_level(level,1)), "namePart", suffix.data, TAG_OPENCLOSE, TAG_NEWLINE, "type", "suffix", NULL );
-	}
 
-	strs_free( &part, &family, &suffix, NULL );
+	strs_free( &family, &suffix, NULL );
+	slist_free( &given );
 }
 
 
@@ -274,81 +619,72 @@ output_name( FILE *outptr, char *p, int level )
 #define NO_AUTHORITY (0)
 #define MARC_AUTHORITY (1)
 
+static convert modsnames[] = {
+	{ "author",                              "AUTHOR",          0, MARC_AUTHORITY },
+	{ "editor",                              "EDITOR",          0, MARC_AUTHORITY },
+	{ "annotator",                           "ANNOTATOR",       0, MARC_AUTHORITY },
+	{ "artist",                              "ARTIST",          0, MARC_AUTHORITY },
+	{ "author",                              "2ND_AUTHOR",      0, MARC_AUTHORITY },
+	{ "author",                              "3RD_AUTHOR",      0, MARC_AUTHORITY },
+	{ "author",                              "SUB_AUTHOR",      0, MARC_AUTHORITY },
+	{ "author",                              "COMMITTEE",       0, MARC_AUTHORITY },
+	{ "author",                              "COURT",           0, MARC_AUTHORITY },
+	{ "author",                              "LEGISLATIVEBODY", 0, MARC_AUTHORITY },
+	{ "author of afterword, colophon, etc.", "AFTERAUTHOR",     0, MARC_AUTHORITY },
+	{ "author of introduction, etc.",        "INTROAUTHOR",     0, MARC_AUTHORITY },
+	{ "cartographer",                        "CARTOGRAPHER",    0, MARC_AUTHORITY },
+	{ "collaborator",                        "COLLABORATOR",    0, MARC_AUTHORITY },
+	{ "commentator",                         "COMMENTATOR",     0, MARC_AUTHORITY },
+	{ "compiler",                            "COMPILER",        0, MARC_AUTHORITY },
+	{ "degree grantor",                      "DEGREEGRANTOR",   0, MARC_AUTHORITY },
+	{ "director",                            "DIRECTOR",        0, MARC_AUTHORITY },
+	{ "event",                               "EVENT",           0, NO_AUTHORITY   },
+	{ "inventor",                            "INVENTOR",        0, MARC_AUTHORITY },
+	{ "organizer of meeting",                "ORGANIZER",       0, MARC_AUTHORITY },
+	{ "patent holder",                       "ASSIGNEE",        0, MARC_AUTHORITY },
+	{ "performer",                           "PERFORMER",       0, MARC_AUTHORITY },
+	{ "producer",                            "PRODUCER",        0, MARC_AUTHORITY },
+	{ "addressee",                           "ADDRESSEE",       0, MARC_AUTHORITY },
+	{ "redactor",                            "REDACTOR",        0, MARC_AUTHORITY },
+	{ "reporter",                            "REPORTER",        0, MARC_AUTHORITY },
+	{ "sponsor",                             "SPONSOR",         0, MARC_AUTHORITY },
+	{ "translator",                          "TRANSLATOR",      0, MARC_AUTHORITY },
+	{ "writer",                              "WRITER",          0, MARC_AUTHORITY },
+};
+#define NMODSNAMES ( sizeof( modsnames ) / sizeof( modsnames[0] ) )
+
 static void
-output_names( fields *f, FILE *outptr, int level )
-{
-	convert   names[] = {
-	  { "author",                              "AUTHOR",          0, MARC_AUTHORITY },
-	  { "editor",                              "EDITOR",          0, MARC_AUTHORITY },
-	  { "annotator",                           "ANNOTATOR",       0, MARC_AUTHORITY },
-	  { "artist",                              "ARTIST",          0, MARC_AUTHORITY },
-	  { "author",                              "2ND_AUTHOR",      0, MARC_AUTHORITY },
-	  { "author",                              "3RD_AUTHOR",      0, MARC_AUTHORITY },
-	  { "author",                              "SUB_AUTHOR",      0, MARC_AUTHORITY },
-	  { "author",                              "COMMITTEE",       0, MARC_AUTHORITY },
-	  { "author",                              "COURT",           0, MARC_AUTHORITY },
-	  { "author",                              "LEGISLATIVEBODY", 0, MARC_AUTHORITY },
-	  { "author of afterword, colophon, etc.", "AFTERAUTHOR",     0, MARC_AUTHORITY },
-	  { "author of introduction, etc.",        "INTROAUTHOR",     0, MARC_AUTHORITY },
-	  { "cartographer",                        "CARTOGRAPHER",    0, MARC_AUTHORITY },
-	  { "collaborator",                        "COLLABORATOR",    0, MARC_AUTHORITY },
-	  { "commentator",                         "COMMENTATOR",     0, MARC_AUTHORITY },
-	  { "compiler",                            "COMPILER",        0, MARC_AUTHORITY },
-	  { "degree grantor",                      "DEGREEGRANTOR",   0, MARC_AUTHORITY },
-	  { "director",                            "DIRECTOR",        0, MARC_AUTHORITY },
-	  { "event",                               "EVENT",           0, NO_AUTHORITY   },
-	  { "inventor",                            "INVENTOR",        0, MARC_AUTHORITY },
-	  { "organizer of meeting",                "ORGANIZER",       0, MARC_AUTHORITY },
-	  { "patent holder",                       "ASSIGNEE",        0, MARC_AUTHORITY },
-	  { "performer",                           "PERFORMER",       0, MARC_AUTHORITY },
-	  { "producer",                            "PRODUCER",        0, MARC_AUTHORITY },
-	  { "addressee",                           "ADDRESSEE",       0, MARC_AUTHORITY },
-	  { "redactor",                            "REDACTOR",        0, MARC_AUTHORITY },
-	  { "reporter",                            "REPORTER",        0, MARC_AUTHORITY },
-	  { "sponsor",                             "SPONSOR",         0, MARC_AUTHORITY },
-	  { "translator",                          "TRANSLATOR",      0, MARC_AUTHORITY },
-	  { "writer",                              "WRITER",          0, MARC_AUTHORITY },
-	};
-	int i, n, nfields, ntypes = sizeof( names ) / sizeof( convert );
-	int f_asis, f_corp, f_conf;
-	str role;
+output_names( modsfields *m, outsink *outptr, int level )
+{
+	fields *f = m->f;
+	int i, n;
 
-	str_init( &role );
-	nfields = fields_num( f );
-	for ( n=0; n<ntypes; ++n ) {
-		for ( i=0; i<nfields; ++i ) {
+	for ( n=0; n<NMODSNAMES; ++n ) {
+		for ( i=modsfields_first( m, modsnames[n].internal ); i!=-1; i=m->next[i] ) {
 			if ( fields_level( f, i )!=level ) continue;
 			if ( f->data[i].len==0 ) continue;
-			f_asis = f_corp = f_conf = 0;
-			str_strcpyc( &role, f->tag[i].data );
-			if ( str_findreplace( &role, ":ASIS", "" )) f_asis=1;
-			if ( str_findreplace( &role, ":CORP", "" )) f_corp=1;
-			if ( str_findreplace( &role, ":CONF", "" )) f_conf=1;
-			if ( strcasecmp( role.data, names[n].internal ) )
-				continue;
-			if ( f_asis ) {
+			if ( m->flags[i] & NAME_ASIS ) {
 				output_tag( outptr, lvl2indent(level),               "name",     NULL, TAG_OPEN,      TAG_NEWLINE, NULL );
 				output_fil( outptr, lvl2indent(incr_level(level,1)), "namePart", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
-			} else if ( f_corp ) {
+			} else if ( m->flags[i] & NAME_CORP ) {
 				output_tag( outptr, lvl2indent(level),               "name",     NULL, TAG_OPEN,      TAG_NEWLINE, "type", "corporate", NULL );
 				output_fil( outptr, lvl2indent(incr_level(level,1)), "namePart", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
-			} else if ( f_conf ) {
+			} else if ( m->flags[i] & NAME_CONF ) {
 				output_tag( outptr, lvl2indent(level),               "name",     NULL, TAG_OPEN,      TAG_NEWLINE, "type", "conference", NULL );
 				output_fil( outptr, lvl2indent(incr_level(level,1)), "namePart", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 			} else {
 				output_name(outptr, f->data[i].data, level);
 			}
 			output_tag( outptr, lvl2indent(incr_level(level,1)), "role", NULL, TAG_OPEN, TAG_NEWLINE, NULL );
-			if ( names[n].code & MARC_AUTHORITY )
-				output_tag( outptr, lvl2indent(incr_level(level,2)), "roleTerm", names[n].mods, TAG_OPENCLOSE, TAG_NEWLINE, "authority", "marcrelator", "type", "text", NULL );
+			if ( modsnames[n].code & MARC_AUTHORITY )
+				output_tag( outptr, lvl2indent(incr_level(level,2)), "roleTerm", modsnames[n].mods, TAG_OPENCLOSE, TAG_NEWLINE, "authority", "marcrelator", "type", "text", NULL );
 			else
-				output_tag( outptr, lvl2indent(incr_level(level,2)), "roleTerm", names[n].mods, TAG_OPENCLOSE, TAG_NEWLINE, "type", "text", NULL );
+				output_tag( outptr, lvl2indent(incr_level(level,2)), "roleTerm", modsnames[n].mods, TAG_OPENCLOSE, TAG_NEWLINE, "type", "text", NULL );
 			output_tag( outptr, lvl2indent(incr_level(level,1)), "role", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
 			output_tag( outptr, lvl2indent(level),               "name", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
 			fields_setused( f, i );
 		}
 	}
-	str_free( &role );
 }
 
 /* datepos[ NUM_DATE_TYPES ]
@@ -365,7 +701,7 @@ output_names( fields *f, FILE *outptr, int level )
 #define NUM_DATE_TYPES (4)
 
 static int
-find_datepos( fields *f, int level, unsigned char use_altnames, int datepos[NUM_DATE_TYPES] )
+find_datepos( modsfields *m, int level, unsigned char use_altnames, int datepos[NUM_DATE_TYPES] )
 {
 	char      *src_names[] = { "DATE:YEAR", "DATE:MONTH", "DATE:DAY", "DATE" };
 	char      *alt_names[] = { "PARTDATE:YEAR", "PARTDATE:MONTH", "PARTDATE:DAY", "PARTDATE" };
@@ -374,9 +710,9 @@ find_datepos( fields *f, int level, unsigned char use_altnames, int datepos[NUM_
 
 	for ( i=0; i<NUM_DATE_TYPES; ++i ) {
 		if ( !use_altnames )
-			datepos[i] = fields_find( f, src_names[i], level );
+			datepos[i] = modsfields_find( m, src_names[i], level );
 		else
-			datepos[i] = fields_find( f, alt_names[i], level );
+			datepos[i] = modsfields_find( m, alt_names[i], level );
 		if ( datepos[i]!=FIELDS_NOTFOUND ) found = 1;
 	}
 
@@ -393,57 +729,57 @@ find_datepos( fields *f, int level, unsigned char use_altnames, int datepos[NUM_
  *      returns 1 if date information found, 0 otherwise
  */
 static int
-find_dateinfo( fields *f, int level, int datepos[ NUM_DATE_TYPES ] )
+find_dateinfo( modsfields *m, int level, int datepos[ NUM_DATE_TYPES ] )
 {
 	int found;
 
 	/* default to finding date information for the current level */
-	found = find_datepos( f, level, 0, datepos );
+	found = find_datepos( m, level, 0, datepos );
 
 	/* for LEVEL_MAIN, do whatever it takes to find a date */
 	if ( !found && level == LEVEL_MAIN ) {
-		found = find_datepos( f, -1, 0, datepos );
+		found = find_datepos( m, -1, 0, datepos );
 	}
 	if ( !found && level == LEVEL_MAIN ) {
-		found = find_datepos( f, -1, 1, datepos );
+		found = find_datepos( m, -1, 1, datepos );
 	}
 
 	return found;
 }
 
 static void
-output_datepieces( fields *f, FILE *outptr, int pos[ NUM_DATE_TYPES ] )
+output_datepieces( fields *f, outsink *outptr, int pos[ NUM_DATE_TYPES ] )
 {
 	str *s;
 	int i;
 
 	for ( i=0; i<3 && pos[i]!=-1; ++i ) {
-		if ( i>0 ) fprintf( outptr, "-" );
+		if ( i>0 ) outsink_puts( outptr, "-" );
 		/* zero pad month or days written as "1", "2", "3" ... */
 		if ( i==DATE_MONTH || i==DATE_DAY ) {
 			s = fields_value( f, pos[i], FIELDS_STRP_NOUSE );
 			if ( s->len==1 ) {
-				fprintf( outptr, "0" );
+				outsink_puts( outptr, "0" );
 			}
 		}
-		fprintf( outptr, "%s", (char *) fields_value( f, pos[i], FIELDS_CHRP ) );
+		outsink_puts( outptr, (char *) fields_value( f, pos[i], FIELDS_CHRP ) );
 	}
 }
 
 static void
-output_dateissued( fields *f, FILE *outptr, int level, int pos[ NUM_DATE_TYPES ] )
+output_dateissued( fields *f, outsink *outptr, int level, int pos[ NUM_DATE_TYPES ] )
 {
 	output_tag( outptr, lvl2indent(incr_level(level,1)), "dateIssued", NULL, TAG_OPEN, TAG_NONEWLINE, NULL );
 	if ( pos[ DATE_YEAR ]!=-1 || pos[ DATE_MONTH ]!=-1 || pos[ DATE_DAY ]!=-1 ) {
 		output_datepieces( f, outptr, pos );
 	} else {
-		fprintf( outptr, "%s", (char *) fields_value( f, pos[ DATE_ALL ], FIELDS_CHRP ) );
+		outsink_puts( outptr, (char *) fields_value( f, pos[ DATE_ALL ], FIELDS_CHRP ) );
 	}
-	fprintf( outptr, "</dateIssued>\n" );
+	outsink_puts( outptr, "</dateIssued>\n" );
 }
 
 static void
-output_origin( fields *f, FILE *outptr, int level )
+output_origin( modsfields *m, outsink *outptr, int level )
 {
 	convert parts[] = {
 		{ "issuance",	  "ISSUANCE",      0, 0 },
@@ -455,9 +791,10 @@ output_origin( fields *f, FILE *outptr, int level )
 	};
 	int nparts = sizeof( parts ) / sizeof( parts[0] );
 	int i, found, datefound, datepos[ NUM_DATE_TYPES ];
+	fields *f = m->f;
 
-	found     = convert_findallfields( f, parts, nparts, level );
-	datefound = find_dateinfo( f, level, datepos );
+	found     = convert_findallfields( m, parts, nparts, level );
+	datefound = find_dateinfo( m, level, datepos );
 	if ( !found && !datefound ) return;
 
 
@@ -509,7 +846,7 @@ output_origin( fields *f, FILE *outptr, int level )
  *
  */
 static void
-output_language_core( fields *f, int n, FILE *outptr, char *tag, int level )
+output_language_core( fields *f, int n, outsink *outptr, char *tag, int level )
 {
 	char *lang, *code;
 
@@ -525,23 +862,23 @@ output_language_core( fields *f, int n, FILE *outptr, char *tag, int level )
 }
 
 static void
-output_language( fields *f, FILE *outptr, int level )
+output_language( modsfields *m, outsink *outptr, int level )
 {
 	int n;
-	n = fields_find( f, "LANGUAGE", level );
+	n = modsfields_find( m, "LANGUAGE", level );
 	if ( n!=FIELDS_NOTFOUND )
-		output_language_core( f, n, outptr, "language", level );
+		output_language_core( m->f, n, outptr, "language", level );
 }
 
 static void
-output_description( fields *f, FILE *outptr, int level )
+output_description( modsfields *m, outsink *outptr, int level )
 {
 	char *val;
 	int n;
 
-	n = fields_find( f, "DESCRIPTION", level );
+	n = modsfields_find( m, "DESCRIPTION", level );
 	if ( n!=FIELDS_NOTFOUND ) {
-		val = ( char * ) fields_value( f, n, FIELDS_CHRP );
+		val = ( char * ) fields_value( m->f, n, FIELDS_CHRP );
 		output_tag( outptr, lvl2indent(level),               "physicalDescription", NULL, TAG_OPEN,      TAG_NEWLINE, NULL );
 		output_tag( outptr, lvl2indent(incr_level(level,1)), "note",                val,  TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 		output_tag( outptr, lvl2indent(level),               "physicalDescription", NULL, TAG_CLOSE,     TAG_NEWLINE, NULL );
@@ -549,14 +886,14 @@ output_description( fields *f, FILE *outptr, int level )
 }
 
 static void
-output_toc( fields *f, FILE *outptr, int level )
+output_toc( modsfields *m, outsink *outptr, int level )
 {
 	char *val;
 	int n;
 
-	n = fields_find( f, "CONTENTS", level );
+	n = modsfields_find( m, "CONTENTS", level );
 	if ( n!=FIELDS_NOTFOUND ) {
-		val = (char *) fields_value( f, n, FIELDS_CHRP );
+		val = (char *) fields_value( m->f, n, FIELDS_CHRP );
 		output_tag( outptr, lvl2indent(level), "tableOfContents", val, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 	}
 }
@@ -568,7 +905,7 @@ output_toc( fields *f, FILE *outptr, int level )
  * <detail type="volume"><number>xxx</number></detail
  */
 static void
-mods_output_detail( fields *f, FILE *outptr, int n, char *item_name, int level )
+mods_output_detail( fields *f, outsink *outptr, int n, char *item_name, int level )
 {
 	if ( n!=-1 ) {
 		output_tag( outptr, lvl2indent(incr_level(level,1)), "detail", NULL,  TAG_OPEN,      TAG_NONEWLINE, "type", item_name, NULL );
@@ -586,7 +923,7 @@ mods_output_detail( fields *f, FILE *outptr, int n, char *item_name, int level )
  * </extent>
  */
 static void
-mods_output_extents( fields *f, FILE *outptr, int start, int end, int total, char *extype, int level )
+mods_output_extents( fields *f, outsink *outptr, int start, int end, int total, char *extype, int level )
 {
 	char *val;
 
@@ -607,14 +944,14 @@ mods_output_extents( fields *f, FILE *outptr, int start, int end, int total, cha
 }
 
 static void
-try_output_partheader( FILE *outptr, int wrote_header, int level )
+try_output_partheader( outsink *outptr, int wrote_header, int level )
 {
 	if ( !wrote_header )
 		output_tag( outptr, lvl2indent(level), "part", NULL, TAG_OPEN, TAG_NEWLINE, NULL );
 }
 
 static void
-try_output_partfooter( FILE *outptr, int wrote_header, int level )
+try_output_partfooter( outsink *outptr, int wrote_header, int level )
 {
 	if ( wrote_header )
 		output_tag( outptr, lvl2indent(level), "part", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
@@ -626,7 +963,7 @@ try_output_partfooter( FILE *outptr, int wrote_header, int level )
  *
  */
 static int
-output_partdate( fields *f, FILE *outptr, int level, int wrote_header )
+output_partdate( modsfields *m, outsink *outptr, int level, int wrote_header )
 {
 	convert parts[] = {
 		{ "",	"PARTDATE:YEAR",           0, 0 },
@@ -634,34 +971,35 @@ output_partdate( fields *f, FILE *outptr, int level, int wrote_header )
 		{ "",	"PARTDATE:DAY",            0, 0 },
 	};
 	int nparts = sizeof(parts)/sizeof(parts[0]);
+	fields *f = m->f;
 
-	if ( !convert_findallfields( f, parts, nparts, level ) ) return 0;
+	if ( !convert_findallfields( m, parts, nparts, level ) ) return 0;
 
 	try_output_partheader( outptr, wrote_header, level );
 
 	output_tag( outptr, lvl2indent(incr_level(level,1)), "date", NULL, TAG_OPEN, TAG_NONEWLINE, NULL );
 
 	if ( parts[0].pos!=-1 ) {
-		fprintf( outptr, "%s", (char *) fields_value( f, parts[0].pos, FIELDS_CHRP ) );
-	} else fprintf( outptr, "XXXX" );
+		outsink_puts( outptr, (char *) fields_value( f, parts[0].pos, FIELDS_CHRP ) );
+	} else outsink_puts( outptr, "XXXX" );
 
 	if ( parts[1].pos!=-1 ) {
-		fprintf( outptr, "-%s", (char *) fields_value( f, parts[1].pos, FIELDS_CHRP ) );
+		outsink_printf( outptr, "-%s", (char *) fields_value( f, parts[1].pos, FIELDS_CHRP ) );
 	}
 
 	if ( parts[2].pos!=-1 ) {
 		if ( parts[1].pos==-1 )
-			fprintf( outptr, "-XX" );
-		fprintf( outptr, "-%s", (char *) fields_value( f, parts[2].pos, FIELDS_CHRP ) );
+			outsink_puts( outptr, "-XX" );
+		outsink_printf( outptr, "-%s", (char *) fields_value( f, parts[2].pos, FIELDS_CHRP ) );
 	}
 
-	fprintf( outptr,"</date>\n");
+	outsink_puts( outptr,"</date>\n");
 
 	return 1;
 }
 
 static int
-output_partpages( fields *f, FILE *outptr, int level, int wrote_header )
+output_partpages( modsfields *m, outsink *outptr, int level, int wrote_header )
 {
 	convert parts[] = {
 		{ "",  "PAGES:START",              0, 0 },
@@ -670,8 +1008,9 @@ output_partpages( fields *f, FILE *outptr, int level, int wrote_header )
 		{ "",  "PAGES:TOTAL",              0, 0 }
 	};
 	int nparts = sizeof(parts)/sizeof(parts[0]);
+	fields *f = m->f;
 
-	if ( !convert_findallfields( f, parts, nparts, level ) ) return 0;
+	if ( !convert_findallfields( m, parts, nparts, level ) ) return 0;
 
 	try_output_partheader( outptr, wrote_header, level );
 
@@ -694,58 +1033,70 @@ output_partpages( fields *f, FILE *outptr, int level, int wrote_header )
 	return 1;
 }
 
+/* <detail> types in the order written; modsin_detail() reads each
+ * back under its type in upper case */
+static const struct {
+	char *internal;
+	char *mods;
+} modsdetails[] = {
+	{ "VOLUME",          "volume"          },
+	{ "SECTION",         "section"         },
+	{ "ISSUE",           "issue"           },
+	{ "NUMBER",          "number"          },
+	{ "PUBLICLAWNUMBER", "publiclawnumber" },
+	{ "SESSION",         "session"         },
+	{ "ARTICLENUMBER",   "articlenumber"   },
+	{ "PART",            "part"            },
+	{ "CHAPTER",         "chapter"         },
+	{ "REPORTNUMBER",    "report number"   },
+};
+#define NMODSDETAILS ( sizeof( modsdetails ) / sizeof( modsdetails[0] ) )
+
 static int
-output_partelement( fields *f, FILE *outptr, int level, int wrote_header )
+output_partelement( modsfields *m, outsink *outptr, int level, int wrote_header )
 {
-	convert parts[] = {
-		{ "",                "NUMVOLUMES",      0, 0 },
-		{ "volume",          "VOLUME",          0, 0 },
-		{ "section",         "SECTION",         0, 0 },
-		{ "issue",           "ISSUE",           0, 0 },
-		{ "number",          "NUMBER",          0, 0 },
-		{ "publiclawnumber", "PUBLICLAWNUMBER", 0, 0 },
-		{ "session",         "SESSION",         0, 0 },
-		{ "articlenumber",   "ARTICLENUMBER",   0, 0 },
-		{ "part",            "PART",            0, 0 },
-		{ "chapter",         "CHAPTER",         0, 0 },
-		{ "report number",   "REPORTNUMBER",    0, 0 },
-	};
-	int i, nparts = sizeof( parts ) / sizeof( convert );
-
-	if ( !convert_findallfields( f, parts, nparts, level ) ) return 0;
+	int i, found, numvolumes, pos[ NMODSDETAILS ];
+	fields *f = m->f;
+
+	numvolumes = modsfields_find( m, "NUMVOLUMES", level );
+	found = ( numvolumes!=FIELDS_NOTFOUND );
+	for ( i=0; i<NMODSDETAILS; ++i ) {
+		pos[i] = modsfields_find( m, modsdetails[i].internal, level );
+		found += ( pos[i]!=FIELDS_NOTFOUND );
+	}
+	if ( !found ) return 0;
 
 	try_output_partheader( outptr, wrote_header, level );
 
-	/* start loop at 1 to skip NUMVOLUMES */
-	for ( i=1; i<nparts; ++i ) {
-		if ( parts[i].pos==-1 ) continue;
-		mods_output_detail( f, outptr, parts[i].pos, parts[i].mods, level );
+	for ( i=0; i<NMODSDETAILS; ++i ) {
+		if ( pos[i]==-1 ) continue;
+		mods_output_detail( f, outptr, pos[i], modsdetails[i].mods, level );
 	}
 
-	if ( parts[0].pos!=-1 )
-		mods_output_extents( f, outptr, -1, -1, parts[0].pos, "volumes", level );
+	if ( numvolumes!=-1 )
+		mods_output_extents( f, outptr, -1, -1, numvolumes, "volumes", level );
 
 	return 1;
 }
 
 static void
-output_part( fields *f, FILE *outptr, int level )
+output_part( modsfields *m, outsink *outptr, int level )
 {
 	int wrote_hdr;
-	wrote_hdr  = output_partdate( f, outptr, level, 0 );
-	wrote_hdr += output_partelement( f, outptr, level, wrote_hdr );
-	wrote_hdr += output_partpages( f, outptr, level, wrote_hdr );
+	wrote_hdr  = output_partdate( m, outptr, level, 0 );
+	wrote_hdr += output_partelement( m, outptr, level, wrote_hdr );
+	wrote_hdr += output_partpages( m, outptr, level, wrote_hdr );
 	try_output_partfooter( outptr, wrote_hdr, level );
 }
 
 static void
-output_recordInfo( fields *f, FILE *outptr, int level )
+output_recordInfo( modsfields *m, outsink *outptr, int level )
 {
 	int n;
-	n = fields_find( f, "LANGCATALOG", level );
+	n = modsfields_find( m, "LANGCATALOG", level );
 	if ( n!=FIELDS_NOTFOUND ) {
 		output_tag( outptr, lvl2indent(level), "recordInfo", NULL, TAG_OPEN, TAG_NEWLINE, NULL );
-		output_language_core( f, n, outptr, "languageOfCataloging", incr_level(level,1) );
+		output_language_core( m->f, n, outptr, "languageOfCataloging", incr_level(level,1) );
 		output_tag( outptr, lvl2indent(level), "recordInfo", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
 	}
 }
@@ -756,13 +1107,13 @@ output_recordInfo( fields *f, FILE *outptr, int level )
  * <genre authority="bibutilsgt">Diploma thesis</genre>
  */
 static void
-output_genre( fields *f, FILE *outptr, int level )
+output_genre( modsfields *m, outsink *outptr, int level )
 {
 	char *value, *attr = NULL, *attrvalue = NULL;
-	int i, n;
+	fields *f = m->f;
+	int i;
 
-	n = fields_num( f );
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "GENRE:MARC" ); i!=-1; i=m->next[i] ) {
 		if ( fields_level( f, i ) != level ) continue;
 		if ( !fields_match_tag( f, i, "GENRE:MARC" ) && !fields_match_tag( f, i, "GENRE:BIBUTILS" ) && !fields_match_tag( f, i, "GENRE:UNKNOWN" ) ) continue;
 		value = fields_value( f, i, FIELDS_CHRP );
@@ -783,12 +1134,13 @@ output_genre( fields *f, FILE *outptr, int level )
  * <typeOfResource>text</typeOfResource>
  */
 static void
-output_resource( fields *f, FILE *outptr, int level )
+output_resource( modsfields *m, outsink *outptr, int level )
 {
+	fields *f = m->f;
 	char *value;
 	int n;
 
-	n = fields_find( f, "RESOURCE", level );
+	n = modsfields_find( m, "RESOURCE", level );
 	if ( n!=FIELDS_NOTFOUND ) {
 		value = fields_value( f, n, FIELDS_CHRP );
 		if ( is_marc_resource( value ) ) {
@@ -800,16 +1152,16 @@ output_resource( fields *f, FILE *outptr, int level )
 }
 
 static void
-output_type( fields *f, FILE *outptr, int level )
+output_type( modsfields *m, outsink *outptr, int level )
 {
 	int n;
 
 	/* silence warnings about INTERNAL_TYPE being unused */
-	n = fields_find( f, "INTERNAL_TYPE", LEVEL_MAIN );
-	if ( n!=FIELDS_NOTFOUND ) fields_setused( f, n );
+	n = modsfields_find( m, "INTERNAL_TYPE", LEVEL_MAIN );
+	if ( n!=FIELDS_NOTFOUND ) fields_setused( m->f, n );
 
-	output_resource( f, outptr, level );
-	output_genre( f, outptr, level );
+	output_resource( m, outptr, level );
+	output_genre( m, outptr, level );
 }
 
 /* output_abs()
@@ -817,38 +1169,53 @@ output_type( fields *f, FILE *outptr, int level )
  * <abstract>xxxx</abstract>
  */
 static void
-output_abs( fields *f, FILE *outptr, int level )
+output_abs( modsfields *m, outsink *outptr, int level )
+{
+	int n;
+
+	n = modsfields_find( m, "ABSTRACT", level );
+	output_fil( outptr, lvl2indent(level), "abstract", m->f, n, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
+}
+
+/* the tags on the NOTES list, with the tag modsin reads each back as */
+static const struct {
+	char *internal;
+	char *mods;
+	char *type;
+	char *back;
+} modsnotes[] = {
+	{ "NOTES",      "note",          NULL,                 "NOTES"  },
+	{ "PUBSTATE",   "note",          "publication status", "NOTES"  },
+	{ "ANNOTE",     "bibtex-annote", NULL,                 "ANNOTE" },
+	{ "TIMESCITED", "note",          "times cited",        "NOTES"  },
+	{ "ANNOTATION", "note",          "annotation",         "NOTES"  },
+	{ "ADDENDUM",   "note",          "addendum",           "NOTES"  },
+	{ "BIBKEY",     "note",          "bibliography key",   "NOTES"  },
+};
+#define NMODSNOTES ( sizeof( modsnotes ) / sizeof( modsnotes[0] ) )
+
+static int
+modsnotes_lookup( const char *tag )
 {
 	int n;
 
-	n = fields_find( f, "ABSTRACT", level );
-	output_fil( outptr, lvl2indent(level), "abstract", f, n, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
+	for ( n=0; n<NMODSNOTES; ++n )
+		if ( !strcasecmp( tag, modsnotes[n].internal ) ) return n;
+
+	return -1;
 }
 
 static void
-output_notes( fields *f, FILE *outptr, int level )
+output_notes( modsfields *m, outsink *outptr, int level )
 {
+	fields *f = m->f;
 	int i, n;
-	char *t;
 
-	n = fields_num( f );
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "NOTES" ); i!=-1; i=m->next[i] ) {
 		if ( fields_level( f, i ) != level ) continue;
-		t = fields_tag( f, i, FIELDS_CHRP_NOUSE );
-		if ( !strcasecmp( t, "NOTES" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
-		else if ( !strcasecmp( t, "PUBSTATE" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "publication status", NULL );
-		else if ( !strcasecmp( t, "ANNOTE" ) )
-			output_fil( outptr, lvl2indent(level), "bibtex-annote", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
-		else if ( !strcasecmp( t, "TIMESCITED" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "times cited", NULL );
-		else if ( !strcasecmp( t, "ANNOTATION" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "annotation", NULL );
-		else if ( !strcasecmp( t, "ADDENDUM" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "addendum", NULL );
-		else if ( !strcasecmp( t, "BIBKEY" ) )
-			output_fil( outptr, lvl2indent(level), "note", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "bibliography key", NULL );
+		n = modsnotes_lookup( fields_tag( f, i, FIELDS_CHRP_NOUSE ) );
+		if ( n==-1 ) continue;
+		output_fil( outptr, lvl2indent(level), modsnotes[n].mods, f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", modsnotes[n].type, NULL );
 	}
 }
 
@@ -859,12 +1226,12 @@ output_notes( fields *f, FILE *outptr, int level )
  * </subject>
  */
 static void
-output_key( fields *f, FILE *outptr, int level )
+output_key( modsfields *m, outsink *outptr, int level )
 {
-	int i, n;
+	fields *f = m->f;
+	int i;
 
-	n = fields_num( f );
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "KEYWORD" ); i!=-1; i=m->next[i] ) {
 		if ( fields_level( f, i ) != level ) continue;
 		if ( !strcasecmp( f->tag[i].data, "KEYWORD" ) ) {
 			output_tag( outptr, lvl2indent(level),               "subject", NULL, TAG_OPEN,      TAG_NEWLINE, NULL );
@@ -879,48 +1246,54 @@ output_key( fields *f, FILE *outptr, int level )
 	}
 }
 
+/* <identifier> types in the order written, with the tag modsin_identifier()
+ * reads each back as; NULL if it doesn't */
+static const struct {
+	char *internal;
+	char *mods;
+	char *back;
+} modsids[] = {
+	{ "ISBN",       "isbn",       "ISBN"      },
+	{ "ISBN13",     "isbn",       "ISBN"      },
+	{ "LCCN",       "lccn",       NULL        },
+	{ "ISSN",       "issn",       "ISSN"      },
+	{ "CODEN",      "coden",      "CODEN"     },
+	{ "REFNUM",     "citekey",    "REFNUM"    },
+	{ "DOI",        "doi",        "DOI"       },
+	{ "EID",        "eid",        NULL        },
+	{ "EPRINT",     "eprint",     NULL        },
+	{ "EPRINTTYPE", "eprinttype", NULL        },
+	{ "PMID",       "pubmed",     "PMID"      },
+	{ "MRNUMBER",   "MRnumber",   "MRNUMBER"  },
+	{ "MEDLINE",    "medline",    "MEDLINE"   },
+	{ "PII",        "pii",        "PII"       },
+	{ "PMC",        "pmc",        "PMC"       },
+	{ "ARXIV",      "arXiv",      "ARXIV"     },
+	{ "ISIREFNUM",  "isi",        "ISIREFNUM" },
+	{ "ACCESSNUM",  "accessnum",  "ACCESSNUM" },
+	{ "JSTOR",      "jstor",      "JSTOR"     },
+	{ "ISRN",       "isrn",       NULL        },
+};
+#define NMODSIDS ( sizeof( modsids ) / sizeof( modsids[0] ) )
+
 static void
-output_sn( fields *f, FILE *outptr, int level )
-{
-	convert sn_types[] = {
-		{ "isbn",      "ISBN",      0, 0 },
-		{ "isbn",      "ISBN13",    0, 0 },
-		{ "lccn",      "LCCN",      0, 0 },
-		{ "issn",      "ISSN",      0, 0 },
-		{ "coden",     "CODEN",     0, 0 },
-		{ "citekey",   "REFNUM",    0, 0 },
-		{ "doi",       "DOI",       0, 0 },
-		{ "eid",       "EID",       0, 0 },
-		{ "eprint",    "EPRINT",    0, 0 },
-		{ "eprinttype","EPRINTTYPE",0, 0 },
-		{ "pubmed",    "PMID",      0, 0 },
-		{ "MRnumber",  "MRNUMBER",  0, 0 },
-		{ "medline",   "MEDLINE",   0, 0 },
-		{ "pii",       "PII",       0, 0 },
-		{ "pmc",       "PMC",       0, 0 },
-		{ "arXiv",     "ARXIV",     0, 0 },
-		{ "isi",       "ISIREFNUM", 0, 0 },
-		{ "accessnum", "ACCESSNUM", 0, 0 },
-		{ "jstor",     "JSTOR",     0, 0 },
-		{ "isrn",      "ISRN",      0, 0 },
-	};
-	int ntypes = sizeof( sn_types ) / sizeof( sn_types[0] );
+output_sn( modsfields *m, outsink *outptr, int level )
+{
+	fields *f = m->f;
 	int i, n;
 
 	/* output call number */
-	n = fields_find( f, "CALLNUMBER", level );
+	n = modsfields_find( m, "CALLNUMBER", level );
 	output_fil( outptr, lvl2indent(level), "classification", f, n, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 
 	/* output specialized serialnumber */
-	convert_findallfields( f, sn_types, ntypes, level );
-	for ( i=0; i<ntypes; ++i ) {
-		if ( sn_types[i].pos==-1 ) continue;
-		output_fil( outptr, lvl2indent(level), "identifier", f, sn_types[i].pos, TAG_OPENCLOSE, TAG_NEWLINE, "type", sn_types[i].mods, NULL );
+	for ( i=0; i<NMODSIDS; ++i ) {
+		n = modsfields_find( m, modsids[i].internal, level );
+		output_fil( outptr, lvl2indent(level), "identifier", f, n, TAG_OPENCLOSE, TAG_NEWLINE, "type", modsids[i].mods, NULL );
 	}
 
 	/* output _all_ elements of type SERIALNUMBER */
-	n = fields_num( f );
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "SERIALNUMBER" ); i!=-1; i=m->next[i] ) {
 		if ( f->level[i]!=level ) continue;
 		if ( strcasecmp( f->tag[i].data, "SERIALNUMBER" ) ) continue;
 		output_fil( outptr, lvl2indent(level), "identifier", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "type", "serial number", NULL );
@@ -937,32 +1310,29 @@ output_sn( fields *f, FILE *outptr, int level )
  * </location>
  */
 static void
-output_url( fields *f, FILE *outptr, int level )
+output_url( modsfields *m, outsink *outptr, int level )
 {
-	int location   = fields_find( f, "LOCATION",   level );
-	int url        = fields_find( f, "URL",        level );
-	int fileattach = fields_find( f, "FILEATTACH", level );
-	int pdflink    = fields_find( f, "PDFLINK",    level );
-	int i, n;
+	fields *f      = m->f;
+	int location   = modsfields_find( m, "LOCATION",   level );
+	int url        = modsfields_find( m, "URL",        level );
+	int fileattach = modsfields_find( m, "FILEATTACH", level );
+	int pdflink    = modsfields_find( m, "PDFLINK",    level );
+	int i;
 
 	if ( url==FIELDS_NOTFOUND && location==FIELDS_NOTFOUND && pdflink==FIELDS_NOTFOUND && fileattach==FIELDS_NOTFOUND ) return;
 	output_tag( outptr, lvl2indent(level), "location", NULL, TAG_OPEN, TAG_NEWLINE, NULL );
 
-	n = fields_num( f );
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "URL" ); i!=-1; i=m->next[i] ) {
 		if ( f->level[i]!=level ) continue;
-		if ( strcasecmp( f->tag[i].data, "URL" ) ) continue;
 		output_fil( outptr, lvl2indent(incr_level(level,1)), "url", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 	}
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "PDFLINK" ); i!=-1; i=m->next[i] ) {
 		if ( f->level[i]!=level ) continue;
-		if ( strcasecmp( f->tag[i].data, "PDFLINK" ) ) continue;
 /*		output_fil( outptr, lvl2indent(incr_level(level,1)), "url", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "urlType", "pdf", NULL ); */
 		output_fil( outptr, lvl2indent(incr_level(level,1)), "url", f, i, TAG_OPENCLOSE, TAG_NEWLINE, NULL );
 	}
-	for ( i=0; i<n; ++i ) {
+	for ( i=modsfields_first( m, "FILEATTACH" ); i!=-1; i=m->next[i] ) {
 		if ( f->level[i]!=level ) continue;
-		if ( strcasecmp( f->tag[i].data, "FILEATTACH" ) ) continue;
 		output_fil( outptr, lvl2indent(incr_level(level,1)), "url", f, i, TAG_OPENCLOSE, TAG_NEWLINE, "displayLabel", "Electronic full text", "access", "raw object", NULL );
 	}
 	if ( location!=-1 )
@@ -973,85 +1343,131 @@ output_url( fields *f, FILE *outptr, int level )
 
 /* refnum should start with a non-number and not include spaces -- ignore this */
 static void
-output_refnum( fields *f, int n, FILE *outptr )
+output_refnum( fields *f, int n, outsink *outptr )
 {
 	char *p = fields_value( f, n, FIELDS_CHRP_NOUSE );
 /*	if ( p && ((*p>='0' && *p<='9') || *p=='-' || *p=='_' ))
-		fprintf( outptr, "ref" );*/
+		outsink_puts( outptr, "ref" );*/
 	while ( p && *p ) {
-		if ( !is_ws(*p) ) fprintf( outptr, "%c", *p );
+		if ( !is_ws(*p) ) outsink_putc( outptr, *p );
 /*		if ( (*p>='A' && *p<='Z') ||
 		     (*p>='a' && *p<='z') ||
 		     (*p>='0' && *p<='9') ||
 		     (*p=='-') || (*p=='
-		     (*p=='_') ) fprintf( outptr, "%c", *p );*/
+		     (*p=='_') ) outsink_putc( outptr, *p );*/
 		p++;
 	}
 }
 
 static void
-output_head( fields *f, FILE *outptr, int dropkey, unsigned long numrefs )
+output_head( modsfields *m, outsink *outptr, int dropkey, unsigned long numrefs )
 {
 	int n;
-	fprintf( outptr, "<mods");
+	outsink_puts( outptr, "<mods");
 	if ( !dropkey ) {
-		n = fields_find( f, "REFNUM", LEVEL_MAIN );
+		n = modsfields_find( m, "REFNUM", LEVEL_MAIN );
 		if ( n!=FIELDS_NOTFOUND ) {
-			fprintf( outptr, " ID=\"");
-			output_refnum( f, n, outptr );
-			fprintf( outptr, "\"");
+			outsink_puts( outptr, " ID=\"");
+			output_refnum( m->f, n, outptr );
+			outsink_puts( outptr, "\"");
 		}
 	}
-	fprintf( outptr, ">\n" );
+	outsink_puts( outptr, ">\n" );
 }
 
 static int
-original_items( fields *f, int level )
+original_items( modsfields *m, int level )
 {
 	int i, targetlevel, n;
 	if ( level < 0 ) return 0;
 	targetlevel = -( level + 2 );
-	n = fields_num( f );
+	if ( m->nlevels!=-1 ) {
+		for ( i=0; i<m->nlevels; ++i ) {
+			if ( m->levels[i] == targetlevel )
+				return targetlevel;
+		}
+		return 0;
+	}
+	n = fields_num( m->f );
 	for ( i=0; i<n; ++i ) {
-		if ( fields_level( f, i ) == targetlevel )
+		if ( fields_level( m->f, i ) == targetlevel )
 			return targetlevel;
 	}
 	return 0;
 }
 
+/* modssections
+ *
+ *       The parts of a reference in the order output_citeparts()
+ *       writes them, and how modsout_normalize() reworks the fields
+ *       of each: either with its own routine, or by keeping the
+ *       listed tags (and the tags on their lists), only the first
+ *       per level of those written once. An entry with no output
+ *       routine stands for the host and original relatedItems.
+ */
+typedef struct modsrt {
+	char *tag;
+	int  once;    /* only the first per level is written */
+} modsrt;
+
+#define MODSRT_MAX (4)
+
+typedef struct modssection {
+	void   (*output)( modsfields *m, outsink *outptr, int level );
+	int    (*normalize)( fields *f, fields *out, int level );
+	modsrt tags[ MODSRT_MAX ];
+} modssection;
+
+static int normalize_names( fields *f, fields *out, int level );
+static int normalize_origin( fields *f, fields *out, int level );
+static int normalize_notes( fields *f, fields *out, int level );
+static int normalize_sn( fields *f, fields *out, int level );
+static int normalize_part( fields *f, fields *out, int level );
+
+static const modssection modssections[] = {
+	{ output_title,       NULL,             { { "TITLE", 1 }, { "SUBTITLE", 1 }, { "SHORTTITLE", 1 } } },
+	{ output_names,       normalize_names,  { { NULL } } },
+	{ output_origin,      normalize_origin, { { NULL } } },
+	{ output_type,        NULL,             { { "RESOURCE", 1 }, { "GENRE:MARC", 0 } } },
+	{ output_language,    NULL,             { { "LANGUAGE", 1 } } },
+	{ output_description, NULL,             { { "DESCRIPTION", 1 } } },
+	{ NULL,               NULL,             { { NULL } } },
+	{ output_abs,         NULL,             { { "ABSTRACT", 1 } } },
+	{ output_notes,       normalize_notes,  { { NULL } } },
+	{ output_toc,         NULL,             { { "CONTENTS", 1 } } },
+	{ output_key,         NULL,             { { "KEYWORD", 0 } } },
+	{ output_sn,          normalize_sn,     { { NULL } } },
+	{ output_url,         NULL,             { { "URL", 0 }, { "PDFLINK", 0 }, { "FILEATTACH", 0 }, { "LOCATION", 1 } } },
+	{ output_part,        normalize_part,   { { NULL } } },
+	{ output_recordInfo,  NULL,             { { NULL } } },
+};
+#define NMODSSECTIONS ( sizeof( modssections ) / sizeof( modssections[0] ) )
+
 static void
-output_citeparts( fields *f, FILE *outptr, int level, int max )
+output_citeparts( modsfields *m, outsink *outptr, int level, int max )
 {
-	int orig_level;
+	int i, orig_level;
 
-	output_title(       f, outptr, level );
-	output_names(       f, outptr, level );
-	output_origin(      f, outptr, level );
-	output_type(        f, outptr, level );
-	output_language(    f, outptr, level );
-	output_description( f, outptr, level );
+	for ( i=0; i<NMODSSECTIONS; ++i ) {
 
-	if ( level >= 0 && level < max ) {
-		output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_OPEN,  TAG_NEWLINE, "type", "host", NULL );
-		output_citeparts( f, outptr, incr_level(level,1), max );
-		output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
-	}
-	/* Look for original item things */
-	orig_level = original_items( f, level );
-	if ( orig_level ) {
-		output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_OPEN,  TAG_NEWLINE, "type", "original", NULL );
-		output_citeparts( f, outptr, orig_level, max );
-		output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
-	}
-	output_abs(        f, outptr, level );
-	output_notes(      f, outptr, level );
-	output_toc(        f, outptr, level );
-	output_key(        f, outptr, level );
-	output_sn(         f, outptr, level );
-	output_url(        f, outptr, level );
-	output_part(       f, outptr, level );
+		if ( modssections[i].output ) {
+			modssections[i].output( m, outptr, level );
+			continue;
+		}
 
-	output_recordInfo( f, outptr, level );
+		if ( level >= 0 && level < max ) {
+			output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_OPEN,  TAG_NEWLINE, "type", "host", NULL );
+			output_citeparts( m, outptr, incr_level(level,1), max );
+			output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
+		}
+		/* Look for original item things */
+		orig_level = original_items( m, level );
+		if ( orig_level ) {
+			output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_OPEN,  TAG_NEWLINE, "type", "original", NULL );
+			output_citeparts( m, outptr, orig_level, max );
+			output_tag( outptr, lvl2indent(level), "relatedItem", NULL, TAG_CLOSE, TAG_NEWLINE, NULL );
+		}
+	}
 }
 
 static void
@@ -1112,35 +1528,527 @@ modsout_report_unused_tags( fields *f, param *p, unsigned long numrefs )
 }
 
 static int
-modsout_write( fields *f, FILE *outptr, param *p, unsigned long numrefs )
+modsout_write( fields *f, outsink *outptr, param *p, unsigned long numrefs )
 {
-	int max, dropkey;
+	int max, dropkey, status;
+	modsfields m;
+
+	status = modsfields_init( &m, f );
+	if ( status!=BIBL_OK ) return status;
+
 	max = fields_maxlevel( f );
 	dropkey = ( p->format_opts & BIBL_FORMAT_MODSOUT_DROPKEY );
 
-	output_head( f, outptr, dropkey, numrefs );
-	output_citeparts( f, outptr, 0, max );
+	output_head( &m, outptr, dropkey, numrefs );
+	output_citeparts( &m, outptr, 0, max );
 	modsout_report_unused_tags( f, p, numrefs );
 
-	fprintf( outptr, "</mods>\n" );
-	fflush( outptr );
+	outsink_puts( outptr, "</mods>\n" );
+
+	modsfields_free( &m );
+
+	return BIBL_OK;
+}
+
+/* modsout_normalize()
+ *
+ *       Rework a reference's fields into what writing them out here and
+ *       reading them back with modsin would give, so that a converter
+ *       handing one reader's fields straight to another writer produces
+ *       the same output as a pipe through MODS:
+ *
+ *       - tags that aren't written, or that modsin doesn't read back,
+ *         are dropped, and of tags written once per level only the
+ *         first survives
+ *       - tags that come back as another tag are renamed, and names
+ *         come back under the tag modsin gives their role
+ *       - "A." given names lose their period, as in output_name()
+ *       - dates come back as DATE:YEAR/MONTH/DAY, with the main level
+ *         borrowing one from another level as find_dateinfo() does
+ *       - genres are reclassified and unknown resource types dropped
+ *       - fields come back in the order written, which is what the
+ *         LEVEL_ANY lookups of the other writers see
+ *
+ *       This covers what the other writers look at; it isn't a full
+ *       model of MODS. What is written where comes from modssections
+ *       and the tables output_citeparts() writes from.
+ *
+ *       Returns BIBL_OK or BIBL_ERR_MEMERR.
+ */
+
+static int
+normalize_add( fields *out, char *tag, char *value, int level, int mode )
+{
+	int fstatus;
+	fstatus = _fields_add( out, tag, value, level, mode );
+	if ( fstatus!=FIELDS_OK ) return BIBL_ERR_MEMERR;
+	else return BIBL_OK;
+}
+
+/* the personal name as output_name() writes it and modsin_person()
+ * puts it back together */
+static int
+normalize_personal( str *name, char *p )
+{
+	str family, given, suffix;
+	slist parts;
+	int i, status;
+
+	strs_init( &family, &given, &suffix, NULL );
+	slist_init( &parts );
+
+	status = modsname_split( p, &family, &parts, &suffix );
+	if ( status!=BIBL_OK ) goto out;
+
+	for ( i=0; i<parts.n; ++i ) {
+		if ( i ) str_addchar( &given, '|' );
+		str_strcat( &given, slist_str( &parts, i ) );
+	}
+
+	str_empty( name );
+	if ( family.len ) {
+		str_strcpy( name, &family );
+		if ( given.len ) {
+			str_addchar( name, '|' );
+			str_strcat( name, &given );
+		}
+	} else if ( given.len ) {
+		if ( !name_parse( name, &given, NULL, NULL ) ) status = BIBL_ERR_MEMERR;
+	}
+
+	if ( suffix.len ) {
+		str_strcatc( name, "||" );
+		str_strcat( name, &suffix );
+	}
+
+	if ( str_memerr( name ) || str_memerr( &given ) ) status = BIBL_ERR_MEMERR;
+
+out:
+	strs_free( &family, &given, &suffix, NULL );
+	slist_free( &parts );
+	return status;
+}
+
+/* names in output_names() order, each under the tag modsin gives its
+ * role */
+static int
+normalize_names( fields *f, fields *out, int level )
+{
+	int i, n, list, status = BIBL_OK;
+	unsigned char flags;
+	str role, tag, name;
+	char *p;
+
+	strs_init( &role, &tag, &name, NULL );
+
+	for ( n=0; n<NMODSNAMES; ++n ) {
+
+		p = marc_convertrole( modsnames[n].mods );
+		if ( p ) str_strcpyc( &role, p );
+		else {
+			str_strcpyc( &role, modsnames[n].mods );
+			str_toupper( &role );
+		}
+
+		for ( i=0; i<f->n; ++i ) {
+			if ( f->level[i]!=level || f->data[i].len==0 ) continue;
+			list = modstag_lookup( f->tag[i].data );
+			flags = 0;
+			if ( list==-1 ) list = modstag_namelist( f->tag[i].data, &tag, &flags );
+			if ( list==-1 || strcasecmp( modstags[list].tag, modsnames[n].internal ) ) continue;
+
+			str_strcpy( &tag, &role );
+			if ( flags & NAME_CORP ) str_strcatc( &tag, ":CORP" );
+			else if ( flags ) str_strcatc( &tag, ":ASIS" );
+			if ( str_memerr( &tag ) ) { status = BIBL_ERR_MEMERR; goto out; }
+
+			if ( flags ) {
+				status = normalize_add( out, str_cstr( &tag ), f->data[i].data, level, FIELDS_NO_DUPS );
+			} else {
+				status = normalize_personal( &name, f->data[i].data );
+				if ( status!=BIBL_OK ) goto out;
+				status = normalize_add( out, str_cstr( &tag ), str_cstr( &name ), level, FIELDS_CAN_DUP );
+			}
+			if ( status!=BIBL_OK ) goto out;
+		}
+	}
+
+out:
+	strs_free( &role, &tag, &name, NULL );
+	return status;
+}
+
+/* a date written as "year-month-day", as modsin_date() reads it */
+static int
+normalize_splitdate( fields *out, str *date, char *tags[3], int level )
+{
+	int i, status = BIBL_OK;
+	char *p;
+	str s;
+
+	str_init( &s );
+
+	p = str_cstr( date );
+	for ( i=0; p && i<3; ++i ) {
+		if ( i<2 ) p = str_cpytodelim( &s, skip_ws( p ), "-", 1 );
+		else p = str_cpytodelim( &s, skip_ws( p ), "", 0 );
+		if ( str_memerr( &s ) ) { status = BIBL_ERR_MEMERR; break; }
+		if ( str_has_value( &s ) ) {
+			status = normalize_add( out, tags[i], str_cstr( &s ), level, FIELDS_NO_DUPS );
+			if ( status!=BIBL_OK ) break;
+		}
+	}
+
+	str_free( &s );
+	return status;
+}
+
+static int
+normalize_datepos( fields *f, char *names[], int level, int pos[ NUM_DATE_TYPES ] )
+{
+	int i, found = 0;
+
+	for ( i=0; i<NUM_DATE_TYPES; ++i ) {
+		pos[i] = fields_find( f, names[i], level );
+		if ( pos[i]!=FIELDS_NOTFOUND ) found = 1;
+	}
+
+	return found;
+}
+
+/* the date as output_dateissued() writes it */
+static int
+normalize_date( fields *f, fields *out, int level )
+{
+	char *src_names[] = { "DATE:YEAR", "DATE:MONTH", "DATE:DAY", "DATE" };
+	char *alt_names[] = { "PARTDATE:YEAR", "PARTDATE:MONTH", "PARTDATE:DAY", "PARTDATE" };
+	int i, found, pos[ NUM_DATE_TYPES ], status;
+	str date;
+
+	found = normalize_datepos( f, src_names, level, pos );
+	if ( !found && level==LEVEL_MAIN )
+		found = normalize_datepos( f, src_names, LEVEL_ANY, pos );
+	if ( !found && level==LEVEL_MAIN )
+		found = normalize_datepos( f, alt_names, LEVEL_ANY, pos );
+	if ( !found ) return BIBL_OK;
+
+	str_init( &date );
+
+	if ( pos[DATE_YEAR]!=-1 || pos[DATE_MONTH]!=-1 || pos[DATE_DAY]!=-1 ) {
+		for ( i=0; i<3 && pos[i]!=-1; ++i ) {
+			if ( i>0 ) str_addchar( &date, '-' );
+			if ( i>0 && f->data[ pos[i] ].len==1 ) str_addchar( &date, '0' );
+			str_strcat( &date, &(f->data[ pos[i] ]) );
+		}
+	} else {
+		str_strcpy( &date, &(f->data[ pos[DATE_ALL] ]) );
+	}
+
+	if ( str_memerr( &date ) ) status = BIBL_ERR_MEMERR;
+	else status = normalize_splitdate( out, &date, src_names, level );
+
+	str_free( &date );
+	return status;
+}
+
+/* modsin_origininfo() adds the date and place as it reads them and the
+ * rest once it is done */
+static int
+normalize_origin( fields *f, fields *out, int level )
+{
+	char *tags[] = { "ADDRESS", "PUBLISHER", "EDITION", "ISSUANCE" };
+	int i, n, ntags = sizeof( tags ) / sizeof( tags[0] ), status;
+
+	status = normalize_date( f, out, level );
+	if ( status!=BIBL_OK ) return status;
+
+	for ( i=0; i<ntags; ++i ) {
+		n = fields_find( f, tags[i], level );
+		if ( n==FIELDS_NOTFOUND ) continue;
+		status = normalize_add( out, tags[i], f->data[n].data, level, FIELDS_NO_DUPS );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	return BIBL_OK;
+}
+
+/* <part> as output_part() writes it */
+static int
+normalize_part( fields *f, fields *out, int level )
+{
+	char *dates[] = { "PARTDATE:YEAR", "PARTDATE:MONTH", "PARTDATE:DAY" };
+	char *pages[] = { "PAGES:START", "PAGES:STOP", "PAGES", "PAGES:TOTAL" };
+	int i, pos[4], status = BIBL_OK;
+	str date, type;
+
+	/* output_partdate() */
+	for ( i=0; i<3; ++i )
+		pos[i] = fields_find( f, dates[i], level );
+	if ( pos[0]!=-1 || pos[1]!=-1 || pos[2]!=-1 ) {
+		str_init( &date );
+		if ( pos[0]!=-1 ) str_strcpy( &date, &(f->data[ pos[0] ]) );
+		else str_strcpyc( &date, "XXXX" );
+		if ( pos[1]!=-1 ) {
+			str_addchar( &date, '-' );
+			str_strcat( &date, &(f->data[ pos[1] ]) );
+		}
+		if ( pos[2]!=-1 ) {
+			if ( pos[1]==-1 ) str_strcatc( &date, "-XX" );
+			str_addchar( &date, '-' );
+			str_strcat( &date, &(f->data[ pos[2] ]) );
+		}
+		if ( str_memerr( &date ) ) status = BIBL_ERR_MEMERR;
+		else status = normalize_splitdate( out, &date, dates, level );
+		str_free( &date );
+		if ( status!=BIBL_OK ) return status;
+	}
+
+	/* output_partelement(), as modsin_detail() names them */
+	str_init( &type );
+	for ( i=0; i<NMODSDETAILS; ++i ) {
+		pos[0] = fields_find( f, modsdetails[i].internal, level );
+		if ( pos[0]==FIELDS_NOTFOUND ) continue;
+		str_strcpyc( &type, modsdetails[i].mods );
+		str_toupper( &type );
+		if ( str_memerr( &type ) ) status = BIBL_ERR_MEMERR;
+		else status = normalize_add( out, str_cstr( &type ), f->data[ pos[0] ].data, level, FIELDS_NO_DUPS );
+		if ( status!=BIBL_OK ) break;
+	}
+	str_free( &type );
+	if ( status!=BIBL_OK ) return status;
+
+	/* output_partpages(); a lone page comes back as the start */
+	for ( i=0; i<4; ++i )
+		pos[i] = fields_find( f, pages[i], level );
+	if ( pos[0]!=-1 && pos[1]!=-1 ) {
+		for ( i=0; i<2; ++i ) {
+			status = normalize_add( out, pages[i], f->data[ pos[i] ].data, level, FIELDS_NO_DUPS );
+			if ( status!=BIBL_OK ) return status;
+		}
+	} else {
+		for ( i=0; i<3; ++i ) {
+			if ( pos[i]==-1 ) continue;
+			status = normalize_add( out, "PAGES:START", f->data[ pos[i] ].data, level, FIELDS_NO_DUPS );
+			if ( status!=BIBL_OK ) return status;
+		}
+	}
+	if ( pos[3]!=-1 )
+		status = normalize_add( out, "PAGES:TOTAL", f->data[ pos[3] ].data, level, FIELDS_NO_DUPS );
+
+	return status;
+}
+
+/* output_head() writes the citekey without its whitespace */
+static int
+normalize_refnum( fields *f, fields *out )
+{
+	int n, status = BIBL_OK;
+	char *p;
+	str s;
+
+	n = fields_find( f, "REFNUM", LEVEL_MAIN );
+	if ( n==FIELDS_NOTFOUND ) return BIBL_OK;
+
+	str_init( &s );
+	for ( p=f->data[n].data; *p; p++ )
+		if ( !is_ws( *p ) ) str_addchar( &s, *p );
+	if ( str_memerr( &s ) ) status = BIBL_ERR_MEMERR;
+	else if ( s.len ) status = normalize_add( out, "REFNUM", str_cstr( &s ), LEVEL_MAIN, FIELDS_NO_DUPS );
+	str_free( &s );
+
+	return status;
+}
+
+/* only the first of a tag written once per level makes it through */
+static int
+normalize_isfirst( fields *f, int n )
+{
+	int i;
+
+	for ( i=0; i<n; ++i ) {
+		if ( f->level[i]!=f->level[n] || f->data[i].len==0 ) continue;
+		if ( !strcasecmp( f->tag[i].data, f->tag[n].data ) ) return 0;
+	}
+
+	return 1;
+}
+
+/* the field as written and read back, under back if not NULL */
+static int
+normalize_field( fields *f, int i, fields *out, char *back )
+{
+	char *tag   = fields_tag( f, i, FIELDS_CHRP_NOUSE );
+	char *value = fields_value( f, i, FIELDS_CHRP_NOUSE );
+	int level   = fields_level( f, i );
+	int ttl, subttl;
+
+	if ( !strncasecmp( tag, "GENRE:", 6 ) ) {
+		if ( is_marc_genre( value ) )    tag = "GENRE:MARC";
+		else if ( is_bu_genre( value ) ) tag = "GENRE:BIBUTILS";
+		else                             tag = "GENRE:UNKNOWN";
+	}
+
+	else if ( !strcasecmp( tag, "RESOURCE" ) ) {
+		if ( !is_marc_resource( value ) ) return BIBL_OK;
+	}
+
+	/* output_title() leaves out a short title that adds nothing */
+	else if ( !strcasecmp( tag, "SHORTTITLE" ) ) {
+		ttl    = fields_find( f, "TITLE", level );
+		subttl = fields_find( f, "SUBTITLE", level );
+		if ( ttl!=-1 && subttl==-1 && !strcmp( f->data[ttl].data, value ) )
+			return BIBL_OK;
+	}
+
+	/* urls may come back as DOIs, arXiv ids, and such */
+	else if ( !strcasecmp( tag, "URL" ) || !strcasecmp( tag, "PDFLINK" ) ) {
+		return urls_split_and_add( value, out, level );
+	}
+
+	if ( back ) tag = back;
+
+	return normalize_add( out, tag, value, level, FIELDS_NO_DUPS );
+}
+
+/* the fields on the list for tag, in order */
+static int
+normalize_list( fields *f, fields *out, int level, char *tag, int once, char *back )
+{
+	int i, list, status = BIBL_OK;
+
+	list = modstag_list( tag );
+
+	for ( i=0; i<f->n && status==BIBL_OK; ++i ) {
+		if ( f->level[i]!=level || f->data[i].len==0 ) continue;
+		if ( modstag_list( f->tag[i].data )!=list ) continue;
+		if ( once && !normalize_isfirst( f, i ) ) continue;
+		status = normalize_field( f, i, out, back );
+	}
+
+	return status;
+}
+
+/* as output_notes() writes them from modsnotes */
+static int
+normalize_notes( fields *f, fields *out, int level )
+{
+	int i, n, list, status = BIBL_OK;
 
+	list = modstag_list( "NOTES" );
+
+	for ( i=0; i<f->n && status==BIBL_OK; ++i ) {
+		if ( f->level[i]!=level || f->data[i].len==0 ) continue;
+		if ( modstag_list( f->tag[i].data )!=list ) continue;
+		n = modsnotes_lookup( f->tag[i].data );
+		if ( n==-1 ) continue;
+		status = normalize_field( f, i, out, modsnotes[n].back );
+	}
+
+	return status;
+}
+
+/* as output_sn() writes them from modsids */
+static int
+normalize_sn( fields *f, fields *out, int level )
+{
+	int i, status;
+
+	/* <classification> */
+	status = normalize_list( f, out, level, "CALLNUMBER", 1, "CLASSIFICATION" );
+
+	for ( i=0; i<NMODSIDS && status==BIBL_OK; ++i ) {
+		if ( !modsids[i].back ) continue;
+		status = normalize_list( f, out, level, modsids[i].internal, 1, modsids[i].back );
+	}
+
+	if ( status==BIBL_OK )
+		status = normalize_list( f, out, level, "SERIALNUMBER", 0, NULL );
+
+	return status;
+}
+
+static int
+normalize_section( fields *f, fields *out, int level, const modssection *sec )
+{
+	int i, status = BIBL_OK;
+
+	if ( sec->normalize ) return sec->normalize( f, out, level );
+
+	for ( i=0; i<MODSRT_MAX && sec->tags[i].tag && status==BIBL_OK; ++i )
+		status = normalize_list( f, out, level, sec->tags[i].tag, sec->tags[i].once, NULL );
+
+	return status;
+}
+
+/* follows output_citeparts() */
+static int
+normalize_citeparts( fields *f, fields *out, int level, int max )
+{
+	int i, j, status = BIBL_OK, orig_level;
+
+	for ( i=0; i<NMODSSECTIONS && status==BIBL_OK; ++i ) {
+
+		if ( modssections[i].output ) {
+			status = normalize_section( f, out, level, &(modssections[i]) );
+			continue;
+		}
+
+		if ( level >= 0 && level < max ) {
+			status = normalize_citeparts( f, out, level+1, max );
+			if ( status!=BIBL_OK ) return status;
+		}
+
+		/* the original item, if any, as its own relatedItem */
+		if ( level >= 0 ) {
+			orig_level = -( level + 2 );
+			for ( j=0; j<f->n; ++j ) {
+				if ( f->level[j]!=orig_level ) continue;
+				status = normalize_citeparts( f, out, orig_level, max );
+				break;
+			}
+		}
+	}
+
+	return status;
+}
+
+int
+modsout_normalize( fields *f, param *p )
+{
+	int status = BIBL_OK;
+	fields out;
+
+	fields_init( &out );
+
+	if ( !( p->format_opts & BIBL_FORMAT_MODSOUT_DROPKEY ) ) {
+		status = normalize_refnum( f, &out );
+		if ( status!=BIBL_OK ) goto out;
+	}
+
+	status = normalize_citeparts( f, &out, 0, fields_maxlevel( f ) );
+	if ( status!=BIBL_OK ) goto out;
+
+	fields_free( f );
+	*f = out;
 	return BIBL_OK;
+
+out:
+	fields_free( &out );
+	return status;
 }
 
 static void
-modsout_writeheader( FILE *outptr, param *p )
+modsout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
-	fprintf(outptr,"<?xml version=\"1.0\" encoding=\"%s\"?>\n",
+	if ( p->utf8bom ) outsink_writebom( outptr );
+	outsink_printf(outptr,"<?xml version=\"1.0\" encoding=\"%s\"?>\n",
 			charset_get_xmlname( p->charsetout ) );
-	fprintf(outptr,"<modsCollection xmlns=\"http://www.loc.gov/mods/v3\">\n");
+	outsink_puts(outptr,"<modsCollection xmlns=\"http://www.loc.gov/mods/v3\">\n");
 }
 
 static void
-modsout_writefooter( FILE *outptr )
+modsout_writefooter( outsink *outptr )
 {
-	fprintf(outptr,"</modsCollection>\n");
-	fflush( outptr );
+	outsink_puts(outptr,"</modsCollection>\n");
 }
 
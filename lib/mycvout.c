@@ -17,6 +17,7 @@
 #include "fields.h"
 #include "bibl.h"
 #include "doi.h"
+#include "outsink.h"
 #include "bibutils.h"
 
 void
@@ -34,6 +35,12 @@ bibtexout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	p->headerf = bibtexout_writeheader;
 	p->footerf = NULL;
@@ -62,7 +69,7 @@ enum {
 };
 
 static void
-output_citekey( FILE *fp, fields *info, unsigned long refnum, int format_opts )
+output_citekey( outsink *fp, fields *info, unsigned long refnum, int format_opts )
 {
 	int n = fields_find( info, "REFNUM", -1 );
 	char *p;
@@ -72,11 +79,11 @@ output_citekey( FILE *fp, fields *info, unsigned long refnum, int format_opts )
 			if ( format_opts & BIBL_FORMAT_BIBOUT_STRICTKEY ) {
 				if ( isdigit((unsigned char)*p) || (*p>='A' && *p<='Z') ||
 				     (*p>='a' && *p<='z' ) )
-					fprintf( fp, "%c", *p );
+					outsink_putc( fp, *p );
 			}
 			else {
 				if ( *p!=' ' && *p!='\t' ) {
-					fprintf( fp, "%c", *p );
+					outsink_putc( fp, *p );
 				}
 			}
 			p++;
@@ -155,7 +162,7 @@ bibtexout_type( fields *info, char *filename, int refnum, param *p )
 }
 
 static void
-output_type( FILE *fp, int type, int format_opts )
+output_type( outsink *fp, int type, int format_opts )
 {
 	typedef struct {
 		int bib_type;
@@ -177,7 +184,7 @@ output_type( FILE *fp, int type, int format_opts )
 		{ TYPE_UNPUBLISHED, "Unpublished" },
 		{ TYPE_ELECTRONIC, "Electronic" },
 		{ TYPE_MISC, "Misc" } };
-	int i, len, ntypes = sizeof( types ) / sizeof( types[0] );
+	int i, ntypes = sizeof( types ) / sizeof( types[0] );
 	char *s = NULL;
 	for ( i=0; i<ntypes; ++i ) {
 		if ( types[i].bib_type == type ) {
@@ -186,65 +193,56 @@ output_type( FILE *fp, int type, int format_opts )
 		}
 	}
 	if ( !s ) s = types[ntypes-1].type_name; /* default to TYPE_MISC */
-	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) fprintf( fp, "@%s{", s );
-	else {
-		len = strlen( s );
-		fprintf( fp, "@" );
-		for ( i=0; i<len; ++i )
-			fprintf( fp, "%c", toupper((unsigned char)s[i]) );
-		fprintf( fp, "{" );
-	}
+	outsink_putc( fp, '@' );
+	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) outsink_puts( fp, s );
+	else outsink_toupper( fp, s );
+	outsink_putc( fp, '{' );
 }
 
 static void
-output_element( FILE *fp, char *tag, char *data, int format_opts )
+output_element( outsink *fp, char *tag, char *data, int format_opts )
 {
-	int i, len, nquotes = 0;
-	char ch;
-	fprintf( fp, ",\n" );
-	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) fprintf( fp, "  " );
-	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) fprintf( fp, "%s", tag );
-	else {
-		len = strlen( tag );
-		for ( i=0; i<len; ++i )
-			fprintf( fp, "%c", toupper((unsigned char)tag[i]) );
-	}
-	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) fprintf( fp, " = \t" );
-	else fprintf( fp, "=" );
-
-	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) fprintf( fp, "{" );
-	else fprintf( fp, "\"" );
-
-	len = strlen( data );
-	for ( i=0; i<len; ++i ) {
-		ch = data[i];
-		if ( ch!='\"' ) fprintf( fp, "%c", ch );
+	int nquotes = 0;
+	char *p, *q;
+	outsink_puts( fp, ",\n" );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) outsink_puts( fp, "  " );
+	if ( !(format_opts & BIBL_FORMAT_BIBOUT_UPPERCASE ) ) outsink_puts( fp, tag );
+	else outsink_toupper( fp, tag );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_WHITESPACE ) outsink_puts( fp, " = \t" );
+	else outsink_putc( fp, '=' );
+
+	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) outsink_putc( fp, '{' );
+	else outsink_putc( fp, '\"' );
+
+	p = data;
+	while ( ( q = strchr( p, '\"' ) ) ) {
+		outsink_write( fp, p, q - p );
+		if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS || 
+		    ( q>data && q[-1]=='\\' ) )
+			outsink_putc( fp, '\"' );
 		else {
-			if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS || 
-			    ( i>0 && data[i-1]=='\\' ) )
-				fprintf( fp, "\"" );
-			else {
-				if ( nquotes % 2 == 0 )
-					fprintf( fp, "``" );
-				else    fprintf( fp, "\'\'" );
-				nquotes++;
-			}
+			if ( nquotes % 2 == 0 )
+				outsink_puts( fp, "``" );
+			else    outsink_puts( fp, "\'\'" );
+			nquotes++;
 		}
+		p = q + 1;
 	}
+	outsink_puts( fp, p );
 
-	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) fprintf( fp, "}" );
-	else fprintf( fp, "\"" );
+	if ( format_opts & BIBL_FORMAT_BIBOUT_BRACKETS ) outsink_putc( fp, '}' );
+	else outsink_putc( fp, '\"' );
 }
 
 static void
-output_and_use( FILE *fp, fields *info, int n, char *outtag, int format_opts )
+output_and_use( outsink *fp, fields *info, int n, char *outtag, int format_opts )
 {
 	output_element( fp, outtag, info->data[n].data, format_opts );
 	fields_setused( info, n );
 }
 
 static void
-output_simple( FILE *fp, fields *info, char *intag, char *outtag, 
+output_simple( outsink *fp, fields *info, char *intag, char *outtag, 
 		int format_opts )
 {
 	int n = fields_find( info, intag, -1 );
@@ -254,7 +252,7 @@ output_simple( FILE *fp, fields *info, char *intag, char *outtag,
 }
 
 static void
-output_simpleall( FILE *fp, fields *info, char *intag, char *outtag,
+output_simpleall( outsink *fp, fields *info, char *intag, char *outtag,
 		int format_opts )
 {
 	int i;
@@ -265,7 +263,7 @@ output_simpleall( FILE *fp, fields *info, char *intag, char *outtag,
 }
 
 static void
-output_fileattach( FILE *fp, fields *info, int format_opts )
+output_fileattach( outsink *fp, fields *info, int format_opts )
 {
 	str data;
 	int i;
@@ -305,7 +303,7 @@ add_person( str *s, char *p )
 }
 
 static void
-output_people( FILE *fp, fields *info, unsigned long refnum, char *tag, 
+output_people( outsink *fp, fields *info, unsigned long refnum, char *tag, 
 		char *ctag, char *atag, char *bibtag, int level, 
 		int format_opts )
 {
@@ -346,7 +344,7 @@ output_people( FILE *fp, fields *info, unsigned long refnum, char *tag,
 }
 
 static void
-output_title( FILE *fp, fields *info, unsigned long refnum, char *bibtag, int level, int format_opts )
+output_title( outsink *fp, fields *info, unsigned long refnum, char *bibtag, int level, int format_opts )
 {
 	str title;
 	int n1 = -1, n2 = -1;
@@ -376,7 +374,7 @@ output_title( FILE *fp, fields *info, unsigned long refnum, char *bibtag, int le
 }
 
 static void
-output_date( FILE *fp, fields *info, unsigned long refnum, int format_opts )
+output_date( outsink *fp, fields *info, unsigned long refnum, int format_opts )
 {
 	char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", 
 		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
@@ -408,7 +406,7 @@ output_date( FILE *fp, fields *info, unsigned long refnum, int format_opts )
 
 /* output article number as pages if true pages aren't found */
 static void
-output_articlenumber( FILE *fp, fields *info, unsigned long refnum,
+output_articlenumber( outsink *fp, fields *info, unsigned long refnum,
 	int format_opts )
 {
 	int ar = fields_find( info, "ARTICLENUMBER", -1 );
@@ -423,7 +421,7 @@ output_articlenumber( FILE *fp, fields *info, unsigned long refnum,
 }
 
 static void
-output_arxiv( FILE *fp, fields *info, int format_opts )
+output_arxiv( outsink *fp, fields *info, int format_opts )
 {
 	int ar = fields_find( info, "ARXIV", -1 );
 	if ( ar!=-1 ) {
@@ -437,7 +435,7 @@ output_arxiv( FILE *fp, fields *info, int format_opts )
 }
 
 static void
-output_pmid( FILE *fp, fields *info, int format_opts )
+output_pmid( outsink *fp, fields *info, int format_opts )
 {
 	int pm = fields_find( info, "PMID", -1 );
 	if ( pm!=-1 ) {
@@ -451,7 +449,7 @@ output_pmid( FILE *fp, fields *info, int format_opts )
 }
 
 static void
-output_jstor( FILE *fp, fields *info, int format_opts )
+output_jstor( outsink *fp, fields *info, int format_opts )
 {
 	int js = fields_find( info, "JSTOR", -1 );
 	if ( js!=-1 ) {
@@ -465,7 +463,7 @@ output_jstor( FILE *fp, fields *info, int format_opts )
 }
 
 static void
-output_pages( FILE *fp, fields *info, unsigned long refnum, int format_opts )
+output_pages( outsink *fp, fields *info, unsigned long refnum, int format_opts )
 {
 	str pages;
 	int sn, en;
@@ -507,7 +505,7 @@ output_pages( FILE *fp, fields *info, unsigned long refnum, int format_opts )
  */
 
 static void
-output_issue_number( FILE *fp, fields *info, int format_opts )
+output_issue_number( outsink *fp, fields *info, int format_opts )
 {
 	int nissue  = fields_find( info, "ISSUE", -1 );
 	int nnumber = fields_find( info, "NUMBER", -1 );
@@ -537,7 +535,7 @@ output_issue_number( FILE *fp, fields *info, int format_opts )
 }
 
 void
-bibtexout_write( fields *info, FILE *fp, param *p, unsigned long refnum )
+bibtexout_write( fields *info, outsink *fp, param *p, unsigned long refnum )
 {
 	int type;
 	fields_clearused( info );
@@ -601,14 +599,13 @@ bibtexout_write( fields *info, FILE *fp, param *p, unsigned long refnum )
 	output_pmid( fp, info, p->format_opts );
 	output_jstor( fp, info, p->format_opts );
 	output_simple( fp, info, "LANGUAGE", "language", p->format_opts );
-	if ( p->format_opts & BIBL_FORMAT_BIBOUT_FINALCOMMA ) fprintf( fp, "," );
-	fprintf( fp, "\n}\n\n" );
-	fflush( fp );
+	if ( p->format_opts & BIBL_FORMAT_BIBOUT_FINALCOMMA ) outsink_puts( fp, "," );
+	outsink_puts( fp, "\n}\n\n" );
 }
 
 void
-bibtexout_writeheader( FILE *outptr, param *p )
+bibtexout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
 
@@ -9,6 +9,7 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 #include "utf8.h"
@@ -17,7 +18,7 @@
 #include "str.h"
 #include "fields.h"
 #include "slist.h"
-#include "intlist.h"
+#include "pslist.h"
 #include "name.h"
 
 /* name_build_withcomma()
@@ -63,33 +64,33 @@ name_build_withcomma( str *s, char *p )
  * of name lists.
  */
 int
-name_findetal( slist *tokens )
+name_findetal( pslist *tokens )
 {
-	str *s1, *s2;
+	char *s1, *s2;
 
 	if ( tokens->n==0 ) return 0;
 
 	/* ...check last entry for full 'et al.' or variant */
-	s2 = slist_str( tokens, tokens->n - 1 );
-	if ( !strcasecmp( s2->data, "et alia" ) ||
-	     !strcasecmp( s2->data, "et al." )  ||
-	     !strcasecmp( s2->data, "et al.," )  ||
-	     !strcasecmp( s2->data, "et al" )   ||
-	     !strcasecmp( s2->data, "etalia" )  ||
-	     !strcasecmp( s2->data, "etal." ) ||
-	     !strcasecmp( s2->data, "etal" ) ) {
+	s2 = pslist_cstr( tokens, tokens->n - 1 );
+	if ( !strcasecmp( s2, "et alia" ) ||
+	     !strcasecmp( s2, "et al." )  ||
+	     !strcasecmp( s2, "et al.," )  ||
+	     !strcasecmp( s2, "et al" )   ||
+	     !strcasecmp( s2, "etalia" )  ||
+	     !strcasecmp( s2, "etal." ) ||
+	     !strcasecmp( s2, "etal" ) ) {
 		return 1;
 	}
 
 	if ( tokens->n==1 ) return 0;
 
 	/* ...check last two entries for full 'et' and 'al.' */
-	s1 = slist_str( tokens, tokens->n - 2 );
-	if ( !strcasecmp( s1->data, "et" ) ) {
-		if ( !strcasecmp( s2->data, "alia" ) ||
-		     !strcasecmp( s2->data, "al." )  ||
-		     !strcasecmp( s2->data, "al.," )  ||
-		     !strcasecmp( s2->data, "al" ) ) {
+	s1 = pslist_cstr( tokens, tokens->n - 2 );
+	if ( !strcasecmp( s1, "et" ) ) {
+		if ( !strcasecmp( s2, "alia" ) ||
+		     !strcasecmp( s2, "al." )  ||
+		     !strcasecmp( s2, "al.," )  ||
+		     !strcasecmp( s2, "al" ) ) {
 			return 2;
 		}
 	}
@@ -103,6 +104,158 @@ name_findetal( slist *tokens )
 #define THIRD     (8)
 #define FOURTH    (16)
 
+/*
+ * A name is parsed from its tokens, copied one after another,
+ * '\0'-terminated, into a buffer, and built into a second buffer that
+ * is long enough for any name the tokens can make. Both buffers are on
+ * the stack unless the name is very long, so a name is parsed without
+ * allocating and copied out once.
+ */
+
+#define NAME_MAXTOKENS (32)
+#define NAME_BUFSIZE   (128)
+#define NAME_PAD       (8)   /* '\0's after the tokens, for utf8_decode() of a broken character */
+#define NAME_OUTSIZE( n ) ( 8 * (n) + 16 )
+
+typedef struct {
+	char *s;
+	int len;
+} name_token;
+
+typedef struct {
+	name_token *tok;
+	int n;
+	char *buf;
+	int buflen;
+	char *out;
+	int outlen;
+	void *heap;
+	name_token tokspace[ NAME_MAXTOKENS ];
+	char bufspace[ NAME_BUFSIZE + NAME_PAD ];
+	char outspace[ NAME_OUTSIZE( NAME_BUFSIZE ) ];
+} name_parts;
+
+/* room for ntok tokens of nbytes in all; returns 1 on ok, 0 on memory error */
+static int
+name_parts_init( name_parts *np, int ntok, int nbytes )
+{
+	int size = nbytes + ntok;
+
+	np->n = np->buflen = np->outlen = 0;
+	np->heap = NULL;
+
+	if ( ntok <= NAME_MAXTOKENS && size <= NAME_BUFSIZE ) {
+		np->tok = np->tokspace;
+		np->buf = np->bufspace;
+		np->out = np->outspace;
+	} else {
+		np->heap = malloc( sizeof( name_token ) * ntok + size + NAME_PAD + NAME_OUTSIZE( size ) );
+		if ( !np->heap ) return 0;
+		np->tok = ( name_token * ) np->heap;
+		np->buf = ( char * ) ( np->tok + ntok );
+		np->out = np->buf + size + NAME_PAD;
+	}
+	memset( np->buf + size, 0, NAME_PAD );
+
+	return 1;
+}
+
+static void
+name_parts_free( name_parts *np )
+{
+	free( np->heap );
+}
+
+static void
+name_parts_addtoken( name_parts *np, const char *p, int len )
+{
+	name_token *t = &(np->tok[ np->n++ ]);
+	t->s   = np->buf + np->buflen;
+	t->len = len;
+	memcpy( t->s, p, len );
+	t->s[len] = '\0';
+	np->buflen += len + 1;
+}
+
+static void
+name_parts_trimtoken( name_parts *np, int n )
+{
+	name_token *t = &(np->tok[n]);
+	t->s[ --t->len ] = '\0';
+}
+
+static void
+name_out( name_parts *np, const char *p, int len )
+{
+	memcpy( np->out + np->outlen, p, len );
+	np->outlen += len;
+}
+
+static void
+name_outc( name_parts *np, const char *p )
+{
+	name_out( np, p, strlen( p ) );
+}
+
+static void
+name_outchar( name_parts *np, char ch )
+{
+	np->out[ np->outlen++ ] = ch;
+}
+
+/* the tokens slist_tokenize( " " ) gives once each ',' has a space added */
+static const char *
+name_nexttoken( const char *p, int *len )
+{
+	const char *q;
+
+	while ( *p==' ' ) p++;
+	if ( *p=='\0' ) return NULL;
+
+	q = p;
+	while ( *q && *q!=' ' ) {
+		if ( *q++==',' ) break;
+	}
+
+	*len = q - p;
+	return p;
+}
+
+static int
+name_parts_tokenize( name_parts *np, const char *name )
+{
+	int len, ntok = 0, nbytes = 0;
+	const char *p;
+
+	for ( p=name_nexttoken( name, &len ); p; p=name_nexttoken( p+len, &len ) ) {
+		ntok++;
+		nbytes += len;
+	}
+
+	if ( !name_parts_init( np, ntok, nbytes ) ) return 0;
+
+	for ( p=name_nexttoken( name, &len ); p; p=name_nexttoken( p+len, &len ) )
+		name_parts_addtoken( np, p, len );
+
+	return 1;
+}
+
+static int
+name_parts_fromlist( name_parts *np, pslist *tokens, int begin, int end )
+{
+	int i, nbytes = 0;
+
+	for ( i=begin; i<end; ++i )
+		nbytes += pslist_strlen( tokens, i );
+
+	if ( !name_parts_init( np, end-begin, nbytes ) ) return 0;
+
+	for ( i=begin; i<end; ++i )
+		name_parts_addtoken( np, pslist_cstr( tokens, i ), pslist_strlen( tokens, i ) );
+
+	return 1;
+}
+
 typedef struct {
 	char *s;
 	unsigned short value;
@@ -134,14 +287,13 @@ identify_suffix( char *p )
 }
 
 static int
-has_suffix( slist *tokens, int begin, int end, int *suffixpos )
+has_suffix( name_parts *np, int begin, int end, int *suffixpos )
 {
+	name_token *t;
 	int i, ret;
-	str *s;
 
 	/* ...check last element, e.g. "H. F. Author, Sr." */
-	s = slist_str( tokens, end - 1 );
-	ret = identify_suffix( s->data );
+	ret = identify_suffix( np->tok[end-1].s );
 	if ( ret ) {
 		*suffixpos = end - 1;
 		return ret;
@@ -149,10 +301,9 @@ has_suffix( slist *tokens, int begin, int end, int *suffixpos )
 
 	/* ...try to find one after a comma, e.g. "Author, Sr., H. F." */
 	for ( i=begin; i<end-1; ++i ) {
-		s = slist_str( tokens, i );
-		if ( s->len && s->data[ s->len - 1 ]==',' ) {
-			s = slist_str( tokens, i+1 );
-			ret = identify_suffix( s->data );
+		t = &(np->tok[i]);
+		if ( t->len && t->s[ t->len - 1 ]==',' ) {
+			ret = identify_suffix( np->tok[i+1].s );
 			if ( ret ) {
 				*suffixpos = i+1;
 				return ret;
@@ -163,60 +314,66 @@ has_suffix( slist *tokens, int begin, int end, int *suffixpos )
 	return 0;
 }
 
-static int
-add_given_split( str *name, str *s )
+static void
+add_given_split( name_parts *np, name_token *t )
 {
 	unsigned int unicode_char;
 	unsigned int pos = 0;
 	char utf8s[7];
-	while ( pos < s->len ) {
-		unicode_char = utf8_decode( s->data, &pos );
+	while ( pos < t->len ) {
+		unicode_char = utf8_decode( t->s, &pos );
 		if ( is_ws( (char) unicode_char ) ) continue;
 		else if ( unicode_char==(unsigned int)'.' ) {
-			if ( s->data[pos]=='-' ) {
-				str_strcatc( name, ".-" );
+			if ( t->s[pos]=='-' ) {
+				name_outc( np, ".-" );
 				pos += 1;
-				unicode_char = utf8_decode( s->data, &pos );
+				unicode_char = utf8_decode( t->s, &pos );
 				utf8_encode_str( unicode_char, utf8s );
-				str_strcatc( name, utf8s );
-				str_addchar( name, '.' );
+				name_outc( np, utf8s );
+				name_outchar( np, '.' );
 			}
 		} else if ( unicode_char==(unsigned int)'-' ) {
-			str_strcatc( name, ".-" );
-			unicode_char = utf8_decode( s->data, &pos );
+			name_outc( np, ".-" );
+			unicode_char = utf8_decode( t->s, &pos );
 			utf8_encode_str( unicode_char, utf8s );
-			str_strcatc( name, utf8s );
-			str_addchar( name, '.' );
+			name_outc( np, utf8s );
+			name_outchar( np, '.' );
 		} else if ( unicode_char==(unsigned int)',' ) { /* nothing */
 		} else {
-			str_addchar( name, '|' );
+			name_outchar( np, '|' );
 			utf8_encode_str( unicode_char, utf8s );
-			str_strcatc( name, utf8s );
+			name_outc( np, utf8s );
 		}
 	}
-	return 1;
+}
+
+static unsigned short
+token_classify( name_parts *np, int n )
+{
+	return unicode_utf8_classify_len( np->tok[n].s, np->tok[n].len );
 }
 
 static unsigned char
-token_has_no_upper( slist *tokens, int n )
+token_has_no_upper( name_parts *np, int n )
 {
-	unsigned short m;
-	str *s;
-	s = slist_str( tokens, n );
-	m = unicode_utf8_classify_str( s );
-	if ( m & UNICODE_UPPER ) return 0;
+	if ( token_classify( np, n ) & UNICODE_UPPER ) return 0;
 	else return 1;
 }
 
 static unsigned char
-token_has_upper( slist *tokens, int n )
+token_has_upper( name_parts *np, int n )
 {
-	if ( token_has_no_upper( tokens, n ) ) return 0;
+	if ( token_has_no_upper( np, n ) ) return 0;
 	else return 1;
 }
 
-static int
-name_multielement_nocomma( intlist *given, intlist *family, slist *tokens, int begin, int end, int suffixpos )
+/*
+ * The family name is tokens [*fbegin,*fend) except fskip; the given
+ * names are the tokens in [*gbegin,*gend) that aren't in the family
+ * name or the suffix.
+ */
+static void
+name_multielement_nocomma( name_parts *np, int begin, int end, int suffixpos, int *fbegin, int *fend, int *fskip, int *gbegin, int *gend )
 {
 	int family_start, family_end;
 	int i, n;
@@ -230,73 +387,56 @@ name_multielement_nocomma( intlist *given, intlist *family, slist *tokens, int b
 	 * ..."Ludwig 'von Beethoven'"
 	 * ..."Johannes Diderik 'van der Waals'"
 	 * ..."Charles Louis Xavier Joseph 'de la Valla Poussin' */
-	if ( token_has_upper( tokens, family_start ) ) {
+	if ( token_has_upper( np, family_start ) ) {
 		i = family_start - 1;
 		n = -1;
-		while ( i >= begin && ( n==-1 || token_has_no_upper( tokens, i ) ) ) {
-			if ( token_has_no_upper( tokens, i ) ) n = i;
+		while ( i >= begin && ( n==-1 || token_has_no_upper( np, i ) ) ) {
+			if ( token_has_no_upper( np, i ) ) n = i;
 			i--;
 		}
 		if ( n != -1 ) family_start = n;
 	}
-	for ( i=family_start; i<family_end+1; i++ )
-		intlist_add( family, i );
+	*fbegin = family_start;
+	*fend   = family_end + 1;
+	*fskip  = -1;
 
 	/* ...given names */
-	for ( i=begin; i<end-1; i++ ) {
-		if ( i>=family_start && i<=family_end ) continue;
-		if ( i==suffixpos ) continue;
-		intlist_add( given, i );
-	}
-
-	return 1;
+	*gbegin = begin;
+	*gend   = end - 1;
 }
 
-static int
-name_multielement_comma( intlist *given, intlist *family, slist *tokens, int begin, int end, int comma, int suffixpos )
+static void
+name_multielement_comma( name_parts *np, int begin, int end, int comma, int suffixpos, int *fbegin, int *fend, int *fskip, int *gbegin, int *gend )
 {
-	str *s;
-	int i;
-
 	/* ...family names */
-	for ( i=begin; i<comma; ++i ) {
-		if ( i==suffixpos ) continue;
-		intlist_add( family, i );
-	}
-	s = slist_str( tokens, comma );
-	str_trimend( s, 1 ); /* remove comma */
-	intlist_add( family, comma );
+	*fbegin = begin;
+	*fend   = comma + 1;
+	*fskip  = suffixpos;
+	name_parts_trimtoken( np, comma ); /* remove comma */
 
 	/* ...given names */
-	for ( i=comma+1; i<end; ++i ) {
-		if ( i==suffixpos ) continue;
-		intlist_add( given, i );
-	}
-
-	return 1;
+	*gbegin = comma + 1;
+	*gend   = end;
 }
 
-static int
-name_mutlielement_build( str *name, intlist *given, intlist *family, slist *tokens )
+static void
+name_mutlielement_build( name_parts *np, int fbegin, int fend, int fskip, int gbegin, int gend, int suffixpos )
 {
 	unsigned short case_given = 0, case_family = 0, should_split = 0;
-	str *s;
-	int i, m;
+	int i, nfamily = 0;
 
 	/* ...copy and analyze family name */
-	for ( i=0; i<family->n; ++i ) {
-		m = intlist_get( family, i );
-		s = slist_str( tokens, m );
-		if ( i ) str_addchar( name, ' '  );
-		str_strcat( name, s );
-		case_family |= unicode_utf8_classify_str( s );
+	for ( i=fbegin; i<fend; ++i ) {
+		if ( i==fskip ) continue;
+		if ( nfamily++ ) name_outchar( np, ' ' );
+		name_out( np, np->tok[i].s, np->tok[i].len );
+		case_family |= token_classify( np, i );
 	}
 
 	/* ...check given name case */
-	for ( i=0; i<given->n; ++i ) {
-		m = intlist_get( given, i );
-		s = slist_str( tokens, m );
-		case_given |= unicode_utf8_classify_str( s );
+	for ( i=gbegin; i<gend; ++i ) {
+		if ( i==suffixpos || ( i>=fbegin && i<fend ) ) continue;
+		case_given |= token_classify( np, i );
 	}
 
 	if ( ( ( case_family & UNICODE_MIXEDCASE ) == UNICODE_MIXEDCASE ) &&
@@ -304,75 +444,68 @@ name_mutlielement_build( str *name, intlist *given, intlist *family, slist *toke
 		should_split = 1;
 	}
 
-	for ( i=0; i<given->n; ++i ) {
-		m = intlist_get( given, i );
-		s = slist_str( tokens, m );
+	for ( i=gbegin; i<gend; ++i ) {
+		if ( i==suffixpos || ( i>=fbegin && i<fend ) ) continue;
 		if ( !should_split ) {
-			str_addchar( name, '|' );
-			str_strcat( name, s );
-		} else add_given_split( name, s );
+			name_outchar( np, '|' );
+			name_out( np, np->tok[i].s, np->tok[i].len );
+		} else add_given_split( np, &(np->tok[i]) );
 	}
-	return 1;
 }
 
-static int
-name_construct_multi( str *outname, slist *tokens, int begin, int end )
+/* build the name from tokens [begin,end) into np->out, '\0'-terminated */
+static void
+name_construct_multi( name_parts *np, int begin, int end )
 {
+	int fbegin, fend, fskip, gbegin, gend;
 	int i, suffix, suffixpos=-1, comma=-1;
-	intlist given, family;
-	str *s;
-
-	intlist_init( &family );
-	intlist_init( &given );
+	name_token *t;
 
-	str_empty( outname );
+	np->outlen = 0;
 
-	suffix = has_suffix( tokens, begin, end, &suffixpos );
+	suffix = has_suffix( np, begin, end, &suffixpos );
 
 	for ( i=begin; i<end && comma==-1; i++ ) {
 		if ( i==suffixpos ) continue;
-		s = slist_str( tokens, i );
-		if ( s->data[ s->len -1 ] == ',' ) {
+		t = &(np->tok[i]);
+		if ( t->len && t->s[ t->len - 1 ] == ',' ) {
 			if ( suffix && i==suffixpos-1 && !(suffix&WITHCOMMA) )
-				str_trimend( s, 1 );
+				name_parts_trimtoken( np, i );
 			else
 				comma = i;
 		}
 	}
 
 	if ( comma != -1 )
-		name_multielement_comma( &given, &family, tokens, begin, end, comma, suffixpos );
+		name_multielement_comma( np, begin, end, comma, suffixpos, &fbegin, &fend, &fskip, &gbegin, &gend );
 	else
-		name_multielement_nocomma( &given, &family, tokens, begin, end, suffixpos );
+		name_multielement_nocomma( np, begin, end, suffixpos, &fbegin, &fend, &fskip, &gbegin, &gend );
 
-	name_mutlielement_build( outname, &given, &family, tokens );
+	name_mutlielement_build( np, fbegin, fend, fskip, gbegin, gend, suffixpos );
 
 	if ( suffix ) {
-		if ( suffix & JUNIOR ) str_strcatc( outname, "||Jr." );
-		if ( suffix & SENIOR ) str_strcatc( outname, "||Sr." );
-		if ( suffix & THIRD  ) str_strcatc( outname, "||III" );
-		if ( suffix & FOURTH ) str_strcatc( outname, "||IV"  );
+		if ( suffix & JUNIOR ) name_outc( np, "||Jr." );
+		if ( suffix & SENIOR ) name_outc( np, "||Sr." );
+		if ( suffix & THIRD  ) name_outc( np, "||III" );
+		if ( suffix & FOURTH ) name_outc( np, "||IV"  );
 	}
 
-	intlist_free( &given );
-	intlist_free( &family );
-
-	return 1;
+	np->out[ np->outlen ] = '\0';
 }
 
 int
-name_addmultielement( fields *info, char *tag, slist *tokens, int begin, int end, int level )
+name_addmultielement( fields *info, char *tag, pslist *tokens, int begin, int end, int level )
 {
 	int status, ok = 1;
-	str name;
+	name_parts np;
 
-	str_init( &name );
+	if ( !name_parts_fromlist( &np, tokens, begin, end ) ) return 0;
 
-	name_construct_multi( &name, tokens, begin, end );
-	status = fields_add_can_dup( info, tag, name.data, level );
+	name_construct_multi( &np, 0, end-begin );
+	status = fields_add_can_dup( info, tag, np.out, level );
 	if ( status!=FIELDS_OK ) ok = 0;
 
-	str_free( &name );
+	name_parts_free( &np );
 
 	return ok;
 }
@@ -411,43 +544,37 @@ name_addsingleelement( fields *info, char *tag, char *name, int level, int corp
 int
 name_parse( str *outname, str *inname, slist *asis, slist *corps )
 {
-	int status, ret = 1;
-	slist tokens;
+	name_parts np;
+	int ret;
 
 	str_empty( outname );
-	if ( !inname || !inname->len ) return ret;
-
-	slist_init( &tokens );
+	if ( !inname || !inname->len ) return 1;
 
 	if ( asis && slist_find( asis, inname ) !=-1 ) {
 		str_strcpy( outname, inname );
-		ret = 2;
-		goto out;
+		return 2;
 	} else if ( corps && slist_find( corps, inname ) != -1 ) {
 		str_strcpy( outname, inname );
-		ret = 3;
-		goto out;
+		return 3;
 	}
 
-	str_findreplace( inname, ",", ", " );
-	status = slist_tokenize( &tokens, inname, " ", 1 );
-	if ( status!=SLIST_OK ) {
+	if ( !name_parts_tokenize( &np, str_cstr( inname ) ) ) {
 		str_strcpy( outname, inname );
-		ret = 2;
-		goto out;
+		str_findreplace( outname, ",", ", " );
+		return 2;
 	}
 
-	if ( tokens.n==1 ) {
+	if ( np.n < 2 ) {
 		str_strcpy( outname, inname );
+		str_findreplace( outname, ",", ", " );
 		ret = 2;
 	} else {
-		name_construct_multi( outname, &tokens, 0, tokens.n );
+		name_construct_multi( &np, 0, np.n );
+		str_segcpy( outname, np.out, np.out + np.outlen );
 		ret = 1;
 	}
 
-out:
-
-	slist_free( &tokens );
+	name_parts_free( &np );
 
 	return ret;
 }
@@ -475,6 +602,138 @@ name_copy( str *name, char *p )
 	return p;
 }
 
+/*
+ * Name cache
+ *
+ * Large bibliographies give the same author over and over, and
+ * parsing a personal name (tokenizing, finding suffixes, splitting
+ * family from given names) costs far more than looking it up. Given a
+ * cache of some size, name_add() remembers the parse of each name in a
+ * table of that many entries (rounded up to a power of two), each name
+ * having just the one place it can go, so a new name replaces whatever
+ * was there.
+ *
+ * The cache belongs to whoever passes it in, as the asis and corps
+ * lists do, and isn't shared between threads. Only the parse is
+ * remembered. Names in the asis and corps lists never reach the cache,
+ * as they are found in those lists (which are indexed) before it is
+ * tried, so the cache holds the same answers whatever lists are in use.
+ */
+
+struct namecache_entry {
+	unsigned long hash;
+	str in;          /* name as given, empty if the entry is unused */
+	str out;         /* as parsed, e.g. 'family|given|given||suffix' */
+	int type;        /* as returned by name_parse() */
+};
+
+static unsigned long
+name_cache_hash( str *s )
+{
+	unsigned long i, h = 5381;
+	for ( i=0; i<s->len; ++i )
+		h = h * 33 + ( unsigned char ) s->data[i];
+	return h;
+}
+
+/* name_cache_init()
+ *
+ * Set up nc to remember the parse of up to size names, or of none if
+ * size is 0.
+ *
+ * Returns 1 on ok, 0 on memory error (leaving the cache off).
+ */
+int
+name_cache_init( namecache *nc, long size )
+{
+	unsigned long i, n = 0;
+
+	memset( nc, 0, sizeof( namecache ) );
+
+	if ( size > 0 )
+		for ( n=1; n<( unsigned long ) size; n*=2 ) ;
+	if ( !n ) return 1;
+
+	nc->entry = ( namecache_entry * ) malloc( sizeof( namecache_entry ) * n );
+	if ( !nc->entry ) return 0;
+	for ( i=0; i<n; ++i )
+		strs_init( &(nc->entry[i].in), &(nc->entry[i].out), NULL );
+	nc->size = n;
+	nc->stats.size = n;
+
+	return 1;
+}
+
+void
+name_cache_free( namecache *nc )
+{
+	unsigned long i;
+
+	for ( i=0; i<nc->size; ++i )
+		strs_free( &(nc->entry[i].in), &(nc->entry[i].out), NULL );
+	free( nc->entry );
+	name_cache_init( nc, 0 );
+}
+
+/* Returns the name type on a hit, 0 on a miss */
+static int
+name_cache_find( namecache *nc, str *outname, str *inname, unsigned long hash )
+{
+	namecache_entry *e;
+
+	nc->stats.lookups++;
+	e = &(nc->entry[ hash & ( nc->size - 1 ) ]);
+	if ( !e->in.len || e->hash!=hash || str_strcmp( &(e->in), inname ) ) return 0;
+
+	str_strcpy( outname, &(e->out) );
+	if ( str_memerr( outname ) ) return 0;
+	nc->stats.hits++;
+	return e->type;
+}
+
+static void
+name_cache_add( namecache *nc, str *inname, unsigned long hash, str *outname, int type )
+{
+	namecache_entry *e;
+
+	e = &(nc->entry[ hash & ( nc->size - 1 ) ]);
+	if ( e->in.len ) nc->stats.replaced++;
+	else nc->stats.used++;
+
+	str_strcpy( &(e->in), inname );
+	str_strcpy( &(e->out), outname );
+	if ( str_memerr( &(e->in) ) || str_memerr( &(e->out) ) ) {
+		/* forget the entry rather than keep half of it */
+		strs_empty( &(e->in), &(e->out), NULL );
+		nc->stats.used--;
+		return;
+	}
+	e->hash = hash;
+	e->type = type;
+}
+
+/* name_parse() through the cache */
+static int
+name_parse_cached( str *outname, str *inname, slist *asis, slist *corps, namecache *nc )
+{
+	unsigned long hash;
+	int ret;
+
+	if ( !nc || !nc->size || !inname->len ||
+	     ( asis && slist_find( asis, inname )!=-1 ) ||
+	     ( corps && slist_find( corps, inname )!=-1 ) )
+		return name_parse( outname, inname, asis, corps );
+
+	hash = name_cache_hash( inname );
+	ret = name_cache_find( nc, outname, inname, hash );
+	if ( ret ) return ret;
+
+	ret = name_parse( outname, inname, NULL, NULL );
+	if ( ret ) name_cache_add( nc, inname, hash, outname, ret );
+
+	return ret;
+}
+
 /*
  * name_add( info, newtag, data, level )
  *
@@ -489,24 +748,24 @@ name_copy( str *name, char *p )
  * for each personal name, send to appropriate algorithm depending
  * on if the author name is in the format "H. F. Author" or
  * "Author, H. F."
+ *
+ * nc, if not NULL, remembers how names were parsed (see above)
  */
 int
-name_add( fields *info, char *tag, char *q, int level, slist *asis, slist *corps )
+name_add( fields *info, char *tag, char *q, int level, slist *asis, slist *corps, namecache *nc )
 {
 	int ok, status, nametype, ret = 1;
 	str inname, outname;
-	slist tokens;
 
 	if ( !q ) return 0;
 
-	slist_init( &tokens );
 	strs_init( &inname, &outname, NULL );
 
 	while ( *q ) {
 
 		q = name_copy( &inname, q );
 
-		nametype = name_parse( &outname, &inname, asis, corps );
+		nametype = name_parse_cached( &outname, &inname, asis, corps, nc );
 		if ( !nametype ) { ret = 0; goto out; }
 
 		if ( nametype==1 ) {
@@ -524,7 +783,6 @@ name_add( fields *info, char *tag, char *q, int level, slist *asis, slist *corps
 
 out:
 	strs_free( &inname, &outname, NULL );
-	slist_free( &tokens );
 
 	return ret;
 }
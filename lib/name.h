@@ -13,14 +13,34 @@
 
 #include "str.h"
 #include "slist.h"
+#include "pslist.h"
 #include "fields.h"
 
-extern int  name_add( fields *info, char *tag, char *q, int level, slist *asis, slist *corps );
+typedef struct namecache_stats {
+	unsigned long lookups;  /* names looked for */
+	unsigned long hits;     /* ...and found */
+	unsigned long replaced; /* entries given over to another name */
+	unsigned long used;     /* entries holding a name */
+	unsigned long size;     /* entries in all */
+} namecache_stats;
+
+typedef struct namecache_entry namecache_entry;
+
+typedef struct namecache {
+	namecache_entry *entry;
+	unsigned long   size;
+	namecache_stats stats;
+} namecache;
+
+extern int  name_cache_init( namecache *nc, long size );
+extern void name_cache_free( namecache *nc );
+
+extern int  name_add( fields *info, char *tag, char *q, int level, slist *asis, slist *corps, namecache *nc );
 extern void name_build_withcomma( str *s, char *p );
 extern int  name_parse( str *outname, str *inname, slist *asis, slist *corps );
 extern int  name_addsingleelement( fields *info, char *tag, char *name, int level, int corp );
-extern int  name_addmultielement( fields *info, char *tag, slist *tokens, int begin, int end, int level );
-extern int  name_findetal( slist *tokens );
+extern int  name_addmultielement( fields *info, char *tag, pslist *tokens, int begin, int end, int level );
+extern int  name_findetal( pslist *tokens );
 
 #endif
 
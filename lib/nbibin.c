@@ -14,6 +14,7 @@
 #include "str.h"
 #include "str_conv.h"
 #include "fields.h"
+#include "pslist.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
@@ -21,6 +22,7 @@
 #include "reftypes.h"
 #include "bibformats.h"
 #include "generic.h"
+#include "tagline.h"
 
 extern variants nbib_all[];
 extern int nbib_nall;
@@ -46,6 +48,8 @@ nbibin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = nbib_readf;
@@ -58,6 +62,7 @@ nbibin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -67,41 +72,6 @@ nbibin_initparams( param *p, const char *progname )
  PUBLIC: int nbib_readf()
 *****************************************************/
 
-/* RIS definition of a tag is strict:
-    character 1 = uppercase alphabetic character
-    character 2 = uppercase alphabetic character
-    character 3 = character or space (ansi 32)
-    character 4 = character or space (ansi 32)
-    character 5 = dash (ansi 45)
-    character 6 = space (ansi 32)
-*/
-static int
-is_upperchar( char c )
-{
-	if ( c>='A' && c<='Z' ) return 1;
-	else return 0;
-}
-
-static int
-is_upperchar_space( char c )
-{
-	if ( c==' ' ) return 1;
-	if ( c>='A' && c<='Z' ) return 1;
-	else return 0;
-}
-
-static int
-nbib_istag( char *buf )
-{
-	if ( !is_upperchar( buf[0] ) ) return 0;
-	if ( !is_upperchar( buf[1] ) ) return 0;
-	if ( !is_upperchar_space( buf[2] ) ) return 0;
-	if ( !is_upperchar_space( buf[3] ) ) return 0;
-	if (buf[4]!='-') return 0;
-	if (buf[5]!=' ') return 0;
-	return 1;
-}
-
 static int
 readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
 {
@@ -109,26 +79,10 @@ readmore( FILE *fp, char *buf, int bufsize, int *bufpos, str *line )
 	else return str_fget( fp, buf, bufsize, bufpos, line );
 }
 
-static int
-skip_utf8_bom( str *line, int *fcharset )
-{
-	unsigned char *up;
-
-	if ( line->len < 3 ) return 0;
-
-	up = ( unsigned char *) str_cstr( line );
-	if ( up[0]==0xEF && up[1]==0xBB && up[2]==0xBF ) {
-		*fcharset = CHARSET_UNICODE;
-		return 3;
-	}
-
-	return 0;
-}
-
 static int
 nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *reference, int *fcharset )
 {
-	int n, haveref = 0, inref = 0, readtoofar = 0;
+	int haveref = 0, inref = 0, readtoofar = 0;
 	char *p;
 
 	*fcharset = CHARSET_UNKNOWN;
@@ -142,8 +96,7 @@ nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refer
 		}
 
 		/* ...recognize and skip over UTF8 BOM */
-		n = skip_utf8_bom( line, fcharset );
-		p = &( line->data[n] );
+		p = tagline_skipbom( line->data, fcharset );
 
 		/* Each reference starts with 'PMID- ' && ends with blank line */
 		if ( strncmp(p,"PMID- ",6)==0 ) {
@@ -155,7 +108,7 @@ nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refer
 				inref = 0;
 			}
 		}
-		if ( nbib_istag( p ) ) {
+		if ( tagline_istag( TAGLINE_NBIB, p ) ) {
 			if ( !inref ) {
 				fprintf(stderr,"Warning.  Tagged line not "
 					"in properly started reference.\n");
@@ -181,65 +134,41 @@ nbib_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refer
  PUBLIC: int nbib_processf()
 *****************************************************/
 
-static char*
-process_line2( str *tag, str *data, char *p )
-{
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	while ( *p=='\r' || *p=='\n' ) p++;
-	return p;
-}
-
-static char*
-process_line( str *tag, str *data, char *p )
-{
-	int i;
-
-	i = 0;
-	while ( i<6 && *p ) {
-		if ( *p!=' ' && *p!='-' ) str_addchar( tag, *p );
-		p++;
-		i++;
-	}
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( data, *p++ );
-	str_trimendingws( data );
-	while ( *p=='\n' || *p=='\r' ) p++;
-	return p;
-}
-
 static int
 nbib_processf( fields *nbib, char *p, char *filename, long nref, param *pm )
 {
-	str tag, data;
-	int status, n;
+	int status, n, ret = 1;
+	str tag, data, *od;
+	tagline t;
 
 	strs_init( &tag, &data, NULL );
 
 	while ( *p ) {
-		if ( nbib_istag( p ) )
-			p = process_line( &tag, &data, p );
+		p = tagline_next( TAGLINE_NBIB, p, &t );
+		if ( !tagline_strs( &t, &tag, &data ) ) {
+			ret = 0;
+			goto out;
+		}
 		/* no anonymous fields allowed */
-		if ( str_has_value( &tag ) ) {
+		if ( t.taglen ) {
 			status = fields_add( nbib, str_cstr( &tag ), str_cstr( &data ), 0 );
-			if ( status!=FIELDS_OK ) return 0;
+			if ( status!=FIELDS_OK ) {
+				ret = 0;
+				goto out;
+			}
 		} else {
-			p = process_line2( &tag, &data, p );
 			n = fields_num( nbib );
 			if ( data.len && n>0 ) {
-				str *od;
 				od = fields_value( nbib, n-1, FIELDS_STRP );
 				str_addchar( od, ' ' );
 				str_strcat( od, &data );
 			}
 		}
-		strs_empty( &tag, &data, NULL );
 	}
 
+out:
 	strs_free( &tag, &data, NULL );
-	return 1;
+	return ret;
 }
 
 /*****************************************************
@@ -377,19 +306,19 @@ nbibin_doi( fields *bibin, int n, str *intag, str *invalue, int level, param *pm
 {
 	int fstatus, sstatus, status = BIBL_OK;
 	char *id, *type, *usetag="";
-	slist tokens;
+	pslist tokens;
 
-	slist_init( &tokens );
+	pslist_init( &tokens );
 
-	sstatus = slist_tokenize( &tokens, invalue, " ", 1 );
-	if ( sstatus!=SLIST_OK ) {
+	sstatus = pslist_tokenize( &tokens, invalue, " ", 1 );
+	if ( sstatus!=PSLIST_OK ) {
 		status = BIBL_ERR_MEMERR;
 		goto out;
 	}
 
 	if ( tokens.n == 2 ) {
-		id   = slist_cstr( &tokens, 0 );
-		type = slist_cstr( &tokens, 1 );
+		id   = pslist_cstr( &tokens, 0 );
+		type = pslist_cstr( &tokens, 1 );
 		if ( !strcmp( type, "[doi]" ) ) usetag = "DOI";
 		else if ( !strcmp( type, "[pii]" ) ) usetag = "PII";
 		if ( strlen( outtag ) > 0 ) {
@@ -401,7 +330,7 @@ nbibin_doi( fields *bibin, int n, str *intag, str *invalue, int level, param *pm
 		}
 	}
 out:
-	slist_free( &tokens );
+	pslist_free( &tokens );
 	return status;
 }
 
@@ -15,13 +15,15 @@
 #include "is_ws.h"
 #include "strsearch.h"
 #include "fields.h"
+#include "outfields.h"
 #include "iso639_3.h"
 #include "title.h"
 #include "bibutils.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static int  nbibout_write( fields *info, FILE *fp, param *p, unsigned long refnum );
-static void nbibout_writeheader( FILE *outptr, param *p );
+static int  nbibout_write( fields *info, outsink *fp, param *p, unsigned long refnum );
+static void nbibout_writeheader( outsink *outptr, param *p );
 
 void
 nbibout_initparams( param *p, const char *progname )
@@ -38,6 +40,12 @@ nbibout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	if ( p->charsetout == BIBL_CHARSET_UNICODE ) {
 		p->utf8out = p->utf8bom = 1;
@@ -56,7 +64,7 @@ enum {
 };
 
 static void
-append_type( fields *in, fields *out, int *status )
+append_type( fields *in, outfields *out, int *status )
 {
 	int fstatus;
 	char *s;
@@ -88,12 +96,12 @@ append_type( fields *in, fields *out, int *status )
 	else if ( type==TYPE_BOOK ) s = "Book";
 	else s = "Miscellaneous";
 
-	fstatus = fields_add( out, "PT", s, LEVEL_MAIN );
+	fstatus = outfields_add( out, "PT", s, LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_titlecore( fields *in, char *nbibtag, int level, char *maintag, char *subtag, fields *out, int *status )
+append_titlecore( fields *in, char *nbibtag, int level, char *maintag, char *subtag, outfields *out, int *status )
 {
 	str *mainttl = fields_findv( in, level, FIELDS_STRP, maintag );
 	str *subttl  = fields_findv( in, level, FIELDS_STRP, subtag );
@@ -109,7 +117,7 @@ append_titlecore( fields *in, char *nbibtag, int level, char *maintag, char *sub
 	}
 
 	if ( str_has_value( &fullttl ) ) {
-		fstatus = fields_add( out, nbibtag, str_cstr( &fullttl ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &fullttl ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 out:
@@ -117,13 +125,13 @@ out:
 }
 
 static void
-append_title( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_title( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	append_titlecore( in, nbibtag, level, "TITLE", "SUBTITLE", out, status );
 }
 
 static void
-append_abbrtitle( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_abbrtitle( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	append_titlecore( in, nbibtag, level, "SHORTTITLE", "SHORTSUBTITLE", out, status );
 }
@@ -178,7 +186,7 @@ process_person( str *person, char *name, int full )
 }
 
 static void
-append_people( fields *f, char *tag, char *nbibtag_full, char *nbibtag_abbr, int level, fields *out, int *status )
+append_people( fields *f, char *tag, char *nbibtag_full, char *nbibtag_abbr, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	vplist people;
@@ -193,12 +201,12 @@ append_people( fields *f, char *tag, char *nbibtag_full, char *nbibtag_abbr, int
 
 		process_person( &person, (char *)vplist_get( &people, i ), 1 );
 		if ( str_memerr( &person ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		fstatus = fields_add_can_dup( out, nbibtag_full, str_cstr( &person ), LEVEL_MAIN );
+		fstatus = outfields_add_can_dup( out, nbibtag_full, str_cstr( &person ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 
 		process_person( &person, (char *)vplist_get( &people, i ), 0 );
 		if ( str_memerr( &person ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		fstatus = fields_add_can_dup( out, nbibtag_abbr, str_cstr( &person ), LEVEL_MAIN );
+		fstatus = outfields_add_can_dup( out, nbibtag_abbr, str_cstr( &person ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 
 	}
@@ -209,20 +217,20 @@ out:
 }
 
 static void
-append_easy( fields *in, char *tag, char *nbibtag, int level, fields *out, int *status )
+append_easy( fields *in, char *tag, char *nbibtag, int level, outfields *out, int *status )
 {
 	char *value;
 	int fstatus;
 
 	value = fields_findv( in, level, FIELDS_CHRP, tag );
 	if ( value ) {
-		fstatus = fields_add( out, nbibtag, value, LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, value, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_easyall( fields *in, char *tag, char *nbibtag, int level, fields *out, int *status )
+append_easyall( fields *in, char *tag, char *nbibtag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -231,14 +239,14 @@ append_easyall( fields *in, char *tag, char *nbibtag, int level, fields *out, in
 	vplist_init( &a );
 	fields_findv_each( in, level, FIELDS_CHRP, &a, tag );
 	for ( i=0; i<a.n; ++i ) {
-		fstatus = fields_add( out, nbibtag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	vplist_free( &a );
 }
 
 static void
-append_pages( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_pages( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	str *start, *stop, *articlenumber;
 	int fstatus;
@@ -278,7 +286,7 @@ append_pages( fields *in, char *nbibtag, int level, fields *out, int *status )
 	}
 
 	if ( str_has_value( &pages ) ) {
-		fstatus = fields_add( out, nbibtag, str_cstr( &pages ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &pages ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -287,7 +295,7 @@ append_pages( fields *in, char *nbibtag, int level, fields *out, int *status )
 
 /* location identifier */
 static void
-append_lid( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_lid( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	str *doi, *pii, *isi;
 	int fstatus;
@@ -299,7 +307,7 @@ append_lid( fields *in, char *nbibtag, int level, fields *out, int *status )
 	if ( doi ) {
 		str_strcpy( &lid, doi );
 		str_strcatc( &lid, " [doi]" );
-		fstatus = fields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -307,7 +315,7 @@ append_lid( fields *in, char *nbibtag, int level, fields *out, int *status )
 	if ( pii ) {
 		str_strcpy( &lid, pii );
 		str_strcatc( &lid, " [pii]" );
-		fstatus = fields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -315,7 +323,7 @@ append_lid( fields *in, char *nbibtag, int level, fields *out, int *status )
 	if ( isi ) {
 		str_strcpy( &lid, isi );
 		str_strcatc( &lid, " [isi]" );
-		fstatus = fields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &lid ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -325,7 +333,7 @@ append_lid( fields *in, char *nbibtag, int level, fields *out, int *status )
 }
 
 static void
-append_date( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_date( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	str *day, *month, *year;
 	int fstatus;
@@ -351,7 +359,7 @@ append_date( fields *in, char *nbibtag, int level, fields *out, int *status )
 	}
 
 	if ( str_has_value( &date ) ) {
-		fstatus = fields_add( out, nbibtag, str_cstr( &date ), LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, str_cstr( &date ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	
@@ -359,7 +367,7 @@ append_date( fields *in, char *nbibtag, int level, fields *out, int *status )
 }
 
 static void
-append_lang( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_lang( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	int fstatus;
 	str *lang;
@@ -369,13 +377,13 @@ append_lang( fields *in, char *nbibtag, int level, fields *out, int *status )
 	if ( lang ) {
 		code = iso639_3_from_name( str_cstr( lang ) );
 		if ( !code ) code = str_cstr( lang );
-		fstatus = fields_add( out, nbibtag, code, LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, code, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_keywords( fields *in, char *nbibtag, int level, fields *out, int *status )
+append_keywords( fields *in, char *nbibtag, int level, outfields *out, int *status )
 {
 	vplist keywords;
 	int fstatus;
@@ -387,14 +395,14 @@ append_keywords( fields *in, char *nbibtag, int level, fields *out, int *status
 	fields_findv_each( in, level, FIELDS_CHRP, &keywords, "KEYWORD" );
 	for ( i=0; i<keywords.n; ++i ) {
 		kw = vplist_get( &keywords, i );
-		fstatus = fields_add( out, nbibtag, kw, LEVEL_MAIN );
+		fstatus = outfields_add( out, nbibtag, kw, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	
 }
 
 static int
-append_data( fields *in, fields *out )
+append_data( fields *in, outfields *out )
 {
 	int status = BIBL_OK;
 
@@ -441,33 +449,25 @@ output_verbose( fields *f, const char *type, unsigned long refnum )
 }
 
 static void
-output_tag( FILE *fp, char *p )
+output_tag( outsink *fp, const char *p )
 {
 	int i = 0;
 
-	while ( i < 4 && p && *p ) {
-		fprintf( fp, "%c", *p );
-		i++;
-		p++;
+	if ( p ) {
+		while ( i < 4 && p[i] ) i++;
+		outsink_write( fp, p, i );
 	}
-
-	for ( ; i<4; ++i )
-		fprintf( fp, " " );
-	fprintf( fp, "- " );
+	outsink_write( fp, "    ", 4-i );
+	outsink_puts( fp, "- " );
 }
 
 static void
-output_value( FILE *fp, str *value )
+output_value( outsink *fp, const char *value )
 {
-	char *p, *q, *lastws;
+	const char *p, *q, *lastws;
 	int n;
 
-	if ( value->len < 82 ) {
-		fprintf( fp, "%s", str_cstr( value ) );
-		return;
-	}
-
-	p = str_cstr( value );
+	p = value;
 	while ( p && *p ) {
 		n = 0;
 		q = p;
@@ -478,67 +478,62 @@ output_value( FILE *fp, str *value )
 			n++;
 		}
 		if ( *q && lastws ) {
-			while ( p!=lastws ) {
-				fprintf( fp, "%c", *p );
-				p++;
-			}
-			p++; /* skip ws separator */
+			outsink_write( fp, p, lastws - p );
+			p = lastws + 1; /* skip ws separator */
 		}
 		else {
-			while ( p!=q ) {
-				fprintf( fp, "%c", *p );
-				p++;
-			}
+			outsink_write( fp, p, q - p );
 			p = q;
 		}
 		if ( *p ) {
-			fprintf( fp, "\n" );
-			fprintf( fp, "      " );
+			outsink_puts( fp, "\n" );
+			outsink_puts( fp, "      " );
 		}
 	}
 }
 
 static void
-output_reference( FILE *fp, fields *out )
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
 {
-	int i;
-
-	for ( i=0; i<out->n; ++i ) {
-
-		output_tag( fp, ( char * ) fields_tag( out, i, FIELDS_CHRP ) );
-		output_value( fp, ( str * ) fields_value( out, i, FIELDS_STRP ) );
-		fprintf( fp, "\n" );
-	}
-
-        fprintf( fp, "\n\n" );
-        fflush( fp );
+	output_tag( fp, tag );
+	output_value( fp, value );
+	outsink_puts( fp, "\n" );
 }
 
 static int
-nbibout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+nbibout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
+	fields verbose;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, NULL );
+	fields_init( &verbose );
 
-	if ( p->format_opts & BIBL_FORMAT_VERBOSE )
+	/* ...verbose output needs the full record, so collect it first */
+	if ( p->format_opts & BIBL_FORMAT_VERBOSE ) {
 		output_verbose( in, "IN", refnum );
+		outfields_collect( &out, &verbose );
+	}
 
 	status = append_data( in, &out );
 
-	if ( status==BIBL_OK ) output_reference( fp, &out );
+	if ( status==BIBL_OK ) {
+		outfields_write( &out );
+		outsink_puts( fp, "\n\n" );
+	}
 
 	if ( p->format_opts & BIBL_FORMAT_VERBOSE )
-		output_verbose( &out, "OUT", refnum );
+		output_verbose( &verbose, "OUT", refnum );
 
-	fields_free( &out );
+	fields_free( &verbose );
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-nbibout_writeheader( FILE *outptr, param *p )
+nbibout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
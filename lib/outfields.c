@@ -0,0 +1,157 @@
+/*
+ * outfields.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Direct emission of a writer's output record. The writers used to
+ * build a complete fields of output tags for every reference and then
+ * print it; here each pair goes to the outsink as soon as it is added.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "phash.h"
+#include "outfields.h"
+
+void
+outfields_init( outfields *of, outsink *o, outfields_writef writef, void *data )
+{
+	of->o       = o;
+	of->writef  = writef;
+	of->data    = data;
+	of->f       = NULL;
+	of->n       = 0;
+	of->seen    = of->seen0;
+	of->nseen   = 0;
+	of->maxseen = OUTFIELDS_NSEEN;
+	of->buf     = of->buf0;
+	of->len     = 0;
+	of->max     = OUTFIELDS_SEENBUF;
+}
+
+/* outfields_collect()
+ *
+ * Store pairs in f rather than writing them; outfields_write() will
+ * emit them later.
+ */
+void
+outfields_collect( outfields *of, fields *f )
+{
+	of->f = f;
+}
+
+void
+outfields_write( outfields *of )
+{
+	char *tag, *value;
+	int i;
+
+	if ( !of->f ) return;
+
+	for ( i=0; i<of->f->n; ++i ) {
+		tag   = fields_tag( of->f, i, FIELDS_CHRP );
+		value = fields_value( of->f, i, FIELDS_CHRP );
+		of->writef( of->o, tag, value, of->n++, of->data );
+	}
+}
+
+void
+outfields_free( outfields *of )
+{
+	if ( of->seen != of->seen0 ) free( of->seen );
+	if ( of->buf != of->buf0 ) free( of->buf );
+	outfields_init( of, NULL, NULL, NULL );
+}
+
+/* case-insensitive, to match the strcasecmp() in fields_add() */
+static unsigned long
+outfields_hash( const char *tag, const char *value, int level )
+{
+	return phash_hash( value, PHASH_WHOLE, phash_hash( tag, PHASH_WHOLE, ( unsigned long ) level ) );
+}
+
+static int
+outfields_isseen( outfields *of, unsigned long hash, const char *tag, const char *value, int level )
+{
+	int i;
+
+	for ( i=0; i<of->nseen; ++i ) {
+		if ( of->seen[i].hash==hash &&
+		     of->seen[i].level==level &&
+		     !strcasecmp( of->buf + of->seen[i].tag, tag ) &&
+		     !strcasecmp( of->buf + of->seen[i].value, value ) )
+			return 1;
+	}
+
+	return 0;
+}
+
+static int
+outfields_remember( outfields *of, unsigned long hash, const char *tag, const char *value, int level )
+{
+	unsigned long ntag = strlen( tag ) + 1, nvalue = strlen( value ) + 1, max;
+	outfields_seen *seen;
+	char *buf;
+
+	if ( of->nseen == of->maxseen ) {
+		seen = ( outfields_seen * ) malloc( sizeof( outfields_seen ) * of->maxseen * 2 );
+		if ( !seen ) return FIELDS_ERR;
+		memcpy( seen, of->seen, sizeof( outfields_seen ) * of->nseen );
+		if ( of->seen != of->seen0 ) free( of->seen );
+		of->seen = seen;
+		of->maxseen *= 2;
+	}
+
+	if ( of->len + ntag + nvalue > of->max ) {
+		max = of->max * 2;
+		while ( of->len + ntag + nvalue > max ) max *= 2;
+		buf = ( char * ) malloc( max );
+		if ( !buf ) return FIELDS_ERR;
+		memcpy( buf, of->buf, of->len );
+		if ( of->buf != of->buf0 ) free( of->buf );
+		of->buf = buf;
+		of->max = max;
+	}
+
+	seen = &( of->seen[ of->nseen++ ] );
+	seen->hash  = hash;
+	seen->level = level;
+	seen->tag   = of->len;
+	memcpy( of->buf + of->len, tag, ntag );
+	of->len += ntag;
+	seen->value = of->len;
+	memcpy( of->buf + of->len, value, nvalue );
+	of->len += nvalue;
+
+	return FIELDS_OK;
+}
+
+/* _outfields_add()
+ *
+ * Same contract as _fields_add(): NULL tags or values are silently
+ * skipped, and with FIELDS_NO_DUPS an identical (case-insensitive)
+ * pair at the same level is only emitted once.
+ */
+int
+_outfields_add( outfields *of, const char *tag, const char *value, int level, int mode )
+{
+	unsigned long hash;
+
+	if ( !tag || !value ) return FIELDS_OK;
+
+	if ( of->f ) return _fields_add( of->f, ( char * ) tag, ( char * ) value, level, mode );
+
+	hash = outfields_hash( tag, value, level );
+	if ( mode==FIELDS_NO_DUPS && outfields_isseen( of, hash, tag, value, level ) )
+		return FIELDS_OK;
+
+	if ( outfields_remember( of, hash, tag, value, level )!=FIELDS_OK )
+		return FIELDS_ERR;
+
+	of->writef( of->o, tag, value, of->n++, of->data );
+
+	return FIELDS_OK;
+}
@@ -0,0 +1,63 @@
+/*
+ * outfields.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef OUTFIELDS_H
+#define OUTFIELDS_H
+
+#include "fields.h"
+#include "outsink.h"
+
+#define OUTFIELDS_NSEEN   (64)
+#define OUTFIELDS_SEENBUF (4096)
+
+/* called once per emitted tag/value pair; n counts the pairs already
+ * emitted for the current reference, data is the writer's own pointer */
+typedef void (*outfields_writef)( outsink *o, const char *tag, const char *value, unsigned long n, void *data );
+
+typedef struct outfields_seen {
+	unsigned long hash;
+	unsigned long tag;    /* offsets into buf */
+	unsigned long value;
+	int           level;
+} outfields_seen;
+
+/* The writers' output record. Pairs are formatted straight into the
+ * outsink as they are added, with the same FIELDS_NO_DUPS semantics
+ * as fields_add(); if a fields is attached with outfields_collect()
+ * they are stored there instead, e.g. for verbose dumps.
+ *
+ * The duplicate check remembers pairs in small inline arrays, so the
+ * common reference costs no allocations at all.
+ */
+typedef struct outfields {
+	outsink          *o;
+	outfields_writef writef;
+	void             *data;
+	fields           *f;
+	unsigned long    n;
+	outfields_seen   *seen;
+	int              nseen;
+	int              maxseen;
+	char             *buf;
+	unsigned long    len;
+	unsigned long    max;
+	outfields_seen   seen0[ OUTFIELDS_NSEEN ];
+	char             buf0[ OUTFIELDS_SEENBUF ];
+} outfields;
+
+void outfields_init    ( outfields *of, outsink *o, outfields_writef writef, void *data );
+void outfields_collect ( outfields *of, fields *f );
+void outfields_write   ( outfields *of );
+void outfields_free    ( outfields *of );
+
+#define outfields_add( a, b, c, d )         _outfields_add( a, b, c, d, FIELDS_NO_DUPS )
+#define outfields_add_can_dup( a, b, c, d ) _outfields_add( a, b, c, d, FIELDS_CAN_DUP )
+
+int _outfields_add( outfields *of, const char *tag, const char *value, int level, int mode );
+
+#endif
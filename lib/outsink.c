@@ -0,0 +1,340 @@
+/*
+ * outsink.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Buffered output for the reference writers. Appends go into one
+ * large buffer that is written to the FILE* only when it fills, so
+ * a large export costs a handful of fwrite() calls rather than a
+ * formatted print (and often a flush) per character or record.
+ *
+ * An asynchronous sink also moves the fwrite() calls onto an I/O
+ * thread: full buffers are queued for it while the caller goes on
+ * formatting into the next, so a slow disk or a pipe into another
+ * program doesn't stall the writer.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "utf8.h"
+#include "outsink.h"
+
+/* Full buffers queue up in ring order from buf[head]; the caller fills
+ * buf[fill], the one after the queue, and waits only when all the
+ * others are still queued for the I/O thread.
+ */
+struct outsink_async {
+	FILE            *fp;
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	char            *buf[OUTSINK_NBUFS];
+	unsigned long   len[OUTSINK_NBUFS];
+	int             head, nqueued, fill;
+	int             done;
+	int             status;
+};
+
+int
+outsink_init( outsink *o, FILE *fp )
+{
+	o->fp     = fp;
+	o->len    = 0;
+	o->max    = OUTSINK_BUFSIZE;
+	o->nout   = 0;
+	o->status = OUTSINK_OK;
+	o->async  = NULL;
+	o->buf    = ( char * ) malloc( o->max );
+	if ( !o->buf ) {
+		o->max    = 0;
+		o->status = OUTSINK_MEMERR;
+	}
+	return o->status;
+}
+
+static void *
+outsink_drain( void *arg )
+{
+	struct outsink_async *a = ( struct outsink_async * ) arg;
+	int n, ok;
+
+	pthread_mutex_lock( &(a->lock) );
+	while ( 1 ) {
+		while ( a->nqueued==0 && !a->done )
+			pthread_cond_wait( &(a->cond), &(a->lock) );
+		if ( a->nqueued==0 ) break;
+		n = a->head;
+		pthread_mutex_unlock( &(a->lock) );
+
+		ok = ( fwrite( a->buf[n], 1, a->len[n], a->fp )==a->len[n] );
+
+		pthread_mutex_lock( &(a->lock) );
+		if ( !ok ) a->status = OUTSINK_ERR;
+		a->head = ( a->head + 1 ) % OUTSINK_NBUFS;
+		a->nqueued--;
+		pthread_cond_signal( &(a->cond) );
+	}
+	pthread_mutex_unlock( &(a->lock) );
+
+	return NULL;
+}
+
+/* outsink_initasync()
+ *
+ * As outsink_init(), but fp is written on a thread of its own. Falls
+ * back to an ordinary sink if the thread or buffers can't be had.
+ */
+int
+outsink_initasync( outsink *o, FILE *fp )
+{
+	struct outsink_async *a;
+	int i;
+
+	if ( outsink_init( o, fp )!=OUTSINK_OK ) return o->status;
+
+	a = ( struct outsink_async * ) calloc( 1, sizeof( struct outsink_async ) );
+	if ( !a ) return o->status;
+
+	a->fp = fp;
+	a->buf[0] = o->buf;
+	for ( i=1; i<OUTSINK_NBUFS; ++i ) {
+		a->buf[i] = ( char * ) malloc( o->max );
+		if ( !a->buf[i] ) goto fail;
+	}
+
+	pthread_mutex_init( &(a->lock), NULL );
+	pthread_cond_init( &(a->cond), NULL );
+	if ( pthread_create( &(a->thread), NULL, outsink_drain, a ) ) {
+		pthread_mutex_destroy( &(a->lock) );
+		pthread_cond_destroy( &(a->cond) );
+		goto fail;
+	}
+
+	o->async = a;
+	return o->status;
+
+fail:
+	for ( i=1; i<OUTSINK_NBUFS; ++i )
+		free( a->buf[i] );
+	free( a );
+	return o->status;
+}
+
+/* queue the current buffer and move on to the next free one */
+static int
+outsink_asyncflush( outsink *o )
+{
+	struct outsink_async *a = o->async;
+
+	pthread_mutex_lock( &(a->lock) );
+	if ( o->len ) {
+		a->len[ a->fill ] = o->len;
+		a->nqueued++;
+		pthread_cond_signal( &(a->cond) );
+		a->fill = ( a->fill + 1 ) % OUTSINK_NBUFS;
+		o->nout += o->len;
+		o->len = 0;
+		while ( a->nqueued==OUTSINK_NBUFS )
+			pthread_cond_wait( &(a->cond), &(a->lock) );
+		o->buf = a->buf[ a->fill ];
+	}
+	if ( a->status!=OUTSINK_OK ) o->status = a->status;
+	pthread_mutex_unlock( &(a->lock) );
+
+	return o->status;
+}
+
+/* queue what is left, wait for the I/O thread to write it all, and
+ * tear the thread down */
+static int
+outsink_asyncfree( outsink *o )
+{
+	struct outsink_async *a = o->async;
+	int i;
+
+	outsink_asyncflush( o );
+
+	pthread_mutex_lock( &(a->lock) );
+	a->done = 1;
+	pthread_cond_signal( &(a->cond) );
+	pthread_mutex_unlock( &(a->lock) );
+	pthread_join( a->thread, NULL );
+
+	if ( a->status!=OUTSINK_OK ) o->status = a->status;
+
+	pthread_mutex_destroy( &(a->lock) );
+	pthread_cond_destroy( &(a->cond) );
+	for ( i=0; i<OUTSINK_NBUFS; ++i )
+		free( a->buf[i] );
+	free( a );
+
+	o->async = NULL;
+	o->buf = NULL;
+	o->max = 0;
+	return o->status;
+}
+
+int
+outsink_flush( outsink *o )
+{
+	if ( o->async ) return outsink_asyncflush( o );
+	if ( o->len ) {
+		if ( fwrite( o->buf, 1, o->len, o->fp )!=o->len )
+			o->status = OUTSINK_ERR;
+		o->nout += o->len;
+		o->len = 0;
+	}
+	return o->status;
+}
+
+/* outsink_free()
+ *
+ * Write anything still buffered and release the buffer; the FILE*
+ * itself is left open (and unflushed) for the caller.
+ */
+int
+outsink_free( outsink *o )
+{
+	int status;
+	if ( o->async ) return outsink_asyncfree( o );
+	status = outsink_flush( o );
+	free( o->buf );
+	o->buf = NULL;
+	o->max = 0;
+	return status;
+}
+
+/* total bytes written to the sink so far, buffered or not */
+unsigned long
+outsink_tell( outsink *o )
+{
+	return o->nout + o->len;
+}
+
+void
+outsink_write( outsink *o, const char *s, unsigned long n )
+{
+	if ( n > o->max - o->len ) {
+		outsink_flush( o );
+		/* an asynchronous sink must keep everything in order on
+		 * its I/O thread, so large spans go through the buffers */
+		while ( o->async && n >= o->max ) {
+			memcpy( o->buf, s, o->max );
+			o->len = o->max;
+			outsink_flush( o );
+			s += o->max;
+			n -= o->max;
+		}
+		/* spans larger than the buffer go straight out */
+		if ( n >= o->max ) {
+			if ( n && fwrite( s, 1, n, o->fp )!=n )
+				o->status = OUTSINK_ERR;
+			o->nout += n;
+			return;
+		}
+	}
+	memcpy( o->buf + o->len, s, n );
+	o->len += n;
+}
+
+void
+outsink_putc( outsink *o, char c )
+{
+	if ( o->len == o->max ) {
+		outsink_flush( o );
+		if ( o->max==0 ) {
+			if ( fputc( c, o->fp )==EOF ) o->status = OUTSINK_ERR;
+			o->nout++;
+			return;
+		}
+	}
+	o->buf[ o->len++ ] = c;
+}
+
+void
+outsink_puts( outsink *o, const char *s )
+{
+	outsink_write( o, s, strlen( s ) );
+}
+
+void
+outsink_str( outsink *o, str *s )
+{
+	if ( s->len ) outsink_write( o, s->data, s->len );
+}
+
+/* write s n times, e.g. indentation */
+void
+outsink_repeat( outsink *o, const char *s, int n )
+{
+	unsigned long len = strlen( s );
+	int i;
+	for ( i=0; i<n; ++i )
+		outsink_write( o, s, len );
+}
+
+void
+outsink_toupper( outsink *o, const char *s )
+{
+	while ( *s ) {
+		outsink_putc( o, toupper( (unsigned char) *s ) );
+		s++;
+	}
+}
+
+void
+outsink_printf( outsink *o, const char *fmt, ... )
+{
+	unsigned long avail = o->max - o->len;
+	va_list ap;
+	char *tmp;
+	int n;
+
+	va_start( ap, fmt );
+	n = vsnprintf( ( o->buf ) ? o->buf + o->len : NULL, avail, fmt, ap );
+	va_end( ap );
+	if ( n < 0 ) {
+		o->status = OUTSINK_ERR;
+		return;
+	}
+	if ( (unsigned long) n < avail ) {
+		o->len += n;
+		return;
+	}
+
+	/* didn't fit in what was left; retry in an empty buffer */
+	outsink_flush( o );
+	if ( (unsigned long) n < o->max ) {
+		va_start( ap, fmt );
+		vsnprintf( o->buf, o->max, fmt, ap );
+		va_end( ap );
+		o->len = n;
+		return;
+	}
+
+	/* larger than the whole buffer */
+	tmp = ( char * ) malloc( n + 1 );
+	if ( !tmp ) {
+		o->status = OUTSINK_MEMERR;
+		return;
+	}
+	va_start( ap, fmt );
+	vsnprintf( tmp, n + 1, fmt, ap );
+	va_end( ap );
+	outsink_write( o, tmp, n );
+	free( tmp );
+}
+
+void
+outsink_writebom( outsink *o )
+{
+	char bom[7];
+	utf8_encode_str( 0xFEFF, bom );
+	outsink_puts( o, bom );
+}
@@ -0,0 +1,54 @@
+/*
+ * outsink.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef OUTSINK_H
+#define OUTSINK_H
+
+#include <stdio.h>
+#include "str.h"
+
+#define OUTSINK_OK     (0)
+#define OUTSINK_MEMERR (-1)
+#define OUTSINK_ERR    (-2)
+
+#define OUTSINK_BUFSIZE (256*1024)
+#define OUTSINK_NBUFS   (4)   /* buffers in flight for an asynchronous sink */
+
+/* Buffered output for the writers: everything is appended to buf
+ * and handed to fp only when the buffer fills or at outsink_free().
+ * An asynchronous sink hands full buffers to its own I/O thread and
+ * carries on filling the next one.
+ */
+struct outsink_async;
+
+typedef struct outsink {
+	FILE          *fp;
+	char          *buf;
+	unsigned long len;
+	unsigned long max;
+	unsigned long nout;	/* bytes already handed to fp */
+	int           status;
+	struct outsink_async *async;	/* NULL if written on the caller's thread */
+} outsink;
+
+int  outsink_init     ( outsink *o, FILE *fp );
+int  outsink_initasync( outsink *o, FILE *fp );
+int  outsink_flush    ( outsink *o );
+int  outsink_free     ( outsink *o );
+unsigned long outsink_tell( outsink *o );
+
+void outsink_write    ( outsink *o, const char *s, unsigned long n );
+void outsink_putc     ( outsink *o, char c );
+void outsink_puts     ( outsink *o, const char *s );
+void outsink_str      ( outsink *o, str *s );
+void outsink_repeat   ( outsink *o, const char *s, int n );
+void outsink_toupper  ( outsink *o, const char *s );
+void outsink_printf   ( outsink *o, const char *fmt, ... );
+void outsink_writebom ( outsink *o );
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * phash.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "phash.h"
+
+/* Hash and displace: keys are split into buckets by one hash, then,
+ * largest bucket first, each bucket is given the first seed that puts
+ * all of its keys into free slots.  A lookup is two hashes and one
+ * comparison.
+ */
+
+#define PHASH_MAXSEED (1UL<<20)
+
+static const char *
+phash_key( phash *h, int n )
+{
+	return *( const char * const * ) ( h->base + h->stride * n );
+}
+
+/* phash_hash()
+ *
+ * FNV-1a of the first len characters of s, or as many as come before
+ * a '\0', folding case as strcasecmp() does in the C locale.
+ */
+unsigned long
+phash_hash( const char *s, unsigned long len, unsigned long seed )
+{
+	unsigned long i, hash = 2166136261UL ^ ( seed * 16777619UL );
+	unsigned char c;
+	for ( i=0; i<len && ( c = ( unsigned char ) s[i] ); ++i ) {
+		if ( c>='A' && c<='Z' ) c = c - 'A' + 'a';
+		hash = ( hash ^ c ) * 16777619UL;
+	}
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6dUL;
+	hash ^= hash >> 12;
+	return hash;
+}
+
+/* place the keys of one bucket; returns 0 if no seed fits */
+static int
+phash_place( phash *h, unsigned long b, int *keys, int nkeys, unsigned long *slots )
+{
+	unsigned long seed, s;
+	int i, j, ok;
+
+	for ( seed=1; seed<PHASH_MAXSEED; ++seed ) {
+		ok = 1;
+		for ( i=0; i<nkeys && ok; ++i ) {
+			s = phash_hash( phash_key( h, keys[i] ), PHASH_WHOLE, seed ) & h->mask;
+			if ( h->slot[s]!=-1 ) ok = 0;
+			for ( j=0; j<i && ok; ++j )
+				if ( slots[j]==s ) ok = 0;
+			slots[i] = s;
+		}
+		if ( !ok ) continue;
+		for ( i=0; i<nkeys; ++i ) h->slot[ slots[i] ] = keys[i];
+		h->disp[b] = seed;
+		return 1;
+	}
+	return 0;
+}
+
+int
+phash_build( phash *h, const void *base, size_t stride, int n )
+{
+	unsigned long b, o, sz, size = 1, *slots = NULL, *start = NULL, *order = NULL;
+	int i, j, k, nkeys, *bk, *keys = NULL, status = PHASH_OK;
+
+	h->base     = ( const char * ) base;
+	h->stride   = stride;
+	h->n        = n;
+	h->nbuckets = n / 4 + 1;
+	while ( size < 2 * (unsigned long) n ) size *= 2;
+	h->mask     = size - 1;
+	h->disp     = ( unsigned long * ) calloc( h->nbuckets, sizeof( unsigned long ) );
+	h->slot     = ( int * ) malloc( size * sizeof( int ) );
+	keys        = ( int * ) malloc( ( n + 1 ) * sizeof( int ) );
+	slots       = ( unsigned long * ) malloc( ( n + 1 ) * sizeof( unsigned long ) );
+	start       = ( unsigned long * ) calloc( h->nbuckets + 1, sizeof( unsigned long ) );
+	order       = ( unsigned long * ) malloc( h->nbuckets * sizeof( unsigned long ) );
+	if ( !h->disp || !h->slot || !keys || !slots || !start || !order ) {
+		status = PHASH_ERR_MEMERR;
+		goto out;
+	}
+	for ( b=0; b<=h->mask; ++b ) h->slot[b] = -1;
+
+	/* keys grouped by bucket, each group in table order */
+	for ( i=0; i<n; ++i ) start[ phash_hash( phash_key( h, i ), PHASH_WHOLE, 0 ) % h->nbuckets + 1 ]++;
+	for ( b=0; b<h->nbuckets; ++b ) start[b+1] += start[b];
+	for ( b=0; b<h->nbuckets; ++b ) slots[b] = start[b];
+	for ( i=0; i<n; ++i ) keys[ slots[ phash_hash( phash_key( h, i ), PHASH_WHOLE, 0 ) % h->nbuckets ]++ ] = i;
+
+	/* largest buckets first, while there is most room */
+	for ( b=0; b<h->nbuckets; ++b ) order[b] = b;
+	for ( b=1; b<h->nbuckets; ++b ) {
+		o = order[b];
+		sz = start[o+1] - start[o];
+		for ( i=b; i>0 && start[order[i-1]+1] - start[order[i-1]] < sz; --i )
+			order[i] = order[i-1];
+		order[i] = o;
+	}
+
+	for ( b=0; b<h->nbuckets; ++b ) {
+		bk = keys + start[ order[b] ];
+		nkeys = start[ order[b]+1 ] - start[ order[b] ];
+		/* drop later copies of a key */
+		for ( i=k=0; i<nkeys; ++i ) {
+			for ( j=0; j<k; ++j )
+				if ( !strcasecmp( phash_key( h, bk[j] ), phash_key( h, bk[i] ) ) ) break;
+			if ( j==k ) bk[k++] = bk[i];
+		}
+		if ( !phash_place( h, order[b], bk, k, slots ) ) {
+			status = PHASH_ERR_BUILD;
+			goto out;
+		}
+	}
+
+out:
+	free( keys );
+	free( slots );
+	free( start );
+	free( order );
+	if ( status!=PHASH_OK ) phash_free( h );
+	return status;
+}
+
+/* phash_find()
+ *
+ * Returns the entry whose key matches query, ignoring case, or -1.
+ */
+int
+phash_find( phash *h, const char *query )
+{
+	unsigned long b;
+	int n;
+
+	b = phash_hash( query, PHASH_WHOLE, 0 ) % h->nbuckets;
+	n = h->slot[ phash_hash( query, PHASH_WHOLE, h->disp[b] ) & h->mask ];
+	if ( n==-1 || strcasecmp( phash_key( h, n ), query ) ) return -1;
+	return n;
+}
+
+/* phash_findn()
+ *
+ * As phash_find() for the first len characters of query.
+ */
+int
+phash_findn( phash *h, const char *query, unsigned long len )
+{
+	const char *key;
+	unsigned long b;
+	int n;
+
+	len = strnlen( query, len );
+	b = phash_hash( query, len, 0 ) % h->nbuckets;
+	n = h->slot[ phash_hash( query, len, h->disp[b] ) & h->mask ];
+	if ( n==-1 ) return -1;
+	key = phash_key( h, n );
+	if ( strlen( key )!=len || strncasecmp( key, query, len ) ) return -1;
+	return n;
+}
+
+/* phash_probe()
+ *
+ * Linear probing from the slot that hash picks in a table of mask+1
+ * slots; the table must have an empty slot.
+ */
+unsigned long
+phash_probe( const void *table, unsigned long mask, unsigned long hash,
+		int (*stop)( const void *table, unsigned long slot, const void *key ),
+		const void *key )
+{
+	unsigned long i = hash & mask;
+	while ( !stop( table, i, key ) ) i = ( i + 1 ) & mask;
+	return i;
+}
+
+void
+phash_free( phash *h )
+{
+	free( h->disp );
+	free( h->slot );
+	h->disp = NULL;
+	h->slot = NULL;
+	h->n    = 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * phash.h
+ *
+ * Perfect hashes over static tables of strings, for vocabularies
+ * that are looked up without regard to case.
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef PHASH_H
+#define PHASH_H
+
+#include <stddef.h>
+
+#define PHASH_OK         (0)
+#define PHASH_ERR_MEMERR (-1)
+#define PHASH_ERR_BUILD  (-2)
+
+#define PHASH_WHOLE ( (unsigned long) -1 ) /* len to hash all of a string */
+
+/* Keys are the char * that starts each of n entries of size stride
+ * at base: a plain array of strings, or an array of structures that
+ * begin with their key.  A key listed twice gives its first entry.
+ */
+typedef struct phash {
+	const char    *base;
+	size_t        stride;
+	int           n;
+	unsigned long nbuckets;
+	unsigned long mask;  /* slots - 1 */
+	unsigned long *disp; /* seed for each bucket */
+	int           *slot; /* entry for each slot, -1 for none */
+} phash;
+
+int  phash_build( phash *h, const void *base, size_t stride, int n );
+int  phash_find ( phash *h, const char *query );
+int  phash_findn( phash *h, const char *query, unsigned long len );
+void phash_free ( phash *h );
+
+/* The same hash serves the open-addressed tables that are filled as
+ * they go, which find a key's slot with phash_probe(): stop() is true
+ * for a slot that is empty or holds key.
+ */
+unsigned long phash_hash ( const char *s, unsigned long len, unsigned long seed );
+unsigned long phash_probe( const void *table, unsigned long mask, unsigned long hash,
+                           int (*stop)( const void *table, unsigned long slot, const void *key ),
+                           const void *key );
+
+#endif
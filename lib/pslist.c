@@ -0,0 +1,248 @@
+/*
+ * pslist.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Implements a list of strings held in one pool, so that filling it
+ * with the tokens of a field costs no allocations when it is short and
+ * a couple when it isn't, rather than one per token.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pslist.h"
+
+/* Do not use asserts if PSLIST_NOASSERT defined */
+#ifdef PSLIST_NOASSERT
+#define NDEBUG
+#endif
+#include <assert.h>
+
+static inline int
+pslist_valid_num( pslist *a, pslist_index n )
+{
+	if ( n < 0 || n >= a->n ) return 0;
+	return 1;
+}
+
+static inline pslist_span *
+pslist_spans( pslist *a )
+{
+	return ( a->span ) ? a->span : a->sspan;
+}
+
+static inline char *
+pslist_pool( pslist *a )
+{
+	return ( a->pool ) ? a->pool : a->spool;
+}
+
+void
+pslist_init( pslist *a )
+{
+	assert( a );
+
+	a->n = 0;
+	a->max = PSLIST_NSPANS;
+	a->span = NULL;
+	a->pool = NULL;
+	a->used = 0;
+	a->size = PSLIST_POOLSIZE;
+}
+
+void
+pslist_free( pslist *a )
+{
+	assert( a );
+
+	if ( a->span ) free( a->span );
+	if ( a->pool ) free( a->pool );
+	pslist_init( a );
+}
+
+/* keeps the memory for reuse */
+void
+pslist_empty( pslist *a )
+{
+	assert( a );
+
+	a->n = 0;
+	a->used = 0;
+}
+
+static int
+pslist_ensure_spans( pslist *a )
+{
+	pslist_span *more;
+	pslist_index alloc;
+
+	if ( a->n < a->max ) return PSLIST_OK;
+
+	alloc = a->max * 2;
+	if ( a->span ) more = ( pslist_span * ) realloc( a->span, sizeof( pslist_span ) * alloc );
+	else {
+		more = ( pslist_span * ) malloc( sizeof( pslist_span ) * alloc );
+		if ( more ) memcpy( more, a->sspan, sizeof( pslist_span ) * a->n );
+	}
+	if ( !more ) return PSLIST_ERR_MEMERR;
+
+	a->span = more;
+	a->max  = alloc;
+
+	return PSLIST_OK;
+}
+
+static int
+pslist_ensure_pool( pslist *a, unsigned long len )
+{
+	unsigned long alloc;
+	char *more;
+
+	if ( a->used + len <= a->size ) return PSLIST_OK;
+
+	alloc = a->size * 2;
+	if ( alloc < a->used + len ) alloc = a->used + len;
+	if ( a->pool ) more = ( char * ) realloc( a->pool, alloc );
+	else {
+		more = ( char * ) malloc( alloc );
+		if ( more ) memcpy( more, a->spool, a->used );
+	}
+	if ( !more ) return PSLIST_ERR_MEMERR;
+
+	a->pool = more;
+	a->size = alloc;
+
+	return PSLIST_OK;
+}
+
+/* pslist_addseg()
+ *
+ * Adds the string from start up to (but not including) end.  The
+ * segment may come from the list itself.
+ */
+int
+pslist_addseg( pslist *a, const char *start, const char *end )
+{
+	unsigned long len, from = 0;
+	int inpool, status;
+	pslist_span *s;
+	char *pool;
+
+	assert( a );
+	assert( start && end && end >= start );
+
+	len = end - start;
+
+	pool = pslist_pool( a );
+	inpool = ( start >= pool && start < pool + a->used );
+	if ( inpool ) from = start - pool;
+
+	status = pslist_ensure_spans( a );
+	if ( status!=PSLIST_OK ) return status;
+
+	status = pslist_ensure_pool( a, len + 1 );
+	if ( status!=PSLIST_OK ) return status;
+
+	pool = pslist_pool( a );
+	if ( inpool ) start = pool + from;
+
+	s = &(pslist_spans( a )[ a->n ]);
+	s->offset = a->used;
+	s->len    = len;
+
+	memcpy( pool + a->used, start, len );
+	pool[ a->used + len ] = '\0';
+	a->used += len + 1;
+
+	a->n++;
+
+	return PSLIST_OK;
+}
+
+int
+pslist_addc( pslist *a, const char *value )
+{
+	assert( value );
+
+	return pslist_addseg( a, value, value + strlen( value ) );
+}
+
+int
+pslist_add( pslist *a, str *value )
+{
+	const char *p;
+
+	assert( value );
+
+	p = str_cstr( value );
+	if ( !p ) p = "";
+
+	return pslist_addseg( a, p, p + value->len );
+}
+
+/* the bytes of string n stay in the pool until the list is emptied */
+int
+pslist_remove( pslist *a, pslist_index n )
+{
+	pslist_span *span;
+
+	assert( a );
+
+	if ( !pslist_valid_num( a, n ) ) return PSLIST_ERR_BADPARAM;
+
+	span = pslist_spans( a );
+	memmove( &(span[n]), &(span[n+1]), sizeof( pslist_span ) * ( a->n - n - 1 ) );
+	a->n--;
+
+	return PSLIST_OK;
+}
+
+char *
+pslist_cstr( pslist *a, pslist_index n )
+{
+	assert( a );
+
+	if ( !pslist_valid_num( a, n ) ) return NULL;
+	return pslist_pool( a ) + pslist_spans( a )[n].offset;
+}
+
+unsigned long
+pslist_strlen( pslist *a, pslist_index n )
+{
+	assert( a );
+
+	if ( !pslist_valid_num( a, n ) ) return 0;
+	return pslist_spans( a )[n].len;
+}
+
+/* as slist_tokenizec() */
+int
+pslist_tokenizec( pslist *tokens, const char *p, const char *delim, int merge_delim )
+{
+	int status = PSLIST_OK;
+	const char *q;
+
+	assert( tokens );
+
+	pslist_empty( tokens );
+	while ( p && *p ) {
+		q = p;
+		while ( *q && !strchr( delim, *q ) ) q++;
+		if ( q!=p || !merge_delim ) {
+			status = pslist_addseg( tokens, p, q );
+			if ( status!=PSLIST_OK ) return status;
+		}
+		p = q;
+		if ( *p ) p++;
+	}
+
+	return status;
+}
+
+int
+pslist_tokenize( pslist *tokens, str *in, const char *delim, int merge_delim )
+{
+	return pslist_tokenizec( tokens, str_cstr( in ), delim, merge_delim );
+}
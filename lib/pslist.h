@@ -0,0 +1,61 @@
+/*
+ * pslist.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+
+#ifndef PSLIST_H
+#define PSLIST_H
+
+#include "str.h"
+
+#define PSLIST_OK            (0)
+#define PSLIST_ERR_MEMERR   (-1)
+#define PSLIST_ERR_BADPARAM (-3)
+
+#define PSLIST_NSPANS    (16)
+#define PSLIST_POOLSIZE (256)
+
+typedef int pslist_index;
+
+typedef struct pslist_span {
+	unsigned long offset, len;
+} pslist_span;
+
+/* A list of strings kept one after another, each '\0'-terminated, in a
+ * single pool, for short-lived lists like the tokens of a name.  Strings
+ * can't be changed in place and a pointer from pslist_cstr() is only
+ * good until the next string is added.
+ *
+ * Small lists live in sspan/spool; span and pool stay NULL until they
+ * outgrow them.
+ */
+typedef struct pslist {
+	pslist_index n, max;
+	pslist_span *span;
+	char *pool;
+	unsigned long used, size;
+	pslist_span sspan[ PSLIST_NSPANS ];
+	char spool[ PSLIST_POOLSIZE ];
+} pslist;
+
+void    pslist_init( pslist *a );
+void    pslist_free( pslist *a );
+void    pslist_empty( pslist *a );
+
+int     pslist_addseg( pslist *a, const char *start, const char *end );
+int     pslist_addc( pslist *a, const char *value );
+int     pslist_add( pslist *a, str *value );
+
+int     pslist_remove( pslist *a, pslist_index n );
+
+char *  pslist_cstr( pslist *a, pslist_index n );
+unsigned long pslist_strlen( pslist *a, pslist_index n );
+
+int     pslist_tokenize( pslist *tokens, str *in, const char *delim, int merge_delim );
+int     pslist_tokenizec( pslist *tokens, const char *p, const char *delim, int merge_delim );
+
+#endif
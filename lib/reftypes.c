@@ -7,23 +7,144 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "is_ws.h"
 #include "fields.h"
+#include "phash.h"
 #include "reftypes.h"
 
+/*
+ * Type and tag indexes
+ *
+ * Each table of variants is indexed the first time it is used: a
+ * perfect hash of its type names, and one of each type's old tags.
+ * Where the table lists a name twice the first entry is kept, so
+ * lookups find what a scan of the table found. A table that can't be
+ * indexed is scanned as before.
+ *
+ * The index hangs off the table's first variant. Readers that find it
+ * there use it without taking a lock; the first readers to find none
+ * each build one, and all but the one that gets it into place throw
+ * theirs away.
+ */
+
+struct reftypes_index {
+	int         nall;
+	int         hashed;     /* 0 to scan the table instead */
+	int         maxtypelen;
+	const char  **types;    /* all[i].type, for the type hash to point at */
+	phash       bytype;
+	phash       *bytag;     /* old tags of each variant */
+};
+
+static void
+reftypes_free( reftypes_index *ix )
+{
+	int i;
+
+	if ( ix->bytag ) {
+		for ( i=0; i<ix->nall; ++i )
+			phash_free( &( ix->bytag[i] ) );
+		free( ix->bytag );
+		ix->bytag = NULL;
+	}
+	phash_free( &( ix->bytype ) );
+	free( ix->types );
+	ix->types = NULL;
+}
+
+/* NULL only if there's no memory to say the table can't be indexed */
+static reftypes_index *
+reftypes_build( variants *all, int nall )
+{
+	reftypes_index *ix;
+	int i, n;
+
+	ix = ( reftypes_index * ) calloc( 1, sizeof( reftypes_index ) );
+	if ( !ix ) return NULL;
+
+	ix->nall  = nall;
+	ix->types = ( const char ** ) calloc( nall + 1, sizeof( const char * ) );
+	ix->bytag = ( phash * ) calloc( nall + 1, sizeof( phash ) );
+	if ( !ix->types || !ix->bytag ) goto out;
+
+	for ( i=0; i<nall; ++i ) {
+		ix->types[i] = all[i].type;
+		n = strlen( all[i].type );
+		if ( n > ix->maxtypelen ) ix->maxtypelen = n;
+	}
+	if ( phash_build( &( ix->bytype ), ix->types, sizeof( ix->types[0] ), nall )!=PHASH_OK )
+		goto out;
+
+	for ( i=0; i<nall; ++i )
+		if ( phash_build( &( ix->bytag[i] ), all[i].tags, sizeof( lookups ), all[i].ntags )!=PHASH_OK )
+			goto out;
+
+	ix->hashed = 1;
+out:
+	if ( !ix->hashed ) reftypes_free( ix );
+	return ix;
+}
+
+/* index for all, built if this is its first use; NULL to scan instead */
+static reftypes_index *
+reftypes_getindex( variants *all, int nall )
+{
+	reftypes_index *ix, *built;
+
+	if ( nall < 1 ) return NULL;
+
+	ix = __atomic_load_n( &( all[0].index ), __ATOMIC_ACQUIRE );
+	if ( !ix ) {
+		built = reftypes_build( all, nall );
+		if ( !built ) return NULL;
+		if ( __atomic_compare_exchange_n( &( all[0].index ), &ix, built, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) )
+			ix = built;
+		else {
+			reftypes_free( built );
+			free( built );
+		}
+	}
+
+	if ( !ix->hashed || ix->nall!=nall ) return NULL;
+	return ix;
+}
+
+/* the first variant whose type starts p, or -1 */
+static int
+reftypes_findtype( reftypes_index *ix, const char *p )
+{
+	int len, k, found = -1;
+
+	for ( len=0; len<=ix->maxtypelen; ++len ) {
+		if ( len && p[len-1]=='\0' ) break;
+		k = phash_findn( &( ix->bytype ), p, len );
+		if ( k!=-1 && ( found==-1 || k < found ) ) found = k;
+	}
+
+	return found;
+}
+
 int
 get_reftype( char *p, long refnum, char *progname, variants *all, int nall, char *tag, int *is_default, int chattiness )
 {
+	reftypes_index *ix;
 	int i;
 
 	p = skip_ws( p );
 
 	*is_default = 0;
 
-	for ( i=0; i<nall; ++i ) {
-		if ( !strncasecmp( all[i].type, p, strlen(all[i].type) ) ) 
-			return i;
+	ix = reftypes_getindex( all, nall );
+	if ( ix ) {
+		i = reftypes_findtype( ix, p );
+		if ( i!=-1 ) return i;
+	} else {
+		for ( i=0; i<nall; ++i ) {
+			if ( !strncasecmp( all[i].type, p, strlen(all[i].type) ) ) 
+				return i;
+		}
 	}
 
 	*is_default = 1;
@@ -40,15 +161,18 @@ get_reftype( char *p, long refnum, char *progname, variants *all, int nall, char
 int
 process_findoldtag( char *oldtag, int reftype, variants all[], int nall )
 {
-        variants *v;
-        int i;
-        v = &(all[reftype]);
-/*      for ( i=0; i<(all[reftype]).ntags; ++i )*/
-        for ( i=0; i<v->ntags; ++i )
-/*              if ( !strcasecmp( ((all[reftype]).tags[i]).oldstr, oldtag ) )*/
-                if ( !strcasecmp( (v->tags[i]).oldstr, oldtag ) )
-                        return i;
-        return -1;
+	reftypes_index *ix;
+	variants *v;
+	int i;
+
+	ix = reftypes_getindex( all, nall );
+	if ( ix ) return phash_find( &( ix->bytag[reftype] ), oldtag );
+
+	v = &(all[reftype]);
+	for ( i=0; i<v->ntags; ++i )
+		if ( !strcasecmp( (v->tags[i]).oldstr, oldtag ) )
+			return i;
+	return -1;
 }
 
 /* translate_oldtag()
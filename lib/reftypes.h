@@ -50,10 +50,13 @@ typedef struct {
 	int  level;
 } lookups;
 
+typedef struct reftypes_index reftypes_index;
+
 typedef struct {
 	char    type[25];
 	lookups *tags;
 	int     ntags;
+	reftypes_index *index; /* of the table, kept in all[0]; see reftypes.c */
 } variants;
 
 int get_reftype( char *q, long refnum, char *progname, variants *all, int nall, char *tag, int *is_default, int chattiness );
@@ -13,6 +13,7 @@
 #include "str.h"
 #include "str_conv.h"
 #include "fields.h"
+#include "pslist.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
@@ -21,6 +22,7 @@
 #include "reftypes.h"
 #include "bibformats.h"
 #include "generic.h"
+#include "tagline.h"
 
 extern variants ris_all[];
 extern int ris_nall;
@@ -46,6 +48,8 @@ risin_initparams( param *p, const char *progname )
 	p->nosplittitle     = 0;
 	p->verbose          = 0;
 	p->addcount         = 0;
+	p->nthreads         = 1;
+	p->namecache        = 0;
 	p->output_raw       = 0;
 
 	p->readf    = risin_readf;
@@ -58,6 +62,7 @@ risin_initparams( param *p, const char *progname )
 
 	slist_init( &(p->asis) );
 	slist_init( &(p->corps) );
+	name_cache_init( &(p->names), 0 );
 
 	if ( !progname ) p->progname = NULL;
 	else p->progname = strdup( progname );
@@ -67,42 +72,6 @@ risin_initparams( param *p, const char *progname )
  PUBLIC: int risin_readf()
 *****************************************************/
 
-/* RIS definition of a tag is strict:
-    character 1 = uppercase alphabetic character
-    character 2 = uppercase alphabetic character or digit
-    character 3 = space (ansi 32)
-    character 4 = space (ansi 32)
-    character 5 = dash (ansi 45)
-    character 6 = space (ansi 32)
-
-  some sources don't have a space at character 6 if there
-  is no data (such as "ER  -" records). Handle this.
-
-  www.omicsonline.org mangles the RIS specification and
-  puts _three_ spaces before the dash.  Handle this too.
-*/
-static int
-is_ris_tag( char *buf )
-{
-	if (! (buf[0]>='A' && buf[0]<='Z') ) return 0;
-	if (! (((buf[1]>='A' && buf[1]<='Z'))||(buf[1]>='0'&&buf[1]<='9')) ) 
-		return 0;
-	if (buf[2]!=' ') return 0;
-	if (buf[3]!=' ') return 0;
-
-	/*...RIS fits specifications with two spaces */
-	if (buf[4]=='-') {
-		if ( buf[5]==' ' || buf[5]=='\0' || buf[5]=='\n' || buf[5]=='\r' ) return 1;
-	}
-
-	/* ...extra space in tag? */
-	else if (buf[4]==' ') {
-		if ( buf[5]=='-' && ( buf[6]==' ' || buf[6]=='\0' || buf[6]=='\n' || buf[6]=='\r' ) ) return 1;
-	}
-
-	return 0;
-}
-
 static int
 is_ris_start_tag( char *p )
 {
@@ -142,12 +111,7 @@ risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
 
 		if ( str_is_empty( line ) ) continue;
 
-		p = &( line->data[0] );
-
-		if ( utf8_is_bom( p ) ) {
-			*fcharset = CHARSET_UNICODE;
-			p += 3;
-		}
+		p = tagline_skipbom( line->data, fcharset );
 
 		/* References are bounded by tags 'TY  - ' && 'ER  - ' */
 		if ( is_ris_start_tag( p ) ) {
@@ -159,7 +123,7 @@ risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
 			}
 		}
 
-		if ( is_ris_tag( p ) ) {
+		if ( tagline_istag( TAGLINE_RIS, p ) ) {
 			if ( !inref ) {
 				fprintf(stderr,"Warning.  Tagged line not "
 					"in properly started reference.\n");
@@ -189,38 +153,6 @@ risin_readf( FILE *fp, char *buf, int bufsize, int *bufpos, str *line, str *refe
  PUBLIC: int risin_processf()
 *****************************************************/
 
-static char*
-process_untagged_line( str *value, char *p )
-{
-	while ( *p==' ' || *p=='\t' ) p++;
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( value, *p++ );
-	while ( *p=='\r' || *p=='\n' ) p++;
-	return p;
-}
-
-static char*
-process_tagged_line( str *tag, str *value, char *p )
-{
-	int i = 0;
-
-	while ( i<6 && *p && *p!='\n' && *p!='\r' ) {
-		if ( i<2 ) str_addchar( tag, *p );
-		p++;
-		i++;
-	}
-
-	while ( *p==' ' || *p=='\t' ) p++;
-
-	while ( *p && *p!='\r' && *p!='\n' )
-		str_addchar( value, *p++ );
-	str_trimendingws( value );
-
-	while ( *p=='\n' || *p=='\r' ) p++;
-
-	return p;
-}
-
 static int
 merge_tag_value( fields *risin, str *tag, str *value, int *tag_added )
 {
@@ -269,32 +201,29 @@ risin_processf( fields *risin, char *p, char *filename, long nref, param *pm )
 {
 	int status, tag_added = 0, ret = 1;
 	str tag, value;
+	tagline t;
 
 	strs_init( &tag, &value, NULL );
 
 	while ( *p ) {
 
+		p = tagline_next( TAGLINE_RIS, p, &t );
+		if ( !tagline_strs( &t, &tag, &value ) ) {
+			ret = 0;
+			goto out;
+		}
+
 		/* ...tag, add entry */
-		if ( is_ris_tag( p ) ) {
-			str_empty( &tag );
-			str_empty( &value );
-			p = process_tagged_line( &tag, &value, p );
+		if ( t.taglen )
 			status = add_tag_value( risin, &tag, &value, &tag_added );
-			if ( status!=BIBL_OK ) {
-				ret = 0;
-				goto out;
-			}
-		}
 
 		/* ...no tag, merge with previous line */
-		else {
-			str_empty( &value );
-			p = process_untagged_line( &value, p );
+		else
 			status = merge_tag_value( risin, &tag, &value, &tag_added );
-			if ( status!=BIBL_OK ) {
-				ret = 0;
-				goto out;
-			}
+
+		if ( status!=BIBL_OK ) {
+			ret = 0;
+			goto out;
 		}
 
 	}
@@ -431,43 +360,43 @@ static int
 risin_person( fields *bibin, int n, str *intag, str *invalue, int level, param *pm, char *outtag, fields *bibout )
 {
 	int i, begin, end, ok, status = BIBL_OK;
-	slist tokens;
+	pslist tokens;
 	str name;
 
 	str_init( &name );
-	slist_init( &tokens );
+	pslist_init( &tokens );
 
-	status = slist_tokenize( &tokens, invalue, " \t\r\n", 1 );
-	if ( status!=SLIST_OK ) { status = BIBL_ERR_MEMERR; goto out; }
+	status = pslist_tokenize( &tokens, invalue, " \t\r\n", 1 );
+	if ( status!=PSLIST_OK ) { status = BIBL_ERR_MEMERR; goto out; }
 
 	begin = 0;
 	while ( begin < tokens.n ) {
 
 		end = begin + 1;
 
-		while ( end < tokens.n && strcasecmp( slist_cstr( &tokens, end ), "and" ) )
+		while ( end < tokens.n && strcasecmp( pslist_cstr( &tokens, end ), "and" ) )
 			end++;
 
 		str_empty( &name );
 		for ( i=begin; i<end; ++i ) {
 			if ( i>begin ) str_addchar( &name, ' ' );
-			str_strcat( &name, slist_str( &tokens, i ) );
+			str_strcatc( &name, pslist_cstr( &tokens, i ) );
 		}
 
-		ok = name_add( bibout, outtag, str_cstr( &name ), level, &(pm->asis), &(pm->corps) );
+		ok = name_add( bibout, outtag, str_cstr( &name ), level, &(pm->asis), &(pm->corps), &(pm->names) );
 		if ( !ok ) { status = BIBL_ERR_MEMERR; goto out; }
 
 		begin = end + 1;
 
 		/* Handle repeated 'and' errors */
-		while ( begin < tokens.n && !strcasecmp( slist_cstr( &tokens, begin ), "and" ) )
+		while ( begin < tokens.n && !strcasecmp( pslist_cstr( &tokens, begin ), "and" ) )
 			begin++;
 
 	}
 
 out:
 	str_free( &name );
-	slist_free( &tokens );
+	pslist_free( &tokens );
 	return status;
 }
 
@@ -14,13 +14,15 @@
 #include "str.h"
 #include "strsearch.h"
 #include "fields.h"
+#include "outfields.h"
 #include "name.h"
 #include "title.h"
 #include "url.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static int  risout_write( fields *info, FILE *fp, param *p, unsigned long refnum );
-static void risout_writeheader( FILE *outptr, param *p );
+static int  risout_write( fields *info, outsink *fp, param *p, unsigned long refnum );
+static void risout_writeheader( outsink *outptr, param *p );
 
 
 void
@@ -38,6 +40,12 @@ risout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	if ( p->charsetout == BIBL_CHARSET_UNICODE ) {
 		p->utf8out = p->utf8bom = 1;
@@ -321,7 +329,7 @@ get_type( fields *f, param *p )
 }
 
 static void
-append_type( int type, param *p, fields *out, int *status )
+append_type( int type, param *p, outfields *out, int *status )
 {
 	char *typenames[ NUM_TYPES ] = {
 		[ TYPE_STD                ] = "STD",
@@ -359,12 +367,12 @@ append_type( int type, param *p, fields *out, int *status )
 		type = TYPE_STD;
 	}
 
-	fstatus = fields_add( out, "TY", typenames[ type ], LEVEL_MAIN );
+	fstatus = outfields_add( out, "TY", typenames[ type ], LEVEL_MAIN );
 	if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 }
 
 static void
-append_people( fields *f, char *tag, char *ristag, int level, fields *out, int *status )
+append_people( fields *f, char *tag, char *ristag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	str oneperson;
@@ -377,7 +385,7 @@ append_people( fields *f, char *tag, char *ristag, int level, fields *out, int *
 	for ( i=0; i<people.n; ++i ) {
 		name_build_withcomma( &oneperson, ( char * ) vplist_get( &people, i ) );
 		if ( str_memerr( &oneperson ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		fstatus = fields_add_can_dup( out, ristag, str_cstr( &oneperson ), LEVEL_MAIN );
+		fstatus = outfields_add_can_dup( out, ristag, str_cstr( &oneperson ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 	}
 out:
@@ -386,7 +394,7 @@ out:
 }
 
 static void
-append_date( fields *in, fields *out, int *status )
+append_date( fields *in, outfields *out, int *status )
 {
 	char *year, *month, *day;
 	str date;
@@ -397,7 +405,7 @@ append_date( fields *in, fields *out, int *status )
 	day   = fields_findv_firstof( in, LEVEL_ANY, FIELDS_CHRP, "DATE:DAY",   "PARTDATE:DAY",   NULL );
 
 	if ( year ) {
-		fstatus = fields_add( out, "PY", year, LEVEL_MAIN );
+		fstatus = outfields_add( out, "PY", year, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -412,7 +420,7 @@ append_date( fields *in, fields *out, int *status )
 
 		if ( str_memerr( &date ) ) { *status = BIBL_ERR_MEMERR; str_free( &date ); return; }
 
-		fstatus = fields_add( out, "DA", str_cstr( &date ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "DA", str_cstr( &date ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 
 		str_free( &date );
@@ -420,7 +428,7 @@ append_date( fields *in, fields *out, int *status )
 }
 
 static void
-append_titlecore( fields *in, char *ristag, int level, char *maintag, char *subtag, fields *out, int *status )
+append_titlecore( fields *in, char *ristag, int level, char *maintag, char *subtag, outfields *out, int *status )
 {
 	str *mainttl = fields_findv( in, level, FIELDS_STRP, maintag );
 	str *subttl  = fields_findv( in, level, FIELDS_STRP, subtag );
@@ -437,7 +445,7 @@ append_titlecore( fields *in, char *ristag, int level, char *maintag, char *subt
 	}
 
 	if ( str_has_value( &fullttl ) ) {
-		fstatus = fields_add( out, ristag, str_cstr( &fullttl ), LEVEL_MAIN );
+		fstatus = outfields_add( out, ristag, str_cstr( &fullttl ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
@@ -446,7 +454,7 @@ out:
 }
 
 static void
-append_alltitles( fields *in, int type, fields *out, int *status )
+append_alltitles( fields *in, int type, outfields *out, int *status )
 {
 	append_titlecore( in, "TI", 0, "TITLE", "SUBTITLE", out, status );
 	append_titlecore( in, "T2", -1, "SHORTTITLE", "SHORTSUBTITLE", out, status );
@@ -461,7 +469,7 @@ append_alltitles( fields *in, int type, fields *out, int *status )
 }
 
 static void
-append_pages( fields *in, fields *out, int *status )
+append_pages( fields *in, outfields *out, int *status )
 {
 	char *sn, *en, *ar;
 	int fstatus;
@@ -471,24 +479,24 @@ append_pages( fields *in, fields *out, int *status )
 
 	if ( sn || en ) {
 		if ( sn ) {
-			fstatus = fields_add( out, "SP", sn, LEVEL_MAIN );
+			fstatus = outfields_add( out, "SP", sn, LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		}
 		if ( en ) {
-			fstatus = fields_add( out, "EP", en, LEVEL_MAIN );
+			fstatus = outfields_add( out, "EP", en, LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		}
 	} else {
 		ar = fields_findv( in, LEVEL_ANY, FIELDS_CHRP, "ARTICLENUMBER" );
 		if ( ar ) {
-			fstatus = fields_add( out, "SP", ar, LEVEL_MAIN );
+			fstatus = outfields_add( out, "SP", ar, LEVEL_MAIN );
 			if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 		}
 	}
 }
 
 static void
-append_keywords( fields *in, fields *out, int *status )
+append_keywords( fields *in, outfields *out, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -497,14 +505,14 @@ append_keywords( fields *in, fields *out, int *status )
 	vplist_init( &vpl );
 	fields_findv_each( in, LEVEL_ANY, FIELDS_CHRP, &vpl, "KEYWORD" );
 	for ( i=0; i<vpl.n; ++i ) {
-		fstatus = fields_add( out, "KW", ( char * ) vplist_get( &vpl, i ), LEVEL_MAIN );
+		fstatus = outfields_add( out, "KW", ( char * ) vplist_get( &vpl, i ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	vplist_free( &vpl );
 }
 
 static void
-append_urls( fields *in, fields *out, int *status )
+append_urls( fields *in, outfields *out, int *status )
 {
 	int lstatus;
 	slist types;
@@ -522,37 +530,37 @@ append_urls( fields *in, fields *out, int *status )
 }
 
 static void
-append_thesishint( int type, fields *out, int *status )
+append_thesishint( int type, outfields *out, int *status )
 {
 	int fstatus;
 
 	if ( type==TYPE_MASTERSTHESIS ) {
-		fstatus = fields_add( out, "U1", "Masters thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Masters thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
 	else if ( type==TYPE_PHDTHESIS ) {
-		fstatus = fields_add( out, "U1", "Ph.D. thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Ph.D. thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
 	else if ( type==TYPE_DIPLOMATHESIS ) {
-		fstatus = fields_add( out, "U1", "Diploma thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Diploma thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
 	else if ( type==TYPE_DOCTORALTHESIS ) {
-		fstatus = fields_add( out, "U1", "Doctoral thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Doctoral thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
 	else if ( type==TYPE_HABILITATIONTHESIS ) {
-		fstatus = fields_add( out, "U1", "Habilitation thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Habilitation thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 
 	else if ( type==TYPE_LICENTIATETHESIS ) {
-		fstatus = fields_add( out, "U1", "Licentiate thesis", LEVEL_MAIN );
+		fstatus = outfields_add( out, "U1", "Licentiate thesis", LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
@@ -571,7 +579,7 @@ is_uri_scheme( char *p )
 
 
 static void
-append_file( fields *in, char *tag, char *ristag, int level, fields *out, int *status )
+append_file( fields *in, char *tag, char *ristag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	str filename;
@@ -588,7 +596,7 @@ append_file( fields *in, char *tag, char *ristag, int level, fields *out, int *s
 		if ( !is_uri_scheme( fl ) ) str_strcatc( &filename, "file:" );
 		str_strcatc( &filename, fl );
 		if ( str_memerr( &filename ) ) { *status = BIBL_ERR_MEMERR; goto out; }
-		fstatus = fields_add( out, ristag, str_cstr( &filename ), LEVEL_MAIN );
+		fstatus = outfields_add( out, ristag, str_cstr( &filename ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) { *status = BIBL_ERR_MEMERR; goto out; }
 	}
 out:
@@ -597,20 +605,20 @@ out:
 }
 
 static void
-append_easy( fields *in, char *tag, char *ristag, int level, fields *out, int *status )
+append_easy( fields *in, char *tag, char *ristag, int level, outfields *out, int *status )
 {
 	char *value;
 	int fstatus;
 
 	value = fields_findv( in, level, FIELDS_CHRP, tag );
 	if ( value ) {
-		fstatus = fields_add( out, ristag, value, LEVEL_MAIN );
+		fstatus = outfields_add( out, ristag, value, LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 }
 
 static void
-append_easyall( fields *in, char *tag, char *ristag, int level, fields *out, int *status )
+append_easyall( fields *in, char *tag, char *ristag, int level, outfields *out, int *status )
 {
 	vplist_index i;
 	int fstatus;
@@ -619,14 +627,14 @@ append_easyall( fields *in, char *tag, char *ristag, int level, fields *out, int
 	vplist_init( &a );
 	fields_findv_each( in, level, FIELDS_CHRP, &a, tag );
 	for ( i=0; i<a.n; ++i ) {
-		fstatus = fields_add( out, ristag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
+		fstatus = outfields_add( out, ristag, (char *) vplist_get( &a, i ), LEVEL_MAIN );
 		if ( fstatus!=FIELDS_OK ) *status = BIBL_ERR_MEMERR;
 	}
 	vplist_free( &a );
 }
 
 static void
-append_allpeople( fields *in, int type, fields *out, int *status )
+append_allpeople( fields *in, int type, outfields *out, int *status )
 {
 	append_people ( in, "AUTHOR",      "AU", LEVEL_MAIN,   out, status );
 	append_easyall( in, "AUTHOR:CORP", "AU", LEVEL_MAIN,   out, status );
@@ -655,23 +663,16 @@ append_allpeople( fields *in, int type, fields *out, int *status )
 }
 
 static void
-output( FILE *fp, fields *out )
+output_field( outsink *fp, const char *tag, const char *value, unsigned long n, void *data )
 {
-	char *tag, *value;
-	int i;
-
-	for ( i=0; i<out->n; ++i ) {
-		tag   = fields_tag( out, i, FIELDS_CHRP );
-		value = fields_value( out, i, FIELDS_CHRP );
-		fprintf( fp, "%s  - %s\n", tag, value );
-	}
-
-	fprintf( fp, "ER  - \n" );
-	fflush( fp );
+	outsink_puts( fp, tag );
+	outsink_puts( fp, "  - " );
+	outsink_puts( fp, value );
+	outsink_putc( fp, '\n' );
 }
 
 static int
-append_data( fields *in, param *p, fields *out )
+append_data( fields *in, param *p, outfields *out )
 {
 	int type, status = BIBL_OK;
 
@@ -712,23 +713,23 @@ append_data( fields *in, param *p, fields *out )
 }
 
 static int
-risout_write( fields *in, FILE *fp, param *p, unsigned long refnum )
+risout_write( fields *in, outsink *fp, param *p, unsigned long refnum )
 {
 	int status;
-	fields out;
+	outfields out;
 
-	fields_init( &out );
+	outfields_init( &out, fp, output_field, NULL );
 
 	status = append_data( in, p, &out );
-	if ( status==BIBL_OK ) output( fp, &out );
+	if ( status==BIBL_OK ) outsink_puts( fp, "ER  - \n" );
 
-	fields_free( &out );
+	outfields_free( &out );
 
 	return status;
 }
 
 static void
-risout_writeheader( FILE *outptr, param *p )
+risout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
+	if ( p->utf8bom ) outsink_writebom( outptr );
 }
@@ -10,6 +10,7 @@
  * Implements a simple managed array of strs.
  *
  */
+#include "phash.h"
 #include "slist.h"
 
 /* Do not use asserts in VPLIST_NOASSERT defined */
@@ -33,6 +34,202 @@ slist_valid_num( slist *a, slist_index n )
 	return 1;
 }
 
+/*
+ * Hash index
+ *
+ * slist_hash() gives a list an index on its strings, folded to lower
+ * case, so that exact and case-insensitive lookups take a probe
+ * instead of a scan. The slist functions that change the list keep the
+ * index up to date, touching only the slots of the strings they change
+ * or move (strings changed in place through slist_str() are not seen,
+ * just as they aren't for sorting). A lookup never builds or changes
+ * the index, so a list that isn't being changed can be searched from
+ * several threads at once. If the index can't grow the list goes back
+ * to being scanned.
+ *
+ * Equal strings can sit in their run of slots in any order, so a
+ * lookup reads the whole run and keeps the lowest-numbered match: the
+ * first of equal strings, as a scan finds.
+ */
+
+#define SLIST_HASHMIN (64)
+
+typedef struct {
+	slist       *a;
+	const char  *s;
+	slist_index len;    /* -1 for all of s */
+	int         nocase;
+	slist_index *found; /* lowest match so far, -1 for none */
+} slist_hashkey;
+
+/* stops only at the empty slot that ends the run */
+static int
+slist_hash_stop( const void *table, unsigned long h, const void *key )
+{
+	const slist_hashkey *k = ( const slist_hashkey * ) key;
+	slist_index n = ( ( const slist_index * ) table )[h];
+	str *s;
+	int match;
+
+	if ( !n ) return 1;
+
+	s = &( k->a->strs[n-1] );
+	if ( k->len>=0 ) match = ( s->len==k->len && ( k->len==0 || !strncmp( s->data, k->s, k->len ) ) );
+	else if ( k->nocase ) match = !str_strcasecmpc( s, k->s );
+	else match = !str_strcmpc( s, k->s );
+
+	if ( match && ( *(k->found)==-1 || n-1 < *(k->found) ) ) *(k->found) = n-1;
+	return 0;
+}
+
+/* stops at the slot holding the entry key, or at an empty one */
+static int
+slist_hash_stopat( const void *table, unsigned long h, const void *key )
+{
+	slist_index n = ( ( const slist_index * ) table )[h];
+	return ( !n || n==*( const slist_index * ) key );
+}
+
+static void
+slist_hash_drop( slist *a )
+{
+	free( a->hash );
+	a->hash = NULL;
+	a->hashsize = 0;
+}
+
+/* the slot of string n, which must be as it was when it was indexed, */
+/* or of the string that has since been moved from n to m             */
+static unsigned long
+slist_hash_slot( slist *a, slist_index n, slist_index m )
+{
+	slist_index entry = n + 1;
+	unsigned long h;
+
+	h = phash_hash( slist_cstr( a, m ), PHASH_WHOLE, 0 );
+	return phash_probe( a->hash, a->hashsize - 1, h, slist_hash_stopat, &entry );
+}
+
+static void
+slist_hash_insert( slist *a, slist_index n )
+{
+	slist_index empty = 0;
+	unsigned long h;
+
+	h = phash_hash( slist_cstr( a, n ), PHASH_WHOLE, 0 );
+	a->hash[ phash_probe( a->hash, a->hashsize - 1, h, slist_hash_stopat, &empty ) ] = n + 1;
+}
+
+/* take string n out of the index, closing the gap in its run */
+static void
+slist_hash_unlink( slist *a, slist_index n )
+{
+	unsigned long i, j, k, mask = a->hashsize - 1;
+
+	i = slist_hash_slot( a, n, n );
+	if ( !a->hash[i] ) return;
+	a->hash[i] = 0;
+
+	for ( j=( i+1 ) & mask; a->hash[j]; j=( j+1 ) & mask ) {
+		k = phash_hash( slist_cstr( a, a->hash[j]-1 ), PHASH_WHOLE, 0 ) & mask;
+		/* leave entries whose home slot is after the gap */
+		if ( ( i<=j ) ? ( i<k && k<=j ) : ( i<k || k<=j ) ) continue;
+		a->hash[i] = a->hash[j];
+		a->hash[j] = 0;
+		i = j;
+	}
+}
+
+/* string n has been moved to m */
+static void
+slist_hash_move( slist *a, slist_index n, slist_index m )
+{
+	unsigned long i;
+
+	i = slist_hash_slot( a, n, m );
+	if ( a->hash[i] ) a->hash[i] = m + 1;
+}
+
+/* (re)index every string */
+static int
+slist_hash_rebuild( slist *a )
+{
+	slist_index i, size = SLIST_HASHMIN;
+
+	while ( size < 2 * a->n ) size *= 2;
+
+	if ( size!=a->hashsize ) {
+		free( a->hash );
+		a->hash = ( slist_index * ) calloc( size, sizeof( slist_index ) );
+		if ( !a->hash ) {
+			a->hashsize = 0;
+			return SLIST_ERR_MEMERR;
+		}
+		a->hashsize = size;
+	} else {
+		memset( a->hash, 0, sizeof( slist_index ) * size );
+	}
+
+	for ( i=0; i<a->n; ++i )
+		slist_hash_insert( a, i );
+
+	return SLIST_OK;
+}
+
+/* after the list has changed other than at its end */
+static void
+slist_hash_update( slist *a )
+{
+	if ( a->hashsize && slist_hash_rebuild( a )!=SLIST_OK )
+		slist_hash_drop( a );
+}
+
+/* after string n has been added to the end */
+static void
+slist_hash_added( slist *a, slist_index n )
+{
+	if ( !a->hashsize ) return;
+	if ( 2 * a->n > a->hashsize ) slist_hash_update( a );
+	else slist_hash_insert( a, n );
+}
+
+/* slist_hash()
+ *
+ * Index the strings of a for lookups from now on.
+ */
+int
+slist_hash( slist *a )
+{
+	assert( a );
+
+	if ( a->hashsize ) return SLIST_OK;
+	return slist_hash_rebuild( a );
+}
+
+/* a copy holds the same strings at the same places, so takes the same index */
+static int
+slist_hash_copy( slist *to, slist *from )
+{
+	to->hash = ( slist_index * ) malloc( sizeof( slist_index ) * from->hashsize );
+	if ( !to->hash ) return SLIST_ERR_MEMERR;
+	memcpy( to->hash, from->hash, sizeof( slist_index ) * from->hashsize );
+	to->hashsize = from->hashsize;
+	return SLIST_OK;
+}
+
+/* len is -1 for all of searchstr */
+static slist_index
+slist_find_hashed( slist *a, const char *searchstr, slist_index len, int nocase )
+{
+	slist_index found = -1;
+	slist_hashkey k = { a, searchstr, len, nocase, &found };
+	unsigned long h;
+
+	h = phash_hash( searchstr, ( len<0 ) ? PHASH_WHOLE : ( unsigned long ) len, 0 );
+	phash_probe( a->hash, a->hashsize - 1, h, slist_hash_stop, &k );
+	return found;
+}
+
 void
 slist_init( slist *a  )
 {
@@ -42,6 +239,8 @@ slist_init( slist *a  )
 	a->max = 0;
 	a->n = 0;
 	a->sorted = 1;
+	a->hash = NULL;
+	a->hashsize = 0;
 }
 
 int
@@ -109,6 +308,7 @@ slist_empty( slist *a )
 
 	a->n = 0;
 	a->sorted = 1;
+	if ( a->hashsize ) memset( a->hash, 0, sizeof( slist_index ) * a->hashsize );
 }
 
 void
@@ -122,6 +322,7 @@ slist_free( slist *a )
 		str_free( &(a->strs[i]) );
 
 	free( a->strs );
+	free( a->hash );
 	slist_init( a );
 }
 
@@ -156,8 +357,17 @@ slist_swap( slist *a, slist_index n1, slist_index n2 )
 {
 	assert( a );
 
-	if ( slist_valid_num( a, n1 ) && slist_valid_num( a, n2 ) )
+	unsigned long h1, h2;
+
+	if ( slist_valid_num( a, n1 ) && slist_valid_num( a, n2 ) && n1!=n2 ) {
+		if ( a->hashsize ) {
+			h1 = slist_hash_slot( a, n1, n1 );
+			h2 = slist_hash_slot( a, n2, n2 );
+			a->hash[h1] = n2 + 1;
+			a->hash[h2] = n1 + 1;
+		}
 		str_swapstrings( &(a->strs[n1]), &(a->strs[n2]) );
+	}
 }
 
 static int
@@ -180,6 +390,7 @@ slist_comp_step( slist *a, slist_index n1, slist_index n2 )
 static str *
 slist_set_cleanup( slist *a, slist_index n )
 {
+	if ( a->hashsize ) slist_hash_insert( a, n );
 	if ( str_memerr( &(a->strs[n]) ) ) return NULL;
 	if ( a->sorted ) {
 		if ( n>0 && slist_comp_step( a, n-1, n )>0 )
@@ -199,6 +410,7 @@ slist_setc( slist *a, slist_index n, const char *s )
 	assert( s );
 
 	if ( !slist_valid_num( a, n ) ) return NULL;
+	if ( a->hashsize ) slist_hash_unlink( a, n );
 	str_strcpyc( &(a->strs[n]), s );
 	return slist_set_cleanup( a, n );
 }
@@ -341,6 +553,7 @@ slist_addvp( slist *a, int mode, void *vp )
 			if ( slist_comp_step( a, a->n-2, a->n-1 ) > 0 )
 				a->sorted = 0;
 		}
+		slist_hash_added( a, a->n-1 );
 
 	}
 
@@ -489,8 +702,16 @@ slist_append( slist *a, slist *toadd )
 			if ( str_memerr( &(a->strs[a->n+i]) ) ) return SLIST_ERR_MEMERR;
 		}
 
+		if ( a->sorted && toadd->n ) {
+			if ( !toadd->sorted || ( a->n && slist_comp_step( a, a->n-1, a->n ) > 0 ) )
+				a->sorted = 0;
+		}
+
 		a->n += toadd->n;
 
+		for ( i=a->n-toadd->n; i<a->n; ++i )
+			slist_hash_added( a, i );
+
 	}
 
 	return status;
@@ -522,9 +743,15 @@ slist_remove( slist *a, slist_index n )
 
 	if ( !slist_valid_num( a, n ) ) return SLIST_ERR_BADPARAM;
 
+	if ( a->hashsize ) slist_hash_unlink( a, n );
+
 	for ( i=n+1; i<a->n; ++i ) {
 		str_strcpy( &(a->strs[i-1]), &(a->strs[i]) );
-		if ( str_memerr( &(a->strs[i-1]) ) ) return SLIST_ERR_MEMERR;
+		if ( str_memerr( &(a->strs[i-1]) ) ) {
+			slist_hash_drop( a );
+			return SLIST_ERR_MEMERR;
+		}
+		if ( a->hashsize ) slist_hash_move( a, i, i-1 );
 	}
 
 	a->n--;
@@ -537,33 +764,26 @@ slist_sort( slist *a )
 {
 	qsort( a->strs, a->n, sizeof( str ), slist_comp );
 	a->sorted = 1;
+	slist_hash_update( a );
 }
 
+/* the first string equal to searchstr in a sorted list */
 static slist_index
 slist_find_sorted( slist *a, const char *searchstr )
 {
 	slist_index min, max, mid;
-	str s, *cs;
-	int comp;
 
 	assert( a );
 	assert( searchstr );
 
-	str_initstrc( &s, searchstr );
 	min = 0;
-	max = a->n - 1;
-	while ( min <= max ) {
-		mid = ( min + max ) / 2;
-		cs = slist_str( a, mid );
-		comp = slist_comp( (void*)cs, (void*) (&s) );
-		if ( comp==0 ) {
-			str_free( &s );
-			return mid;
-		}
-		else if ( comp > 0 ) max = mid - 1;
-		else if ( comp < 0 ) min = mid + 1;
+	max = a->n;
+	while ( min < max ) {
+		mid = min + ( max - min ) / 2;
+		if ( strcmp( slist_cstr( a, mid ), searchstr ) < 0 ) min = mid + 1;
+		else max = mid;
 	}
-	str_free( &s );
+	if ( min < a->n && !strcmp( slist_cstr( a, min ), searchstr ) ) return min;
 	return -1;
 }
 
@@ -593,12 +813,35 @@ slist_findc( slist *a, const char *searchstr )
 	assert( a );
 
 	if ( a->n==0 ) return -1;
-	if ( a->sorted )
+	if ( a->hashsize )
+		return slist_find_hashed( a, searchstr, -1, 0 );
+	else if ( a->sorted )
 		return slist_find_sorted( a, searchstr );
 	else
 		return slist_find_simple( a, searchstr, 0 );
 }
 
+/* slist_findcn()
+ *
+ * As slist_findc(), for the len characters at searchstr, which need
+ * not be terminated.
+ */
+slist_index
+slist_findcn( slist *a, const char *searchstr, slist_index len )
+{
+	slist_index i;
+
+	assert( a );
+	assert( searchstr );
+
+	if ( a->hashsize )
+		return slist_find_hashed( a, searchstr, len, 0 );
+	for ( i=0; i<a->n; ++i )
+		if ( a->strs[i].len==len && ( len==0 || !strncmp( a->strs[i].data, searchstr, len ) ) )
+			return i;
+	return -1;
+}
+
 slist_index
 slist_find( slist *a, str *searchstr )
 {
@@ -611,6 +854,8 @@ slist_findnocasec( slist *a, const char *searchstr )
 {
 	assert( a );
 
+	if ( a->hashsize )
+		return slist_find_hashed( a, searchstr, -1, 1 );
 	return slist_find_simple( a, searchstr, 1 );
 }
 
@@ -686,7 +931,7 @@ slist_copy( slist *to, slist *from )
 
 	slist_free( to );
 
-	if ( from->n==0 ) return SLIST_OK;
+	if ( from->n==0 ) return ( from->hashsize ) ? slist_hash( to ) : SLIST_OK;
 
 	status = slist_ensure_space( to, from->n, SLIST_EXACT_SIZE );
 
@@ -700,6 +945,8 @@ slist_copy( slist *to, slist *from )
 			if ( str_memerr( &(to->strs[i]) ) ) return SLIST_ERR_MEMERR;
 		}
 
+		if ( from->hashsize ) return slist_hash_copy( to, from );
+
 	}
 	return SLIST_OK;
 }
@@ -779,6 +1026,7 @@ slist_trimend( slist *a, int n )
 		slist_empty( a );
 	} else {
 		for ( i=a->n -n; i<a->n; ++i ) {
+			if ( a->hashsize ) slist_hash_unlink( a, i );
 			str_empty( &(a->strs[i]) );
 		}
 		a->n -= n;
@@ -32,6 +32,8 @@ typedef struct slist {
 	slist_index n, max;
 	int sorted;
 	str *strs;
+	slist_index *hash;     /* private to slist.c: optional index, see slist_hash() */
+	slist_index hashsize;  /* private to slist.c */
 } slist;
 
 
@@ -79,8 +81,11 @@ str *   slist_setc( slist *a, slist_index n, const char *s );
 
 void    slist_sort( slist *a );
 
+int     slist_hash( slist *a );
+
 int     slist_find( slist *a, str *searchstr );
 int     slist_findc( slist *a, const char *searchstr );
+int     slist_findcn( slist *a, const char *searchstr, slist_index len );
 int     slist_findnocase( slist *a, str *searchstr );
 int     slist_findnocasec( slist *a, const char *searchstr );
 int     slist_wasfound( slist *a, slist_index n );
@@ -16,6 +16,11 @@
 
 #include <stdio.h>
 
+/* A string's characters are always in their own allocation, at least
+ * 64 bytes to start with, and never inside the str itself: data is
+ * read directly throughout the library and must stay valid when a str
+ * is moved, as by realloc() of an array of them or by qsort().
+ */
 typedef struct str {
 	char *data;
 	long dim;
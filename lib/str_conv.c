@@ -13,6 +13,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "latex.h"
 #include "entities.h"
 #include "utf8.h"
@@ -161,6 +166,112 @@ write_unicode( str *s, unsigned int ch, int charsetout, int latexout,
 	return 1;
 }
 
+/*
+ * Clean runs
+ *
+ * Most of a typical value is plain ASCII that every supported input
+ * decodes to itself and every non-latex output writes back unchanged.
+ * Such runs are found a block at a time and copied in bulk; only the
+ * bytes that need work (non-ASCII, XML specials when escaping, entity
+ * or latex starts on input) go through get_unicode()/write_unicode().
+ */
+#define CONV_XMLOUT (1)   /* escaped as one of the five XML entities */
+#define CONV_XMLIN  (2)   /* may start an XML entity */
+#define CONV_END    (4)
+
+/* latex starts aren't listed here but come from LATEX_STARTCHARS, */
+/* the set latex2char() itself checks                              */
+
+static const unsigned char conv_ascii[128] = {
+	[ '\0' ] = CONV_END,
+	[ '"'  ] = CONV_XMLOUT,
+	[ '&'  ] = CONV_XMLOUT | CONV_XMLIN,
+	[ '\'' ] = CONV_XMLOUT,
+	[ '<'  ] = CONV_XMLOUT,
+	[ '>'  ] = CONV_XMLOUT,
+};
+
+typedef struct convstops {
+	unsigned char stop[ 128 ];
+	int           n;
+	char          c[ 16 ];
+} convstops;
+
+/* returns 0 if ASCII isn't passed through unchanged in this conversion */
+static int
+convstops_init( convstops *st, int charsetin, int latexin, int xmlin,
+		int charsetout, int latexout, int utf8out, int xmlout )
+{
+	unsigned char mask;
+	const char *p;
+	int i;
+
+	if ( charsetin!=CHARSET_UNICODE && charsetin!=CHARSET_GB18030 ) return 0;
+	if ( latexout ) return 0;
+	if ( !utf8out && charsetout!=CHARSET_UNICODE && charsetout!=CHARSET_GB18030 ) return 0;
+
+	mask = CONV_END;
+	if ( xmlout ) mask |= CONV_XMLOUT;
+	if ( xmlin  ) mask |= CONV_XMLIN;
+
+	for ( i=0; i<128; ++i )
+		st->stop[i] = ( conv_ascii[i] & mask )!=0;
+	if ( latexin && charsetin!=CHARSET_GB18030 ) {
+		for ( p=LATEX_STARTCHARS; *p; ++p )
+			st->stop[ (unsigned char) *p ] = 1;
+	}
+
+	st->n = 0;
+	for ( i=0; i<128; ++i )
+		if ( st->stop[i] ) st->c[ st->n++ ] = i;
+
+	return 1;
+}
+
+static inline int
+convstops_isstop( convstops *st, unsigned char c )
+{
+	return ( c > 127 || st->stop[c] );
+}
+
+/* length of the clean run at the start of p[0..len) */
+static unsigned long
+convstops_span( convstops *st, const char *p, unsigned long len )
+{
+	unsigned long n = 0;
+#if defined(__AVX2__) && defined(__GNUC__)
+	__m256i v, m, c[ 16 ];
+	unsigned int bits;
+	int i;
+
+	for ( i=0; i<st->n; ++i ) c[i] = _mm256_set1_epi8( st->c[i] );
+	for ( ; n + 32 <= len; n += 32 ) {
+		v = _mm256_loadu_si256( ( const __m256i * ) ( p + n ) );
+		m = v;   /* high bit marks non-ASCII */
+		for ( i=0; i<st->n; ++i )
+			m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, c[i] ) );
+		bits = ( unsigned int ) _mm256_movemask_epi8( m );
+		if ( bits ) return n + __builtin_ctz( bits );
+	}
+#elif defined(__SSE2__) && defined(__GNUC__)
+	__m128i v, m, c[ 16 ];
+	unsigned int bits;
+	int i;
+
+	for ( i=0; i<st->n; ++i ) c[i] = _mm_set1_epi8( st->c[i] );
+	for ( ; n + 16 <= len; n += 16 ) {
+		v = _mm_loadu_si128( ( const __m128i * ) ( p + n ) );
+		m = v;   /* high bit marks non-ASCII */
+		for ( i=0; i<st->n; ++i )
+			m = _mm_or_si128( m, _mm_cmpeq_epi8( v, c[i] ) );
+		bits = ( unsigned int ) _mm_movemask_epi8( m );
+		if ( bits ) return n + __builtin_ctz( bits );
+	}
+#endif
+	while ( n < len && !convstops_isstop( st, p[n] ) ) n++;
+	return n;
+}
+
 /*
  * Returns 1 on memory error condition
  */
@@ -170,12 +281,22 @@ str_convert( str *s,
 	int charsetout, int latexout, int utf8out, int xmlout )
 {
 	unsigned int pos = 0;
+	unsigned long n;
 	unsigned int ch;
+	convstops st;
+	int ok = 1, fast;
 	str ns;
-	int ok = 1;
 
 	if ( !s || s->len==0 ) return ok;
 
+	if ( charsetin==CHARSET_UNKNOWN ) charsetin = CHARSET_DEFAULT;
+	if ( charsetout==CHARSET_UNKNOWN ) charsetout = CHARSET_DEFAULT;
+
+	fast = convstops_init( &st, charsetin, latexin, xmlin, charsetout, latexout, utf8out, xmlout );
+
+	/* nothing to convert */
+	if ( fast && convstops_span( &st, s->data, s->len )==s->len ) return ok;
+
 	/* Ensure that string is internally allocated.
 	 * This fixes NULL pointer derefernce in CVE-2018-10775 in bibutils
 	 * as a string with a valid data pointer is potentially replaced
@@ -187,10 +308,16 @@ str_convert( str *s,
 	 */
 	str_initstrc( &ns, "" );
 
-	if ( charsetin==CHARSET_UNKNOWN ) charsetin = CHARSET_DEFAULT;
-	if ( charsetout==CHARSET_UNKNOWN ) charsetout = CHARSET_DEFAULT;
-
-	while ( s->data[pos] ) {
+	/* a sequence cut short at the end can be decoded past the NUL */
+	while ( pos < s->len && s->data[pos] ) {
+		if ( fast ) {
+			n = convstops_span( &st, s->data + pos, s->len - pos );
+			if ( n ) {
+				str_segcat( &ns, s->data + pos, s->data + pos + n );
+				pos += n;
+				continue;
+			}
+		}
 		ch = get_unicode( s, &pos, charsetin, latexin, utf8in, xmlin );
 		ok = write_unicode( &ns, ch, charsetout, latexout, utf8out, xmlout );
 		if ( !ok ) goto out;
@@ -15,27 +15,163 @@
  * strsearch returns haystack when needle is empty as per strstr()
  * conventions
  *
+ * uses the Two-Way algorithm (Crochemore-Perrin) on characters
+ * folded with toupper(), so searches are linear in the length of
+ * haystack and need no memory allocation
+ *
  */
 #include <stdio.h>
 #include <ctype.h>
 #include "strsearch.h"
 
-char *strsearch (const char *haystack, const char *needle)
+#define fold( c ) ( toupper( (unsigned char)(c) ) )
+
+#define maxval( a, b ) ( ( (a) > (b) ) ? (a) : (b) )
+
+#define bitop( a, b, op ) \
+	( (a)[ (size_t)(b) / ( 8 * sizeof *(a) ) ] op \
+	  (size_t)1 << ( (size_t)(b) % ( 8 * sizeof *(a) ) ) )
+
+/* locate first character matching c (already folded) */
+static char *
+strsearch_char( const unsigned char *h, int c )
+{
+	while ( *h ) {
+		if ( fold( *h ) == c ) return (char *) h;
+		h++;
+	}
+	return NULL;
+}
+
+/* maximal_suffix()
+ *
+ * Compute the maximal suffix of the folded needle n[0..l) under
+ * the normal (invert==0) or reversed (invert!=0) byte ordering.
+ * Returns the start of the suffix minus one, period in *period.
+ */
+static size_t
+maximal_suffix( const unsigned char *n, size_t l, int invert, size_t *period )
+{
+	size_t ip = (size_t) -1, jp = 0, k = 1, p = 1;
+	int a, b;
+
+	while ( jp + k < l ) {
+		a = fold( n[ip+k] );
+		b = fold( n[jp+k] );
+		if ( a == b ) {
+			if ( k == p ) {
+				jp += p;
+				k = 1;
+			} else k++;
+		} else if ( invert ? ( a < b ) : ( a > b ) ) {
+			jp += k;
+			k = 1;
+			p = jp - ip;
+		} else {
+			ip = jp++;
+			k = p = 1;
+		}
+	}
+	*period = p;
+	return ip;
+}
+
+static int
+is_periodic( const unsigned char *n, size_t p, size_t ms )
+{
+	size_t i;
+	for ( i=0; i<ms+1; ++i )
+		if ( fold( n[i] ) != fold( n[i+p] ) ) return 0;
+	return 1;
+}
+
+static char *
+strsearch_twoway( const unsigned char *h, const unsigned char *n )
 {
-	char *returnptr=NULL;
-	unsigned long pos=0;
+	size_t byteset[ 32 / sizeof( size_t ) ] = { 0 };
+	size_t shift[ 256 ];
+	size_t l, k, p, p0, ms, ms0, mem, mem0, grow, avail;
+	const unsigned char *z;
+	int c;
+
+	/* needle length and bad-character shift table over folded bytes; */
+	/* bail out early if the haystack is shorter than the needle      */
+	for ( l=0; n[l] && h[l]; l++ ) {
+		c = fold( n[l] );
+		bitop( byteset, c, |= );
+		shift[ c ] = l + 1;
+	}
+	if ( n[l] ) return NULL;
+
+	/* critical factorization of the needle */
+	ms0 = maximal_suffix( n, l, 0, &p0 );
+	ms  = maximal_suffix( n, l, 1, &p );
+	if ( ms + 1 <= ms0 + 1 ) {
+		ms = ms0;
+		p  = p0;
+	}
 
-	if ( !(*needle) ) returnptr = (char *) haystack;
+	if ( is_periodic( n, p, ms ) ) mem0 = l - p;
+	else {
+		mem0 = 0;
+		p = maxval( ms, l - ms - 1 ) + 1;
+	}
+	mem = 0;
+
+	/* z tracks how much of the haystack is known to be non-NUL */
+	z = h;
+
+	for ( ;; ) {
+
+		if ( (size_t)( z - h ) < l ) {
+			grow = l | 63;
+			for ( avail=0; avail<grow && z[avail]; avail++ ) ;
+			z += avail;
+			if ( avail < grow && (size_t)( z - h ) < l ) return NULL;
+		}
 
-	while (*(haystack+pos) && returnptr==NULL) {
-		if ( toupper((unsigned char)*(haystack+pos)) == toupper((unsigned char)*(needle+pos)) )
-			pos++;
-		else {
-			pos = 0;
-			haystack++;
+		/* check last byte first, advancing by the shift table */
+		c = fold( h[l-1] );
+		if ( bitop( byteset, c, & ) ) {
+			k = l - shift[ c ];
+			if ( k ) {
+				if ( k < mem ) k = mem;
+				h += k;
+				mem = 0;
+				continue;
+			}
+		} else {
+			h += l;
+			mem = 0;
+			continue;
 		}
-		if ( ! (*(needle+pos)) ) returnptr = (char *) haystack;
+
+		/* compare right half */
+		for ( k=maxval( ms+1, mem ); n[k] && fold( n[k] )==fold( h[k] ); k++ ) ;
+		if ( n[k] ) {
+			h += k - ms;
+			mem = 0;
+			continue;
+		}
+
+		/* compare left half */
+		for ( k=ms+1; k>mem && fold( n[k-1] )==fold( h[k-1] ); k-- ) ;
+		if ( k <= mem ) return (char *) h;
+		h += p;
+		mem = mem0;
 	}
-	return returnptr;
 }
 
+char *strsearch (const char *haystack, const char *needle)
+{
+	const unsigned char *h = (const unsigned char *) haystack;
+	const unsigned char *n = (const unsigned char *) needle;
+
+	if ( !(*needle) ) return (char *) haystack;
+
+	/* skip to first plausible starting point */
+	h = (const unsigned char *) strsearch_char( h, fold( n[0] ) );
+	if ( !h || !n[1] ) return (char *) h;
+
+	return strsearch_twoway( h, n );
+}
@@ -0,0 +1,220 @@
+/*
+ * tagline.c
+ *
+ * Copyright (c) Chris Putnam 2003-2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Shared line tokenizer for the tagged formats (RIS, ISI, NBIB,
+ * EndNote/Refer, and COPAC). Tag shapes are described per-format
+ * as sequences of byte classes looked up in a precomputed table,
+ * and lines are returned as (tag, value) spans into the caller's
+ * buffer.
+ *
+ */
+#include <stdio.h>
+#include "is_ws.h"
+#include "charsets.h"
+#include "str.h"
+#include "tagline.h"
+
+/* byte classes */
+#define TC_UP (1)    /* uppercase A-Z */
+#define TC_DG (2)    /* digit 0-9 */
+#define TC_LO (4)    /* lowercase a-z */
+#define TC_SP (8)    /* space (ansi 32) */
+#define TC_DA (16)   /* dash (ansi 45) */
+#define TC_OT (32)   /* other characters allowed in EndNote tags */
+#define TC_EL (64)   /* end of line: '\0', '\n', '\r' */
+#define TC_PC (128)  /* percent, starts EndNote tags */
+
+static const unsigned char byteclass[256] = {
+	TC_EL, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, TC_EL, 0, 0, TC_EL, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	TC_SP, TC_OT, 0, TC_OT, TC_OT, TC_PC, TC_OT, 0,
+	TC_OT, TC_OT, TC_OT, TC_OT, 0, TC_DA, 0, 0,
+	TC_DG, TC_DG, TC_DG, TC_DG, TC_DG, TC_DG, TC_DG, TC_DG,
+	TC_DG, TC_DG, 0, 0, 0, TC_OT, TC_OT, TC_OT,
+	TC_OT, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP,
+	TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP,
+	TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP, TC_UP,
+	TC_UP, TC_UP, TC_UP, TC_OT, 0, 0, TC_OT, 0,
+	0, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO,
+	TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO,
+	TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO, TC_LO,
+	TC_LO, TC_LO, TC_LO, 0, 0, 0, TC_OT, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define TAGLINE_MAXSHAPE  (8)
+#define TAGLINE_MAXSHAPES (2)
+
+typedef struct tagshape {
+	/* tag is accepted if the line matches any of the shapes; each */
+	/* shape lists the required class per character, 0 terminated  */
+	unsigned char shape[TAGLINE_MAXSHAPES][TAGLINE_MAXSHAPE];
+	unsigned char tagclass;  /* classes of characters in the tag itself */
+	int           tagmax;    /* maximum length of the tag itself */
+	int           skip;      /* characters before value starts */
+	int           trim_untagged;
+} tagshape;
+
+/* indexed by TAGLINE_RIS, TAGLINE_ISI, ... */
+static const tagshape shapes[] = {
+
+	/* RIS is strict: "XY  - ", but some sources omit the final space */
+	/* when there is no data ("ER  -") and www.omicsonline.org puts   */
+	/* three spaces before the dash                                   */
+	{
+		{ { TC_UP, TC_UP|TC_DG, TC_SP, TC_SP, TC_DA, TC_SP|TC_EL, 0 },
+		  { TC_UP, TC_UP|TC_DG, TC_SP, TC_SP, TC_SP, TC_DA, TC_SP|TC_EL, 0 } },
+		TC_UP|TC_DG, 2, 6, 0
+	},
+
+	/* ISI: "XY" */
+	{
+		{ { TC_UP, TC_UP|TC_DG, 0 } },
+		TC_UP|TC_DG, 2, 2, 1
+	},
+
+	/* NBIB: "XY  - " through "WXYZ- " */
+	{
+		{ { TC_UP, TC_UP, TC_UP|TC_SP, TC_UP|TC_SP, TC_DA, TC_SP, 0 } },
+		TC_UP, 4, 6, 0
+	},
+
+	/* EndNote: "%X " */
+	{
+		{ { TC_PC, TC_UP|TC_LO|TC_DG|TC_OT, TC_SP, 0 } },
+		TC_PC|TC_UP|TC_LO|TC_DG|TC_OT, 2, 2, 1
+	},
+
+	/* COPAC: "XY- " */
+	{
+		{ { TC_UP, TC_UP, TC_DA, TC_SP, 0 } },
+		TC_UP|TC_DA, 3, 3, 1
+	},
+};
+
+#define byte_is( c, classes ) ( byteclass[ (unsigned char)(c) ] & (classes) )
+
+static int
+tagline_matchshape( const unsigned char *shape, const char *p )
+{
+	int i;
+	for ( i=0; i<TAGLINE_MAXSHAPE && shape[i]; ++i ) {
+		if ( !byte_is( p[i], shape[i] ) ) return 0;
+		/* don't look past the end of the string */
+		if ( p[i]=='\0' ) return ( shape[i+1]==0 );
+	}
+	return ( i > 0 );
+}
+
+/* tagline_istag()
+ *
+ * Returns 1 if line starting at p begins with a tag of the format.
+ */
+int
+tagline_istag( int format, const char *p )
+{
+	const tagshape *s = &(shapes[format]);
+	int i;
+	for ( i=0; i<TAGLINE_MAXSHAPES; ++i )
+		if ( tagline_matchshape( s->shape[i], p ) ) return 1;
+	return 0;
+}
+
+/* tagline_skipbom()
+ *
+ * Skip over UTF8 byte order mark (ef bb bf), setting *fcharset
+ * if it is found.
+ */
+char *
+tagline_skipbom( char *p, int *fcharset )
+{
+	unsigned char *up = ( unsigned char * ) p;
+
+	/* ...if null-terminated string is too short, we're ok */
+	if ( up[0]==0xEF && up[1]==0xBB && up[2]==0xBF ) {
+		*fcharset = CHARSET_UNICODE;
+		p += 3;
+	}
+	return p;
+}
+
+/* tagline_next()
+ *
+ * Tokenize the line starting at p into tag and value spans and
+ * return the start of the following line. Value has leading
+ * whitespace skipped; trailing whitespace is trimmed for tagged
+ * lines (and untagged lines for formats that trim them).
+ */
+char *
+tagline_next( int format, char *p, tagline *t )
+{
+	const tagshape *s = &(shapes[format]);
+	int i, trim = 1;
+
+	t->tag    = p;
+	t->taglen = 0;
+
+	if ( tagline_istag( format, p ) ) {
+		while ( t->taglen < s->tagmax && byte_is( p[t->taglen], s->tagclass ) )
+			t->taglen++;
+		for ( i=0; i<s->skip && !byte_is( *p, TC_EL ); ++i )
+			p++;
+	} else {
+		trim = s->trim_untagged;
+	}
+
+	while ( *p==' ' || *p=='\t' ) p++;
+
+	t->value = p;
+	while ( !byte_is( *p, TC_EL ) ) p++;
+	t->valuelen = p - t->value;
+
+	if ( trim ) {
+		while ( t->valuelen > 0 && is_ws( t->value[t->valuelen-1] ) )
+			t->valuelen--;
+	}
+
+	while ( *p=='\n' || *p=='\r' ) p++;
+
+	return p;
+}
+
+/* tagline_strs()
+ *
+ * Copy tag and value spans into strings. The tag is left untouched
+ * for untagged lines so that it carries over from the previous line.
+ *
+ * Returns 1 on success, 0 on memory error.
+ */
+int
+tagline_strs( tagline *t, str *tag, str *value )
+{
+	if ( t->taglen ) {
+		str_segcpy( tag, t->tag, t->tag + t->taglen );
+		if ( str_memerr( tag ) ) return 0;
+	}
+	str_segcpy( value, t->value, t->value + t->valuelen );
+	if ( str_memerr( value ) ) return 0;
+	return 1;
+}
@@ -0,0 +1,35 @@
+/*
+ * tagline.h
+ *
+ * Copyright (c) Chris Putnam 2003-2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef TAGLINE_H
+#define TAGLINE_H
+
+#include "str.h"
+
+#define TAGLINE_RIS     (0)
+#define TAGLINE_ISI     (1)
+#define TAGLINE_NBIB    (2)
+#define TAGLINE_ENDNOTE (3)
+#define TAGLINE_COPAC   (4)
+
+/* Spans point into the scanned buffer and are not NUL-terminated;
+ * taglen==0 marks an untagged (continuation) line.
+ */
+typedef struct tagline {
+	char          *tag;
+	unsigned long taglen;
+	char          *value;
+	unsigned long valuelen;
+} tagline;
+
+int   tagline_istag   ( int format, const char *p );
+char *tagline_skipbom ( char *p, int *fcharset );
+char *tagline_next    ( int format, char *p, tagline *t );
+int   tagline_strs    ( tagline *t, str *tag, str *value );
+
+#endif
@@ -316,14 +316,15 @@ unicode_utf8_classify( char *p )
 	else return unicodeinfo[n].info;
 }
 
+/* classify the len bytes at p */
 unsigned short
-unicode_utf8_classify_str( str *s )
+unicode_utf8_classify_len( char *p, unsigned int len )
 {
 	unsigned int unicode_character, pos = 0;
 	unsigned short value = 0;
 	int n;
-	while ( pos < s->len ) {
-		unicode_character = utf8_decode( str_cstr( s ), &pos );
+	while ( pos < len ) {
+		unicode_character = utf8_decode( p, &pos );
 		n = unicode_find( unicode_character );
 		if ( n==-1 ) value |= UNICODE_SYMBOL;
 		else value |= unicodeinfo[n].info;
@@ -331,3 +332,9 @@ unicode_utf8_classify_str( str *s )
 	return value;
 }
 
+unsigned short
+unicode_utf8_classify_str( str *s )
+{
+	return unicode_utf8_classify_len( str_cstr( s ), s->len );
+}
+
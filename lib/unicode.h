@@ -17,6 +17,7 @@
 #define UNICODE_MIXEDCASE ( UNICODE_UPPER | UNICODE_LOWER )
 
 extern unsigned short unicode_utf8_classify( char *p );
+extern unsigned short unicode_utf8_classify_len( char *p, unsigned int len );
 extern unsigned short unicode_utf8_classify_str( str *s );
 
 #endif
@@ -244,7 +244,7 @@ urls_split_and_add( char *value_in, fields *out, int lvl_out )
  *
  */
 static int
-urls_merge_and_add_type( fields *out, char *tag_out, int lvl_out, char *prefix, vplist *values )
+urls_merge_and_add_type( outfields *out, char *tag_out, int lvl_out, char *prefix, vplist *values )
 {
 	int fstatus, status = BIBL_OK;
 	vplist_index i;
@@ -255,7 +255,7 @@ urls_merge_and_add_type( fields *out, char *tag_out, int lvl_out, char *prefix,
 	for ( i=0; i<values->n; ++i ) {
 		str_strcpyc( &url, prefix );
 		str_strcatc( &url, ( char * ) vplist_get( values, i ) );
-		fstatus = fields_add( out, tag_out, str_cstr( &url ), lvl_out );
+		fstatus = outfields_add( out, tag_out, str_cstr( &url ), lvl_out );
 		if ( fstatus!=FIELDS_OK ) {
 			status = BIBL_ERR_MEMERR;
 			goto out;
@@ -277,7 +277,7 @@ out:
  * like bibtex ought to do special things with DOI, ARXIV, MRNUMBER, and the like.
  */
 int
-urls_merge_and_add( fields *in, int lvl_in, fields *out, char *tag_out, int lvl_out, slist *types )
+urls_merge_and_add( fields *in, int lvl_in, outfields *out, char *tag_out, int lvl_out, slist *types )
 {
 	int i, j, status = BIBL_OK;
 	char *tag, *prefix, *empty="";
@@ -11,6 +11,7 @@
 
 #include "slist.h"
 #include "fields.h"
+#include "outfields.h"
 
 int is_doi( char *s );
 int is_uri_remote_scheme( char *p );
@@ -23,7 +24,7 @@ void arxiv_to_url( fields *info, int n, char *urltag, str *arxiv_url );
 void jstor_to_url( fields *info, int n, char *urltag, str *jstor_url );
 void mrnumber_to_url( fields *info, int n, char *urltag, str *jstor_url );
 
-int urls_merge_and_add( fields *in, int lvl_in, fields *out, char *tag_out, int lvl_out, slist *types );
+int urls_merge_and_add( fields *in, int lvl_in, outfields *out, char *tag_out, int lvl_out, slist *types );
 int urls_split_and_add( char *value_in, fields *out, int lvl_out );
 
 
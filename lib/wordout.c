@@ -14,11 +14,12 @@
 #include "str.h"
 #include "fields.h"
 #include "utf8.h"
+#include "outsink.h"
 #include "bibformats.h"
 
-static void wordout_writeheader( FILE *outptr, param *p );
-static void wordout_writefooter( FILE *outptr );
-static int  wordout_write( fields *info, FILE *outptr, param *p, unsigned long numrefs );
+static void wordout_writeheader( outsink *outptr, param *p );
+static void wordout_writefooter( outsink *outptr );
+static int  wordout_write( fields *info, outsink *outptr, param *p, unsigned long numrefs );
 
 void
 wordout_initparams( param *p, const char *progname )
@@ -38,6 +39,12 @@ wordout_initparams( param *p, const char *progname )
 	p->verbose          = 0;
 	p->addcount         = 0;
 	p->singlerefperfile = 0;
+	p->compressout      = BIBL_COMPRESS_NONE;
+	p->asyncout         = 0;
+	p->outdir           = NULL;
+	p->shardmode        = BIBL_SHARD_NONE;
+	p->shardsize        = 0;
+	p->shardprefix      = NULL;
 
 	p->headerf = wordout_writeheader;
 	p->footerf = wordout_writefooter;
@@ -107,23 +114,23 @@ enum {
  * fixed output
  */
 static void
-output_fixed( FILE *outptr, char *tag, char *value, int level )
+output_fixed( outsink *outptr, char *tag, char *value, int level )
 {
 	int i;
-	for ( i=0; i<level; ++i ) fprintf( outptr, " " );
-	fprintf( outptr, "<%s>%s</%s>\n", tag, value, tag );
+	for ( i=0; i<level; ++i ) outsink_puts( outptr, " " );
+	outsink_printf( outptr, "<%s>%s</%s>\n", tag, value, tag );
 }
 
 /* detail output
  *
  */
 static void
-output_item( fields *info, FILE *outptr, char *tag, char *prefix, int item, int level )
+output_item( fields *info, outsink *outptr, char *tag, char *prefix, int item, int level )
 {
 	int i;
 	if ( item==-1 ) return;
-	for ( i=0; i<level; ++i ) fprintf( outptr, " " );
-	fprintf( outptr, "<%s>%s%s</%s>\n",
+	for ( i=0; i<level; ++i ) outsink_puts( outptr, " " );
+	outsink_printf( outptr, "<%s>%s%s</%s>\n",
 		tag,
 		prefix,
 		(char*) fields_value( info, item, FIELDS_CHRP ),
@@ -132,11 +139,11 @@ output_item( fields *info, FILE *outptr, char *tag, char *prefix, int item, int
 }
 
 static void
-output_itemv( FILE *outptr, char *tag, char *item, int level )
+output_itemv( outsink *outptr, char *tag, char *item, int level )
 {
 	int i;
-	for ( i=0; i<level; ++i ) fprintf( outptr, " " );
-	fprintf( outptr, "<%s>%s</%s>\n", tag, item, tag );
+	for ( i=0; i<level; ++i ) outsink_puts( outptr, " " );
+	outsink_printf( outptr, "<%s>%s</%s>\n", tag, item, tag );
 }
 
 /* range output
@@ -145,7 +152,7 @@ output_itemv( FILE *outptr, char *tag, char *item, int level )
  *
  */
 static void
-output_range( FILE *outptr, char *tag, char *start, char *end, int level )
+output_range( outsink *outptr, char *tag, char *start, char *end, int level )
 {
 	int i;
 	if ( start==NULL && end==NULL ) return;
@@ -155,13 +162,13 @@ output_range( FILE *outptr, char *tag, char *start, char *end, int level )
 		output_itemv( outptr, tag, start, 0 );
 	else {
 		for ( i=0; i<level; ++i )
-			fprintf( outptr, " " );
-		fprintf( outptr, "<%s>%s-%s</%s>\n", tag, start, end, tag );
+			outsink_puts( outptr, " " );
+		outsink_printf( outptr, "<%s>%s-%s</%s>\n", tag, start, end, tag );
 	}
 }
 
 static void
-output_list( fields *info, FILE *outptr, convert *c, int nc )
+output_list( fields *info, outsink *outptr, convert *c, int nc )
 {
         int i, n;
         for ( i=0; i<nc; ++i ) {
@@ -272,31 +279,31 @@ get_type( fields *info )
 }
 
 static void
-output_titlebits( char *mainttl, char *subttl, FILE *outptr )
+output_titlebits( char *mainttl, char *subttl, outsink *outptr )
 {
-	if ( mainttl ) fprintf( outptr, "%s", mainttl );
+	if ( mainttl ) outsink_puts( outptr, mainttl );
 	if ( subttl ) {
 		if ( mainttl ) {
 			if ( mainttl[ strlen( mainttl ) - 1 ] != '?' )
-				fprintf( outptr, ": " );
-			else fprintf( outptr, " " );
+				outsink_puts( outptr, ": " );
+			else outsink_puts( outptr, " " );
 		}
-		fprintf( outptr, "%s", subttl );
+		outsink_puts( outptr, subttl );
 	}
 }
 
 static void
-output_titleinfo( char *mainttl, char *subttl, FILE *outptr, char *tag, int level )
+output_titleinfo( char *mainttl, char *subttl, outsink *outptr, char *tag, int level )
 {
 	if ( mainttl || subttl ) {
-		fprintf( outptr, "<%s>", tag );
+		outsink_printf( outptr, "<%s>", tag );
 		output_titlebits( mainttl, subttl, outptr );
-		fprintf( outptr, "</%s>\n", tag );
+		outsink_printf( outptr, "</%s>\n", tag );
 	}
 }
 
 static void
-output_generaltitle( fields *info, FILE *outptr, char *tag, int level )
+output_generaltitle( fields *info, outsink *outptr, char *tag, int level )
 {
 	char *ttl       = fields_findv( info, level, FIELDS_CHRP, "TITLE" );
 	char *subttl    = fields_findv( info, level, FIELDS_CHRP, "SUBTITLE" );
@@ -312,7 +319,7 @@ output_generaltitle( fields *info, FILE *outptr, char *tag, int level )
 }
 
 static void
-output_maintitle( fields *info, FILE *outptr, int level )
+output_maintitle( fields *info, outsink *outptr, int level )
 {
 	char *ttl       = fields_findv( info, level, FIELDS_CHRP, "TITLE" );
 	char *subttl    = fields_findv( info, level, FIELDS_CHRP, "SUBTITLE" );
@@ -325,9 +332,9 @@ output_maintitle( fields *info, FILE *outptr, int level )
 		/* output shorttitle if it's different from normal title */
 		if ( shrttl ) {
 			if ( !ttl || ( strcmp( shrttl, ttl ) || subttl ) ) {
-				fprintf( outptr,  " <b:ShortTitle>" );
+				outsink_puts( outptr,  " <b:ShortTitle>" );
 				output_titlebits( shrttl, shrsubttl, outptr );
-				fprintf( outptr, "</b:ShortTitle>\n" );
+				outsink_puts( outptr, "</b:ShortTitle>\n" );
 			}
 		}
 	}
@@ -337,15 +344,15 @@ output_maintitle( fields *info, FILE *outptr, int level )
 }
 
 static void
-output_name_nomangle( FILE *outptr, char *p )
+output_name_nomangle( outsink *outptr, char *p )
 {
-	fprintf( outptr, "<b:Person>" );
-	fprintf( outptr, "<b:Last>%s</b:Last>", p );
-	fprintf( outptr, "</b:Person>\n" );
+	outsink_puts( outptr, "<b:Person>" );
+	outsink_printf( outptr, "<b:Last>%s</b:Last>", p );
+	outsink_puts( outptr, "</b:Person>\n" );
 }
 
 static void
-output_name( FILE *outptr, char *p )
+output_name( outsink *outptr, char *p )
 {
 	str family, part;
 	int n=0, npart=0;
@@ -354,8 +361,8 @@ output_name( FILE *outptr, char *p )
 	while ( *p && *p!='|' ) str_addchar( &family, *p++ );
 	if ( *p=='|' ) p++;
 	if ( str_has_value( &family ) ) {
-		fprintf( outptr, "<b:Person>" );
-		fprintf( outptr, "<b:Last>%s</b:Last>", str_cstr( &family ) );
+		outsink_puts( outptr, "<b:Person>" );
+		outsink_printf( outptr, "<b:Last>%s</b:Last>", str_cstr( &family ) );
 		n++;
 	}
 	str_free( &family );
@@ -364,11 +371,11 @@ output_name( FILE *outptr, char *p )
 	while ( *p ) {
 		while ( *p && *p!='|' ) str_addchar( &part, *p++ );
 		if ( str_has_value( &part ) ) {
-			if ( n==0 ) fprintf( outptr, "<b:Person>" );
+			if ( n==0 ) outsink_puts( outptr, "<b:Person>" );
 			if ( npart==0 ) 
-				fprintf( outptr, "<b:First>%s</b:First>", str_cstr( &part ) );
+				outsink_printf( outptr, "<b:First>%s</b:First>", str_cstr( &part ) );
 			else
-				fprintf( outptr, "<b:Middle>%s</b:Middle>", str_cstr( &part ) );
+				outsink_printf( outptr, "<b:Middle>%s</b:Middle>", str_cstr( &part ) );
 			n++;
 			npart++;
 		}
@@ -377,7 +384,7 @@ output_name( FILE *outptr, char *p )
 			str_empty( &part );
 		}
 	}
-	if ( n ) fprintf( outptr, "</b:Person>\n" );
+	if ( n ) outsink_puts( outptr, "</b:Person>\n" );
 
 	str_free( &part );
 }
@@ -398,7 +405,7 @@ extract_name_and_info( str *outtag, str *intag )
 }
 
 static void
-output_name_type( fields *info, FILE *outptr, int level, 
+output_name_type( fields *info, outsink *outptr, int level, 
 			char *map[], int nmap, char *tag )
 {
 	str ntag;
@@ -410,7 +417,7 @@ output_name_type( fields *info, FILE *outptr, int level,
 			code = extract_name_and_info( &ntag, &(info->tag[i]) );
 			if ( strcasecmp( str_cstr( &ntag ), map[j] ) ) continue;
 			if ( n==0 )
-				fprintf( outptr, "<%s><b:NameList>\n", tag );
+				outsink_printf( outptr, "<%s><b:NameList>\n", tag );
 			if ( code != NAME )
 				output_name_nomangle( outptr, (char *) fields_value( info, i, FIELDS_CHRP ) );
 			else 
@@ -420,11 +427,11 @@ output_name_type( fields *info, FILE *outptr, int level,
 	}
 	str_free( &ntag );
 	if ( n )
-		fprintf( outptr, "</b:NameList></%s>\n", tag );
+		outsink_printf( outptr, "</b:NameList></%s>\n", tag );
 }
 
 static void
-output_names( fields *info, FILE *outptr, int level, int type )
+output_names( fields *info, outsink *outptr, int level, int type )
 {
 	char *authors[] = { "AUTHOR", "WRITER", "ASSIGNEE", "ARTIST",
 		"CARTOGRAPHER", "INVENTOR", "ORGANIZER", "DIRECTOR",
@@ -441,14 +448,14 @@ output_names( fields *info, FILE *outptr, int level, int type )
 
 	if ( type == TYPE_PATENT ) author_type = inventor;
 
-	fprintf( outptr, "<b:Author>\n" );
+	outsink_puts( outptr, "<b:Author>\n" );
 	output_name_type( info, outptr, level, authors, nauthors, author_type );
 	output_name_type( info, outptr, level, editors, neditors, "b:Editor" );
-	fprintf( outptr, "</b:Author>\n" );
+	outsink_puts( outptr, "</b:Author>\n" );
 }
 
 static void
-output_date( fields *info, FILE *outptr, int level )
+output_date( fields *info, outsink *outptr, int level )
 {
 	char *year  = fields_findv_firstof( info, level, FIELDS_CHRP,
 			"PARTDATE:YEAR", "DATE:YEAR", NULL );
@@ -462,7 +469,7 @@ output_date( fields *info, FILE *outptr, int level )
 }
 
 static void
-output_pages( fields *info, FILE *outptr, int level )
+output_pages( fields *info, outsink *outptr, int level )
 {
 	char *sn = fields_findv( info, LEVEL_ANY, FIELDS_CHRP, "PAGES:START" );
 	char *en = fields_findv( info, LEVEL_ANY, FIELDS_CHRP, "PAGES:STOP" );
@@ -474,7 +481,7 @@ output_pages( fields *info, FILE *outptr, int level )
 }
 
 static void
-output_includedin( fields *info, FILE *outptr, int type )
+output_includedin( fields *info, outsink *outptr, int type )
 {
 	if ( type==TYPE_JOURNALARTICLE ) {
 		output_generaltitle( info, outptr, "b:JournalName", 1 );
@@ -499,7 +506,7 @@ type_is_thesis( int type )
 }
 
 static void
-output_thesisdetails( fields *info, FILE *outptr, int type )
+output_thesisdetails( fields *info, outsink *outptr, int type )
 {
 	char *tag;
 	int i, n;
@@ -545,27 +552,27 @@ static
 int ntypes = sizeof( types ) / sizeof( types[0] );
 
 static void
-output_type( fields *info, FILE *outptr, int type )
+output_type( fields *info, outsink *outptr, int type )
 {
 	int i, found = 0;
-	fprintf( outptr, "<b:SourceType>" );
+	outsink_puts( outptr, "<b:SourceType>" );
 	for ( i=0; i<ntypes && !found; ++i ) {
 		if ( types[i].value!=type ) continue;
 		found = 1;
-		fprintf( outptr, "%s", types[i].out );
+		outsink_puts( outptr, types[i].out );
 	}
 	if ( !found ) {
-		if (  type_is_thesis( type ) ) fprintf( outptr, "Report" );
-		else fprintf( outptr, "Misc" );
+		if (  type_is_thesis( type ) ) outsink_puts( outptr, "Report" );
+		else outsink_puts( outptr, "Misc" );
 	}
-	fprintf( outptr, "</b:SourceType>\n" );
+	outsink_puts( outptr, "</b:SourceType>\n" );
 
 	if ( type_is_thesis( type ) )
 		output_thesisdetails( info, outptr, type );
 }
 
 static void
-output_comments( fields *info, FILE *outptr, int level )
+output_comments( fields *info, outsink *outptr, int level )
 {
 	vplist_index i;
 	vplist notes;
@@ -576,17 +583,17 @@ output_comments( fields *info, FILE *outptr, int level )
 	abs = fields_findv( info, level, FIELDS_CHRP, "ABSTRACT" );
 	fields_findv_each( info, level, FIELDS_CHRP, &notes, "NOTES" );
 
-	if ( abs || notes.n ) fprintf( outptr, "<b:Comments>" );
-	if ( abs ) fprintf( outptr, "%s", abs );
+	if ( abs || notes.n ) outsink_puts( outptr, "<b:Comments>" );
+	if ( abs ) outsink_puts( outptr, abs );
 	for ( i=0; i<notes.n; ++i )
-		fprintf( outptr, "%s", (char*)vplist_get( &notes, i ) );
-	if ( abs || notes.n ) fprintf( outptr, "</b:Comments>\n" );
+		outsink_puts( outptr, (char*)vplist_get( &notes, i ) );
+	if ( abs || notes.n ) outsink_puts( outptr, "</b:Comments>\n" );
 
 	vplist_free( &notes );
 }
 
 static void
-output_bibkey( fields *info, FILE *outptr )
+output_bibkey( fields *info, outsink *outptr )
 {
 	char *bibkey = fields_findv_firstof( info, LEVEL_ANY, FIELDS_CHRP,
 			"REFNUM", "BIBKEY", NULL );
@@ -594,7 +601,7 @@ output_bibkey( fields *info, FILE *outptr )
 }
 
 static void
-output_citeparts( fields *info, FILE *outptr, int level, int max, int type )
+output_citeparts( fields *info, outsink *outptr, int level, int max, int type )
 {
 	convert origin[] = {
 		{ "ADDRESS",	"b:City",	"", LEVEL_ANY },
@@ -633,33 +640,30 @@ output_citeparts( fields *info, FILE *outptr, int level, int max, int type )
 }
 
 static int
-wordout_write( fields *info, FILE *outptr, param *p, unsigned long numrefs )
+wordout_write( fields *info, outsink *outptr, param *p, unsigned long numrefs )
 {
 	int max = fields_maxlevel( info );
 	int type = get_type( info );
 
-	fprintf( outptr, "<b:Source>\n" );
+	outsink_puts( outptr, "<b:Source>\n" );
 	output_citeparts( info, outptr, -1, max, type );
-	fprintf( outptr, "</b:Source>\n" );
-
-	fflush( outptr );
+	outsink_puts( outptr, "</b:Source>\n" );
 
 	return BIBL_OK;
 }
 
 static void
-wordout_writeheader( FILE *outptr, param *p )
+wordout_writeheader( outsink *outptr, param *p )
 {
-	if ( p->utf8bom ) utf8_writebom( outptr );
-	fprintf(outptr,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-	fprintf(outptr,"<b:Sources SelectedStyle=\"\" "
+	if ( p->utf8bom ) outsink_writebom( outptr );
+	outsink_puts(outptr,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	outsink_printf(outptr,"<b:Sources SelectedStyle=\"\" "
 		"xmlns:b=\"http://schemas.openxmlformats.org/officeDocument/2006/bibliography\" "
 		" xmlns=\"http://schemas.openxmlformats.org/officeDocument/2006/bibliography\" >\n");
 }
 
 static void
-wordout_writefooter( FILE *outptr )
+wordout_writefooter( outsink *outptr )
 {
-	fprintf(outptr,"</b:Sources>\n");
-	fflush( outptr );
+	outsink_puts(outptr,"</b:Sources>\n");
 }
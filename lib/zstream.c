@@ -0,0 +1,600 @@
+/*
+ * zstream.c
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ * Transparent gzip/zstd/xz streams. Input is identified by its
+ * magic bytes and decompressed on a separate thread into a pipe, so
+ * the parser reads plain text while decompression runs alongside.
+ * Output is compressed the same way in reverse. Each format is only
+ * available when its library was found by configure (HAVE_ZLIB,
+ * HAVE_ZSTD, HAVE_LZMA).
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#include "zstream.h"
+
+#define ZSTREAM_BUFSIZE (64*1024)
+
+static const unsigned char gzip_magic[] = { 0x1f, 0x8b };
+static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+static const unsigned char xz_magic[]   = { 0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00 };
+
+void
+zstream_init( zstream *z )
+{
+	z->fp       = NULL;
+	z->raw      = NULL;
+	z->type     = ZSTREAM_NONE;
+	z->writing  = 0;
+	z->threaded = 0;
+	z->pipefd   = -1;
+	z->status   = ZSTREAM_OK;
+	z->npeek    = 0;
+}
+
+int
+zstream_available( int type )
+{
+	switch ( type ) {
+	case ZSTREAM_NONE: return 1;
+#ifdef HAVE_ZLIB
+	case ZSTREAM_GZIP: return 1;
+#endif
+#ifdef HAVE_ZSTD
+	case ZSTREAM_ZSTD: return 1;
+#endif
+#ifdef HAVE_LZMA
+	case ZSTREAM_XZ:   return 1;
+#endif
+	default:           return 0;
+	}
+}
+
+int
+zstream_type( const char *name )
+{
+	if ( !strcasecmp( name, "none" ) ) return ZSTREAM_NONE;
+	if ( !strcasecmp( name, "gzip" ) || !strcasecmp( name, "gz" ) )
+		return ZSTREAM_GZIP;
+	if ( !strcasecmp( name, "zstd" ) || !strcasecmp( name, "zst" ) )
+		return ZSTREAM_ZSTD;
+	if ( !strcasecmp( name, "xz" ) ) return ZSTREAM_XZ;
+	return -1;
+}
+
+const char *
+zstream_name( int type )
+{
+	switch ( type ) {
+	case ZSTREAM_GZIP: return "gzip";
+	case ZSTREAM_ZSTD: return "zstd";
+	case ZSTREAM_XZ:   return "xz";
+	default:           return "none";
+	}
+}
+
+const char *
+zstream_suffix( int type )
+{
+	switch ( type ) {
+	case ZSTREAM_GZIP: return ".gz";
+	case ZSTREAM_ZSTD: return ".zst";
+	case ZSTREAM_XZ:   return ".xz";
+	default:           return "";
+	}
+}
+
+/*
+ * pipe helpers used by the worker threads
+ */
+
+/* write all of buf to fd; returns 0 if the reader has gone away */
+static int
+zstream_put( int fd, const unsigned char *buf, size_t n )
+{
+	ssize_t m;
+	while ( n ) {
+		m = write( fd, buf, n );
+		if ( m < 0 ) {
+			if ( errno==EINTR ) continue;
+			return 0;
+		}
+		buf += m;
+		n   -= m;
+	}
+	return 1;
+}
+
+/* fill buf from fd as far as possible; returns 0 at end of input */
+static size_t
+zstream_get( int fd, unsigned char *buf, size_t size )
+{
+	size_t n = 0;
+	ssize_t m;
+	while ( n < size ) {
+		m = read( fd, buf + n, size - n );
+		if ( m < 0 && errno==EINTR ) continue;
+		if ( m <= 0 ) break;
+		n += m;
+	}
+	return n;
+}
+
+/* after a failure, keep reading so the writer never sees a broken pipe */
+static void
+zstream_drain( int fd, unsigned char *buf )
+{
+	while ( zstream_get( fd, buf, ZSTREAM_BUFSIZE ) ) ;
+}
+
+/* next block of compressed input, starting with the detected magic */
+static size_t
+zstream_fill( zstream *z, unsigned char *buf, size_t size )
+{
+	size_t n = 0;
+	if ( z->npeek ) {
+		memcpy( buf, z->peek, z->npeek );
+		n = z->npeek;
+		z->npeek = 0;
+	}
+	n += fread( buf + n, 1, size - n, z->raw );
+	if ( n==0 && ferror( z->raw ) ) z->status = ZSTREAM_ERR_SYSTEM;
+	return n;
+}
+
+/*
+ * decoders: compressed z->raw -> pipe
+ */
+
+/* input began with a partial magic number, so pass it through */
+static void
+zstream_copyin( zstream *z, unsigned char *in )
+{
+	size_t n;
+	while ( ( n = zstream_fill( z, in, ZSTREAM_BUFSIZE ) ) ) {
+		if ( !zstream_put( z->pipefd, in, n ) ) return;
+	}
+}
+
+#ifdef HAVE_ZLIB
+static void
+zstream_gunzip( zstream *z, unsigned char *in, unsigned char *out )
+{
+	int ret = Z_OK, full = 0;
+	z_stream s;
+	size_t n;
+
+	memset( &s, 0, sizeof( s ) );
+	/* 15+32 accepts gzip (and zlib) headers */
+	if ( inflateInit2( &s, 15+32 )!=Z_OK ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return;
+	}
+	for ( ;; ) {
+		if ( s.avail_in==0 && !full ) {
+			n = zstream_fill( z, in, ZSTREAM_BUFSIZE );
+			if ( n==0 ) break;
+			s.next_in  = in;
+			s.avail_in = n;
+		}
+		/* concatenated members, as produced by "cat a.gz b.gz" */
+		if ( ret==Z_STREAM_END ) inflateReset( &s );
+		s.next_out  = out;
+		s.avail_out = ZSTREAM_BUFSIZE;
+		ret = inflate( &s, Z_NO_FLUSH );
+		if ( ret!=Z_OK && ret!=Z_STREAM_END && ret!=Z_BUF_ERROR ) break;
+		full = ( ret!=Z_STREAM_END && s.avail_out==0 );
+		if ( !zstream_put( z->pipefd, out, ZSTREAM_BUFSIZE - s.avail_out ) ) {
+			ret = Z_STREAM_END;
+			break;
+		}
+	}
+	if ( ret!=Z_STREAM_END && z->status==ZSTREAM_OK )
+		z->status = ZSTREAM_ERR_DATA;
+	inflateEnd( &s );
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void
+zstream_unzstd( zstream *z, unsigned char *in, unsigned char *out )
+{
+	ZSTD_inBuffer  zin;
+	ZSTD_outBuffer zout;
+	ZSTD_DCtx *d;
+	size_t ret = 0, n;
+
+	d = ZSTD_createDCtx();
+	if ( !d ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return;
+	}
+	while ( ( n = zstream_fill( z, in, ZSTREAM_BUFSIZE ) ) ) {
+		zin.src  = in;
+		zin.size = n;
+		zin.pos  = 0;
+		/* a full output buffer may leave data inside the decoder */
+		do {
+			zout.dst  = out;
+			zout.size = ZSTREAM_BUFSIZE;
+			zout.pos  = 0;
+			ret = ZSTD_decompressStream( d, &zout, &zin );
+			if ( ZSTD_isError( ret ) ) {
+				z->status = ZSTREAM_ERR_DATA;
+				goto out;
+			}
+			if ( !zstream_put( z->pipefd, out, zout.pos ) ) goto out;
+		} while ( zin.pos < zin.size || zout.pos==zout.size );
+	}
+	/* non-zero means the last frame was cut short */
+	if ( ret!=0 && z->status==ZSTREAM_OK ) z->status = ZSTREAM_ERR_DATA;
+out:
+	ZSTD_freeDCtx( d );
+}
+#endif
+
+#ifdef HAVE_LZMA
+static void
+zstream_unxz( zstream *z, unsigned char *in, unsigned char *out )
+{
+	lzma_stream s = LZMA_STREAM_INIT;
+	lzma_action action = LZMA_RUN;
+	lzma_ret ret;
+	size_t n;
+
+	if ( lzma_stream_decoder( &s, UINT64_MAX, LZMA_CONCATENATED )!=LZMA_OK ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return;
+	}
+	for ( ;; ) {
+		if ( s.avail_in==0 && action==LZMA_RUN ) {
+			n = zstream_fill( z, in, ZSTREAM_BUFSIZE );
+			if ( n==0 ) action = LZMA_FINISH;
+			s.next_in  = in;
+			s.avail_in = n;
+		}
+		s.next_out  = out;
+		s.avail_out = ZSTREAM_BUFSIZE;
+		ret = lzma_code( &s, action );
+		if ( !zstream_put( z->pipefd, out, ZSTREAM_BUFSIZE - s.avail_out ) )
+			break;
+		if ( ret==LZMA_STREAM_END ) break;
+		if ( ret!=LZMA_OK ) {
+			if ( z->status==ZSTREAM_OK ) z->status = ZSTREAM_ERR_DATA;
+			break;
+		}
+	}
+	lzma_end( &s );
+}
+#endif
+
+static void *
+zstream_readthread( void *arg )
+{
+	zstream *z = ( zstream * ) arg;
+	unsigned char *in, *out;
+	sigset_t set;
+
+	/* a reader that stops early should give EPIPE, not kill us */
+	sigemptyset( &set );
+	sigaddset( &set, SIGPIPE );
+	pthread_sigmask( SIG_BLOCK, &set, NULL );
+
+	in  = malloc( ZSTREAM_BUFSIZE );
+	out = malloc( ZSTREAM_BUFSIZE );
+	if ( !in || !out ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		goto out;
+	}
+
+	switch ( z->type ) {
+#ifdef HAVE_ZLIB
+	case ZSTREAM_GZIP: zstream_gunzip( z, in, out ); break;
+#endif
+#ifdef HAVE_ZSTD
+	case ZSTREAM_ZSTD: zstream_unzstd( z, in, out ); break;
+#endif
+#ifdef HAVE_LZMA
+	case ZSTREAM_XZ:   zstream_unxz( z, in, out );   break;
+#endif
+	default:           zstream_copyin( z, in );      break;
+	}
+
+out:
+	close( z->pipefd );
+	free( in );
+	free( out );
+	return NULL;
+}
+
+/*
+ * encoders: pipe -> compressed z->raw
+ */
+
+#if defined( HAVE_ZLIB ) || defined( HAVE_ZSTD ) || defined( HAVE_LZMA )
+static int
+zstream_emit( zstream *z, const unsigned char *buf, size_t n )
+{
+	if ( fwrite( buf, 1, n, z->raw )!=n ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return 0;
+	}
+	return 1;
+}
+#endif
+
+#ifdef HAVE_ZLIB
+static int
+zstream_gzip( zstream *z, unsigned char *in, unsigned char *out )
+{
+	int flush, ret;
+	z_stream s;
+	size_t n;
+
+	memset( &s, 0, sizeof( s ) );
+	/* 15+16 writes a gzip rather than zlib wrapper */
+	if ( deflateInit2( &s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8,
+			Z_DEFAULT_STRATEGY )!=Z_OK ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return 0;
+	}
+	do {
+		n = zstream_get( z->pipefd, in, ZSTREAM_BUFSIZE );
+		flush = ( n ) ? Z_NO_FLUSH : Z_FINISH;
+		s.next_in  = in;
+		s.avail_in = n;
+		do {
+			s.next_out  = out;
+			s.avail_out = ZSTREAM_BUFSIZE;
+			ret = deflate( &s, flush );
+			if ( ret==Z_STREAM_ERROR ||
+			     !zstream_emit( z, out, ZSTREAM_BUFSIZE - s.avail_out ) ) {
+				deflateEnd( &s );
+				return 0;
+			}
+		} while ( s.avail_out==0 );
+	} while ( flush!=Z_FINISH );
+	deflateEnd( &s );
+	return 1;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int
+zstream_zstd( zstream *z, unsigned char *in, unsigned char *out )
+{
+	ZSTD_EndDirective mode;
+	ZSTD_inBuffer  zin;
+	ZSTD_outBuffer zout;
+	ZSTD_CCtx *c;
+	size_t ret, n;
+
+	c = ZSTD_createCCtx();
+	if ( !c ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return 0;
+	}
+	do {
+		n = zstream_get( z->pipefd, in, ZSTREAM_BUFSIZE );
+		mode = ( n ) ? ZSTD_e_continue : ZSTD_e_end;
+		zin.src  = in;
+		zin.size = n;
+		zin.pos  = 0;
+		do {
+			zout.dst  = out;
+			zout.size = ZSTREAM_BUFSIZE;
+			zout.pos  = 0;
+			ret = ZSTD_compressStream2( c, &zout, &zin, mode );
+			if ( ZSTD_isError( ret ) ) z->status = ZSTREAM_ERR_SYSTEM;
+			if ( ZSTD_isError( ret ) || !zstream_emit( z, out, zout.pos ) ) {
+				ZSTD_freeCCtx( c );
+				return 0;
+			}
+		} while ( ( mode==ZSTD_e_end ) ? ret!=0 : zin.pos < zin.size );
+	} while ( mode!=ZSTD_e_end );
+	ZSTD_freeCCtx( c );
+	return 1;
+}
+#endif
+
+#ifdef HAVE_LZMA
+static int
+zstream_xz( zstream *z, unsigned char *in, unsigned char *out )
+{
+	lzma_stream s = LZMA_STREAM_INIT;
+	lzma_action action = LZMA_RUN;
+	lzma_ret ret;
+	size_t n;
+
+	if ( lzma_easy_encoder( &s, 6, LZMA_CHECK_CRC64 )!=LZMA_OK ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		return 0;
+	}
+	do {
+		if ( s.avail_in==0 && action==LZMA_RUN ) {
+			n = zstream_get( z->pipefd, in, ZSTREAM_BUFSIZE );
+			if ( n==0 ) action = LZMA_FINISH;
+			s.next_in  = in;
+			s.avail_in = n;
+		}
+		s.next_out  = out;
+		s.avail_out = ZSTREAM_BUFSIZE;
+		ret = lzma_code( &s, action );
+		if ( ret!=LZMA_OK && ret!=LZMA_STREAM_END ) z->status = ZSTREAM_ERR_SYSTEM;
+		if ( ( ret!=LZMA_OK && ret!=LZMA_STREAM_END ) ||
+		     !zstream_emit( z, out, ZSTREAM_BUFSIZE - s.avail_out ) ) {
+			lzma_end( &s );
+			return 0;
+		}
+	} while ( ret!=LZMA_STREAM_END );
+	lzma_end( &s );
+	return 1;
+}
+#endif
+
+static void *
+zstream_writethread( void *arg )
+{
+	zstream *z = ( zstream * ) arg;
+	unsigned char *in, *out;
+	int ok = 0;
+
+	in  = malloc( ZSTREAM_BUFSIZE );
+	out = malloc( ZSTREAM_BUFSIZE );
+	if ( !in || !out ) {
+		z->status = ZSTREAM_ERR_SYSTEM;
+		goto out;
+	}
+
+	switch ( z->type ) {
+#ifdef HAVE_ZLIB
+	case ZSTREAM_GZIP: ok = zstream_gzip( z, in, out ); break;
+#endif
+#ifdef HAVE_ZSTD
+	case ZSTREAM_ZSTD: ok = zstream_zstd( z, in, out ); break;
+#endif
+#ifdef HAVE_LZMA
+	case ZSTREAM_XZ:   ok = zstream_xz( z, in, out );   break;
+#endif
+	default:           z->status = ZSTREAM_ERR_UNAVAIL; break;
+	}
+
+	if ( !ok ) zstream_drain( z->pipefd, in );
+out:
+	close( z->pipefd );
+	free( in );
+	free( out );
+	return NULL;
+}
+
+/*
+ * open/close
+ */
+
+static int
+zstream_start( zstream *z, int writing )
+{
+	int fd[2];
+
+	if ( pipe( fd ) ) return ZSTREAM_ERR_SYSTEM;
+
+	z->writing = writing;
+	if ( writing ) {
+		z->fp     = fdopen( fd[1], "w" );
+		z->pipefd = fd[0];
+	} else {
+		z->fp     = fdopen( fd[0], "r" );
+		z->pipefd = fd[1];
+	}
+	if ( !z->fp ) goto err;
+
+	if ( pthread_create( &(z->thread), NULL,
+			writing ? zstream_writethread : zstream_readthread, z ) ) {
+		fclose( z->fp );
+		close( z->pipefd );
+		z->fp = z->raw;
+		return ZSTREAM_ERR_SYSTEM;
+	}
+	z->threaded = 1;
+	return ZSTREAM_OK;
+err:
+	close( fd[0] );
+	close( fd[1] );
+	z->fp = z->raw;
+	return ZSTREAM_ERR_SYSTEM;
+}
+
+static int
+zstream_magic( zstream *z, const unsigned char *magic, int len )
+{
+	return ( z->npeek >= len && !memcmp( z->peek, magic, len ) );
+}
+
+/* zstream_openread()
+ *
+ * Identify the compression of raw from its leading bytes. Plain
+ * input is left untouched (z->fp==raw); otherwise z->fp delivers
+ * the decompressed bytes.
+ */
+int
+zstream_openread( zstream *z, FILE *raw )
+{
+	int c;
+
+	zstream_init( z );
+	z->raw = raw;
+	z->fp  = raw;
+
+	c = getc( raw );
+	if ( c==EOF ) return ZSTREAM_OK;
+	if ( c!=gzip_magic[0] && c!=zstd_magic[0] && c!=xz_magic[0] ) {
+		ungetc( c, raw );
+		return ZSTREAM_OK;
+	}
+
+	z->peek[0] = c;
+	z->npeek = 1 + fread( z->peek + 1, 1, sizeof( xz_magic ) - 1, raw );
+
+	if      ( zstream_magic( z, gzip_magic, sizeof( gzip_magic ) ) ) z->type = ZSTREAM_GZIP;
+	else if ( zstream_magic( z, zstd_magic, sizeof( zstd_magic ) ) ) z->type = ZSTREAM_ZSTD;
+	else if ( zstream_magic( z, xz_magic,   sizeof( xz_magic ) ) )   z->type = ZSTREAM_XZ;
+
+	if ( !zstream_available( z->type ) ) return ZSTREAM_ERR_UNAVAIL;
+
+	/* more than one byte was consumed, so even plain input needs a thread */
+	return zstream_start( z, 0 );
+}
+
+int
+zstream_openwrite( zstream *z, FILE *raw, int type )
+{
+	zstream_init( z );
+	z->raw  = raw;
+	z->fp   = raw;
+	z->type = type;
+	if ( type==ZSTREAM_NONE ) return ZSTREAM_OK;
+	if ( !zstream_available( type ) ) return ZSTREAM_ERR_UNAVAIL;
+	fflush( raw );
+	return zstream_start( z, 1 );
+}
+
+/* zstream_close()
+ *
+ * Finish the stream and wait for its thread; raw is not closed.
+ */
+int
+zstream_close( zstream *z )
+{
+	if ( !z->threaded ) return z->status;
+
+	/* closing our end signals end of data (writing) or lets a */
+	/* decoder blocked on a full pipe finish (reading)          */
+	if ( fclose( z->fp ) && z->writing && z->status==ZSTREAM_OK )
+		z->status = ZSTREAM_ERR_SYSTEM;
+	pthread_join( z->thread, NULL );
+	if ( z->writing && fflush( z->raw ) && z->status==ZSTREAM_OK )
+		z->status = ZSTREAM_ERR_SYSTEM;
+
+	z->threaded = 0;
+	z->fp = z->raw;
+	return z->status;
+}
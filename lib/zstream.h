@@ -0,0 +1,52 @@
+/*
+ * zstream.h
+ *
+ * Copyright (c) Chris Putnam 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#ifndef ZSTREAM_H
+#define ZSTREAM_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* bibutils.h repeats these as BIBL_COMPRESS_* */
+#define ZSTREAM_NONE (0)
+#define ZSTREAM_GZIP (1)
+#define ZSTREAM_ZSTD (2)
+#define ZSTREAM_XZ   (3)
+
+#define ZSTREAM_OK          (0)
+#define ZSTREAM_ERR_UNAVAIL (-1)  /* format not compiled in */
+#define ZSTREAM_ERR_DATA    (-2)  /* corrupt or truncated stream */
+#define ZSTREAM_ERR_SYSTEM  (-3)  /* pipe, thread, memory, or i/o failure */
+
+/* A zstream puts a (de)compressing thread between the caller and
+ * a raw FILE*; the caller reads or writes plain bytes through fp.
+ * For input that isn't compressed, fp is simply the raw FILE*.
+ */
+typedef struct zstream {
+	FILE          *fp;      /* uncompressed side, used by the caller */
+	FILE          *raw;     /* compressed side */
+	int           type;
+	int           writing;
+	int           threaded;
+	int           pipefd;   /* thread's end of the pipe */
+	int           status;
+	pthread_t     thread;
+	unsigned char peek[8];  /* magic bytes consumed during detection */
+	int           npeek;
+} zstream;
+
+void        zstream_init      ( zstream *z );
+int         zstream_openread  ( zstream *z, FILE *raw );
+int         zstream_openwrite ( zstream *z, FILE *raw, int type );
+int         zstream_close     ( zstream *z );
+int         zstream_available ( int type );
+int         zstream_type      ( const char *name );
+const char *zstream_name      ( int type );
+const char *zstream_suffix    ( int type );
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * adsjournals_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "adsout_journals.h"
+
+char progname[] = "adsjournals_test";
+
+typedef struct test_t {
+	char *name;
+	char *abbr;
+} test_t;
+
+int
+test_journalabbr( void )
+{
+	test_t tests[] = {
+		{ "The Astrophysical Journal",                     "ApJ.." },
+		{ "the astrophysical journal",                     "ApJ.." },
+		{ "THE ASTROPHYSICAL JOURNAL LETTERS",             "ApJL." },
+		{ "Monthly Notices of the Royal Astronomical Society", "MNRAS" },
+		{ "Nature",                                        "Natur" },
+		{ "The Astronomical Journal",                      "AJ..." },
+		{ "Europhysics Letters",                           "EL..." },
+		{ "Astrophysical Journal",                         NULL    },
+		{ "",                                              NULL    },
+	};
+	int ntests = sizeof( tests ) / sizeof( tests[0] );
+	int i, found, failed = 0;
+	char abbr[6];
+
+	for ( i=0; i<ntests; ++i ) {
+		found = adsout_journalabbr( tests[i].name, abbr );
+		if ( !tests[i].abbr && found ) {
+			printf( "%s: Error adsout_journalabbr( '%s' ) returned '%s', expected none\n", progname, tests[i].name, abbr );
+			failed++;
+		} else if ( tests[i].abbr && ( !found || strcmp( abbr, tests[i].abbr ) ) ) {
+			printf( "%s: Error adsout_journalabbr( '%s' ) returned '%s', expected '%s'\n", progname, tests[i].name, found ? abbr : "none", tests[i].abbr );
+			failed++;
+		}
+	}
+	return failed;
+}
+
+int
+test_journalname( void )
+{
+	test_t tests[] = {
+		{ "The Astrophysical Journal",                         "ApJ.."  },
+		{ "The Astrophysical Journal",                         "ApJ"    },
+		{ "The Astrophysical Journal",                         "ApJ."   },
+		{ "The Astrophysical Journal Letters",                 "ApJL"   },
+		{ "Monthly Notices of the Royal Astronomical Society", "MNRAS"  },
+		{ "Nature",                                            "Natur"  },
+		{ "The Astronomical Journal",                          "AJ"     },
+		/* listed twice, the first entry wins */
+		{ "EPL (Europhysics Letters)",                         "EL..."  },
+		{ "Bulletin of the Special Astrophysics Observatory",  "BSAO"   },
+		/* abbreviations are case sensitive */
+		{ NULL,                                                "apj.."  },
+		{ NULL,                                                "XXXXX"  },
+		{ NULL,                                                "MNRASX" },
+		{ NULL,                                                "....."  },
+		{ NULL,                                                ""       },
+	};
+	int ntests = sizeof( tests ) / sizeof( tests[0] );
+	int i, failed = 0;
+	const char *name;
+
+	for ( i=0; i<ntests; ++i ) {
+		name = adsout_journalname( tests[i].abbr );
+		if ( !tests[i].name && name ) {
+			printf( "%s: Error adsout_journalname( '%s' ) returned '%s', expected NULL\n", progname, tests[i].abbr, name );
+			failed++;
+		} else if ( tests[i].name && ( !name || strcmp( name, tests[i].name ) ) ) {
+			printf( "%s: Error adsout_journalname( '%s' ) returned '%s', expected '%s'\n", progname, tests[i].abbr, name ? name : "NULL", tests[i].name );
+			failed++;
+		}
+	}
+	return failed;
+}
+
+/* the tables are filled on first use, whichever thread gets there first */
+#define NTHREADS (4)
+
+static void *
+lookup_thread( void *arg )
+{
+	int *failed = ( int * ) arg;
+	const char *name;
+	char abbr[6];
+	int i;
+
+	for ( i=0; i<1000; ++i ) {
+		if ( !adsout_journalabbr( "Nature", abbr ) || strcmp( abbr, "Natur" ) ) ( *failed )++;
+		name = adsout_journalname( "MNRAS" );
+		if ( !name || strcmp( name, "Monthly Notices of the Royal Astronomical Society" ) ) ( *failed )++;
+	}
+	return NULL;
+}
+
+int
+test_threads( void )
+{
+	int i, nfailed[ NTHREADS ], failed = 0;
+	pthread_t threads[ NTHREADS ];
+
+	for ( i=0; i<NTHREADS; ++i ) {
+		nfailed[i] = 0;
+		if ( pthread_create( &threads[i], NULL, lookup_thread, &nfailed[i] ) ) {
+			printf( "%s: Error could not start thread %d\n", progname, i );
+			return 1;
+		}
+	}
+	for ( i=0; i<NTHREADS; ++i ) {
+		pthread_join( threads[i], NULL );
+		if ( nfailed[i] ) {
+			printf( "%s: Error thread %d had %d failed lookups\n", progname, i, nfailed[i] );
+			failed++;
+		}
+	}
+	return failed;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_threads();
+	failed += test_journalabbr();
+	failed += test_journalname();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,509 @@
+/*
+ * bibconvert_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "str.h"
+#include "bibutils.h"
+
+char progname[] = "bibconvert_test";
+char version[] = "0.1";
+
+/*
+ * Converting directly, with the references normalized between
+ * reading and writing as bibconvert does, has to give the same
+ * output as a pipe through MODS XML, e.g. ris2xml | xml2bib, for
+ * every reader and every writer.
+ */
+
+static const char ris[] =
+	"TY  - JOUR\n"
+	"AU  - Smith, John A.\n"
+	"AU  - Doe, Jane\n"
+	"AU  - World Health Organization\n"
+	"TI  - A study of <things> & \"stuff\" in 'space'\n"
+	"T2  - The Astrophysical Journal\n"
+	"PY  - 2001/05/12/\n"
+	"VL  - 12\n"
+	"IS  - 3\n"
+	"SP  - 100\n"
+	"EP  - 110\n"
+	"KW  - galaxies\n"
+	"KW  - stars; dust\n"
+	"AB  - This is an abstract\n"
+	"  that continues on another line.\n"
+	"DO  - 10.1000/xyz123\n"
+	"UR  - http://example.com/a?b=1&c=2\n"
+	"SN  - 0004-637X\n"
+	"LA  - eng\n"
+	"ID  - Smith2001\n"
+	"ER  - \n"
+	"\n"
+	"TY  - BOOK\n"
+	"AU  - M\303\274ller, Hans\n"
+	"ED  - \303\211bert, \303\210ve\n"
+	"TI  - Ein Buch \303\274ber Sachen\n"
+	"PB  - Springer\n"
+	"CY  - Berlin\n"
+	"PY  - 1999\n"
+	"SN  - 978-3-16-148410-0\n"
+	"LA  - German\n"
+	"N1  - A note here\n"
+	"ER  -\n"
+	"TY   - CHAP\n"
+	"AU   - Last, First\n"
+	"TI   - Chapter title\n"
+	"BT  - Book Title\n"
+	"PY  - 2010\n"
+	"SP  - 5\n"
+	"EP  - 9\n"
+	"ER  - \n"
+	"TY  - JOUR\n"
+	"AU  - Smith, John A.\n"
+	"TI  - Same author same year\n"
+	"PY  - 2001\n"
+	"JO  - Monthly Notices of the Royal Astronomical Society\n"
+	"ER  - \n";
+
+static const char bibtex[] =
+	"@STRING{ apj = \"The Astrophysical Journal\" }\n"
+	"@string{foo=\"Foo\"}\n"
+	"% comment\n"
+	"@Article{smith01,\n"
+	"  author = {John A. Smith and Jane Doe and {World Health Organization}},\n"
+	"  title = {A {S}tudy of \\\"{U}ber-things \\& stuff},\n"
+	"  journal = apj,\n"
+	"  year = 2001,\n"
+	"  volume = \"12\",\n"
+	"  number = {3},\n"
+	"  pages = {100--110},\n"
+	"  month = may,\n"
+	"  doi = {10.1000/xyz123},\n"
+	"  url = {http://example.com/a?b=1&c=2},\n"
+	"  keywords = {galaxies; stars},\n"
+	"  note = foo # \" and \" # {bar} # apj,\n"
+	"}\n"
+	"\n"
+	"@book{muller99,\n"
+	"  author = \"M{\\\"u}ller, Hans and von Neumann, John and Smith, Jr., Bob\",\n"
+	"  editor = {Ebert, Eve},\n"
+	"  title = \"Ein Buch {\\\"u}ber Sachen\",\n"
+	"  publisher = {Springer},\n"
+	"  address = {Berlin},\n"
+	"  year = {1999},\n"
+	"  isbn = {978-3-16-148410-0},\n"
+	"  language = {german},\n"
+	"}\n"
+	"@inproceedings{conf10,\n"
+	"  author = {Last, First and Other, Another and others},\n"
+	"  title = {Conference paper},\n"
+	"  booktitle = {Proceedings of Things},\n"
+	"  year = {2010},\n"
+	"  pages = {5-9},\n"
+	"  series = {LNCS},\n"
+	"}\n"
+	"@misc{ misc1, author = {A. B. Cee}, title={Misc}, howpublished={online}, year=2020 }\n"
+	"@phdthesis{th1, author={Stu Dent}, title={Thesis}, school={MIT}, year=2005}\n";
+
+static const char biblatex[] =
+	"@article{smith01,\n"
+	"  author = {Smith, John A. and Doe, Jane},\n"
+	"  title = {A study},\n"
+	"  journaltitle = {The Astrophysical Journal},\n"
+	"  date = {2001-05},\n"
+	"  volume = {12},\n"
+	"  pages = {100--110},\n"
+	"  doi = {10.1000/xyz123},\n"
+	"}\n"
+	"@book{m99, author={M\303\274ller, Hans}, title={Buch}, publisher={Springer}, location={Berlin}, year={1999}}\n";
+
+static const char endnote[] =
+	"%0 Journal Article\n"
+	"%A Smith, John A.\n"
+	"%A Doe, Jane\n"
+	"%T A study of things & stuff\n"
+	"%J The Astrophysical Journal\n"
+	"%D 2001\n"
+	"%V 12\n"
+	"%N 3\n"
+	"%P 100-110\n"
+	"%K galaxies\n"
+	"%R 10.1000/xyz123\n"
+	"%U http://example.com\n"
+	"\n"
+	"%0 Book\n"
+	"%A M\303\274ller, Hans\n"
+	"%T Ein Buch\n"
+	"%I Springer\n"
+	"%C Berlin\n"
+	"%D 1999\n"
+	"%@ 978-3-16-148410-0\n";
+
+static const char copac[] =
+	"TI- A study of things\n"
+	"AU- Smith, John A.\n"
+	"AU- Doe, Jane\n"
+	"PU- London : Publisher, 2001.\n"
+	"PY- 2001\n"
+	"IS- 1234567890\n"
+	"LA- English\n"
+	"NT- A note\n"
+	"\n"
+	"TI- Another book\n"
+	"AU- Muller, Hans\n"
+	"PU- Berlin : Springer, 1999.\n"
+	"PY- 1999\n";
+
+static const char isi[] =
+	"FN ISI Export Format\n"
+	"VR 1.0\n"
+	"PT J\n"
+	"AU Smith, JA\n"
+	"   Doe, J\n"
+	"AF Smith, John A.\n"
+	"   Doe, Jane\n"
+	"TI A study of things and stuff\n"
+	"   in space\n"
+	"SO ASTROPHYSICAL JOURNAL\n"
+	"LA English\n"
+	"DT Article\n"
+	"DE galaxies; stars\n"
+	"AB This is an abstract.\n"
+	"SN 0004-637X\n"
+	"PY 2001\n"
+	"VL 12\n"
+	"IS 3\n"
+	"BP 100\n"
+	"EP 110\n"
+	"DI 10.1000/xyz123\n"
+	"UT ISI:000123\n"
+	"ER\n"
+	"\n"
+	"PT J\n"
+	"AU Muller, H\n"
+	"TI Another\n"
+	"SO NATURE\n"
+	"PY 1999\n"
+	"VL 400\n"
+	"BP 1\n"
+	"EP 2\n"
+	"ER\n"
+	"\n"
+	"EF\n";
+
+static const char medline[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<PubmedArticleSet>\n"
+	"<PubmedArticle>\n"
+	"<MedlineCitation Owner=\"NLM\" Status=\"MEDLINE\">\n"
+	"<PMID>12345678</PMID>\n"
+	"<Article PubModel=\"Print\">\n"
+	"<Journal>\n"
+	"<ISSN IssnType=\"Print\">0004-637X</ISSN>\n"
+	"<JournalIssue CitedMedium=\"Print\"><Volume>12</Volume><Issue>3</Issue><PubDate><Year>2001</Year><Month>May</Month></PubDate></JournalIssue>\n"
+	"<Title>The Astrophysical journal</Title>\n"
+	"<ISOAbbreviation>Astrophys. J.</ISOAbbreviation>\n"
+	"</Journal>\n"
+	"<ArticleTitle>A study of things &amp; stuff.</ArticleTitle>\n"
+	"<Pagination><MedlinePgn>100-10</MedlinePgn></Pagination>\n"
+	"<Abstract><AbstractText>This is an abstract.</AbstractText></Abstract>\n"
+	"<AuthorList CompleteYN=\"Y\">\n"
+	"<Author ValidYN=\"Y\"><LastName>Smith</LastName><ForeName>John A</ForeName><Initials>JA</Initials></Author>\n"
+	"<Author ValidYN=\"Y\"><LastName>Doe</LastName><ForeName>Jane</ForeName><Initials>J</Initials></Author>\n"
+	"</AuthorList>\n"
+	"<Language>eng</Language>\n"
+	"<Language>fre</Language>\n"
+	"<PublicationTypeList><PublicationType>Journal Article</PublicationType></PublicationTypeList>\n"
+	"</Article>\n"
+	"<MedlineJournalInfo><Country>United States</Country><MedlineTA>Astrophys J</MedlineTA></MedlineJournalInfo>\n"
+	"<MeshHeadingList><MeshHeading><DescriptorName MajorTopicYN=\"N\">Galaxies</DescriptorName></MeshHeading></MeshHeadingList>\n"
+	"</MedlineCitation>\n"
+	"<PubmedData><ArticleIdList><ArticleId IdType=\"doi\">10.1000/xyz123</ArticleId><ArticleId IdType=\"pubmed\">12345678</ArticleId></ArticleIdList></PubmedData>\n"
+	"</PubmedArticle>\n"
+	"<PubmedArticle>\n"
+	"<MedlineCitation><PMID>2</PMID><Article><Journal><Title>Nature</Title><JournalIssue><PubDate><Year>1999</Year></PubDate></JournalIssue></Journal><ArticleTitle>Second</ArticleTitle><AuthorList><Author><LastName>Muller</LastName><ForeName>Hans</ForeName></Author></AuthorList><Language>ger</Language></Article></MedlineCitation>\n"
+	"</PubmedArticle>\n"
+	"</PubmedArticleSet>\n";
+
+static const char nbib[] =
+	"PMID- 12345678\n"
+	"OWN - NLM\n"
+	"STAT- MEDLINE\n"
+	"DA  - 20010512\n"
+	"TI  - A study of things and stuff in space with a very long title that\n"
+	"      continues on the next line.\n"
+	"AB  - This is an abstract.\n"
+	"FAU - Smith, John A\n"
+	"AU  - Smith JA\n"
+	"FAU - Doe, Jane\n"
+	"AU  - Doe J\n"
+	"LA  - eng\n"
+	"PT  - Journal Article\n"
+	"DEP - 20010501\n"
+	"TA  - Astrophys J\n"
+	"JT  - The Astrophysical journal\n"
+	"JID - 0001\n"
+	"SB  - IM\n"
+	"MH  - Galaxies\n"
+	"AID - 10.1000/xyz123 [doi]\n"
+	"PST - ppublish\n"
+	"SO  - Astrophys J. 2001 May;12(3):100-10.\n"
+	"DP  - 2001 May\n"
+	"VI  - 12\n"
+	"IP  - 3\n"
+	"PG  - 100-10\n"
+	"\n"
+	"PMID- 22222222\n"
+	"TI  - Second\n"
+	"FAU - Muller, Hans\n"
+	"AU  - Muller H\n"
+	"DP  - 1999\n"
+	"TA  - Nature\n"
+	"PT  - Journal Article\n";
+
+static const char endxml[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<xml><records><record><database name=\"My.enl\">My.enl</database><ref-type name=\"Journal Article\">17</ref-type><contributors><authors><author><style face=\"normal\" font=\"default\" size=\"100%\">Smith, John A.</style></author><author>Doe, Jane</author></authors></contributors><titles><title><style face=\"normal\" font=\"default\" size=\"100%\">A study of things &amp; stuff</style></title><secondary-title>The Astrophysical Journal</secondary-title><short-title>A study</short-title></titles><periodical><full-title>The Astrophysical Journal</full-title></periodical><pages>100-110</pages><volume>12</volume><number>3</number><keywords><keyword>galaxies</keyword><keyword>stars</keyword></keywords><dates><year>2001</year><pub-dates><date>May 12</date></pub-dates></dates><isbn>0004-637X</isbn><electronic-resource-num>10.1000/xyz123</electronic-resource-num><urls><related-urls><url>http://example.com/a</url></related-urls></urls><language>eng</language><notes>A note</notes><abstract>An abstract.</abstract></record><record><ref-type name=\"Book\">6</ref-type><contributors><authors><author>Muller, Hans</author></authors></contributors><titles><title>Ein Buch</title></titles><publisher>Springer</publisher><pub-location>Berlin</pub-location><dates><year>1999</year></dates></record></records></xml>\n";
+
+static const char ebi[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<Publication Type=\"JournalArticle\">\n"
+	"<Article>\n"
+	"<Journal><Title>The Astrophysical Journal</Title><ISSN>0004-637X</ISSN><JournalIssue><Volume>12</Volume><Issue>3</Issue><PubDate><Year>2001</Year><Month>May</Month></PubDate></JournalIssue></Journal>\n"
+	"<ArticleTitle>A study of things &amp; stuff</ArticleTitle>\n"
+	"<Pagination><Pages>100-110</Pages></Pagination>\n"
+	"<Abstract><AbstractText>An abstract.</AbstractText></Abstract>\n"
+	"<AuthorList><Author><LastName>Smith</LastName><FirstName>John</FirstName><Initials>JA</Initials></Author><Author><LastName>Doe</LastName><FirstName>Jane</FirstName></Author></AuthorList>\n"
+	"</Article>\n"
+	"<MeshHeadingList><MeshHeading><DescriptorName>Galaxies</DescriptorName></MeshHeading></MeshHeadingList>\n"
+	"</Publication>\n"
+	"<Publication Type=\"Book\">\n"
+	"<Book><Title>Ein Buch</Title><AuthorList><Author><LastName>Muller</LastName><FirstName>Hans</FirstName></Author></AuthorList><Publisher>Springer</Publisher><Year>1999</Year><ISBN10>3161484100</ISBN10><Language>ger</Language></Book>\n"
+	"</Publication>\n";
+
+static const char word[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<b:Sources SelectedStyle=\"\" xmlns:b=\"http://schemas.openxmlformats.org/officeDocument/2006/bibliography\"  xmlns=\"http://schemas.openxmlformats.org/officeDocument/2006/bibliography\" >\n"
+	"<b:Source>\n"
+	"<b:Tag>Smith2001a</b:Tag>\n"
+	"<b:SourceType>ArticleInAPeriodical</b:SourceType>\n"
+	"<b:Year>2001</b:Year>\n"
+	"<b:Month>05</b:Month>\n"
+	"<b:Day>12</b:Day>\n"
+	"<b:PeriodicalTitle>The Astrophysical Journal</b:PeriodicalTitle>\n"
+	"<b:Volume>12</b:Volume>\n"
+	"<b:Issue>3</b:Issue>\n"
+	"<b:Url>http://example.com/a?b=1&amp;c=2</b:Url>\n"
+	"<b:Url>https://doi.org/10.1000/xyz123</b:Url>\n"
+	"<b:Pages>100-110</b:Pages>\n"
+	"<b:Author>\n"
+	"<b:Author><b:NameList>\n"
+	"<b:Person><b:Last>Smith</b:Last><b:First>John</b:First><b:Middle>A</b:Middle></b:Person>\n"
+	"<b:Person><b:Last>Doe</b:Last><b:First>Jane</b:First></b:Person>\n"
+	"<b:Person><b:Last>Organization</b:Last><b:First>World</b:First><b:Middle>Health</b:Middle></b:Person>\n"
+	"</b:NameList></b:Author>\n"
+	"</b:Author>\n"
+	"<b:Title>A study of &lt;things&gt; &amp; &quot;stuff&quot; in &apos;space&apos;</b:Title>\n"
+	"<b:Comments>This is an abstract that continues on another line.</b:Comments>\n"
+	"</b:Source>\n"
+	"<b:Source>\n"
+	"<b:Tag>M\303\274ller1999</b:Tag>\n"
+	"<b:SourceType>Book</b:SourceType>\n"
+	"<b:City>Berlin</b:City>\n"
+	"<b:Publisher>Springer</b:Publisher>\n"
+	"<b:Year>1999</b:Year>\n"
+	"<b:Author>\n"
+	"<b:Author><b:NameList>\n"
+	"<b:Person><b:Last>M\303\274ller</b:Last><b:First>Hans</b:First></b:Person>\n"
+	"</b:NameList></b:Author>\n"
+	"<b:Editor><b:NameList>\n"
+	"<b:Person><b:Last>\303\211bert</b:Last><b:First>\303\210ve</b:First></b:Person>\n"
+	"</b:NameList></b:Editor>\n"
+	"</b:Author>\n"
+	"<b:Title>Ein Buch \303\274ber Sachen</b:Title>\n"
+	"<b:Comments>A note here</b:Comments>\n"
+	"</b:Source>\n"
+	"</b:Sources>\n";
+
+typedef struct sample {
+	char       *name;
+	int        readformat;
+	const char *data;
+} sample;
+
+static const sample samples[] = {
+	{ "ris",      BIBL_RISIN,        ris      },
+	{ "bibtex",   BIBL_BIBTEXIN,     bibtex   },
+	{ "biblatex", BIBL_BIBLATEXIN,   biblatex },
+	{ "endnote",  BIBL_ENDNOTEIN,    endnote  },
+	{ "copac",    BIBL_COPACIN,      copac    },
+	{ "isi",      BIBL_ISIIN,        isi      },
+	{ "medline",  BIBL_MEDLINEIN,    medline  },
+	{ "nbib",     BIBL_NBIBIN,       nbib     },
+	{ "endxml",   BIBL_ENDNOTEXMLIN, endxml   },
+	{ "ebi",      BIBL_EBIIN,        ebi      },
+	{ "word",     BIBL_WORDIN,       word     },
+};
+#define NSAMPLES ( sizeof( samples ) / sizeof( samples[0] ) )
+
+static const int writers[] = {
+	BIBL_BIBTEXOUT,
+	BIBL_RISOUT,
+	BIBL_ENDNOTEOUT,
+	BIBL_ISIOUT,
+	BIBL_WORD2007OUT,
+	BIBL_ADSABSOUT,
+	BIBL_NBIBOUT,
+};
+#define NWRITERS ( sizeof( writers ) / sizeof( writers[0] ) )
+
+static int
+read_str( bibl *b, str *in, param *p )
+{
+	int status;
+	FILE *fp;
+
+	fp = tmpfile();
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+	fwrite( str_cstr( in ), 1, in->len, fp );
+	rewind( fp );
+	status = bibl_read( b, fp, progname, p );
+	fclose( fp );
+
+	return status;
+}
+
+static int
+write_str( bibl *b, str *out, param *p )
+{
+	char buf[512];
+	int status;
+	size_t n;
+	FILE *fp;
+
+	str_empty( out );
+
+	fp = tmpfile();
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+	status = bibl_write( b, fp, p );
+	rewind( fp );
+	while ( ( n = fread( buf, 1, sizeof( buf ), fp ) ) > 0 )
+		str_indxcat( out, buf, 0, n );
+	fclose( fp );
+
+	if ( str_memerr( out ) ) return BIBL_ERR_MEMERR;
+	return status;
+}
+
+/* the reader's references, written directly */
+static int
+convert_direct( const sample *s, int writeformat, str *out )
+{
+	int status;
+	param p;
+	bibl b;
+	str in;
+
+	str_init( &in );
+	str_strcpyc( &in, s->data );
+	bibl_init( &b );
+	bibl_initparams( &p, s->readformat, writeformat, progname );
+
+	status = read_str( &b, &in, &p );
+	if ( status==BIBL_OK ) status = bibl_normalize( &b, &p );
+	if ( status==BIBL_OK ) status = write_str( &b, out, &p );
+
+	bibl_freeparams( &p );
+	bibl_free( &b );
+	str_free( &in );
+
+	return status;
+}
+
+/* the reader's references, written out as MODS and read back in */
+static int
+convert_pipe( const sample *s, int writeformat, str *out )
+{
+	int status;
+	str in, xml;
+	param p;
+	bibl b;
+
+	strs_init( &in, &xml, NULL );
+	str_strcpyc( &in, s->data );
+
+	bibl_init( &b );
+	bibl_initparams( &p, s->readformat, BIBL_MODSOUT, progname );
+	status = read_str( &b, &in, &p );
+	if ( status==BIBL_OK ) status = write_str( &b, &xml, &p );
+	bibl_freeparams( &p );
+	bibl_free( &b );
+
+	if ( status==BIBL_OK ) {
+		bibl_init( &b );
+		bibl_initparams( &p, BIBL_MODSIN, writeformat, progname );
+		status = read_str( &b, &xml, &p );
+		if ( status==BIBL_OK ) status = write_str( &b, out, &p );
+		bibl_freeparams( &p );
+		bibl_free( &b );
+	}
+
+	strs_free( &in, &xml, NULL );
+
+	return status;
+}
+
+int
+test_convert( const sample *s, int writeformat )
+{
+	int sdirect, spipe, failed = 0;
+	str direct, pipe;
+
+	strs_init( &direct, &pipe, NULL );
+
+	sdirect = convert_direct( s, writeformat, &direct );
+	spipe   = convert_pipe( s, writeformat, &pipe );
+
+	if ( sdirect!=BIBL_OK || spipe!=BIBL_OK ) {
+		fprintf( stdout, "%s: %s to %d failed, direct %d, through MODS %d\n",
+			progname, s->name, writeformat, sdirect, spipe );
+		failed = 1;
+	} else if ( direct.len==0 ) {
+		fprintf( stdout, "%s: %s to %d wrote nothing\n", progname, s->name, writeformat );
+		failed = 1;
+	} else if ( strcmp( str_cstr( &direct ), str_cstr( &pipe ) ) ) {
+		fprintf( stdout, "%s: %s to %d differs\n--- direct\n%s\n--- through MODS\n%s\n",
+			progname, s->name, writeformat, str_cstr( &direct ), str_cstr( &pipe ) );
+		failed = 1;
+	}
+
+	strs_free( &direct, &pipe, NULL );
+
+	return failed;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int i, j, failed = 0;
+
+	/* the writers report tags they don't use on stderr */
+	if ( !freopen( "/dev/null", "w", stderr ) ) return EXIT_FAILURE;
+
+	for ( i=0; i<NSAMPLES; ++i )
+		for ( j=0; j<NWRITERS; ++j )
+			failed += test_convert( &(samples[i]), writers[j] );
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,166 @@
+/*
+ * bibindex_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bibutils.h"
+
+char progname[] = "bibindex_test";
+char version[] = "0.1";
+
+#define check( a, b ) { \
+	if ( !(a) ) { \
+		fprintf( stderr, "Failed %s (%s) in %s() line %d\n", #a, b, __FUNCTION__, __LINE__ );\
+		return 1; \
+	} \
+}
+
+static const char bibtex[] =
+	"@Article{s17,\n"
+	"  author=\"Smith, A.\",\n"
+	"  title=\"First\",\n"
+	"  year=2001\n"
+	"}\n"
+	"\n"
+	"@Article{j250,\n"
+	"  author=\"Jones, B.\",\n"
+	"  title=\"Second\",\n"
+	"  year=2002\n"
+	"}\n"
+	"\n"
+	"@Article{s17,\n"
+	"  author=\"Smith, C.\",\n"
+	"  title=\"Third\",\n"
+	"  year=2003\n"
+	"}\n"
+	"\n"
+	"@Article{k9,\n"
+	"  author=\"Kim, D.\",\n"
+	"  title=\"Fourth\",\n"
+	"  year=2004\n"
+	"}\n";
+
+static int
+has_title( bibl *b, long n, const char *title )
+{
+	char *t;
+	int m;
+
+	m = fields_find( b->ref[n], "TITLE", LEVEL_MAIN );
+	if ( m==FIELDS_NOTFOUND ) return 0;
+	t = fields_value( b->ref[n], m, FIELDS_CHRP_NOUSE );
+	return ( !strcmp( t, title ) );
+}
+
+/* read the references with the given keys through an index of the file */
+static int
+read_keys( bibl *b, slist *keys )
+{
+	FILE *fp, *idxfp;
+	int status;
+	param p;
+
+	fp = tmpfile();
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+	idxfp = tmpfile();
+	if ( !idxfp ) {
+		fclose( fp );
+		return BIBL_ERR_CANTOPEN;
+	}
+
+	fputs( bibtex, fp );
+	fflush( fp );
+	rewind( fp );
+
+	bibl_initparams( &p, BIBL_BIBTEXIN, BIBL_MODSOUT, progname );
+
+	status = bibl_writeindex( fp, "bibindex_test.bib", idxfp, &p );
+	if ( status==BIBL_OK ) {
+		rewind( fp );
+		rewind( idxfp );
+		status = bibl_readindexed( b, fp, "bibindex_test.bib", idxfp, keys, &p );
+	}
+
+	bibl_freeparams( &p );
+	fclose( idxfp );
+	fclose( fp );
+
+	return status;
+}
+
+/* every reference under a key shared by several is found by it */
+int
+test_duplicated_key( void )
+{
+	int status;
+	slist keys;
+	bibl b;
+
+	slist_init( &keys );
+	bibl_init( &b );
+
+	slist_addc( &keys, "s17" );
+	status = read_keys( &b, &keys );
+	check( (status==BIBL_OK), "bibl_readindexed() should return BIBL_OK" );
+	check( (b.nrefs==2), "both references keyed s17 should be read" );
+	check( has_title( &b, 0, "First" ), "the first s17 should come first" );
+	check( has_title( &b, 1, "Third" ), "the second s17 should come second" );
+	bibl_free( &b );
+
+	bibl_init( &b );
+	slist_addc( &keys, "J250" );
+	status = read_keys( &b, &keys );
+	check( (status==BIBL_OK), "bibl_readindexed() should return BIBL_OK" );
+	check( (b.nrefs==3), "both s17s and j250 should be read" );
+	check( has_title( &b, 0, "First" ), "references should be in input order" );
+	check( has_title( &b, 1, "Second" ), "references should be in input order" );
+	check( has_title( &b, 2, "Third" ), "references should be in input order" );
+	bibl_free( &b );
+
+	slist_free( &keys );
+
+	return 0;
+}
+
+int
+test_missing_key( void )
+{
+	int status;
+	slist keys;
+	bibl b;
+
+	slist_init( &keys );
+	bibl_init( &b );
+
+	slist_addc( &keys, "nosuchkey" );
+	status = read_keys( &b, &keys );
+	check( (status==BIBL_OK), "bibl_readindexed() should return BIBL_OK" );
+	check( (b.nrefs==0), "no references should be read" );
+
+	bibl_free( &b );
+	slist_free( &keys );
+
+	return 0;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_duplicated_key();
+	failed += test_missing_key();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
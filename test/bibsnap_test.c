@@ -0,0 +1,213 @@
+/*
+ * bibsnap_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bibsnap.h"
+
+char progname[] = "bibsnap_test";
+char version[] = "0.1";
+
+#define check( a, b ) { \
+	if ( !(a) ) { \
+		fprintf( stderr, "Failed %s (%s) in %s() line %d\n", #a, b, __FUNCTION__, __LINE__ );\
+		return 1; \
+	} \
+}
+
+#define NREFS (300)
+
+/* references with a few shared tags, an empty value, and several levels */
+static int
+build_bibl( bibl *b )
+{
+	char value[64];
+	fields *f;
+	int i;
+
+	bibl_init( b );
+	for ( i=0; i<NREFS; ++i ) {
+		f = fields_new();
+		if ( !f ) return 0;
+		sprintf( value, "Author%d, A.", i );
+		fields_add_can_dup( f, "AUTHOR", value, LEVEL_MAIN );
+		fields_add_can_dup( f, "AUTHOR", "Second, B.", LEVEL_MAIN );
+		sprintf( value, "Title of reference %d", i );
+		fields_add( f, "TITLE", value, LEVEL_MAIN );
+		fields_add( f, "TITLE", "Journal", LEVEL_HOST );
+		fields_add( f, "NOTES", "", LEVEL_MAIN );
+		if ( i%3==0 ) fields_add( f, "TITLE", "Original title", LEVEL_ORIG );
+		sprintf( value, "TAG%d", i%150 );
+		fields_add( f, value, "rare tag", LEVEL_SERIES );
+		if ( !bibl_addref( b, f ) ) return 0;
+	}
+	return 1;
+}
+
+static int
+same_fields( fields *a, fields *b )
+{
+	int i;
+	if ( a->n != b->n ) return 0;
+	for ( i=0; i<a->n; ++i ) {
+		if ( a->level[i] != b->level[i] ) return 0;
+		if ( strcmp( str_cstr( &(a->tag[i]) ), str_cstr( &(b->tag[i]) ) ) ) return 0;
+		if ( strcmp( str_cstr( &(a->data[i]) ) ? str_cstr( &(a->data[i]) ) : "",
+		             str_cstr( &(b->data[i]) ) ? str_cstr( &(b->data[i]) ) : "" ) ) return 0;
+	}
+	return 1;
+}
+
+static int
+check_snapshot( bibsnap *s, bibl *b )
+{
+	fields f;
+	long i;
+
+	if ( s->nrefs != b->nrefs ) return 0;
+	if ( s->readformat != 101 ) return 0;
+
+	/* in any order, as the index allows */
+	for ( i=s->nrefs-1; i>=0; --i ) {
+		fields_init( &f );
+		if ( bibsnap_getref( s, i, &f )!=BIBSNAP_OK ) return 0;
+		if ( !same_fields( &f, b->ref[i] ) ) return 0;
+		fields_free( &f );
+	}
+	return 1;
+}
+
+/*
+ * int bibsnap_write( FILE *fp, bibl *b, int readformat );
+ * int bibsnap_open( bibsnap *s, FILE *fp );
+ */
+int
+test_file( void )
+{
+	int status;
+	bibsnap s;
+	FILE *fp;
+	bibl b;
+
+	check( build_bibl( &b ), "build_bibl() should succeed" );
+
+	fp = tmpfile();
+	check( (fp!=NULL), "tmpfile() should succeed" );
+
+	status = bibsnap_write( fp, &b, 101 );
+	check( (status==BIBSNAP_OK), "bibsnap_write() should return BIBSNAP_OK" );
+	rewind( fp );
+
+	status = bibsnap_open( &s, fp );
+	check( (status==BIBSNAP_OK), "bibsnap_open() should return BIBSNAP_OK" );
+	check( (s.mapped==1), "a snapshot in a file should be mapped" );
+	check( (s.ntags==153), "tags should be stored once" );
+	check( check_snapshot( &s, &b ), "references should read back unchanged" );
+	check( (bibsnap_getref( &s, NREFS, NULL )==BIBSNAP_ERR_DATA), "past the end should return BIBSNAP_ERR_DATA" );
+	bibsnap_close( &s );
+
+	fclose( fp );
+	bibl_free( &b );
+
+	return 0;
+}
+
+/* a snapshot read from a pipe can't be mapped */
+int
+test_pipe( void )
+{
+	int status, fd[2];
+	FILE *in, *out;
+	bibsnap s;
+	bibl b;
+	pid_t pid;
+
+	check( build_bibl( &b ), "build_bibl() should succeed" );
+	check( (pipe( fd )==0), "pipe() should succeed" );
+
+	pid = fork();
+	check( (pid!=-1), "fork() should succeed" );
+	if ( pid==0 ) {
+		close( fd[0] );
+		out = fdopen( fd[1], "w" );
+		status = bibsnap_write( out, &b, 101 );
+		fclose( out );
+		_exit( status==BIBSNAP_OK ? 0 : 1 );
+	}
+	close( fd[1] );
+	in = fdopen( fd[0], "r" );
+
+	status = bibsnap_open( &s, in );
+	check( (status==BIBSNAP_OK), "bibsnap_open() should return BIBSNAP_OK" );
+	check( (s.mapped==0), "a snapshot in a pipe should be read" );
+	check( check_snapshot( &s, &b ), "references should read back unchanged" );
+	bibsnap_close( &s );
+
+	fclose( in );
+	bibl_free( &b );
+
+	return 0;
+}
+
+/* damaged snapshots are refused rather than read */
+int
+test_damaged( void )
+{
+	long len;
+	int status;
+	bibsnap s;
+	FILE *fp;
+	bibl b;
+
+	check( build_bibl( &b ), "build_bibl() should succeed" );
+
+	fp = tmpfile();
+	check( (fp!=NULL), "tmpfile() should succeed" );
+	bibsnap_write( fp, &b, 101 );
+	fflush( fp );
+	len = ftell( fp );
+
+	/* truncated */
+	check( (ftruncate( fileno( fp ), len - 1 )==0), "ftruncate() should succeed" );
+	rewind( fp );
+	status = bibsnap_open( &s, fp );
+	check( (status==BIBSNAP_ERR_DATA), "a truncated snapshot should return BIBSNAP_ERR_DATA" );
+	fclose( fp );
+
+	/* not a snapshot */
+	fp = tmpfile();
+	check( (fp!=NULL), "tmpfile() should succeed" );
+	fprintf( fp, "@Article{key,\n  title=\"Not a snapshot at all, just some text\"\n}\n" );
+	rewind( fp );
+	status = bibsnap_open( &s, fp );
+	check( (status==BIBSNAP_ERR_DATA), "text should return BIBSNAP_ERR_DATA" );
+	fclose( fp );
+
+	bibl_free( &b );
+
+	return 0;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_file();
+	failed += test_pipe();
+	failed += test_damaged();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
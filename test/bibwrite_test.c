@@ -0,0 +1,128 @@
+/*
+ * bibwrite_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bibutils.h"
+#include "zstream.h"
+
+char progname[] = "bibwrite_test";
+char version[] = "0.1";
+
+#define check( a, b ) { \
+	if ( !(a) ) { \
+		fprintf( stderr, "Failed %s (%s) in %s() line %d\n", #a, b, __FUNCTION__, __LINE__ );\
+		return 1; \
+	} \
+}
+
+static const char ris[] =
+	"TY  - JOUR\n"
+	"AU  - Smith, A.\n"
+	"TI  - A title long enough to fill the output buffer in a few thousand references\n"
+	"JO  - Journal\n"
+	"PY  - 2001\n"
+	"ER  - \n";
+
+/* read nrefs copies of the RIS reference */
+static int
+read_refs( bibl *b, int nrefs )
+{
+	int i, status;
+	param p;
+	FILE *fp;
+
+	fp = tmpfile();
+	if ( !fp ) return BIBL_ERR_CANTOPEN;
+	for ( i=0; i<nrefs; ++i )
+		fputs( ris, fp );
+	rewind( fp );
+
+	bibl_initparams( &p, BIBL_RISIN, BIBL_RISOUT, progname );
+	status = bibl_read( b, fp, "bibwrite_test.ris", &p );
+	bibl_freeparams( &p );
+	fclose( fp );
+
+	return status;
+}
+
+static int
+write_refs( bibl *b, FILE *fp, int compress, int async )
+{
+	int status;
+	param p;
+
+	bibl_initparams( &p, BIBL_RISIN, BIBL_RISOUT, progname );
+	p.compressout = compress;
+	p.asyncout    = async;
+	status = bibl_write( b, fp, &p );
+	bibl_freeparams( &p );
+
+	return status;
+}
+
+/* output that doesn't fit on the device is an error, whether it */
+/* fails when the buffer fills or only at the final flush        */
+static int
+test_write_full( int compress, int async )
+{
+	int nrefs[] = { 1, 5000 };
+	int i, status;
+	FILE *fp;
+	bibl b;
+
+	if ( !zstream_available( compress ) ) return 0;
+
+	for ( i=0; i<2; ++i ) {
+
+		bibl_init( &b );
+		status = read_refs( &b, nrefs[i] );
+		check( (status==BIBL_OK), "bibl_read() should return BIBL_OK" );
+		check( (b.nrefs==nrefs[i]), "all references should be read" );
+
+		fp = tmpfile();
+		check( (fp!=NULL), "tmpfile() should open" );
+		status = write_refs( &b, fp, compress, async );
+		fclose( fp );
+		check( (status==BIBL_OK), "bibl_write() to a file should return BIBL_OK" );
+
+		fp = fopen( "/dev/full", "w" );
+		if ( !fp ) {
+			bibl_free( &b );
+			return 0;
+		}
+		status = write_refs( &b, fp, compress, async );
+		fclose( fp );
+		check( (status==BIBL_ERR_WRITE), "bibl_write() to a full device should return BIBL_ERR_WRITE" );
+
+		bibl_free( &b );
+	}
+
+	return 0;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_write_full( BIBL_COMPRESS_NONE, 0 );
+	failed += test_write_full( BIBL_COMPRESS_GZIP, 0 );
+	failed += test_write_full( BIBL_COMPRESS_ZSTD, 0 );
+	failed += test_write_full( BIBL_COMPRESS_XZ,   0 );
+	failed += test_write_full( BIBL_COMPRESS_NONE, 1 );
+	failed += test_write_full( BIBL_COMPRESS_GZIP, 1 );
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
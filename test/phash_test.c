@@ -0,0 +1,203 @@
+/*
+ * phash_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "phash.h"
+
+char progname[] = "phash_test";
+char version[] = "0.1";
+
+#define check( a, b ) { \
+	if ( !(a) ) { \
+		fprintf( stderr, "Failed %s (%s) in %s() line %d\n", #a, b, __FUNCTION__, __LINE__ );\
+		return 1; \
+	} \
+}
+
+static const char *genres[] = {
+	"abstract or summary",
+	"art original",
+	"Atlas",
+	"book",
+	"ATLAS",   /* a second copy, in another case */
+	"web site",
+	"",
+};
+static const int ngenres = sizeof( genres ) / sizeof( genres[0] );
+
+typedef struct {
+	char *code;
+	char *name;
+} role;
+
+static const role roles[] = {
+	{ "aut", "AUTHOR" },
+	{ "edt", "EDITOR" },
+	{ "trl", "TRANSLATOR" },
+};
+
+/*
+ * int phash_build( phash *h, const void *base, size_t stride, int n );
+ * int phash_find( phash *h, const char *query );
+ */
+int
+test_strings( void )
+{
+	int status;
+	phash h;
+
+	status = phash_build( &h, genres, sizeof( genres[0] ), ngenres );
+	check( (status==PHASH_OK), "phash_build() should return PHASH_OK" );
+
+	check( (phash_find( &h, "abstract or summary" )==0), "keys should be found" );
+	check( (phash_find( &h, "Art Original" )==1), "case should be ignored" );
+	check( (phash_find( &h, "atlas" )==2), "a repeated key should give its first entry" );
+	check( (phash_find( &h, "WEB SITE" )==5), "keys should be found" );
+	check( (phash_find( &h, "" )==6), "an empty key should be found" );
+	check( (phash_find( &h, "web" )==-1), "a prefix should not be found" );
+	check( (phash_find( &h, "book " )==-1), "a longer string should not be found" );
+
+	phash_free( &h );
+	return 0;
+}
+
+/*
+ * int phash_findn( phash *h, const char *query, unsigned long len );
+ */
+int
+test_findn( void )
+{
+	int status;
+	phash h;
+
+	status = phash_build( &h, genres, sizeof( genres[0] ), ngenres );
+	check( (status==PHASH_OK), "phash_build() should return PHASH_OK" );
+
+	check( (phash_findn( &h, "bookshelf", 4 )==3), "the first len characters should be found" );
+	check( (phash_findn( &h, "Atlases", 5 )==2), "case should be ignored" );
+	check( (phash_findn( &h, "bookshelf", 3 )==-1), "a prefix of a key should not be found" );
+	check( (phash_findn( &h, "bookshelf", 0 )==6), "no characters should find the empty key" );
+	check( (phash_findn( &h, "book", 10 )==3), "a query shorter than len should end at its '\\0'" );
+	check( (phash_findn( &h, "web site", PHASH_WHOLE )==5), "PHASH_WHOLE should use the whole query" );
+
+	phash_free( &h );
+	return 0;
+}
+
+/*
+ * unsigned long phash_hash( const char *s, unsigned long len, unsigned long seed );
+ * unsigned long phash_probe( const void *table, unsigned long mask, unsigned long hash,
+ *                            int (*stop)( const void *table, unsigned long slot, const void *key ),
+ *                            const void *key );
+ */
+static int
+stop_at( const void *table, unsigned long i, const void *key )
+{
+	const char * const *slot = ( const char * const * ) table;
+	return ( !slot[i] || !strcmp( slot[i], ( const char * ) key ) );
+}
+
+int
+test_probe( void )
+{
+	const char *slot[8] = { NULL }, *words[] = { "one", "two", "three", "four", "five" };
+	unsigned long i, j;
+	int n;
+
+	check( (phash_hash( "Book", PHASH_WHOLE, 0 )==phash_hash( "bOOK", PHASH_WHOLE, 0 )), "case should be folded" );
+	check( (phash_hash( "bookshelf", 4, 0 )==phash_hash( "book", PHASH_WHOLE, 0 )), "only len characters should be hashed" );
+	check( (phash_hash( "book", PHASH_WHOLE, 1 )!=phash_hash( "book", PHASH_WHOLE, 0 )), "the seed should change the hash" );
+
+	/* every word goes in the same bucket so all but one are displaced */
+	for ( n=0; n<5; ++n ) {
+		i = phash_probe( slot, 7, 3, stop_at, words[n] );
+		check( (slot[i]==NULL), "a new key should stop at an empty slot" );
+		slot[i] = words[n];
+	}
+	for ( n=0; n<5; ++n ) {
+		i = phash_probe( slot, 7, 3, stop_at, words[n] );
+		check( (i==( 3 + n ) % 8), "a key should be found where it was put" );
+	}
+	j = phash_probe( slot, 7, 3, stop_at, "six" );
+	check( (j==0 && slot[j]==NULL), "a missing key should wrap round to an empty slot" );
+
+	return 0;
+}
+
+int
+test_structures( void )
+{
+	int status;
+	phash h;
+
+	status = phash_build( &h, roles, sizeof( roles[0] ), 3 );
+	check( (status==PHASH_OK), "phash_build() should return PHASH_OK" );
+	check( (phash_find( &h, "EDT" )==1), "keys should be found" );
+	check( (phash_find( &h, "EDITOR" )==-1), "only the first member is a key" );
+	phash_free( &h );
+
+	status = phash_build( &h, roles, sizeof( roles[0] ), 0 );
+	check( (status==PHASH_OK), "phash_build() of nothing should return PHASH_OK" );
+	check( (phash_find( &h, "aut" )==-1), "an empty table has no keys" );
+	phash_free( &h );
+
+	return 0;
+}
+
+/* every one of many generated keys, and nothing else, is found */
+int
+test_many( void )
+{
+	char buf[32], **keys;
+	int i, n = 10000, status;
+	phash h;
+
+	keys = ( char ** ) malloc( sizeof( char * ) * n );
+	check( (keys!=NULL), "malloc() should succeed" );
+	for ( i=0; i<n; ++i ) {
+		sprintf( buf, "Key%d", i * 7919 );
+		keys[i] = strdup( buf );
+		check( (keys[i]!=NULL), "strdup() should succeed" );
+	}
+
+	status = phash_build( &h, keys, sizeof( keys[0] ), n );
+	check( (status==PHASH_OK), "phash_build() should return PHASH_OK" );
+	for ( i=0; i<n; ++i ) {
+		check( (phash_find( &h, keys[i] )==i), "each key should be found" );
+		sprintf( buf, "key%d", i * 7919 + 1 );
+		check( (phash_find( &h, buf )==-1), "other strings should not be found" );
+	}
+	phash_free( &h );
+
+	for ( i=0; i<n; ++i ) free( keys[i] );
+	free( keys );
+
+	return 0;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_strings();
+	failed += test_findn();
+	failed += test_probe();
+	failed += test_structures();
+	failed += test_many();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,215 @@
+/*
+ * pslist_test.c
+ *
+ * test pslist functions
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pslist.h"
+
+char progname[] = "pslist_test";
+char version[] = "0.1";
+
+#define check( a, b ) { \
+	if ( !(a) ) { \
+		fprintf( stderr, "Failed %s (%s) in %s() line %d\n", #a, b, __FUNCTION__, __LINE__ );\
+		return 1; \
+	} \
+}
+
+#define check_entry( a, b, c ) if ( !_check_entry( a, b, c, __FUNCTION__, __LINE__ ) ) return 1;
+int
+_check_entry( pslist *a, int n, const char *expected, const char *fn, int line )
+{
+	char *s;
+	s = pslist_cstr( a, n );
+	if ( s==NULL && expected==NULL ) return 1;
+	if ( s!=NULL && expected!=NULL && !strcmp( s, expected ) &&
+	     pslist_strlen( a, n )==strlen( expected ) ) return 1;
+	fprintf( stderr, "Failed: %s() line %d: Expected pslist element %d to be '%s', found '%s'\n",
+		fn, line, n, expected ? expected : "NULL", s ? s : "NULL" );
+	return 0;
+}
+
+int
+test_init( void )
+{
+	pslist a;
+
+	pslist_init( &a );
+
+	check( (a.n==0), "list a should be empty" );
+	check_entry( &a, -1, NULL );
+	check_entry( &a,  0, NULL );
+
+	pslist_free( &a );
+
+	return 0;
+}
+
+/*
+ * int     pslist_addseg( pslist *a, const char *start, const char *end );
+ * int     pslist_addc( pslist *a, const char *value );
+ * int     pslist_add( pslist *a, str *value );
+ */
+int
+test_add( void )
+{
+	char buf[16], *seg = "three four";
+	int i, status;
+	pslist a;
+	str s;
+
+	str_init( &s );
+	pslist_init( &a );
+
+	status = pslist_addc( &a, "1" );
+	check( (status==PSLIST_OK), "pslist_addc() should return PSLIST_OK" );
+	str_strcpyc( &s, "two" );
+	status = pslist_add( &a, &s );
+	check( (status==PSLIST_OK), "pslist_add() should return PSLIST_OK" );
+	str_empty( &s );
+	status = pslist_add( &a, &s );
+	check( (status==PSLIST_OK), "pslist_add() should return PSLIST_OK" );
+	status = pslist_addseg( &a, seg, seg+5 );
+	check( (status==PSLIST_OK), "pslist_addseg() should return PSLIST_OK" );
+
+	check( (a.n==4), "list a should have four elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 1, "two" );
+	check_entry( &a, 2, "" );
+	check_entry( &a, 3, "three" );
+	check_entry( &a, 4, NULL );
+
+	/* enough to move the pool, adding from the list itself */
+	for ( i=0; i<200; ++i ) {
+		status = pslist_addc( &a, pslist_cstr( &a, 3 ) );
+		check( (status==PSLIST_OK), "pslist_addc() should return PSLIST_OK" );
+		sprintf( buf, "%d", i );
+		status = pslist_addc( &a, buf );
+		check( (status==PSLIST_OK), "pslist_addc() should return PSLIST_OK" );
+	}
+	check( (a.n==404), "list a should have 404 elements" );
+	for ( i=0; i<200; ++i ) {
+		check_entry( &a, 4+2*i, "three" );
+		sprintf( buf, "%d", i );
+		check_entry( &a, 5+2*i, buf );
+	}
+
+	pslist_empty( &a );
+	check( (a.n==0), "list a should be empty" );
+	status = pslist_addc( &a, "again" );
+	check( (status==PSLIST_OK), "pslist_addc() should return PSLIST_OK" );
+	check_entry( &a, 0, "again" );
+
+	pslist_free( &a );
+	str_free( &s );
+	return 0;
+}
+
+/*
+ * int     pslist_remove( pslist *a, pslist_index n );
+ */
+int
+test_remove( void )
+{
+	int status;
+	pslist a;
+
+	pslist_init( &a );
+
+	status = pslist_tokenizec( &a, "1 2 3 4", " ", 1 );
+	check( (status==PSLIST_OK), "pslist_tokenizec() should return PSLIST_OK" );
+
+	status = pslist_remove( &a, 4 );
+	check( (status==PSLIST_ERR_BADPARAM), "pslist_remove() past the end should return PSLIST_ERR_BADPARAM" );
+
+	status = pslist_remove( &a, 1 );
+	check( (status==PSLIST_OK), "pslist_remove() should return PSLIST_OK" );
+	check( (a.n==3), "list a should have three elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 1, "3" );
+	check_entry( &a, 2, "4" );
+
+	status = pslist_remove( &a, 2 );
+	check( (status==PSLIST_OK), "pslist_remove() should return PSLIST_OK" );
+	check( (a.n==2), "list a should have two elements" );
+	check_entry( &a, 1, "3" );
+
+	pslist_free( &a );
+	return 0;
+}
+
+/*
+ * int     pslist_tokenize( pslist *tokens, str *in, const char *delim, int merge_delim );
+ * int     pslist_tokenizec( pslist *tokens, const char *p, const char *delim, int merge_delim );
+ */
+int
+test_tokenize( void )
+{
+	int status;
+	pslist a;
+	str s;
+
+	str_init( &s );
+	pslist_init( &a );
+
+	str_strcpyc( &s, "1 2 3 4 5" );
+	status = pslist_tokenize( &a, &s, " \t", 0 );
+	check( (status==PSLIST_OK), "pslist_tokenize() should return PSLIST_OK" );
+	check( (a.n==5), "list a should have five elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 4, "5" );
+
+	status = pslist_tokenizec( &a, "1\t2\t3\t4\t5", " \t", 1 );
+	check( (status==PSLIST_OK), "pslist_tokenizec() should return PSLIST_OK" );
+	check( (a.n==5), "list a should have five elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 4, "5" );
+
+	status = pslist_tokenizec( &a, "1  2 3 4", " \t", 0 );
+	check( (status==PSLIST_OK), "pslist_tokenizec() should return PSLIST_OK" );
+	check( (a.n==5), "list a should have five elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 1, "" );
+	check_entry( &a, 2, "2" );
+	check_entry( &a, 3, "3" );
+	check_entry( &a, 4, "4" );
+
+	status = pslist_tokenizec( &a, "1  2 3 4", " \t", 1 );
+	check( (status==PSLIST_OK), "pslist_tokenizec() should return PSLIST_OK" );
+	check( (a.n==4), "list a should have four elements" );
+	check_entry( &a, 0, "1" );
+	check_entry( &a, 1, "2" );
+	check_entry( &a, 2, "3" );
+	check_entry( &a, 3, "4" );
+
+	str_empty( &s );
+	status = pslist_tokenize( &a, &s, " \t", 0 );
+	check( (status==PSLIST_OK), "pslist_tokenize() should return PSLIST_OK" );
+	check( (a.n==0), "list a should be empty" );
+
+	pslist_free( &a );
+	str_free( &s );
+	return 0;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_init();
+	failed += test_add();
+	failed += test_remove();
+	failed += test_tokenize();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
@@ -1441,6 +1441,219 @@ test_findnocasec( void )
 	return 0;
 }
 
+/*
+ * int slist_findcn( slist *a, const char *searchstr, slist_index len );
+ */
+int
+test_findcn( void )
+{
+	char buf[] = "boorishness";
+	int n, status;
+	slist a;
+
+	slist_init( &a );
+
+	status = slist_addc_all( &a, "churlish", "boorish", "", NULL );
+	check( (status==SLIST_OK), "slist_addc_all() should return SLIST_OK" );
+
+	n = slist_findcn( &a, buf, 7 );
+	check( (n==1), "slist_findcn() should find 'boorish' at the start of 'boorishness'" );
+	n = slist_findcn( &a, buf, 4 );
+	check( (n==-1), "slist_findcn() should not find 'boor'" );
+	n = slist_findcn( &a, buf, 0 );
+	check( (n==2), "slist_findcn() should find the empty string" );
+
+	status = slist_hash( &a );
+	check( (status==SLIST_OK), "slist_hash() should return SLIST_OK" );
+	n = slist_findcn( &a, buf, 7 );
+	check( (n==1), "slist_findcn() should find 'boorish' through the index" );
+	n = slist_findcn( &a, buf, 4 );
+	check( (n==-1), "slist_findcn() should not find 'boor' through the index" );
+
+	slist_free( &a );
+
+	return 0;
+}
+
+/* sorted lists find the first of several equal strings */
+int
+test_findsorted( void )
+{
+	int n, status;
+	slist a;
+
+	slist_init( &a );
+
+	status = slist_addc_all( &a, "a", "b", "b", "b", "c", "d", "e", NULL );
+	check( (status==SLIST_OK), "slist_addc_all() should return SLIST_OK" );
+	check( (a.sorted), "list should be sorted" );
+
+	n = slist_findc( &a, "b" );
+	check( (n==1), "slist_findc() should find the first 'b'" );
+	n = slist_findc( &a, "e" );
+	check( (n==6), "slist_findc() should find 'e'" );
+	n = slist_findc( &a, "bb" );
+	check( (n==-1), "slist_findc() should not find 'bb'" );
+
+	slist_free( &a );
+
+	return 0;
+}
+
+/*
+ * int slist_hash( slist *a );
+ */
+int
+test_hash( void )
+{
+	int i, n, status;
+	char buf[64];
+	slist a, b;
+
+	slists_init( &a, &b, NULL );
+
+	for ( i=0; i<500; ++i ) {
+		sprintf( buf, "word%d", i );
+		slist_addc( &a, buf );
+	}
+	status = slist_hash( &a );
+	check( (status==SLIST_OK), "slist_hash() should return SLIST_OK" );
+
+	for ( i=0; i<500; ++i ) {
+		sprintf( buf, "word%d", i );
+		n = slist_findc( &a, buf );
+		check( (n==i), "slist_findc() should find each string" );
+		sprintf( buf, "WORD%d", i );
+		n = slist_findnocasec( &a, buf );
+		check( (n==i), "slist_findnocasec() should find each string" );
+		n = slist_findc( &a, buf );
+		check( (n==-1), "slist_findc() should not ignore case" );
+	}
+
+	/* adding keeps the index, and it grows */
+	for ( i=500; i<1000; ++i ) {
+		sprintf( buf, "word%d", i );
+		check( (slist_addc_unique( &a, buf )!=NULL), "slist_addc_unique() should succeed" );
+		check( (slist_addc_unique( &a, "word7" )!=NULL), "slist_addc_unique() should succeed" );
+	}
+	check_len( &a, 1000 );
+	n = slist_findc( &a, "word999" );
+	check( (n==999), "slist_findc() should find a string added after indexing" );
+
+	/* the first of equal strings is found */
+	slist_addc( &a, "WORD3" );
+	slist_addc( &a, "word3" );
+	n = slist_findc( &a, "WORD3" );
+	check( (n==1000), "slist_findc() should find 'WORD3' where it was added" );
+	n = slist_findc( &a, "word3" );
+	check( (n==3), "slist_findc() should find the first 'word3'" );
+	n = slist_findnocasec( &a, "Word3" );
+	check( (n==3), "slist_findnocasec() should find the first match" );
+
+	/* other changes */
+	slist_remove( &a, 0 );
+	n = slist_findc( &a, "word1" );
+	check( (n==0), "index should follow slist_remove()" );
+	slist_swap( &a, 0, 1 );
+	n = slist_findc( &a, "word1" );
+	check( (n==1), "index should follow slist_swap()" );
+	slist_setc( &a, 2, "changed" );
+	n = slist_findc( &a, "changed" );
+	check( (n==2), "index should follow slist_setc()" );
+	n = slist_findc( &a, "word3" );
+	check( (n==1000), "index should follow slist_setc()" );
+	slist_trimend( &a, 1 );
+	n = slist_findc( &a, "word3" );
+	check( (n==-1), "index should follow slist_trimend()" );
+
+	slist_sort( &a );
+	for ( i=0; i<a.n; ++i ) {
+		n = slist_findc( &a, slist_cstr( &a, i ) );
+		check( (n==i), "index should follow slist_sort()" );
+	}
+
+	status = slist_copy( &b, &a );
+	check( (status==SLIST_OK), "slist_copy() should return SLIST_OK" );
+	n = slist_findc( &b, "word500" );
+	check( (n==slist_findc( &a, "word500" )), "a copy should find what the original does" );
+	slist_addc( &b, "copied" );
+	n = slist_findc( &b, "copied" );
+	check( (n==b.n-1), "a copy should index its own additions" );
+	n = slist_findc( &a, "copied" );
+	check( (n==-1), "a copy's additions shouldn't reach the original" );
+
+	slist_empty( &a );
+	n = slist_findc( &a, "word500" );
+	check( (n==-1), "index should follow slist_empty()" );
+	slist_addc( &a, "word500" );
+	n = slist_findc( &a, "word500" );
+	check( (n==0), "an emptied list should stay indexed" );
+
+	slists_free( &a, &b, NULL );
+
+	return 0;
+}
+
+/* the index follows each change to the list, with many equal strings */
+int
+test_hash_changes( void )
+{
+	const char *words[] = { "a", "A", "b", "B", "cc", "Cc", "dd", "" };
+	int nwords = sizeof( words ) / sizeof( words[0] );
+	int i, j, n, m;
+	slist a, b;
+
+	slists_init( &a, &b, NULL );
+	slist_hash( &a );
+
+	srand( 45 );
+	for ( i=0; i<20000; ++i ) {
+		switch ( rand() % 6 ) {
+		case 0:
+		case 1:
+			slist_addc( &a, words[ rand() % nwords ] );
+			slist_addc( &b, slist_cstr( &a, a.n-1 ) );
+			break;
+		case 2:
+			if ( !a.n ) break;
+			n = rand() % a.n;
+			slist_setc( &a, n, words[ rand() % nwords ] );
+			slist_setc( &b, n, slist_cstr( &a, n ) );
+			break;
+		case 3:
+			if ( !a.n ) break;
+			n = rand() % a.n;
+			m = rand() % a.n;
+			slist_swap( &a, n, m );
+			slist_swap( &b, n, m );
+			break;
+		case 4:
+			if ( !a.n ) break;
+			n = rand() % a.n;
+			slist_remove( &a, n );
+			slist_remove( &b, n );
+			break;
+		case 5:
+			if ( rand() % 8 ) break;
+			n = rand() % 4;
+			slist_trimend( &a, n );
+			slist_trimend( &b, n );
+			break;
+		}
+		check_len( &a, b.n );
+		for ( j=0; j<nwords; ++j ) {
+			check( (slist_findc( &a, words[j] )==slist_findc( &b, words[j] )),
+				"slist_findc() should find what a scan finds" );
+			check( (slist_findnocasec( &a, words[j] )==slist_findnocasec( &b, words[j] )),
+				"slist_findnocasec() should find what a scan finds" );
+		}
+	}
+
+	slists_free( &a, &b, NULL );
+
+	return 0;
+}
+
 /*
  * int slist_match_entry( slist *a, int n, const char *s );
  */
@@ -1798,6 +2011,10 @@ main( int argc, char *argv[] )
 	failed += test_findc();
 	failed += test_findnocase();
 	failed += test_findnocasec();
+	failed += test_findcn();
+	failed += test_findsorted();
+	failed += test_hash();
+	failed += test_hash_changes();
 	failed += test_match_entry();
 
 	failed += test_fill();
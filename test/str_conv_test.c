@@ -0,0 +1,196 @@
+/*
+ * str_conv_test.c
+ *
+ * Copyright (c) 2018
+ *
+ * Source code released under the GPL version 2
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "str.h"
+#include "str_conv.h"
+#include "charsets.h"
+#include "entities.h"
+#include "latex.h"
+#include "utf8.h"
+#include "gb18030.h"
+
+char progname[] = "str_conv_test";
+char version[] = "0.1";
+
+/*
+ * The reference conversion: str_convert() as it was before clean
+ * ASCII runs were copied in bulk, one character at a time through
+ * the same decoders and encoders. latex output never takes the
+ * bulk path and isn't covered here.
+ */
+static int
+ref_xmlchar( str *s, unsigned int ch )
+{
+	if ( ch==34 )      { str_strcatc( s, "&quot;" ); return 1; }
+	else if ( ch==38 ) { str_strcatc( s, "&amp;" );  return 1; }
+	else if ( ch==39 ) { str_strcatc( s, "&apos;" ); return 1; }
+	else if ( ch==60 ) { str_strcatc( s, "&lt;" );   return 1; }
+	else if ( ch==62 ) { str_strcatc( s, "&gt;" );   return 1; }
+	return 0;
+}
+
+static void
+ref_entity( str *s, unsigned int ch )
+{
+	char buf[32];
+	sprintf( buf, "&#%u;", ch );
+	str_strcatc( s, buf );
+}
+
+static void
+ref_write( str *s, unsigned int ch, int charsetout, int utf8out, int xmlout )
+{
+	unsigned char code[6];
+	unsigned int c;
+	int i, nc;
+
+	if ( utf8out || charsetout==CHARSET_GB18030 ) {
+		if ( xmlout ) {
+			if ( ref_xmlchar( s, ch ) ) return;
+			if ( ch > 127 && xmlout==STR_CONV_XMLOUT_ENTITIES ) {
+				ref_entity( s, ch );
+				return;
+			}
+		}
+		if ( utf8out ) nc = utf8_encode( ch, code );
+		else nc = gb18030_encode( ch, code );
+		for ( i=0; i<nc; ++i )
+			str_addchar( s, code[i] );
+	} else {
+		c = charset_lookupuni( charsetout, ch );
+		if ( !xmlout ) str_addchar( s, c );
+		else if ( ref_xmlchar( s, c ) ) return;
+		else if ( c > 127 ) ref_entity( s, c );
+		else str_addchar( s, c );
+	}
+}
+
+static void
+ref_convert( str *s, str *out, int charsetin, int latexin, int utf8in, int xmlin,
+		int charsetout, int utf8out, int xmlout )
+{
+	unsigned int pos = 0, ch;
+	int unicode, err;
+
+	str_strcpyc( out, "" );
+	while ( pos < s->len && s->data[pos] ) {
+		unicode = 0;
+		err = 0;
+		if ( xmlin && s->data[pos]=='&' ) {
+			ch = decode_entity( s->data, &pos, &unicode, &err );
+		} else if ( charsetin==CHARSET_GB18030 ) {
+			ch = gb18030_decode( s->data, &pos );
+			unicode = 1;
+		} else if ( latexin ) {
+			if ( utf8in && ( s->data[pos] & 128 ) ) {
+				ch = utf8_decode( s->data, &pos );
+				unicode = 1;
+			} else ch = latex2char( s->data, &pos, &unicode );
+		} else if ( utf8in ) {
+			ch = utf8_decode( s->data, &pos );
+		} else {
+			ch = ( unsigned int ) s->data[pos];
+			pos++;
+		}
+		if ( !unicode && charsetin!=CHARSET_UNICODE )
+			ch = charset_lookupchar( charsetin, ch );
+		ref_write( out, ch, charsetout, utf8out, xmlout );
+	}
+}
+
+/* pieces that exercise clean runs, their stops, and what follows them */
+static const char *pieces[] = {
+	"a", "Z", "0", " ", ".", "}", "|", "plain words ",
+	"\"", "&", "'", "<", ">",
+	"&amp;", "&lt;", "&#233;", "&#x4e2d;", "&eacute;", "&bogus", "&#",
+	"{", "\\", "~", "$", "`", "-", "^",
+	"{\\'e}", "\\'e", "\\\"o", "\\alpha", "$\\beta$", "--", "---", "``", "''", "\\&", "{}",
+	"\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xe9", "\x81\x30\x81\x30",
+};
+
+#define NPIECES ( sizeof( pieces ) / sizeof( pieces[0] ) )
+
+#define NSTRINGS (400000)
+
+int
+test_convert( void )
+{
+	int charsets[5], xmlouts[3] = { STR_CONV_XMLOUT_FALSE, STR_CONV_XMLOUT_TRUE, STR_CONV_XMLOUT_ENTITIES };
+	int charsetin, latexin, utf8in, xmlin, charsetout, utf8out, xmlout;
+	int i, j, n, failed = 0;
+	str s, in, ref;
+
+	charsets[0] = CHARSET_UNICODE;
+	charsets[1] = CHARSET_GB18030;
+	charsets[2] = CHARSET_UNKNOWN;
+	charsets[3] = charset_find( "ISO-8859-1" );
+	charsets[4] = charset_find( "CP1252" );
+	if ( charsets[3]==CHARSET_UNKNOWN ) charsets[3] = CHARSET_UNICODE;
+	if ( charsets[4]==CHARSET_UNKNOWN ) charsets[4] = CHARSET_UNICODE;
+
+	strs_init( &s, &in, &ref, NULL );
+
+	srand( 2018 );
+	for ( i=0; i<NSTRINGS && failed<10; ++i ) {
+
+		str_empty( &in );
+		n = rand() % 12;
+		for ( j=0; j<n; ++j )
+			str_strcatc( &in, pieces[ rand() % NPIECES ] );
+		/* a multibyte decoder cut off by the end reads past the NUL */
+		if ( n ) str_strcatc( &in, "end." );
+
+		charsetin  = charsets[ rand() % 5 ];
+		latexin    = rand() % 2;
+		utf8in     = rand() % 2;
+		xmlin      = rand() % 2;
+		/* numeric entities in GB18030 input go to charset_lookupchar() */
+		/* with no table to look in                                      */
+		if ( charsetin==CHARSET_GB18030 ) xmlin = 0;
+		charsetout = charsets[ rand() % 5 ];
+		utf8out    = rand() % 2;
+		xmlout     = xmlouts[ rand() % 3 ];
+
+		str_strcpy( &s, &in );
+		str_convert( &s, charsetin, latexin, utf8in, xmlin, charsetout, 0, utf8out, xmlout );
+
+		if ( charsetin==CHARSET_UNKNOWN ) charsetin = CHARSET_DEFAULT;
+		if ( charsetout==CHARSET_UNKNOWN ) charsetout = CHARSET_DEFAULT;
+		if ( in.len ) ref_convert( &in, &ref, charsetin, latexin, utf8in, xmlin, charsetout, utf8out, xmlout );
+		else str_strcpyc( &ref, "" );
+
+		if ( strcmp( str_cstr( &s ), str_cstr( &ref ) ) ) {
+			fprintf( stdout, "%s: str_convert( '%s', in %d/%d/%d/%d, out %d/%d/%d ) gave '%s', expected '%s'\n",
+				progname, str_cstr( &in ), charsetin, latexin, utf8in, xmlin,
+				charsetout, utf8out, xmlout, str_cstr( &s ), str_cstr( &ref ) );
+			failed++;
+		}
+	}
+
+	strs_free( &s, &in, &ref, NULL );
+
+	return ( failed!=0 );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	failed += test_convert();
+
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}
@@ -1019,11 +1019,37 @@ test_swapstrings( str *s )
 	if ( string_mismatch( s, 5, "abcde" ) ) failed++;
 	if ( string_mismatch( &t, 10, "0123456789" ) ) failed++;
 
+	/* one short, one grown past its first allocation */
+	str_strcpyc( &t, "0123456789012345678901234567890123456789012345678901234567890123456789" );
+	str_swapstrings( s, &t );
+	if ( string_mismatch( &t, 5, "abcde" ) ) failed++;
+	if ( string_mismatch( s, 70, "0123456789012345678901234567890123456789012345678901234567890123456789" ) ) failed++;
+	str_addchar( &t, 'f' );
+	if ( string_mismatch( &t, 6, "abcdef" ) ) failed++;
+
 	str_free( &t );
 
 	return failed;
 }
 
+/* strings grown a character at a time, through each reallocation */
+static int
+test_grow( str *s )
+{
+	char expected[256];
+	int failed = 0, i;
+
+	str_empty( s );
+	for ( i=0; i<255; ++i ) {
+		str_addchar( s, 'a' + i%26 );
+		expected[i] = 'a' + i%26;
+		expected[i+1] = '\0';
+		if ( string_mismatch( s, i+1, expected ) ) failed++;
+	}
+
+	return failed;
+}
+
 int
 main ( int argc, char *argv[] )
 {
@@ -1096,6 +1122,8 @@ main ( int argc, char *argv[] )
 		failed += test_char( &s );
 	for ( i=0; i<ntest; ++i )
 		failed += test_swapstrings( &s );
+	for ( i=0; i<ntest; ++i )
+		failed += test_grow( &s );
 	for ( i=0; i<ntest; ++i )
 		failed += test_match( &s );
 
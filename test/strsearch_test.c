@@ -0,0 +1,198 @@
+/*
+ * strsearch_test.c
+ *
+ * test strsearch function
+ *
+ * run as "strsearch_test --benchmark" to time searches over
+ * multi-megabyte buffers
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "strsearch.h"
+
+char progname[] = "strsearch_test";
+char version[] = "0.1";
+
+/* reference implementation, the original O(n*m) search */
+static char *
+naive_strsearch( const char *haystack, const char *needle )
+{
+	char *returnptr=NULL;
+	unsigned long pos=0;
+
+	if ( !(*needle) ) returnptr = (char *) haystack;
+
+	while (*(haystack+pos) && returnptr==NULL) {
+		if ( toupper((unsigned char)*(haystack+pos)) == toupper((unsigned char)*(needle+pos)) )
+			pos++;
+		else {
+			pos = 0;
+			haystack++;
+		}
+		if ( ! (*(needle+pos)) ) returnptr = (char *) haystack;
+	}
+	return returnptr;
+}
+
+static int
+test_found( const char *haystack, const char *needle, long expected )
+{
+	char *p;
+	long found;
+
+	p = strsearch( haystack, needle );
+	found = ( p ) ? (long)( p - haystack ) : -1;
+
+	if ( found != expected ) {
+		printf( "%s: Error strsearch( '%s', '%s' ) found %ld, expected %ld\n",
+			progname, haystack, needle, found, expected );
+		return 1;
+	}
+	return 0;
+}
+
+static int
+test_fixed( void )
+{
+	int failed = 0;
+
+	failed += test_found( "", "", 0 );
+	failed += test_found( "abc", "", 0 );
+	failed += test_found( "", "a", -1 );
+	failed += test_found( "a", "a", 0 );
+	failed += test_found( "a", "A", 0 );
+	failed += test_found( "a", "ab", -1 );
+	failed += test_found( "abc", "c", 2 );
+	failed += test_found( "abc", "C", 2 );
+	failed += test_found( "abc", "d", -1 );
+	failed += test_found( "Hello World", "world", 6 );
+	failed += test_found( "Hello World", "WORLDS", -1 );
+	failed += test_found( "aaaaaaaaab", "AAAB", 6 );
+	failed += test_found( "abababababc", "ababc", 6 );
+	failed += test_found( "<mods:mods ID=\"x\"></MODS:MODS>", "</mods:mods>", 18 );
+	failed += test_found( "<mods ID=\"x\">", "<mods ", 0 );
+	failed += test_found( "<modsCollection><mods>", "<mods>", 16 );
+	failed += test_found( "xxxx</PubmedArticle", "</PubmedArticle>", -1 );
+	failed += test_found( "\xc3\xa9t\xc3\xa9", "t\xc3\xa9", 2 );
+
+	return failed;
+}
+
+/* compare against the reference implementation on random strings
+ * over a small alphabet to exercise periodic needles */
+static int
+test_random( void )
+{
+	const char alphabet[] = "aAbB<";
+	char haystack[200], needle[20];
+	int failed = 0, i, j, nh, nn;
+	char *p, *q;
+
+	srand( 1 );
+
+	for ( i=0; i<20000 && failed<10; ++i ) {
+		nh = rand() % ( sizeof( haystack ) - 1 );
+		nn = rand() % ( sizeof( needle ) - 1 );
+		for ( j=0; j<nh; ++j )
+			haystack[j] = alphabet[ rand() % ( sizeof( alphabet ) - 1 ) ];
+		haystack[nh] = '\0';
+		for ( j=0; j<nn; ++j )
+			needle[j] = alphabet[ rand() % ( sizeof( alphabet ) - 1 ) ];
+		needle[nn] = '\0';
+		p = strsearch( haystack, needle );
+		q = naive_strsearch( haystack, needle );
+		if ( p!=q ) {
+			printf( "%s: Error strsearch( '%s', '%s' ) found %ld, expected %ld\n",
+				progname, haystack, needle,
+				( p ) ? (long)( p - haystack ) : -1L,
+				( q ) ? (long)( q - haystack ) : -1L );
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+static double
+time_search( char *(*f)( const char *, const char * ), const char *haystack, const char *needle, int nrepeat, char **result )
+{
+	clock_t start;
+	int i;
+
+	start = clock();
+	for ( i=0; i<nrepeat; ++i )
+		*result = f( haystack, needle );
+	return (double)( clock() - start ) / CLOCKS_PER_SEC / nrepeat;
+}
+
+static void
+benchmark_one( const char *label, const char *haystack, const char *needle, int nrepeat )
+{
+	char *p, *q;
+	double tnew, told;
+
+	tnew = time_search( strsearch, haystack, needle, nrepeat, &p );
+	told = time_search( naive_strsearch, haystack, needle, nrepeat, &q );
+
+	printf( "%-36s strsearch %8.3f ms   naive %8.3f ms%s\n", label,
+		tnew * 1000., told * 1000., ( p==q ) ? "" : "   MISMATCH" );
+}
+
+/* multi-megabyte buffers with the needle only at the very end */
+static void
+benchmark( void )
+{
+	const char record[] = "<mods:mods ID=\"ref\"><mods:titleInfo><mods:title>"
+		"Title</mods:title></mods:titleInfo></mods:mod></mods:mods";
+	const size_t size = 8 * 1024 * 1024;
+	char *haystack, *needle;
+	size_t i, n = strlen( record );
+
+	haystack = malloc( size + 64 );
+	needle   = malloc( 1024 + 2 );
+	if ( !haystack || !needle ) {
+		fprintf( stderr, "%s: cannot allocate benchmark memory\n", progname );
+		exit( EXIT_FAILURE );
+	}
+
+	/* XML records where every "</mods:mod" almost matches */
+	for ( i=0; i+n<size; i+=n ) memcpy( haystack+i, record, n );
+	strcpy( haystack+i, "</MODS:MODS>" );
+	benchmark_one( "8MB xml, '</mods:mods>'", haystack, "</mods:mods>", 3 );
+	benchmark_one( "8MB xml, '</PubmedArticle>'", haystack, "</PubmedArticle>", 3 );
+
+	/* highly repetitive text with a long, nearly matching needle */
+	memset( haystack, 'a', size/8 );
+	strcpy( haystack+size/8, "B" );
+	memset( needle, 'A', 1024 );
+	needle[1024] = 'b';
+	needle[1025] = '\0';
+	benchmark_one( "1MB 'a', 1kB 'A...Ab' needle", haystack, needle, 1 );
+
+	free( needle );
+	free( haystack );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int failed = 0;
+
+	if ( argc > 1 && !strcmp( argv[1], "--benchmark" ) ) {
+		benchmark();
+		return EXIT_SUCCESS;
+	}
+
+	failed += test_fixed();
+	failed += test_random();
+	if ( !failed ) {
+		printf( "%s: PASSED\n", progname );
+		return EXIT_SUCCESS;
+	} else {
+		printf( "%s: FAILED\n", progname );
+		return EXIT_FAILURE;
+	}
+}